@@ -2,7 +2,10 @@
 #pragma once
 
 #include "../include/Ms3dModel.h"
+#include "../include/Ms3dPoseCache.h"
 #include <vector>
+#include <map>
+#include <string>
 
 /** Loads *.ms3d model files. */
 class Ms3dLoader {
@@ -22,6 +25,9 @@ public:
     ~Ms3dLoader ();
 
     /** Loads ms3d model.
+    The file is read from disk only the first time, later models of the
+    same file are parsed from the cached file data. The model uses the
+    pose cache of the file, if there is one.
     @param[in] _modelFile  filename of the model
     @exception ErrorMessage 
     
@@ -54,11 +60,67 @@ public:
     @return the pointer to the Ms3dModel object */
     Ms3dModel* GetModel (UINT _id) const;
     
-    /** Unloads all the models. */
+    /** Unloads all the models. The cached file data is kept. */
     void UnloadModels ();
 
+    /** Frees the cached file data. */
+    void ClearFileCache ();
+
+    /** Caches the data of a model file which is already read,
+    so the models of the file are not read from disk again.
+    @param[in] _modelFile  filename of the model
+    @param[in,out] _data  the file data, it is taken over unless the file is already cached
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_OUT_OF_MEM not enough memory */
+    void AddFileData (const char* _modelFile, std::vector<char>& _data);
+
+    /** Checks if the data of a model file is cached.
+    @param[in] _modelFile  filename of the model
+    @return @c true the file is cached. @c false otherwise */
+    bool IsFileCached (const char* _modelFile) const;
+
+    /** Samples an animation clip of a model file to the pose cache of the file.
+    The cache is shared by all the models of the file, loaded before or after.
+    @param[in] _modelFile  filename of the model
+    @param[in] _name  name of the clip, used in the reports only
+    @param[in] _startTime  the time of the animation where the clip starts
+    @param[in] _endTime  the time of the animation where the clip ends
+    @param[in] _sampleRate  palettes per second of the animation
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_FILE_NOT_FOUND the specified model filename does not exist
+        - @c ERRC_BAD_FILE the file is either corrupted or not *.ms3d format
+        - @c ERRC_INVALID_PARAMETER the model has no joints, the times or the rate are invalid
+        - @c ERRC_OUT_OF_MEM not enough memory for the palettes
+
+    @return ID of the clip in the pose cache of the file */
+    UINT BakeClip (const char* _modelFile, const char* _name, float _startTime, float _endTime, float _sampleRate);
+
+    /** Returns the pose cache of a model file.
+    @param[in] _modelFile  filename of the model
+    @return the pose cache, NULL if no clip of the file is sampled */
+    const Ms3dPoseCache* GetPoseCache (const char* _modelFile) const;
+
+    /** Frees the pose caches, the models interpolate their keyframes again. */
+    void ClearPoseCaches ();
+
 private:
+    /** Returns the cached data of the model file, reading the file if needed.
+    @param[in] _modelFile  filename of the model
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_FILE_NOT_FOUND the specified model filename does not exist
+        - @c ERRC_BAD_FILE the file cannot be read
+    @return the file data */
+    const std::vector<char>& GetFileData (const char* _modelFile);
+
     std::vector<Ms3dModel*> m_Models;   /**< A vector of the pointers to the loaded models */
+    std::map<std::string, std::vector<char>> m_Files;  /**< Model file data by filename */
+    std::map<std::string, Ms3dPoseCache> m_PoseCaches; /**< Sampled animation clips by model filename */
 
     LogManager* m_Log;                  /**< A log manager */
 };
\ No newline at end of file
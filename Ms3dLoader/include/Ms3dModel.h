@@ -17,10 +17,12 @@
     #pragma comment (lib, "lib/Debug/Log.lib")
     #pragma comment (lib, "lib/Debug/RendererLoader.lib")
     #pragma comment (lib, "lib/Debug/ErrorMessage.lib")
+    #pragma comment (lib, "lib/Debug/PackFile.lib")
 #else
     #pragma comment (lib, "lib/Log.lib")
     #pragma comment (lib, "lib/RendererLoader.lib")
     #pragma comment (lib, "lib/ErrorMessage.lib")
+    #pragma comment (lib, "lib/PackFile.lib")
 #endif
 
 #pragma pack (push, packing)
@@ -52,11 +54,14 @@ namespace ms3d {
         UCHAR Flag;             /**< Unimportant. */
         char Name[32];          /**< Mesh name. */
         USHORT NumTriangles;    /**< Number of triangles in the mesh. */
-        USHORT* TriIndex;       /**< Indices of the triangles. */
+        USHORT* TriIndex;       /**< Indices of the triangles. They are owned by the model. */
         char Material;          /**< Material ID. -1 - no material. */
 
+        UINT FirstRenderVertex; /**< Index of the first render vertex of the mesh in the model render vertices. */
+        USHORT NumRenderVertices;   /**< Number of the unique render vertices of the mesh. */
+        UINT FirstRenderIndex;  /**< Index of the first index of the mesh in the model render indices. */
+
         MESH ();    /**< Constructor. */
-        ~MESH ();   /**< Destructor. */
     };
 
     /** Model material. */
@@ -88,28 +93,40 @@ namespace ms3d {
         float Position[3];          /**< Position. */
         USHORT NumRotFrames;        /**< Number of the rotation keyframes. */
         USHORT NumTransFrames;      /**< Number of the translation keyframes. */
-        KEYFRAME* RotKeyFrame;      /**< Rotation keyframes. */
-        KEYFRAME* TransKeyFrame;    /**< Translation keyframes. */
-
-        VERTEX* Vertex;             /**< Array of the vertices which belongs to the joint. */
-        VERTEX* Transformed;        /**< Array of the transformed vertices. */
-        D3DXVECTOR3* Normal;        /**< Array of the normals. */
-        D3DXVECTOR3* RotatedNormal; /**< Array of the transformed normals. */
-        USHORT NumVertices;         /**< Number of the vertices in the array. */
-        short ParentId;             /**< Parent joint ID. */
-        D3DXMATRIX Local;           /**< Local matrix. */
-        D3DXMATRIX Absolute;        /**< Absolute matrix. */
-        D3DXMATRIX Final;           /**< Final matrix. */
+        KEYFRAME* RotKeyFrame;      /**< Rotation keyframes. They are owned by the model. */
+        KEYFRAME* TransKeyFrame;    /**< Translation keyframes. They are owned by the model. */
+
+        USHORT FirstVertex;         /**< Index of the first vertex of the joint in the model vertices. */
+        USHORT NumVertices;         /**< Number of the vertices of the joint. */
+        short ParentId;             /**< Parent joint ID. Load sorts the joints, so a parent always comes before its children. */
         USHORT CurRotFrame;         /**< Current rotation keyframe. */
         USHORT CurTransFrame;       /**< Current transformation keyframe. */
 
         JOINT ();   /** Constructor. */
-        ~JOINT ();  /** Destructor. */
+    };
+
+    /** Sections of the validated model file data.
+    The pointers point to the first record of the section in the file data. */
+    struct SECTIONS {
+        const char* Vertices;   /**< Vertex records. */
+        const char* Triangles;  /**< Triangle records. */
+        const char* Meshes;     /**< Mesh records. */
+        const char* Materials;  /**< Material records. */
+        const char* Joints;     /**< Joint records. */
+        USHORT NumVertices;     /**< Number of the vertices. */
+        USHORT NumTriangles;    /**< Number of the triangles. */
+        USHORT NumMeshes;       /**< Number of the meshes. */
+        USHORT NumMaterials;    /**< Number of the materials. */
+        USHORT NumJoints;       /**< Number of the joints. */
+        UINT NumTriIndices;     /**< Number of the triangle indices of all meshes. */
+        UINT NumKeyFrames;      /**< Number of the keyframes of all joints. */
     };
 }
 
 #pragma pack (pop, packing)
 
+class Ms3dPoseCache;
+
 /** A ms3d model data and methods to manipulate it. */
 class Ms3dModel {
 public:
@@ -137,18 +154,44 @@ public:
         - @c ERRC_OUT_OF_MEM not enough memory to load the file */
     void Load (const char* _filename);
 
+    /** Loads the model from the ms3d file data already in memory.
+    The data is copied, so it may be freed or reused afterwards.
+    @param[in] _filename the name of the ms3d model file, kept as the model filename
+    @param[in] _data the file data
+    @param[in] _size the size of the file data in bytes
+    @exception ErrorMessage 
+
+    - Possible error codes:
+        - @c ERRC_BAD_FILE the data is either corrupted or not *.ms3d format
+        - @c ERRC_OUT_OF_MEM not enough memory to load the model */
+    void Load (const char* _filename, const char* _data, UINT _size);
+
     /** Unloads the model. */
     void Unload ();
 
     /** Getter: vertices.
-    @param[in] _jointId joint ID
+    All the vertices are kept in a single array sorted by joint, the vertices
+    which do not belong to any joint come first. The vertices of a joint are
+    in its local space.
+    @param[in] _jointId joint ID, -1 for the vertices without a joint
     @Exception ErrorMessage
 
     -Possible error codes:
         - @c ERRC_OUT_OF_RANGE invalid joint ID
 
-    @return model vertices */
+    @return the first vertex of the joint */
     ms3d::VERTEX* GetVertices (short _jointId);
+
+    /** Getter: number of the joints.
+    @return number of the joints */
+    USHORT GetNumJoints () const;
+
+    /** Getter: matrix palette.
+    The palette holds a final matrix per joint for the current animation
+    pose. A vertex is skinned by the matrix of its BoneId, without the model
+    transformations.
+    @return the final matrices of the joints */
+    const D3DXMATRIX* GetPalette () const;
     
     /** Getter: triangles.
     @return model triangles */
@@ -187,6 +230,30 @@ public:
     @param[in] _loop whether loop the animation or not */
     void Animate (float _speed, float _startTime, float _endTime, bool _loop);
 
+    /** Advances the animation time without evaluating the pose.
+    The joint palette keeps the last evaluated pose until EvaluatePose is called.
+    @param[in] _speed the animation speed. 1.0f is a normal speed.
+    @param[in] _startTime the time of the animation where it has to start
+    @param[in] _endTime the time of the animation where it has to stop
+    @param[in] _loop whether loop the animation or not */
+    void AdvanceAnimation (float _speed, float _startTime, float _endTime, bool _loop);
+
+    /** Evaluates the joint palette at the current animation time.
+    If the current clip is in the pose cache, the palette is blended from
+    the cached samples, otherwise the keyframes are interpolated. */
+    void EvaluatePose ();
+
+    /** Interpolates the keyframes of all joints at the given time.
+    The current pose of the model is not changed.
+    @param[in] _time the time of the animation
+    @param[out] _palette a final matrix per joint */
+    void SamplePose (float _time, D3DXMATRIX* _palette);
+
+    /** Setter: pose cache.
+    The cache is not owned by the model.
+    @param[in] _cache the sampled clips of the model file, NULL to interpolate the keyframes */
+    void SetPoseCache (const Ms3dPoseCache* _cache);
+
     /** Checks if model's animation is completed.
     If animation is looping, it returns always false.
     @return @c true model's animation is completed. @c false otherwise. */
@@ -230,52 +297,78 @@ public:
     @param[out] _max maximum x, y and z coordinates values */
     void GetBounds (float(&_min)[3], float(&_max)[3]);
 
+    /** Validates the model file data and finds its sections.
+    Every section size is checked against the data size, as well as
+    the vertex, triangle, material and parent joint references and names,
+    and that no joint is its own ancestor, before anything is allocated. Load calls it, the model is not changed.
+    @param[in] _filename the name of the ms3d model file
+    @param[in] _data the file data, its id string and version are already checked
+    @param[in] _size the size of the file data in bytes
+    @param[out] _sections the sections of the file data
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_BAD_FILE the data is truncated or corrupted */
+    void ValidateData (const char* _filename, const char* _data, UINT _size, ms3d::SECTIONS& _sections) const;
+
 private:
     /** Updates the bounds of the model. */
     void UpdateBounds ();
 
-    /** Loads the vertices.
-    @param[in,out] _modelData a pointer to model file data
-    @param[out] _vertex loaded vertices
-    @param[out] _numVertices number of the loaded vertices
-    @exception ErrorMessage 
-    
-    - Possible error codes:
-        - @c ERRC_OUT_OF_MEM not enough memory to load vertices
-        - @c ERRC_BAD_FILE the ms3d model file is corrupted */
-    void LoadVertices (char*& _modelData, ms3d::VERTEX*& _vertex, USHORT& _numVertices);
-    
+    /** Transforms the vertices by the matrix palette and the model transformations.
+    The vertices of each joint are transformed as one run of the vertex array.
+    @param[in] _world the model transformations
+    @param[in] _normals whether transform the normals too */
+    void SkinVertices (const D3DXMATRIX& _world, bool _normals);
+
     /** Loads the triangles.
-    @param[in] _modelData [in,out] a pointer to model file data
+    @param[in] _sections the sections of the validated file data
     @exception ErrorMessage 
     
     -Possible error codes:
         - @c ERRC_OUT_OF_MEM not enough memory to load triangles */
-    void LoadTriangles (char*& _modelData);
+    void LoadTriangles (const ms3d::SECTIONS& _sections);
 
     /** Loads the meshes.
-    @param[in] _modelData [in,out] a pointer to model file data
+    The triangle indices of all meshes are kept in a single array.
+    @param[in] _sections the sections of the validated file data
     @exception ErrorMessage 
     
     - Possible error codes:
         - @c ERRC_OUT_OF_MEM not enough memory to load meshes */
-    void LoadMeshes (char*& _modelData);
+    void LoadMeshes (const ms3d::SECTIONS& _sections);
 
     /** Loads the materials.
-    @param[in] _modelData [in,out] a pointer to model file data
+    @param[in] _sections the sections of the validated file data
     @exception ErrorMessage 
     
     - Possible error codes:
         - @c ERRC_OUT_OF_MEM not enough memory to load materials */
-    void LoadMaterials (char*& _modelData);
+    void LoadMaterials (const ms3d::SECTIONS& _sections);
 
     /** Loads the joints.
-    @param[in] _modelData [in,out] a pointer to model file data
+    The keyframes of all joints are kept in a single array. The joints are
+    sorted so that every parent comes before its children, the file order
+    is kept otherwise.
+    @param[in] _sections the sections of the validated file data
+    @param[out] _jointId the sorted ID of each joint of the file
     @exception ErrorMessage 
     
     - Possible error codes:
         - @c ERRC_OUT_OF_MEM not enough memory to load joints */
-    void LoadJoints (char*& _modelData);
+    void LoadJoints (const ms3d::SECTIONS& _sections, std::vector<short>& _jointId);
+
+    /** Builds the indexed render vertices of the meshes.
+    The corners of the triangles of a mesh which share a vertex and the texture
+    coordinates share a render vertex. The triangles are ordered for the
+    post-transform vertex cache, and the render vertices in the order of
+    their first use.
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_BAD_FILE a mesh has more than 65535 render vertices
+        - @c ERRC_OUT_OF_MEM not enough memory */
+    void BuildRenderBuffers ();
 
     /** Setter: filename
     @param[in] _filename filename of the model */
@@ -315,31 +408,43 @@ private:
     float m_StartTime;      /**< Animation's start time. */
     float m_EndTime;        /**< Animation's end time. */
     float m_LastTime;       /**< Last time of the animation. */
+    float m_PoseTime;       /**< Time of the animation where the pose is evaluated. */
     DWORD m_TimerLastClock; /**< Animation's last clock time. */
     bool m_IsAnimationCompleted;    /**< If animation is completed then it is true. */
+    const Ms3dPoseCache* m_PoseCache;   /**< The sampled clips of the model file. */
+    UINT m_PoseClip;                    /**< ID of the current clip in the pose cache, INVALID_ID if it is not sampled. */
 
-    ms3d::VERTEX* m_Vertex;         /**< The array of the model vertices which do not belong to any bone. */
-    ms3d::VERTEX* m_Transformed;    /**< The array of the transformed vertices which do not belong to any bone. */
-    D3DXVECTOR3* m_Normal;          /**< The array of the vertices' without bone normals. */
-    D3DXVECTOR3* m_RotatedNormal;   /**< The array of the vertices' without bone transformed normals. */
+    ms3d::VERTEX* m_Vertex;         /**< The array of the model vertices sorted by joint. */
+    D3DXVECTOR3* m_Transformed;     /**< The array of the transformed vertices. */
+    D3DXVECTOR3* m_Normal;          /**< The array of the vertex normals. */
+    D3DXVECTOR3* m_RotatedNormal;   /**< The array of the transformed vertex normals. */
     USHORT m_NumVertices;           /**< Number of the vertices. */
+    USHORT m_NumStaticVertices;     /**< Number of the vertices which do not belong to any joint. */
 
     ms3d::TRIANGLE* m_Triangle; /**< The array of the model triangles. */
     USHORT m_NumTriangles;      /**< Number of the triangles. */
 
     ms3d::MESH* m_Mesh;     /**< The array of the model meshes. */
     USHORT m_NumMeshes;     /**< Number of the meshes. */
+    USHORT* m_TriIndex;     /**< The triangle indices of all meshes. */
 
     ms3d::MATERIAL* m_Material; /**< The array of the model materials. */
     USHORT m_NumMaterials;      /**< Number of the materials. */
 
     ms3d::JOINT* m_Joint;   /**< The array of the model joints. */
     USHORT m_NumJoints;     /**< Number of the joints. */
+    ms3d::KEYFRAME* m_KeyFrame; /**< The keyframes of all joints. */
+    D3DXMATRIX* m_Local;        /**< The local matrices of the joints. */
+    D3DXMATRIX* m_Absolute;     /**< The absolute matrices of the joints in the bind pose. */
+    D3DXMATRIX* m_Palette;      /**< The final matrices of the joints in the current pose. */
 
     float m_Min[3];     /**< The model min bounds. */
     float m_Max[3];     /**< The model max bounds. */
 
-    vs3d::UUVERTEX* m_VertexData;   /**< The vertices for model rendering. */
+    vs3d::UUVERTEX* m_VertexData;   /**< The unique render vertices of all meshes, the texture coordinates are set on load. */
+    USHORT* m_RenderSource;         /**< The model vertex of each render vertex. */
+    UINT m_NumRenderVertices;       /**< Number of the render vertices. */
+    WORD* m_RenderIndex;            /**< The render indices of all meshes, relative to the first render vertex of their mesh. */
     std::vector<UINT> m_SkinId;     /**< The array of the model skins. */
 
     MATRIX44 m_Translation;     /**< The model translation matrix. */
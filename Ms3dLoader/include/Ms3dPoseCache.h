@@ -0,0 +1,83 @@
+/** @file Ms3dPoseCache.h */
+#pragma once
+
+#include "../include/Ms3dModel.h"
+#include <vector>
+#include <string>
+
+/** Joint palettes of the animation clips of a model file, sampled at a fixed rate.
+A cache is baked once per model file and shared by all models of the file.
+A model which finds its clip in the cache blends the two nearest sampled
+palettes instead of interpolating the keyframes of every joint. */
+class Ms3dPoseCache {
+public:
+    /** Constructor. */
+    Ms3dPoseCache ();
+
+    /** Samples the joint palettes of an animation clip.
+    The samples are evenly spaced from the start to the end of the clip,
+    at least _sampleRate of them per second of the animation.
+    @param[in] _model a loaded model of the file, its current pose is not changed
+    @param[in] _name name of the clip, used in the reports only
+    @param[in] _startTime the time of the animation where the clip starts
+    @param[in] _endTime the time of the animation where the clip ends
+    @param[in] _sampleRate palettes per second of the animation
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_INVALID_PARAMETER the model is not loaded, the times or the rate are invalid
+        - @c ERRC_OUT_OF_MEM not enough memory for the palettes
+
+    @return ID of the clip. If the clip is already sampled, its ID is returned. */
+    UINT AddClip (Ms3dModel& _model, const char* _name, float _startTime, float _endTime, float _sampleRate);
+
+    /** Finds a sampled clip.
+    @param[in] _startTime the time of the animation where the clip starts
+    @param[in] _endTime the time of the animation where the clip ends
+    @return ID of the clip, INVALID_ID if it is not sampled */
+    UINT FindClip (float _startTime, float _endTime) const;
+
+    /** Blends the palette of a clip at the given time.
+    @param[in] _clipId ID of the clip
+    @param[in] _time the time of the animation, clamped to the clip
+    @param[out] _palette a matrix per joint */
+    void GetPose (UINT _clipId, float _time, D3DXMATRIX* _palette) const;
+
+    /** Getter: number of the sampled clips.
+    @return number of the clips */
+    UINT GetNumClips () const;
+
+    /** Getter: clip name.
+    @param[in] _clipId ID of the clip
+    @return name of the clip */
+    const char* GetClipName (UINT _clipId) const;
+
+    /** Getter: number of the palettes of a clip.
+    @param[in] _clipId ID of the clip
+    @return number of the samples */
+    UINT GetClipNumSamples (UINT _clipId) const;
+
+    /** Getter: memory used by the palettes of a clip.
+    @param[in] _clipId ID of the clip
+    @return size in bytes */
+    UINT GetClipMemory (UINT _clipId) const;
+
+    /** Getter: memory used by all the palettes.
+    @return size in bytes */
+    UINT GetMemory () const;
+
+private:
+    /** A sampled clip. */
+    struct CLIP {
+        std::string Name;   /**< Name of the clip. */
+        float StartTime;    /**< The time of the animation where the clip starts. */
+        float EndTime;      /**< The time of the animation where the clip ends. */
+        float Rate;         /**< Samples per second, the spacing is exact. */
+        UINT NumSamples;    /**< Number of the palettes. */
+        UINT FirstMatrix;   /**< Index of the first matrix of the clip in the matrices. */
+    };
+
+    std::vector<CLIP> m_Clip;           /**< The sampled clips. */
+    std::vector<D3DXMATRIX> m_Matrix;   /**< The palettes of all clips, a palette holds a matrix per joint. */
+    USHORT m_NumJoints;                 /**< Number of the joints in a palette. */
+};
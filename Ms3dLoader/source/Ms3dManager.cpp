@@ -1,4 +1,5 @@
 #include "../include/Ms3dManager.h"
+#include "../include/PackFile.h"
 
 using namespace ms3d;
 
@@ -32,8 +33,15 @@ Ms3dLoader::~Ms3dLoader () {
 UINT Ms3dLoader::LoadModel (const char* _modelFile) {
     UINT id = m_Models.size();
     try {
+        const std::vector<char>& data = GetFileData (_modelFile);
         Ms3dModel* model = new Ms3dModel (m_Log);
-        model->Load (_modelFile);
+        try {
+            model->Load (_modelFile, data.empty () ? NULL : &data[0], data.size ());
+        } catch (ErrorMessage&) {
+            delete model;
+            throw;
+        }
+        model->SetPoseCache (GetPoseCache (_modelFile));
         m_Models.push_back (model);
     } catch (std::bad_alloc) {
         #ifdef _DEBUG
@@ -76,4 +84,96 @@ void Ms3dLoader::UnloadModels () {
         delete m_Models[i];
     }
     m_Models.clear();
+}
+
+void Ms3dLoader::ClearFileCache () {
+    m_Files.clear ();
+}
+
+void Ms3dLoader::AddFileData (const char* _modelFile, std::vector<char>& _data) {
+    if (IsFileCached (_modelFile)) {
+        return;
+    }
+    try {
+        m_Files[_modelFile].swap (_data);
+    } catch (std::bad_alloc) {
+        #ifdef _DEBUG
+            if (m_Log) {
+                m_Log->Log ("Error: Out of memory. (Ms3dLoader::AddFileData)\n");
+            }
+        #endif
+        THROW_ERROR (ERRC_OUT_OF_MEM);
+    }
+}
+
+bool Ms3dLoader::IsFileCached (const char* _modelFile) const {
+    return m_Files.find (_modelFile) != m_Files.end ();
+}
+
+UINT Ms3dLoader::BakeClip (const char* _modelFile, const char* _name, float _startTime, float _endTime, float _sampleRate) {
+    UINT id = INVALID_ID;
+    try {
+        const std::vector<char>& data = GetFileData (_modelFile);
+        Ms3dModel model (m_Log);
+        model.Load (_modelFile, data.empty () ? NULL : &data[0], data.size ());
+        Ms3dPoseCache& cache = m_PoseCaches[_modelFile];
+        id = cache.AddClip (model, _name, _startTime, _endTime, _sampleRate);
+        for (UINT i = 0; i < m_Models.size (); i++) {
+            if (strcmp (m_Models[i]->GetFilename (), _modelFile) == 0) {
+                m_Models[i]->SetPoseCache (&cache);
+            }
+        }
+    } catch (std::bad_alloc) {
+        #ifdef _DEBUG
+            if (m_Log) {
+                m_Log->Log ("Error: Out of memory. (Ms3dLoader::BakeClip)\n");
+            }
+        #endif
+        THROW_ERROR (ERRC_OUT_OF_MEM);
+    }
+    return id;
+}
+
+const Ms3dPoseCache* Ms3dLoader::GetPoseCache (const char* _modelFile) const {
+    std::map<std::string, Ms3dPoseCache>::const_iterator cache = m_PoseCaches.find (_modelFile);
+    if (cache == m_PoseCaches.end () || cache->second.GetNumClips () == 0) {
+        return NULL;
+    }
+    return &cache->second;
+}
+
+void Ms3dLoader::ClearPoseCaches () {
+    for (UINT i = 0; i < m_Models.size (); i++) {
+        m_Models[i]->SetPoseCache (NULL);
+    }
+    m_PoseCaches.clear ();
+}
+
+const std::vector<char>& Ms3dLoader::GetFileData (const char* _modelFile) {
+    std::map<std::string, std::vector<char>>::iterator cached = m_Files.find (_modelFile);
+    if (cached != m_Files.end ()) {
+        return cached->second;
+    }
+    std::vector<char> data;
+    try {
+        VirtualFile::Load (_modelFile, data);
+    } catch (ErrorMessage&) {
+        #ifdef _DEBUG
+            if (m_Log) {
+                m_Log->Log ("Error: Cannot open file %s. (Ms3dLoader::GetFileData)\n", _modelFile);
+            }
+        #endif
+        throw;
+    }
+    if (data.empty ()) {
+        #ifdef _DEBUG
+            if (m_Log) {
+                m_Log->Log ("Error: Cannot read file %s. (Ms3dLoader::GetFileData)\n", _modelFile);
+            }
+        #endif
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _modelFile);
+    }
+    std::vector<char>& cachedData = m_Files[_modelFile];
+    cachedData.swap (data);
+    return cachedData;
 }
\ No newline at end of file
@@ -1,62 +1,89 @@
 #include "../include/Ms3dModel.h"
+#include "../include/Ms3dPoseCache.h"
+#include "../include/PackFile.h"
+#include "../include/VertexCacheOptimizer.h"
 
 using namespace ms3d;
 
-MESH::MESH () {
-    TriIndex = NULL;
+/* sizes of the records in the file, they differ from the structures */
+#define MS3D_HEADER_SIZE 14
+#define MS3D_TRIANGLE_SIZE 70
+#define MS3D_MESH_HEADER_SIZE 35
+#define MS3D_ANIMATION_SIZE 12
+#define MS3D_JOINT_HEADER_SIZE 93
+
+/* Moves _data over _size bytes if they are there. */
+static bool SkipData (const char*& _data, const char* _end, UINT _size) {
+    if ((UINT)(_end - _data) < _size) {
+        return false;
+    }
+    _data += _size;
+    return true;
 }
 
-MESH::~MESH () {
-    delete[] TriIndex;
+/* Reads a section count and moves _data over it if it is there. */
+static bool ReadCount (const char*& _data, const char* _end, USHORT& _count) {
+    if ((UINT)(_end - _data) < sizeof (USHORT)) {
+        return false;
+    }
+    memcpy (&_count, _data, sizeof (USHORT));
+    _data += sizeof (USHORT);
+    return true;
 }
 
-JOINT::JOINT () {
-    memset (&Absolute, 0, sizeof (D3DXMATRIX));
-    Vertex = NULL;
-    Transformed = NULL;
-    Normal = NULL;
-    RotatedNormal = NULL;
-    NumVertices = 0;
-    RotKeyFrame = NULL;
-    TransKeyFrame = NULL;
+/* Checks that a fixed size name field is terminated. */
+static bool IsName (const char* _name, UINT _length) {
+    return memchr (_name, '\0', _length) != NULL;
+}
+
+MESH::MESH () {
+    TriIndex = NULL;
+    FirstRenderVertex = 0;
+    NumRenderVertices = 0;
+    FirstRenderIndex = 0;
 }
 
-JOINT::~JOINT () {
-    delete[] Vertex;
-    Vertex = NULL;
-    delete[] Transformed;
-    Transformed = NULL;
-    delete[] Normal;
-    Normal = NULL;
-    delete[] RotatedNormal;
-    RotatedNormal = NULL;
-    delete[] RotKeyFrame;
+JOINT::JOINT () {
     RotKeyFrame = NULL;
-    delete[] TransKeyFrame;
     TransKeyFrame = NULL;
+    FirstVertex = 0;
+    NumVertices = 0;
+    ParentId = -1;
 }
 
 Ms3dModel::Ms3dModel () {
     m_Filename[0] = '\0';
     m_StartTime = -1.0f;
     m_EndTime = -1.0f;
+    m_PoseTime = 0.0f;
     m_IsAnimationCompleted = false;
+    m_PoseCache = NULL;
+    m_PoseClip = INVALID_ID;
     m_Vertex = NULL;
     m_Transformed = NULL;
     m_Normal = NULL;
     m_RotatedNormal = NULL;
     m_NumVertices = 0;
+    m_NumStaticVertices = 0;
     m_Triangle = NULL;
     m_NumTriangles = 0;
     m_Mesh = NULL;
     m_NumMeshes = 0;
+    m_TriIndex = NULL;
     m_Material = NULL;
     m_NumMaterials = 0;
     m_Joint = NULL;
     m_NumJoints = 0;
+    m_KeyFrame = NULL;
+    m_Local = NULL;
+    m_Absolute = NULL;
+    m_Palette = NULL;
     m_Log = NULL;
     m_IsEmpty = true;
     m_VertexData = NULL;
+    m_RenderSource = NULL;
+    m_NumRenderVertices = 0;
+    m_RenderIndex = NULL;
     ClearTransformations ();
 }
 
@@ -64,23 +91,35 @@ Ms3dModel::Ms3dModel (LogManager* _log) {
     m_Filename[0] = '\0';
     m_StartTime = -1.0f;
     m_EndTime = -1.0f;
+    m_PoseTime = 0.0f;
     m_IsAnimationCompleted = false;
+    m_PoseCache = NULL;
+    m_PoseClip = INVALID_ID;
     m_Vertex = NULL;
     m_Transformed = NULL;
     m_Normal = NULL;
     m_RotatedNormal = NULL;
     m_NumVertices = 0;
+    m_NumStaticVertices = 0;
     m_Triangle = NULL;
     m_NumTriangles = 0;
     m_Mesh = NULL;
     m_NumMeshes = 0;
+    m_TriIndex = NULL;
     m_Material = NULL;
     m_NumMaterials = 0;
     m_Joint = NULL;
     m_NumJoints = 0;
+    m_KeyFrame = NULL;
+    m_Local = NULL;
+    m_Absolute = NULL;
+    m_Palette = NULL;
     m_Log = _log;
     m_IsEmpty = true;
     m_VertexData = NULL;
+    m_RenderSource = NULL;
+    m_NumRenderVertices = 0;
+    m_RenderIndex = NULL;
     ClearTransformations ();
 }
 
@@ -90,6 +129,8 @@ Ms3dModel::~Ms3dModel () {
 
 void Ms3dModel::Unload () {
     ClearTransformations ();
+    m_PoseCache = NULL;     // the cache belongs to the model file
+    m_PoseClip = INVALID_ID;
     m_SkinId.clear();
     delete[] m_Vertex;
     m_Vertex = NULL;
@@ -100,41 +141,157 @@ void Ms3dModel::Unload () {
     delete[] m_RotatedNormal;
     m_RotatedNormal = NULL;
     m_NumVertices = 0;
+    m_NumStaticVertices = 0;
     delete[] m_Triangle;
     m_Triangle = NULL;
     m_NumTriangles = 0;
     delete[] m_Mesh;
     m_Mesh = NULL;
     m_NumMeshes = 0;
+    delete[] m_TriIndex;
+    m_TriIndex = NULL;
     delete[] m_Material;
     m_Material = NULL;
     m_NumMaterials = 0;
     delete[] m_Joint;
     m_Joint = NULL;
     m_NumJoints = 0;
+    delete[] m_KeyFrame;
+    m_KeyFrame = NULL;
+    delete[] m_Local;
+    m_Local = NULL;
+    delete[] m_Absolute;
+    m_Absolute = NULL;
+    delete[] m_Palette;
+    m_Palette = NULL;
     delete[] m_VertexData;
     m_VertexData = NULL;
+    delete[] m_RenderSource;
+    m_RenderSource = NULL;
+    m_NumRenderVertices = 0;
+    delete[] m_RenderIndex;
+    m_RenderIndex = NULL;
 }
 
 void Ms3dModel::SetLog (LogManager* _Log) {
     m_Log = _Log;
 }
 
-void Ms3dModel::LoadVertices (char*& _modelData, VERTEX*& _vertex, USHORT& _numVertices) {
-    memcpy (&_numVertices, _modelData, sizeof (USHORT));
-    _modelData += 2;
-    try {
-        _vertex = new VERTEX[_numVertices];
-    } catch (std::bad_alloc) {
+void Ms3dModel::ValidateData (const char* _filename, const char* _data, UINT _size, SECTIONS& _sections) const {
+    memset (&_sections, 0, sizeof (SECTIONS));
+    const char* end = _data + _size;
+    const char* data = _data + MS3D_HEADER_SIZE;
+    bool isValid = ReadCount (data, end, _sections.NumVertices);
+    _sections.Vertices = data;
+    isValid = isValid && SkipData (data, end, _sections.NumVertices * sizeof (VERTEX));
+    isValid = isValid && ReadCount (data, end, _sections.NumTriangles);
+    _sections.Triangles = data;
+    isValid = isValid && SkipData (data, end, _sections.NumTriangles * MS3D_TRIANGLE_SIZE);
+    isValid = isValid && ReadCount (data, end, _sections.NumMeshes);
+    _sections.Meshes = data;
+    for (UINT i = 0; isValid && i < _sections.NumMeshes; i++) {
+        USHORT numTriangles;
+        isValid = SkipData (data, end, MS3D_MESH_HEADER_SIZE - sizeof (USHORT)) &&
+            ReadCount (data, end, numTriangles) &&
+            SkipData (data, end, numTriangles * sizeof (USHORT) + 1);
+        _sections.NumTriIndices += isValid ? numTriangles : 0;
+    }
+    isValid = isValid && ReadCount (data, end, _sections.NumMaterials);
+    _sections.Materials = data;
+    isValid = isValid && SkipData (data, end, _sections.NumMaterials * sizeof (MATERIAL));
+    isValid = isValid && SkipData (data, end, MS3D_ANIMATION_SIZE);
+    isValid = isValid && ReadCount (data, end, _sections.NumJoints);
+    _sections.Joints = data;
+    for (UINT i = 0; isValid && i < _sections.NumJoints; i++) {
+        USHORT numFrames[2];
+        isValid = (UINT)(end - data) >= MS3D_JOINT_HEADER_SIZE;
+        if (isValid) {
+            memcpy (numFrames, data + MS3D_JOINT_HEADER_SIZE - sizeof (numFrames), sizeof (numFrames));
+            data += MS3D_JOINT_HEADER_SIZE;
+            isValid = SkipData (data, end, (numFrames[0] + numFrames[1]) * sizeof (KEYFRAME));
+            _sections.NumKeyFrames += isValid ? numFrames[0] + numFrames[1] : 0;
+        }
+    }
+    if (!isValid) {
         #ifdef _DEBUG
         if (m_Log) {
-            m_Log->Log ("Error: Out of memory. (Ms3dModel::LoadVertices)\n");
+            m_Log->Log ("Error: File is truncated (%s). (Ms3dModel::ValidateData)\n", _filename);
         }
         #endif
-        THROW_ERROR (ERRC_OUT_OF_MEM);
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+
+    // the sizes are right, check the references
+    const VERTEX* vertex = (const VERTEX*)_sections.Vertices;
+    for (UINT i = 0; isValid && i < _sections.NumVertices; i++) {
+        isValid = vertex[i].BoneId >= -1 && vertex[i].BoneId < _sections.NumJoints;
+    }
+    data = _sections.Triangles;
+    for (UINT i = 0; isValid && i < _sections.NumTriangles; i++) {
+        USHORT vertIndex[3];
+        memcpy (vertIndex, data + sizeof (USHORT), sizeof (vertIndex));
+        isValid = vertIndex[0] < _sections.NumVertices && vertIndex[1] < _sections.NumVertices &&
+            vertIndex[2] < _sections.NumVertices;
+        data += MS3D_TRIANGLE_SIZE;
+    }
+    data = _sections.Meshes;
+    for (UINT i = 0; isValid && i < _sections.NumMeshes; i++) {
+        USHORT numTriangles;
+        USHORT triIndex;
+        isValid = IsName (data + 1, 32);
+        memcpy (&numTriangles, data + MS3D_MESH_HEADER_SIZE - sizeof (USHORT), sizeof (USHORT));
+        data += MS3D_MESH_HEADER_SIZE;
+        for (UINT j = 0; isValid && j < numTriangles; j++) {
+            memcpy (&triIndex, data + j * sizeof (USHORT), sizeof (USHORT));
+            isValid = triIndex < _sections.NumTriangles;
+        }
+        data += numTriangles * sizeof (USHORT);
+        isValid = isValid && *data >= -1 && *data < (int)_sections.NumMaterials;
+        data += 1;
+    }
+    const MATERIAL* material = (const MATERIAL*)_sections.Materials;
+    for (UINT i = 0; isValid && i < _sections.NumMaterials; i++) {
+        isValid = IsName (material[i].Name, 32) && IsName (material[i].Texture, 128) &&
+            IsName (material[i].Alpha, 128);
+    }
+    // a parent may be anywhere in the file, but no joint may be its own ancestor
+    std::vector<const char*> jointName;
+    std::vector<const char*> parentName;
+    data = _sections.Joints;
+    for (UINT i = 0; isValid && i < _sections.NumJoints; i++) {
+        const char* name = data + 1;
+        const char* parent = name + 32;
+        isValid = IsName (name, 32) && IsName (parent, 32);
+        jointName.push_back (name);
+        parentName.push_back (parent);
+        USHORT numFrames[2];
+        memcpy (numFrames, data + MS3D_JOINT_HEADER_SIZE - sizeof (numFrames), sizeof (numFrames));
+        data += MS3D_JOINT_HEADER_SIZE + (numFrames[0] + numFrames[1]) * sizeof (KEYFRAME);
+    }
+    std::vector<int> parentId (_sections.NumJoints, -1);
+    for (UINT i = 0; isValid && i < _sections.NumJoints; i++) {
+        if (parentName[i][0] != '\0') {
+            for (UINT j = 0; parentId[i] == -1 && j < _sections.NumJoints; j++) {
+                parentId[i] = strcmp (parentName[i], jointName[j]) == 0 ? j : -1;
+            }
+            isValid = parentId[i] != -1;
+        }
+    }
+    for (UINT i = 0; isValid && i < _sections.NumJoints; i++) {
+        int ancestor = parentId[i];
+        for (UINT j = 0; ancestor != -1 && j < _sections.NumJoints; j++) {
+            ancestor = parentId[ancestor];
+        }
+        isValid = ancestor == -1;
+    }
+    if (!isValid) {
+        #ifdef _DEBUG
+        if (m_Log) {
+            m_Log->Log ("Error: File is corrupted (%s). (Ms3dModel::ValidateData)\n", _filename);
+        }
+        #endif
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
     }
-    memcpy (_vertex, _modelData, sizeof (VERTEX) * _numVertices);
-    _modelData += sizeof (VERTEX) * _numVertices;
 }
 
 VERTEX* Ms3dModel::GetVertices (short _jointId) {
@@ -144,13 +301,19 @@ VERTEX* Ms3dModel::GetVertices (short _jointId) {
     if (-1 > _jointId || _jointId >= m_NumJoints) {
         THROW_ERROR (ERRC_OUT_OF_RANGE);
     }
-    return m_Joint[_jointId].Vertex;
+    return &m_Vertex[m_Joint[_jointId].FirstVertex];
+}
+
+USHORT Ms3dModel::GetNumJoints () const {
+    return m_NumJoints;
+}
+
+const D3DXMATRIX* Ms3dModel::GetPalette () const {
+    return m_Palette;
 }
 
-void Ms3dModel::LoadTriangles (char*& _modelData) {
-    memcpy (&m_NumTriangles, _modelData, sizeof (USHORT));
-    _modelData += 2;
-    UINT size = m_NumTriangles * sizeof (TRIANGLE);
+void Ms3dModel::LoadTriangles (const SECTIONS& _sections) {
+    m_NumTriangles = _sections.NumTriangles;
     try {
         m_Triangle = new TRIANGLE[m_NumTriangles];
     } catch (std::bad_alloc) {
@@ -161,43 +324,39 @@ void Ms3dModel::LoadTriangles (char*& _modelData) {
         #endif
         THROW_ERROR (ERRC_OUT_OF_MEM);
     }
+    // the file has no joint indices, the rest of the record follows the flag
+    const char* data = _sections.Triangles;
     for (UINT i = 0; i < m_NumTriangles; i++) {
-        memcpy (&(m_Triangle[i].Flag), _modelData, sizeof (USHORT));
-        _modelData += sizeof (USHORT);
-        memcpy (&(m_Triangle[i].VertIndex[0]), _modelData, 68);
-        _modelData += 68;
-        //memcpy (m_Triangle, _modelData, size);
+        memcpy (&m_Triangle[i].Flag, data, sizeof (USHORT));
+        memcpy (m_Triangle[i].VertIndex, data + sizeof (USHORT), MS3D_TRIANGLE_SIZE - sizeof (USHORT));
+        data += MS3D_TRIANGLE_SIZE;
     }
-    //_modelData += size;
 }
 
 TRIANGLE* Ms3dModel::GetTriangles () {
     return m_Triangle;
 }
 
-void Ms3dModel::LoadMeshes (char*& _modelData) {
-    memcpy (&m_NumMeshes, _modelData, sizeof (USHORT));    
-    _modelData += 2;
+void Ms3dModel::LoadMeshes (const SECTIONS& _sections) {
+    m_NumMeshes = _sections.NumMeshes;
     try {
         m_Mesh = new MESH[m_NumMeshes];
-        UINT size;
-        UINT maxNumTriangles = 0;
+        m_TriIndex = new USHORT[_sections.NumTriIndices];
+        const char* data = _sections.Meshes;
+        USHORT* triIndex = m_TriIndex;
         for (UINT i = 0; i < m_NumMeshes; i++) {
-            memcpy (&m_Mesh[i], _modelData, 35);   // read the first 35 bytes of a m_Mesh
-            _modelData += 35;
-            size = m_Mesh[i].NumTriangles * sizeof (USHORT);
-            m_Mesh[i].TriIndex = new USHORT[m_Mesh[i].NumTriangles];
-            memcpy (m_Mesh[i].TriIndex, _modelData, size); // read triangle indices
-            _modelData += size;
-            memcpy (&m_Mesh[i].Material, _modelData, sizeof (char));   // read material index
-            _modelData += 1;
+            memcpy (&m_Mesh[i], data, MS3D_MESH_HEADER_SIZE);
+            data += MS3D_MESH_HEADER_SIZE;
+            UINT size = m_Mesh[i].NumTriangles * sizeof (USHORT);
+            m_Mesh[i].TriIndex = triIndex;
+            memcpy (triIndex, data, size);
+            triIndex += m_Mesh[i].NumTriangles;
+            data += size;
+            m_Mesh[i].Material = *data;
+            data += 1;
 
             m_SkinId.push_back (INVALID_ID);
-            if (m_Mesh[i].NumTriangles > maxNumTriangles) {
-                maxNumTriangles = m_Mesh[i].NumTriangles;
-            }
         }
-        m_VertexData = new vs3d::UUVERTEX[maxNumTriangles * 3];
     } catch (std::bad_alloc) {
         #ifdef _DEBUG
         if (m_Log) {
@@ -213,10 +372,8 @@ MESH* Ms3dModel::GetMeshes () {
     return m_Mesh;
 }
 
-void Ms3dModel::LoadMaterials (char*& _modelData) {
-    memcpy (&m_NumMaterials, _modelData, sizeof (USHORT));
-    _modelData += 2;
-    UINT size = m_NumMaterials * sizeof (MATERIAL);
+void Ms3dModel::LoadMaterials (const SECTIONS& _sections) {
+    m_NumMaterials = _sections.NumMaterials;
     try {
         m_Material = new MATERIAL[m_NumMaterials];
     } catch (std::bad_alloc) {
@@ -227,31 +384,60 @@ void Ms3dModel::LoadMaterials (char*& _modelData) {
         #endif
         THROW_ERROR (ERRC_OUT_OF_MEM);
     }
-    memcpy (m_Material, _modelData, size);
-    _modelData += size;
+    memcpy (m_Material, _sections.Materials, m_NumMaterials * sizeof (MATERIAL));
 }
 
 MATERIAL* Ms3dModel::GetMaterials () {
     return m_Material;
 }
 
-void Ms3dModel::LoadJoints (char*& _modelData) {
-    memcpy (&m_NumJoints, _modelData, sizeof (USHORT));
-    _modelData += 2;
+void Ms3dModel::LoadJoints (const SECTIONS& _sections, std::vector<short>& _jointId) {
+    m_NumJoints = _sections.NumJoints;
+    JOINT* fileJoint = NULL;
     try {
+        fileJoint = new JOINT[m_NumJoints];
         m_Joint = new JOINT[m_NumJoints];
-        UINT size;
+        m_KeyFrame = new KEYFRAME[_sections.NumKeyFrames];
+        const char* data = _sections.Joints;
+        KEYFRAME* keyFrame = m_KeyFrame;
         for (UINT i = 0; i < m_NumJoints; i++) {
-            memcpy (&m_Joint[i], _modelData, 93);
-            _modelData += 93;
-            size = m_Joint[i].NumRotFrames * sizeof (KEYFRAME);
-            m_Joint[i].RotKeyFrame = new KEYFRAME[m_Joint[i].NumRotFrames];
-            memcpy (m_Joint[i].RotKeyFrame, _modelData, size);
-            _modelData += size;
-            size = m_Joint[i].NumTransFrames * sizeof (KEYFRAME);
-            m_Joint[i].TransKeyFrame = new KEYFRAME[m_Joint[i].NumTransFrames];
-            memcpy (m_Joint[i].TransKeyFrame, _modelData, size);
-            _modelData += size;
+            memcpy (&fileJoint[i], data, MS3D_JOINT_HEADER_SIZE);
+            data += MS3D_JOINT_HEADER_SIZE;
+            // rotation and translation keyframes are stored one after another
+            UINT numFrames = fileJoint[i].NumRotFrames + fileJoint[i].NumTransFrames;
+            memcpy (keyFrame, data, numFrames * sizeof (KEYFRAME));
+            data += numFrames * sizeof (KEYFRAME);
+            fileJoint[i].RotKeyFrame = keyFrame;
+            fileJoint[i].TransKeyFrame = keyFrame + fileJoint[i].NumRotFrames;
+            keyFrame += numFrames;
+        }
+
+        // find parents, anywhere in the file
+        for (UINT i = 0; i < m_NumJoints; i++) {
+            if (fileJoint[i].Parent[0] != '\0') {
+                for (UINT j = 0; j < m_NumJoints; j++) {
+                    if (strcmp (fileJoint[i].Parent, fileJoint[j].Name) == 0) {
+                        fileJoint[i].ParentId = j;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // sort the joints so a parent comes before its children, otherwise in the file order.
+        // ValidateData has refused the cycles, so every pass moves at least one joint.
+        _jointId.assign (m_NumJoints, -1);
+        USHORT numSorted = 0;
+        while (numSorted < m_NumJoints) {
+            for (UINT i = 0; i < m_NumJoints; i++) {
+                short parentId = fileJoint[i].ParentId;
+                if (_jointId[i] == -1 && (parentId == -1 || _jointId[parentId] != -1)) {
+                    _jointId[i] = numSorted;
+                    m_Joint[numSorted] = fileJoint[i];
+                    m_Joint[numSorted].ParentId = parentId == -1 ? -1 : _jointId[parentId];
+                    numSorted++;
+                }
+            }
         }
     } catch (std::bad_alloc) {
         #ifdef _DEBUG
@@ -259,9 +445,11 @@ void Ms3dModel::LoadJoints (char*& _modelData) {
             m_Log->Log ("Error: Out of memory. (Ms3dLoader::LoadJoints)\n");
         }
         #endif
+        delete[] fileJoint;
         Unload ();
         THROW_ERROR (ERRC_OUT_OF_MEM);
     }
+    delete[] fileJoint;
 }
 
 JOINT* Ms3dModel::GetJoints () {
@@ -270,58 +458,32 @@ JOINT* Ms3dModel::GetJoints () {
 
 void Ms3dModel::Load (const char* _filename) {
     Unload ();
-    FILE* modelFile = NULL;
-    modelFile = fopen (_filename, "rb");
-    if (!modelFile) {
-        #ifdef _DEBUG
-        if (m_Log) {
-            m_Log->Log ("Error: Cannot open file %s. (Ms3dModel::Load)\n", _filename);
-        }
-        #endif
-        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _filename);
-    }
-    // copy file data to buffer
-    if (fseek (modelFile, 0, SEEK_END)) {
-        #ifdef _DEBUG
-        if (m_Log) {
-            m_Log->Log ("Error: Cannot seek file %s (Ms3dModel::Load)\n", _filename);
-        }
-        #endif
-        fclose (modelFile);
-        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
-    }
-    UINT fileSize = ftell (modelFile);
-    if (fseek (modelFile, 0, SEEK_SET)) {
-        #ifdef _DEBUG
-        if (m_Log) {
-            m_Log->Log ("Error: Cannot seek file %s (Ms3dModel::Load)\n", _filename);
-        }
-        #endif
-        fclose (modelFile);
-        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
-    }
-    char* model = (char*) malloc (fileSize);
-    char* originModelAdr = model;   // origin model address
-    if (!model) {
+    // from the archive or the loose file
+    VirtualFile modelFile;
+    try {
+        modelFile.Open (_filename);
+    } catch (ErrorMessage&) {
         #ifdef _DEBUG
         if (m_Log) {
-            m_Log->Log ("Error: Out of memory. (Ms3dLoader::Load)\n");
+            m_Log->Log ("Error: Cannot read file %s. (Ms3dModel::Load)\n", _filename);
         }
         #endif
-        fclose (modelFile);
-        THROW_ERROR (ERRC_OUT_OF_MEM);
+        throw;
     }
-    if (fread (model, 1, fileSize, modelFile) != fileSize) {
+    Load (_filename, modelFile.GetData (), modelFile.GetSize ());
+}
+
+void Ms3dModel::Load (const char* _filename, const char* _data, UINT _size) {
+    Unload ();
+    const char* model = _data;
+    if (_size < 14) {
         #ifdef _DEBUG
         if (m_Log) {
-            m_Log->Log ("Error: Cannot read file (%s). (Ms3dModel::Load)\n", _filename);
+            m_Log->Log ("Error: File is too short (%s). (Ms3dModel::Load)\n", _filename);
         }
         #endif
-        free (model);
-        fclose (modelFile);
         THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
     }
-    fclose (modelFile);
     // check id string
     char idString[11];
     memcpy (idString, model, 10);   // 10 bytes id string
@@ -332,7 +494,6 @@ void Ms3dModel::Load (const char* _filename) {
             m_Log->Log ("Error: ID string (%s) does not match (%s). (Ms3dModel::Load)\n", idString, _filename);
         }
         #endif
-        free (originModelAdr);
         THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
     }
     // check version
@@ -345,128 +506,203 @@ void Ms3dModel::Load (const char* _filename) {
             m_Log->Log ("Error: Wrong file version (%d) (%s) (Ms3dModel::Load)\n", version, _filename);
         }
         #endif
-        free (originModelAdr);
         THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
     }
-    model += 4;
-    // check if memory allocation is required    
+    SECTIONS sections;
+    ValidateData (_filename, _data, _size, sections);
     SetFilename (_filename);
-    VERTEX* vertex = NULL;
-    USHORT numVertices = 0;
+    // vertex records are packed like the structure, they are read in place,
+    // so their joints are looked up in the sorted order by jointId
+    const VERTEX* vertex = (const VERTEX*)sections.Vertices;
+    USHORT numVertices = sections.NumVertices;
+    std::vector<short> jointId;
     try {
-        LoadVertices (model, vertex, numVertices);
-        LoadTriangles (model);
-        LoadMeshes (model);
-        LoadMaterials (model);
-        // skip unnecessary information
-        model += 12;
-        LoadJoints (model);
+        LoadTriangles (sections);
+        LoadMeshes (sections);
+        LoadMaterials (sections);
+        LoadJoints (sections, jointId);
     } catch (ErrorMessage&) {
         Unload ();
-        delete[] vertex;
-        free (originModelAdr);
         throw;
     }
 
     // additional setups
     USHORT* vertexIndex = NULL;
     try {
-        // Count the vertices by joints their belong
+        // count the vertices by joints their belong, then sort them by joint
         vertexIndex = new USHORT[numVertices];
+        m_NumVertices = numVertices;
         for (UINT i = 0; i < numVertices; i++) {
             if (vertex[i].BoneId == -1) {
-                m_NumVertices++;
+                m_NumStaticVertices++;
             } else {
-                m_Joint[vertex[i].BoneId].NumVertices++;
+                m_Joint[jointId[vertex[i].BoneId]].NumVertices++;
             }
         }
-        if (m_NumVertices > 0) {
-            m_Vertex = new VERTEX[m_NumVertices];
-            m_Transformed = new VERTEX[m_NumVertices];
-            m_Normal = new D3DXVECTOR3[m_NumVertices];
-            m_RotatedNormal = new D3DXVECTOR3[m_NumVertices];
-            m_NumVertices = 0;
-        }
-
-        // find parents
+        USHORT firstVertex = m_NumStaticVertices;
         for (UINT i = 0; i < m_NumJoints; i++) {
-            if (m_Joint[i].NumVertices > 0) {
-                m_Joint[i].Vertex = new VERTEX[m_Joint[i].NumVertices];
-                m_Joint[i].Transformed = new VERTEX[m_Joint[i].NumVertices];
-                m_Joint[i].Normal = new D3DXVECTOR3[m_Joint[i].NumVertices];
-                m_Joint[i].RotatedNormal = new D3DXVECTOR3[m_Joint[i].NumVertices];
-                m_Joint[i].NumVertices = 0;
-            }
-            if (m_Joint[i].Parent[0] != '\0') {
-                for (UINT j = 0; j < m_NumJoints; j++) {
-                    if (strcmp (m_Joint[i].Parent, m_Joint[j].Name) == 0) {
-                        m_Joint[i].ParentId = j;
-                        break;
-                    }
-                }
-            } else {
-                m_Joint[i].ParentId = -1;
-            }
+            m_Joint[i].FirstVertex = firstVertex;
+            firstVertex += m_Joint[i].NumVertices;
+            m_Joint[i].NumVertices = 0;
         }
-
-        // create matrices
+        m_Vertex = new VERTEX[m_NumVertices];
+        m_Transformed = new D3DXVECTOR3[m_NumVertices];
+        m_Normal = new D3DXVECTOR3[m_NumVertices];
+        m_RotatedNormal = new D3DXVECTOR3[m_NumVertices];
+        m_Local = new D3DXMATRIX[m_NumJoints];
+        m_Absolute = new D3DXMATRIX[m_NumJoints];
+        m_Palette = new D3DXMATRIX[m_NumJoints];
+
+        // create matrices in a single pass
         for (UINT i = 0; i < m_NumJoints; i++) {
-            m_Joint[i].Local = CreateRotationMatrix (m_Joint[i].Rotation);
-            m_Joint[i].Local._41 = m_Joint[i].Position[0];
-            m_Joint[i].Local._42 = m_Joint[i].Position[1];
-            m_Joint[i].Local._43 = m_Joint[i].Position[2];
+            m_Local[i] = CreateRotationMatrix (m_Joint[i].Rotation);
+            m_Local[i]._41 = m_Joint[i].Position[0];
+            m_Local[i]._42 = m_Joint[i].Position[1];
+            m_Local[i]._43 = m_Joint[i].Position[2];
             if (m_Joint[i].ParentId != -1) {
-                UINT pid = m_Joint[i].ParentId;
                 // why not absolute * local?
-                m_Joint[i].Absolute = m_Joint[i].Local * m_Joint[pid].Absolute;
+                m_Absolute[i] = m_Local[i] * m_Absolute[m_Joint[i].ParentId];
             } else {
-                m_Joint[i].Absolute = m_Joint[i].Local;
+                m_Absolute[i] = m_Local[i];
             }
-            m_Joint[i].Final = m_Joint[i].Absolute;
+            m_Palette[i] = m_Absolute[i];
         }
 
-        // transform vertices
-        UINT bid;   // bone id
+        // transform vertices to the space of their joints
+        USHORT staticVertex = 0;
         for (UINT i = 0; i < numVertices; i++) {
             if (vertex[i].BoneId != -1) {
-                bid = vertex[i].BoneId;
-                InvTranslate (vertex[i].Vertex, m_Joint[bid].Final); 
-                InvRotate (vertex[i].Vertex, m_Joint[bid].Final);
-                vertexIndex[i] = m_Joint[bid].NumVertices;
-                m_Joint[bid].Vertex[m_Joint[bid].NumVertices++] = vertex[i];
+                short boneId = jointId[vertex[i].BoneId];
+                JOINT& joint = m_Joint[boneId];
+                vertexIndex[i] = joint.FirstVertex + joint.NumVertices++;
+                m_Vertex[vertexIndex[i]] = vertex[i];
+                m_Vertex[vertexIndex[i]].BoneId = (char)boneId;
+                InvTranslate (m_Vertex[vertexIndex[i]].Vertex, m_Absolute[boneId]); 
+                InvRotate (m_Vertex[vertexIndex[i]].Vertex, m_Absolute[boneId]);
             } else {
-                vertexIndex[i] = m_NumVertices;
-                m_Vertex[m_NumVertices++] = vertex[i];
+                vertexIndex[i] = staticVertex++;
+                m_Vertex[vertexIndex[i]] = vertex[i];
             }
         }
 
         // transform normals
         for (UINT i = 0; i < m_NumTriangles; i++) {
             for (UINT j = 0; j < 3; j++) {  // loop through each index
-                VERTEX* vert = &vertex[m_Triangle[i].VertIndex[j]];
-                m_Triangle[i].JointIndex[j] = vert->BoneId;
                 m_Triangle[i].VertIndex[j] = vertexIndex[m_Triangle[i].VertIndex[j]];
+                const VERTEX* vert = &m_Vertex[m_Triangle[i].VertIndex[j]];
+                m_Triangle[i].JointIndex[j] = vert->BoneId;
                 if (vert->BoneId != -1) {
-                    InvRotate (m_Triangle[i].Normal[j], m_Joint[vert->BoneId].Final);
-                    m_Joint[vert->BoneId].Normal[m_Triangle[i].VertIndex[j]] = m_Triangle[i].Normal[j];
-                } else {
-                    m_Normal[m_Triangle[i].VertIndex[j]] = m_Triangle[i].Normal[j];
+                    InvRotate (m_Triangle[i].Normal[j], m_Absolute[vert->BoneId]);
                 }
+                m_Normal[m_Triangle[i].VertIndex[j]] = m_Triangle[i].Normal[j];
             }
         }
     } catch (std::bad_alloc) {
         delete[] vertexIndex;
-        delete[] vertex;
-        free (originModelAdr);
         Unload ();
         THROW_ERROR (ERRC_OUT_OF_MEM);
     }
     delete[] vertexIndex;
-    delete[] vertex;
-    free (originModelAdr);
+    try {
+        BuildRenderBuffers ();
+    } catch (ErrorMessage&) {
+        Unload ();
+        throw;
+    }
     UpdateBounds ();
 }
 
+void Ms3dModel::BuildRenderBuffers () {
+    UINT numIndices = 0;
+    for (UINT i = 0; i < m_NumMeshes; i++) {
+        numIndices += m_Mesh[i].NumTriangles * 3;
+    }
+    try {
+        m_RenderIndex = new WORD[numIndices];
+        std::vector<vs3d::UUVERTEX> renderVertex;
+        std::vector<USHORT> renderSource;
+        std::vector<UINT> nextCorner;   // the next render vertex of the same model vertex in the mesh
+        std::vector<UINT> firstCorner;
+        std::vector<UINT> remap;
+        std::vector<vs3d::UUVERTEX> usedVertex;
+        std::vector<USHORT> usedSource;
+        UINT firstIndex = 0;
+        for (UINT i = 0; i < m_NumMeshes; i++) {
+            MESH& mesh = m_Mesh[i];
+            UINT firstVertex = renderVertex.size ();
+            firstCorner.assign (m_NumVertices, INVALID_ID);
+            for (UINT j = 0; j < mesh.NumTriangles; j++) {
+                const TRIANGLE& tri = m_Triangle[mesh.TriIndex[j]];
+                for (UINT k = 0; k < 3; k++) {
+                    USHORT vertex = tri.VertIndex[k];
+                    UINT corner = firstCorner[vertex];
+                    while (corner != INVALID_ID && (renderVertex[corner].Tu != tri.TexCoord[0][k] ||
+                                                    renderVertex[corner].Tv != tri.TexCoord[1][k])) {
+                        corner = nextCorner[corner];
+                    }
+                    if (corner == INVALID_ID) {
+                        corner = renderVertex.size ();
+                        if (corner - firstVertex >= 0xFFFF) {
+                            #ifdef _DEBUG
+                            if (m_Log) {
+                                m_Log->Log ("Error: Mesh %s has too many vertices (%s). (Ms3dModel::BuildRenderBuffers)\n", mesh.Name, m_Filename);
+                            }
+                            #endif
+                            THROW_DETAILED_ERROR (ERRC_BAD_FILE, m_Filename);
+                        }
+                        vs3d::UUVERTEX newVertex;
+                        newVertex.Tu = tri.TexCoord[0][k];
+                        newVertex.Tv = tri.TexCoord[1][k];
+                        renderVertex.push_back (newVertex);
+                        renderSource.push_back (vertex);
+                        nextCorner.push_back (firstCorner[vertex]);
+                        firstCorner[vertex] = corner;
+                    }
+                    m_RenderIndex[firstIndex + j * 3 + k] = (WORD)(corner - firstVertex);
+                }
+            }
+            mesh.FirstRenderVertex = firstVertex;
+            mesh.NumRenderVertices = (USHORT)(renderVertex.size () - firstVertex);
+            mesh.FirstRenderIndex = firstIndex;
+            WORD* index = &m_RenderIndex[firstIndex];
+            UINT numMeshIndices = mesh.NumTriangles * 3;
+            OptimizeTriangleOrder (index, numMeshIndices, mesh.NumRenderVertices);
+
+            // number the render vertices in the order the triangles use them
+            remap.assign (mesh.NumRenderVertices, INVALID_ID);
+            usedVertex.clear ();
+            usedSource.clear ();
+            for (UINT j = 0; j < numMeshIndices; j++) {
+                if (remap[index[j]] == INVALID_ID) {
+                    remap[index[j]] = usedVertex.size ();
+                    usedVertex.push_back (renderVertex[firstVertex + index[j]]);
+                    usedSource.push_back (renderSource[firstVertex + index[j]]);
+                }
+                index[j] = (WORD)remap[index[j]];
+            }
+            for (UINT j = 0; j < mesh.NumRenderVertices; j++) {
+                renderVertex[firstVertex + j] = usedVertex[j];
+                renderSource[firstVertex + j] = usedSource[j];
+            }
+            firstIndex += numMeshIndices;
+        }
+        m_NumRenderVertices = renderVertex.size ();
+        m_VertexData = new vs3d::UUVERTEX[m_NumRenderVertices];
+        m_RenderSource = new USHORT[m_NumRenderVertices];
+        for (UINT i = 0; i < m_NumRenderVertices; i++) {
+            m_VertexData[i] = renderVertex[i];
+            m_RenderSource[i] = renderSource[i];
+        }
+    } catch (std::bad_alloc) {
+        #ifdef _DEBUG
+        if (m_Log) {
+            m_Log->Log ("Error: Out of memory. (Ms3dModel::BuildRenderBuffers)\n");
+        }
+        #endif
+        THROW_ERROR (ERRC_OUT_OF_MEM);
+    }
+}
+
 void Ms3dModel::SetFilename (const char* _filename) {
     strcpy (m_Filename, _filename);
 }
@@ -493,6 +729,11 @@ bool Ms3dModel::IsAnimationCompleted () const {
 }
 
 void Ms3dModel::Animate (float _speed, float _startTime, float _endTime, bool _loop) {
+    AdvanceAnimation (_speed, _startTime, _endTime, _loop);
+    EvaluatePose ();
+}
+
+void Ms3dModel::AdvanceAnimation (float _speed, float _startTime, float _endTime, bool _loop) {
     if (!IsLoaded ()) {
         return;
     }
@@ -502,6 +743,7 @@ void Ms3dModel::Animate (float _speed, float _startTime, float _endTime, bool _l
         m_StartTime = _startTime;
         m_EndTime = _endTime;
         m_IsAnimationCompleted = false;
+        m_PoseClip = m_PoseCache ? m_PoseCache->FindClip (_startTime, _endTime) : INVALID_ID;
     }
     DWORD timerCurClock = timeGetTime ();
 
@@ -520,11 +762,31 @@ void Ms3dModel::Animate (float _speed, float _startTime, float _endTime, bool _l
             m_IsAnimationCompleted = true;
         }
     }
+    m_PoseTime = time;
+}
+
+void Ms3dModel::EvaluatePose () {
+    if (!IsLoaded ()) {
+        return;
+    }
+    if (m_PoseClip != INVALID_ID) {
+        m_PoseCache->GetPose (m_PoseClip, m_PoseTime, m_Palette);
+    } else {
+        SamplePose (m_PoseTime, m_Palette);
+    }
+}
+
+void Ms3dModel::SamplePose (float _time, D3DXMATRIX* _palette) {
+    if (!IsLoaded ()) {
+        return;
+    }
+    float time = _time;
+    // parents come first, so their final matrices are ready for their children
     for (UINT i = 0; i < m_NumJoints; i++) {
         D3DXMATRIX tempMat;
         UINT frame = 0;
         if (m_Joint[i].NumRotFrames == 0 && m_Joint[i].NumTransFrames == 0) {
-            m_Joint[i].Final = m_Joint[i].Absolute;
+            _palette[i] = m_Absolute[i];
             continue;
         }
         while (frame < m_Joint[i].NumTransFrames && m_Joint[i].TransKeyFrame[frame].Time < time) {
@@ -577,53 +839,25 @@ void Ms3dModel::Animate (float _speed, float _startTime, float _endTime, bool _l
         tempMat._42 = translation[1];
         tempMat._43 = translation[2];
 
-        D3DXMATRIX finalMat = tempMat * m_Joint[i].Local;
+        D3DXMATRIX finalMat = tempMat * m_Local[i];
         if (m_Joint[i].ParentId == -1) {
-            m_Joint[i].Final = finalMat;
+            _palette[i] = finalMat;
         } else {
-            m_Joint[i].Final = finalMat * m_Joint[m_Joint[i].ParentId].Final;
+            _palette[i] = finalMat * _palette[m_Joint[i].ParentId];
         }
     }
 }
 
+void Ms3dModel::SetPoseCache (const Ms3dPoseCache* _cache) {
+    m_PoseCache = _cache;
+    m_PoseClip = m_PoseCache ? m_PoseCache->FindClip (m_StartTime, m_EndTime) : INVALID_ID;
+}
+
 void Ms3dModel::Render (RenderDevice* _device) {
     ISkinManager* skin = _device->GetSkinManager ();
     IVertexCacheManager* vcache = _device->GetVCacheManager ();
     MATRIX44 transform = m_Scale * m_Rotation * m_Translation;
-    for (UINT i = 0; i < m_NumJoints; i++) {
-        if (m_Joint[i].NumVertices > 0) {
-            D3DXVec3TransformCoordArray (
-                &(m_Joint[i].Transformed[0].Vertex), 
-                sizeof (VERTEX), 
-                &(m_Joint[i].Vertex[0].Vertex), 
-                sizeof (VERTEX), 
-                &(m_Joint[i].Final * *(D3DXMATRIX*)transform.data()), 
-                m_Joint[i].NumVertices);
-            D3DXVec3TransformNormalArray (
-                m_Joint[i].RotatedNormal, 
-                sizeof (D3DXVECTOR3), 
-                m_Joint[i].Normal, 
-                sizeof (D3DXVECTOR3), 
-                &(m_Joint[i].Final * *(D3DXMATRIX*)transform.data()), 
-                m_Joint[i].NumVertices);
-        }
-    }
-    if (m_NumVertices > 0) {
-        D3DXVec3TransformCoordArray (
-            &(m_Transformed[0].Vertex), 
-            sizeof (VERTEX), 
-            &(m_Vertex[0].Vertex), 
-            sizeof (VERTEX), 
-            (D3DXMATRIX*)transform.data(), 
-            m_NumVertices);
-        D3DXVec3TransformNormalArray (
-            m_RotatedNormal, 
-            sizeof (D3DXVECTOR3), 
-            m_Normal, 
-            sizeof (D3DXVECTOR3), 
-            (D3DXMATRIX*)transform.data(), 
-            m_NumVertices);
-    }
+    SkinVertices (*(D3DXMATRIX*)transform.data(), true);
 
     for (UINT i = 0; i < m_NumMeshes; i++) {
         if (m_Mesh[i].Material >= 0) {
@@ -641,59 +875,22 @@ void Ms3dModel::Render (RenderDevice* _device) {
             }
         }
         
-        UINT vertNum = 0;
-
-        for (UINT j = 0; j < m_Mesh[i].NumTriangles; j++) {
-            
-            TRIANGLE* tri = &m_Triangle[m_Mesh[i].TriIndex[j]];
-
-            for (UINT k = 0; k < 3; k++) {
-                VERTEX* vert = NULL;
-                D3DXVECTOR3* normal = NULL;
-                if (tri->JointIndex[k] == -1) {
-                    vert = &m_Transformed[tri->VertIndex[k]];
-                    normal = &m_RotatedNormal[tri->VertIndex[k]];
-                } else {
-                    vert = &m_Joint[tri->JointIndex[k]].Transformed[tri->VertIndex[k]];
-                    normal = &m_Joint[tri->JointIndex[k]].RotatedNormal[tri->VertIndex[k]];
-                }
-
-                m_VertexData[vertNum].Tu = tri->TexCoord[0][k];
-                m_VertexData[vertNum].Tv = tri->TexCoord[1][k];
-                /*if (vert->BoneId == -1) {
-                    D3DXVec3TransformCoord (&vecVertex, &vert->Vertex, (D3DXMATRIX*)transform.data());
-                    renderVertex.x = vecVertex.x;
-                    renderVertex.y = vecVertex.y;
-                    renderVertex.z = vecVertex.z;
-                    D3DXVec3TransformNormal (&vecNormal, &tri->Normal[k], (D3DXMATRIX*)m_Rotation.data());
-                    renderVertex.Normal[0] = vecNormal.x;
-                    renderVertex.Normal[1] = vecNormal.y;
-                    renderVertex.Normal[2] = vecNormal.z;
-                } else {
-                    JOINT* curJoint = &m_Joint[vert->BoneId];
-                    D3DXMATRIX finalTransformation = curJoint->Final * *(D3DXMATRIX*)m_Rotation.data();
-                    D3DXVec3TransformNormal (&vecNormal, &tri->Normal[k], &finalTransformation);
-                    renderVertex.Normal[0] = vecNormal.x;
-                    renderVertex.Normal[1] = vecNormal.y;
-                    renderVertex.Normal[2] = vecNormal.z;
-                    finalTransformation = curJoint->Final * *(D3DXMATRIX*)transform.data();
-                    D3DXVec3TransformCoord (&vecVertex, &vert->Vertex, &finalTransformation);
-                    renderVertex.x = vecVertex.x;
-                    renderVertex.y = vecVertex.y;
-                    renderVertex.z = vecVertex.z;
-                }*/
-                m_VertexData[vertNum].X = vert->Vertex.x;
-                m_VertexData[vertNum].Y = vert->Vertex.y;
-                m_VertexData[vertNum].Z = vert->Vertex.z;
-                m_VertexData[vertNum].Normal[0] = normal->x;
-                m_VertexData[vertNum].Normal[1] = normal->y;
-                m_VertexData[vertNum].Normal[2] = normal->z;
-                vertNum++;
-            }
+        // only the positions and normals change, the texture coordinates are set on load
+        MESH& mesh = m_Mesh[i];
+        vs3d::UUVERTEX* renderVertex = &m_VertexData[mesh.FirstRenderVertex];
+        const USHORT* source = &m_RenderSource[mesh.FirstRenderVertex];
+        for (UINT j = 0; j < mesh.NumRenderVertices; j++) {
+            const D3DXVECTOR3& vert = m_Transformed[source[j]];
+            const D3DXVECTOR3& normal = m_RotatedNormal[source[j]];
+            renderVertex[j].X = vert.x;
+            renderVertex[j].Y = vert.y;
+            renderVertex[j].Z = vert.z;
+            renderVertex[j].Normal[0] = normal.x;
+            renderVertex[j].Normal[1] = normal.y;
+            renderVertex[j].Normal[2] = normal.z;
         }
-        //vcache->Render (PT_TRIANGLELIST, vertNum, renderVertexArray, 0, 0, FVF_UU, skinId);
-        vcache->Render (PT_TRIANGLELIST, m_VertexData, vertNum, NULL, 0, VFT_UU, m_SkinId[i]);
-        //m_Log->Log ("%u\n", m_SkinId[i]);
+        vcache->Render (PT_TRIANGLELIST, renderVertex, mesh.NumRenderVertices,
+                        &m_RenderIndex[mesh.FirstRenderIndex], mesh.NumTriangles * 3, VFT_UU, m_SkinId[i]);
     }
 }
 
@@ -742,17 +939,14 @@ D3DXQUATERNION Ms3dModel::CreateQuaternion (float _x, float _y, float _z) const
 	float dCY = cos(_z * 0.5f);
 	float dCP = cos(_y * 0.5f);
 	float dCR = cos(_x * 0.5f);
-    float* quat = new float[4];
+    float quat[4];
 
 	quat[0] = dSR * dCP * dCY - dCR * dSP * dSY;
 	quat[1] = dCR * dSP * dCY + dSR * dCP * dSY;
 	quat[2] = dCR * dCP * dSY - dSR * dSP * dCY;
 	quat[3] = dCR * dCP * dCY + dSR * dSP * dSY;
 
-    D3DXQUATERNION retQuat (quat);
-
-    delete quat;
-    return retQuat;
+    return D3DXQUATERNION (quat);
 }
 
 void Ms3dModel::InvRotate (D3DXVECTOR3& _vector, const D3DXMATRIX& _matrix) const {
@@ -814,66 +1008,48 @@ void Ms3dModel::UpdateBounds () {
     m_Max[0] = -99999.0f;
     m_Max[1] = -99999.0f;
     m_Max[2] = -99999.0f;
-    for (UINT i = 0; i < m_NumJoints; i++) {
-        if (m_Joint[i].NumVertices > 0) {
-            D3DXVec3TransformCoordArray (
-                &(m_Joint[i].Transformed[0].Vertex), 
-                sizeof (VERTEX), 
-                &(m_Joint[i].Vertex[0].Vertex), 
-                sizeof (VERTEX), 
-                &(m_Joint[i].Final * *(D3DXMATRIX*)transform.data()), 
-                m_Joint[i].NumVertices);
-        }
-    }
-    if (m_NumVertices > 0) {
-        D3DXVec3TransformCoordArray (
-            &(m_Transformed[0].Vertex), 
-            sizeof (VERTEX), 
-            &(m_Vertex[0].Vertex), 
-            sizeof (VERTEX), 
-            (D3DXMATRIX*)transform.data(), 
-            m_NumVertices);
-    }
-    for (UINT i = 0; i < m_NumJoints; i++) {
-        for (UINT j = 0; j < m_Joint[i].NumVertices; j++) {
-            if (m_Joint[i].Transformed[j].Vertex.x < m_Min[0]) {
-                m_Min[0] = m_Joint[i].Transformed[j].Vertex.x;
-            }
-            if (m_Joint[i].Transformed[j].Vertex.y < m_Min[1]) {
-                m_Min[1] = m_Joint[i].Transformed[j].Vertex.y;
-            }
-            if (m_Joint[i].Transformed[j].Vertex.z < m_Min[2]) {
-                m_Min[2] = m_Joint[i].Transformed[j].Vertex.z;
-            }
-            if (m_Joint[i].Transformed[j].Vertex.x > m_Max[0]) {
-                m_Max[0] = m_Joint[i].Transformed[j].Vertex.x;
-            }
-            if (m_Joint[i].Transformed[j].Vertex.y > m_Max[1]) {
-                m_Max[1] = m_Joint[i].Transformed[j].Vertex.y;
-            }
-            if (m_Joint[i].Transformed[j].Vertex.z > m_Max[2]) {
-                m_Max[2] = m_Joint[i].Transformed[j].Vertex.z;
-            }
-        }
-    }
+    SkinVertices (*(D3DXMATRIX*)transform.data(), false);
     for (UINT i = 0; i < m_NumVertices; i++) {
-        if (m_Transformed[i].Vertex.x < m_Min[0]) {
-            m_Min[0] = m_Transformed[i].Vertex.x;
+        if (m_Transformed[i].x < m_Min[0]) {
+            m_Min[0] = m_Transformed[i].x;
+        }
+        if (m_Transformed[i].y < m_Min[1]) {
+            m_Min[1] = m_Transformed[i].y;
+        }
+        if (m_Transformed[i].z < m_Min[2]) {
+            m_Min[2] = m_Transformed[i].z;
         }
-        if (m_Transformed[i].Vertex.y < m_Min[1]) {
-            m_Min[1] = m_Transformed[i].Vertex.y;
+        if (m_Transformed[i].x > m_Max[0]) {
+            m_Max[0] = m_Transformed[i].x;
         }
-        if (m_Transformed[i].Vertex.z < m_Min[2]) {
-            m_Min[2] = m_Transformed[i].Vertex.z;
+        if (m_Transformed[i].y > m_Max[1]) {
+            m_Max[1] = m_Transformed[i].y;
         }
-        if (m_Transformed[i].Vertex.x > m_Max[0]) {
-            m_Max[0] = m_Transformed[i].Vertex.x;
+        if (m_Transformed[i].z > m_Max[2]) {
+            m_Max[2] = m_Transformed[i].z;
         }
-        if (m_Transformed[i].Vertex.y > m_Max[1]) {
-            m_Max[1] = m_Transformed[i].Vertex.y;
+    }
+}
+
+void Ms3dModel::SkinVertices (const D3DXMATRIX& _world, bool _normals) {
+    if (m_NumStaticVertices > 0) {
+        D3DXVec3TransformCoordArray (m_Transformed, sizeof (D3DXVECTOR3), 
+            &(m_Vertex[0].Vertex), sizeof (VERTEX), &_world, m_NumStaticVertices);
+        if (_normals) {
+            D3DXVec3TransformNormalArray (m_RotatedNormal, sizeof (D3DXVECTOR3), 
+                m_Normal, sizeof (D3DXVECTOR3), &_world, m_NumStaticVertices);
         }
-        if (m_Transformed[i].Vertex.z > m_Max[2]) {
-            m_Max[2] = m_Transformed[i].Vertex.z;
+    }
+    for (UINT i = 0; i < m_NumJoints; i++) {
+        if (m_Joint[i].NumVertices > 0) {
+            UINT first = m_Joint[i].FirstVertex;
+            D3DXMATRIX skin = m_Palette[i] * _world;
+            D3DXVec3TransformCoordArray (&m_Transformed[first], sizeof (D3DXVECTOR3), 
+                &(m_Vertex[first].Vertex), sizeof (VERTEX), &skin, m_Joint[i].NumVertices);
+            if (_normals) {
+                D3DXVec3TransformNormalArray (&m_RotatedNormal[first], sizeof (D3DXVECTOR3), 
+                    &m_Normal[first], sizeof (D3DXVECTOR3), &skin, m_Joint[i].NumVertices);
+            }
         }
     }
 }
\ No newline at end of file
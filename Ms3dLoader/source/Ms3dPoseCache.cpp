@@ -0,0 +1,92 @@
+#include "../include/Ms3dPoseCache.h"
+
+Ms3dPoseCache::Ms3dPoseCache () {
+    m_NumJoints = 0;
+}
+
+UINT Ms3dPoseCache::AddClip (Ms3dModel& _model, const char* _name, float _startTime, float _endTime, float _sampleRate) {
+    if (_model.GetNumJoints () == 0 || (!m_Clip.empty () && _model.GetNumJoints () != m_NumJoints) ||
+        _startTime < 0.0f || _endTime < _startTime || _sampleRate <= 0.0f) {
+
+        THROW_ERROR (ERRC_INVALID_PARAMETER);
+    }
+    UINT id = FindClip (_startTime, _endTime);
+    if (id != INVALID_ID) {
+        return id;
+    }
+    CLIP clip;
+    clip.Name = _name;
+    clip.StartTime = _startTime;
+    clip.EndTime = _endTime;
+    UINT numIntervals = (UINT)ceil ((_endTime - _startTime) * _sampleRate);
+    clip.NumSamples = numIntervals + 1;
+    clip.Rate = numIntervals > 0 ? numIntervals / (_endTime - _startTime) : 0.0f;
+    clip.FirstMatrix = m_Matrix.size ();
+    m_NumJoints = _model.GetNumJoints ();
+    try {
+        m_Matrix.resize (m_Matrix.size () + clip.NumSamples * m_NumJoints);
+        for (UINT i = 0; i < clip.NumSamples; i++) {
+            float time = i < numIntervals ? _startTime + i / clip.Rate : _endTime;
+            _model.SamplePose (time, &m_Matrix[clip.FirstMatrix + i * m_NumJoints]);
+        }
+        m_Clip.push_back (clip);
+    } catch (std::bad_alloc) {
+        m_Matrix.resize (clip.FirstMatrix);
+        THROW_ERROR (ERRC_OUT_OF_MEM);
+    }
+    return m_Clip.size () - 1;
+}
+
+UINT Ms3dPoseCache::FindClip (float _startTime, float _endTime) const {
+    for (UINT i = 0; i < m_Clip.size (); i++) {
+        if (m_Clip[i].StartTime == _startTime && m_Clip[i].EndTime == _endTime) {
+            return i;
+        }
+    }
+    return INVALID_ID;
+}
+
+void Ms3dPoseCache::GetPose (UINT _clipId, float _time, D3DXMATRIX* _palette) const {
+    const CLIP& clip = m_Clip[_clipId];
+    float sample = (_time - clip.StartTime) * clip.Rate;
+    sample = sample > 0.0f ? sample : 0.0f;
+    UINT first = (UINT)sample;
+    if (first + 1 >= clip.NumSamples) {
+        memcpy (_palette, &m_Matrix[clip.FirstMatrix + (clip.NumSamples - 1) * m_NumJoints], m_NumJoints * sizeof (D3DXMATRIX));
+        return;
+    }
+    // the joints are rigid, so blending the matrices of close samples is close enough to blending the rotations
+    float interp = sample - first;
+    const float* prev = (const float*)&m_Matrix[clip.FirstMatrix + first * m_NumJoints];
+    const float* next = prev + m_NumJoints * 16;
+    float* final = (float*)_palette;
+    for (UINT i = 0; i < m_NumJoints * 16U; i++) {
+        final[i] = prev[i] + (next[i] - prev[i]) * interp;
+    }
+}
+
+UINT Ms3dPoseCache::GetNumClips () const {
+    return m_Clip.size ();
+}
+
+const char* Ms3dPoseCache::GetClipName (UINT _clipId) const {
+    if (_clipId >= m_Clip.size ()) {
+        THROW_DETAILED_ERROR (ERRC_OUT_OF_RANGE, "Invalid ms3d clip ID.");
+    }
+    return m_Clip[_clipId].Name.c_str ();
+}
+
+UINT Ms3dPoseCache::GetClipNumSamples (UINT _clipId) const {
+    if (_clipId >= m_Clip.size ()) {
+        THROW_DETAILED_ERROR (ERRC_OUT_OF_RANGE, "Invalid ms3d clip ID.");
+    }
+    return m_Clip[_clipId].NumSamples;
+}
+
+UINT Ms3dPoseCache::GetClipMemory (UINT _clipId) const {
+    return GetClipNumSamples (_clipId) * m_NumJoints * sizeof (D3DXMATRIX);
+}
+
+UINT Ms3dPoseCache::GetMemory () const {
+    return m_Matrix.size () * sizeof (D3DXMATRIX);
+}
@@ -106,8 +106,10 @@ public:
     UINT GetBufferNumVertices (VERTEXFORMATTYPE _vft, UINT _bufferId);
 
     /** Adds index information to the buffer.
+    A new buffer is started when the indices do not fit.
     @param[in] _indexData the indices
     @param[in] _numIndices the number of the indices 
+    @param[out] _startIndex at which index of the buffer the indices start
     @exception ErrorMessage
 
     - Possible error codes:
@@ -116,11 +118,7 @@ public:
         - @c ERRC_API_CALL
 
     @return buffer ID */
-    UINT AddToIndexBuffer (WORD* _indexData, UINT _numIndices);
-
-    /** Getter: the number of the indices of the buffer.
-    @return the number of the indices */
-    UINT GetIndexBufferNumIndices ();
+    UINT AddToIndexBuffer (WORD* _indexData, UINT _numIndices, UINT& _startIndex);
 
     /** Getter: A pointer to the ObjModel.
     @param[in] _id model ID
@@ -132,6 +130,12 @@ public:
     @return A pointer to the ObjModel */
     ObjModel* GetModel (UINT _id);
 
+    /** Getter: number of the models.
+    @return number of the models */
+    inline UINT GetNumModels () const {
+        return m_Models.size();
+    }
+
     /** Unloads all the models. */
     void UnloadAll ();
 
@@ -140,6 +144,6 @@ private:
 
     /** The vector of the rendering buffers information. @see Buffer */
     std::vector<std::vector<Buffer>> m_RenderingBuffers;    
-    Buffer m_IndexBuffer;               /**< Index buffer ID. */
+    std::vector<Buffer> m_IndexBuffers; /**< The index buffers information. @see Buffer */
     std::vector<ObjModel*> m_Models;    /**< The vector of the pointers to the ObjModel objects. */
 };
\ No newline at end of file
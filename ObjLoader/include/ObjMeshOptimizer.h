@@ -0,0 +1,44 @@
+/** @file ObjMeshOptimizer.h */
+#pragma once
+
+#include <Windows.h>
+#include <vector>
+#include "..\include\RenderDevice.h"
+#include "..\include\VertexCacheOptimizer.h"
+
+#define OBJ_FIFO_CACHE_SIZE 16      /**< Size of the FIFO cache used to count the cache misses. */
+
+/** Reorders indexed triangle lists for the rendering.
+The indices are 32-bit, so any mesh can be optimised,
+the caller narrows them to 16-bit when the vertices fit.
+The triangle order for the vertex cache is OptimizeTriangleOrder of VertexCacheOptimizer.h. */
+class ObjMeshOptimizer {
+public:
+    /** Reorders the clusters of the triangle order to reduce the overdraw.
+    A cluster starts where the FIFO cache misses every vertex of a triangle,
+    so the cache misses barely change. The clusters which face away from
+    the center of the mesh are drawn first, they hide the inner ones.
+    The order is kept if the FIFO cache would miss over 5% more vertices.
+    @param[in,out] _index indices of the triangle list
+    @param[in] _numIndices number of the indices
+    @param[in] _position x, y and z coordinates of every vertex
+    @param[in] _numVertices number of the vertices */
+    static void OptimizeOverdraw (UINT* _index, UINT _numIndices, const float* _position, UINT _numVertices);
+
+    /** Renumbers the vertices in the order of their first use.
+    @param[in,out] _index indices of the triangle list
+    @param[in] _numIndices number of the indices
+    @param[in] _numVertices number of the vertices
+    @param[out] _newVertex new number of every vertex, INVALID_ID for unused vertices
+    @return number of the used vertices */
+    static UINT OptimizeVertexOrder (UINT* _index, UINT _numIndices, UINT _numVertices, UINT* _newVertex);
+
+    /** Counts the misses of a FIFO post-transform vertex cache.
+    The misses divided by the triangles give the average cache miss ratio (ACMR).
+    @param[in] _index indices of the triangle list
+    @param[in] _numIndices number of the indices
+    @param[in] _numVertices number of the vertices
+    @param[in] _cacheSize number of the vertices in the cache
+    @return number of the transformed vertices */
+    static UINT CountCacheMisses (const UINT* _index, UINT _numIndices, UINT _numVertices, UINT _cacheSize);
+};
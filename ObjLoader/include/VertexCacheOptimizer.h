@@ -0,0 +1,131 @@
+/** @file VertexCacheOptimizer.h
+Triangle order for the post-transform vertex cache, after Tom Forsyth's
+linear-speed vertex cache optimisation. It is shared by the model loaders,
+which index their meshes with 16-bit or 32-bit indices.
+*/
+#pragma once
+
+#include "../include/Engine.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+/** Size of the post-transform vertex cache simulated by the triangle order. */
+#define VERTEX_CACHE_SIZE 32
+
+/** Scores a vertex for the triangle order.
+@param[in] _cachePosition position of the vertex in the simulated cache, -1 if it is not there
+@param[in] _numTriangles number of the triangles of the vertex which are not ordered yet
+@return score of the vertex, -1 if it has no triangles left */
+inline float VertexCacheScore (int _cachePosition, UINT _numTriangles) {
+    if (_numTriangles == 0) {
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if (_cachePosition >= 0) {
+        if (_cachePosition < 3) {
+            score = 0.75f;  // used by the last triangle, whichever way it goes next
+        } else {
+            score = powf (1.0f - (_cachePosition - 3) / (float)(VERTEX_CACHE_SIZE - 3), 1.5f);
+        }
+    }
+    // vertices with few triangles left are finished first
+    return score + 2.0f / sqrtf ((float)_numTriangles);
+}
+
+/** Reorders the triangles of an indexed triangle list for the post-transform vertex cache.
+The next triangle is the best scored one among the triangles of the vertices
+in the simulated cache. The vertices of every triangle keep their order.
+@param[in,out] _index indices of the triangle list, @c WORD or @c UINT
+@param[in] _numIndices number of the indices
+@param[in] _numVertices number of the vertices the indices refer to */
+template <class INDEX>
+void OptimizeTriangleOrder (INDEX* _index, UINT _numIndices, UINT _numVertices) {
+    UINT numTriangles = _numIndices / 3;
+    // triangles of each vertex, the ones not ordered yet are kept at the front
+    std::vector<UINT> numActive (_numVertices, 0);
+    for (UINT i = 0; i < _numIndices; i++) {
+        numActive[_index[i]]++;
+    }
+    std::vector<UINT> firstTriangle (_numVertices, 0);
+    for (UINT i = 1; i < _numVertices; i++) {
+        firstTriangle[i] = firstTriangle[i - 1] + numActive[i - 1];
+    }
+    std::vector<UINT> vertexTriangle (_numIndices);
+    std::vector<UINT> numFilled (_numVertices, 0);
+    for (UINT i = 0; i < _numIndices; i++) {
+        vertexTriangle[firstTriangle[_index[i]] + numFilled[_index[i]]++] = i / 3;
+    }
+    std::vector<int> cachePosition (_numVertices, -1);
+    std::vector<float> vertexScore (_numVertices);
+    for (UINT i = 0; i < _numVertices; i++) {
+        vertexScore[i] = VertexCacheScore (-1, numActive[i]);
+    }
+    std::vector<float> triangleScore (numTriangles);
+    std::vector<bool> isOrdered (numTriangles, false);
+    for (UINT i = 0; i < numTriangles; i++) {
+        triangleScore[i] = vertexScore[_index[i * 3]] + vertexScore[_index[i * 3 + 1]] + vertexScore[_index[i * 3 + 2]];
+    }
+    std::vector<INDEX> ordered;
+    ordered.reserve (numTriangles * 3);
+    std::vector<INDEX> cache;
+    std::vector<INDEX> newCache;
+    cache.reserve (VERTEX_CACHE_SIZE + 3);
+    newCache.reserve (VERTEX_CACHE_SIZE + 3);
+    UINT best = INVALID_ID;
+    while (ordered.size () < numTriangles * 3) {
+        if (best == INVALID_ID) {
+            // nothing left around the cache, start over with the best triangle of all
+            float bestScore = -1.0f;
+            for (UINT i = 0; i < numTriangles; i++) {
+                if (!isOrdered[i] && triangleScore[i] > bestScore) {
+                    bestScore = triangleScore[i];
+                    best = i;
+                }
+            }
+        }
+        isOrdered[best] = true;
+        newCache.clear ();
+        for (UINT k = 0; k < 3; k++) {
+            INDEX vertex = _index[best * 3 + k];
+            ordered.push_back (vertex);
+            newCache.push_back (vertex);
+            UINT* triangle = &vertexTriangle[firstTriangle[vertex]];
+            for (UINT j = 0; j < numActive[vertex]; j++) {
+                if (triangle[j] == best) {
+                    triangle[j] = triangle[--numActive[vertex]];
+                    break;
+                }
+            }
+        }
+        for (UINT i = 0; i < cache.size (); i++) {
+            if (cache[i] != newCache[0] && cache[i] != newCache[1] && cache[i] != newCache[2]) {
+                newCache.push_back (cache[i]);
+            }
+        }
+        for (UINT i = 0; i < newCache.size (); i++) {
+            cachePosition[newCache[i]] = i < VERTEX_CACHE_SIZE ? i : -1;
+            vertexScore[newCache[i]] = VertexCacheScore (cachePosition[newCache[i]], numActive[newCache[i]]);
+        }
+        best = INVALID_ID;
+        float bestScore = -1.0f;
+        for (UINT i = 0; i < newCache.size (); i++) {
+            const UINT* triangle = &vertexTriangle[firstTriangle[newCache[i]]];
+            for (UINT j = 0; j < numActive[newCache[i]]; j++) {
+                const INDEX* index = &_index[triangle[j] * 3];
+                triangleScore[triangle[j]] = vertexScore[index[0]] + vertexScore[index[1]] + vertexScore[index[2]];
+                if (triangleScore[triangle[j]] > bestScore) {
+                    bestScore = triangleScore[triangle[j]];
+                    best = triangle[j];
+                }
+            }
+        }
+        if (newCache.size () > VERTEX_CACHE_SIZE) {
+            newCache.resize (VERTEX_CACHE_SIZE);
+        }
+        cache.swap (newCache);
+    }
+    if (!ordered.empty ()) {
+        memcpy (_index, &ordered[0], ordered.size () * sizeof (INDEX));
+    }
+}
@@ -15,8 +15,6 @@ ObjManager::ObjManager (RenderDevice* _device):
     } catch (std::bad_alloc) {
         THROW_ERROR (ERRC_OUT_OF_MEM);
     }
-    m_IndexBuffer.BufferId = INVALID_ID;
-    m_IndexBuffer.Num = 0;
 }
 
 ObjManager::~ObjManager () {
@@ -112,19 +110,29 @@ UINT ObjManager::GetBufferNumVertices (VERTEXFORMATTYPE _vft, UINT _bufferId) {
     return 0;
 }
 
-UINT ObjManager::AddToIndexBuffer (WORD* _IndexData, UINT _NumIndices) {
-    if (m_IndexBuffer.BufferId == INVALID_ID) {
-        m_IndexBuffer.BufferId = m_Device->GetVCacheManager()->CreateStaticIndexBuffer(_IndexData, _NumIndices);
-        m_IndexBuffer.Num = _NumIndices;
-    } else {
-        m_Device->GetVCacheManager()->AddToStaticIndexBuffer(m_IndexBuffer.BufferId, _IndexData, _NumIndices);
-        m_IndexBuffer.Num += _NumIndices;
+UINT ObjManager::AddToIndexBuffer (WORD* _indexData, UINT _numIndices, UINT& _startIndex) {
+    for (UINT i = 0; i < m_IndexBuffers.size(); i++) {
+        try {
+            m_Device->GetVCacheManager()->AddToStaticIndexBuffer(m_IndexBuffers[i].BufferId, _indexData, _numIndices);
+            _startIndex = m_IndexBuffers[i].Num;
+            m_IndexBuffers[i].Num += _numIndices;
+            return m_IndexBuffers[i].BufferId;
+        } catch (ErrorMessage e) {
+            if (e.GetErrorCode () != ERRC_OUT_OF_MEM) { /* Static index buffer was not full. */
+                throw;
+            }
+        }
     }
-    return m_IndexBuffer.BufferId;
-}
-
-UINT ObjManager::GetIndexBufferNumIndices () {
-    return m_IndexBuffer.Num;
+    Buffer newBuffer;
+    newBuffer.BufferId = m_Device->GetVCacheManager()->CreateStaticIndexBuffer(_indexData, _numIndices);
+    newBuffer.Num = _numIndices;
+    try {
+        m_IndexBuffers.push_back (newBuffer);
+    } catch (std::bad_alloc) {
+        THROW_ERROR (ERRC_OUT_OF_MEM);
+    }
+    _startIndex = 0;
+    return newBuffer.BufferId;
 }
 
 ObjModel* ObjManager::GetModel (UINT _id) {
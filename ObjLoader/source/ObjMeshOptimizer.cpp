@@ -0,0 +1,131 @@
+#include "..\include\ObjMeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+/* A run of triangles and how much it faces away from the center of the mesh. */
+struct ObjCluster {
+    UINT FirstIndex;
+    UINT NumIndices;
+    float Facing;
+};
+
+static bool IsFacingMore (const ObjCluster& _first, const ObjCluster& _second) {
+    return _first.Facing > _second.Facing;
+}
+
+void ObjMeshOptimizer::OptimizeOverdraw (UINT* _index, UINT _numIndices, const float* _position, UINT _numVertices) {
+    UINT numTriangles = _numIndices / 3;
+    if (numTriangles < 2) {
+        return;
+    }
+    // the clusters start where the cache is cold anyway
+    std::vector<ObjCluster> clusters;
+    std::vector<UINT> cacheTime (_numVertices, INVALID_ID);
+    UINT time = 0;
+    for (UINT i = 0; i < numTriangles; i++) {
+        UINT numMisses = 0;
+        for (UINT k = 0; k < 3; k++) {
+            UINT vertex = _index[i * 3 + k];
+            if (cacheTime[vertex] == INVALID_ID || time - cacheTime[vertex] >= OBJ_FIFO_CACHE_SIZE) {
+                cacheTime[vertex] = time++;
+                numMisses++;
+            }
+        }
+        if (numMisses == 3 || clusters.empty ()) {
+            ObjCluster cluster;
+            cluster.FirstIndex = i * 3;
+            cluster.NumIndices = 0;
+            cluster.Facing = 0.0f;
+            clusters.push_back (cluster);
+        }
+        clusters.back ().NumIndices += 3;
+    }
+    if (clusters.size () < 2) {
+        return;
+    }
+    float meshCenter[3] = {0.0f, 0.0f, 0.0f};
+    float meshArea = 0.0f;
+    std::vector<float> clusterCenter (clusters.size () * 3, 0.0f);
+    std::vector<float> clusterNormal (clusters.size () * 3, 0.0f);
+    std::vector<float> clusterArea (clusters.size (), 0.0f);
+    for (UINT c = 0; c < clusters.size (); c++) {
+        for (UINT i = clusters[c].FirstIndex; i < clusters[c].FirstIndex + clusters[c].NumIndices; i += 3) {
+            const float* p0 = &_position[_index[i] * 3];
+            const float* p1 = &_position[_index[i + 1] * 3];
+            const float* p2 = &_position[_index[i + 2] * 3];
+            float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            // the cross product is twice the area along the normal
+            float normal[3] = {
+                e1[1] * e2[2] - e1[2] * e2[1],
+                e1[2] * e2[0] - e1[0] * e2[2],
+                e1[0] * e2[1] - e1[1] * e2[0]};
+            float area = sqrtf (normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            for (UINT k = 0; k < 3; k++) {
+                float center = (p0[k] + p1[k] + p2[k]) / 3.0f;
+                clusterCenter[c * 3 + k] += center * area;
+                clusterNormal[c * 3 + k] += normal[k];
+                meshCenter[k] += center * area;
+            }
+            clusterArea[c] += area;
+            meshArea += area;
+        }
+    }
+    if (meshArea <= 0.0f) {
+        return;
+    }
+    for (UINT c = 0; c < clusters.size (); c++) {
+        if (clusterArea[c] <= 0.0f) {
+            continue;
+        }
+        float length = sqrtf (clusterNormal[c * 3] * clusterNormal[c * 3] +
+            clusterNormal[c * 3 + 1] * clusterNormal[c * 3 + 1] +
+            clusterNormal[c * 3 + 2] * clusterNormal[c * 3 + 2]);
+        if (length <= 0.0f) {
+            continue;
+        }
+        for (UINT k = 0; k < 3; k++) {
+            float offset = clusterCenter[c * 3 + k] / clusterArea[c] - meshCenter[k] / meshArea;
+            clusters[c].Facing += offset * clusterNormal[c * 3 + k] / length;
+        }
+    }
+    std::stable_sort (clusters.begin (), clusters.end (), IsFacingMore);
+    std::vector<UINT> ordered;
+    ordered.reserve (numTriangles * 3);
+    for (UINT c = 0; c < clusters.size (); c++) {
+        ordered.insert (ordered.end (), _index + clusters[c].FirstIndex, _index + clusters[c].FirstIndex + clusters[c].NumIndices);
+    }
+    // the clusters may still share some cached vertices, keep the order if too many are lost
+    UINT numMisses = CountCacheMisses (_index, _numIndices, _numVertices, OBJ_FIFO_CACHE_SIZE);
+    if (CountCacheMisses (&ordered[0], ordered.size (), _numVertices, OBJ_FIFO_CACHE_SIZE) > numMisses + numMisses / 20) {
+        return;
+    }
+    memcpy (_index, &ordered[0], ordered.size () * sizeof (UINT));
+}
+
+UINT ObjMeshOptimizer::OptimizeVertexOrder (UINT* _index, UINT _numIndices, UINT _numVertices, UINT* _newVertex) {
+    for (UINT i = 0; i < _numVertices; i++) {
+        _newVertex[i] = INVALID_ID;
+    }
+    UINT numUsed = 0;
+    for (UINT i = 0; i < _numIndices; i++) {
+        if (_newVertex[_index[i]] == INVALID_ID) {
+            _newVertex[_index[i]] = numUsed++;
+        }
+        _index[i] = _newVertex[_index[i]];
+    }
+    return numUsed;
+}
+
+UINT ObjMeshOptimizer::CountCacheMisses (const UINT* _index, UINT _numIndices, UINT _numVertices, UINT _cacheSize) {
+    // a vertex stays in the FIFO until _cacheSize other vertices are transformed
+    std::vector<UINT> cacheTime (_numVertices, INVALID_ID);
+    UINT time = 0;
+    for (UINT i = 0; i < _numIndices; i++) {
+        UINT vertex = _index[i];
+        if (cacheTime[vertex] == INVALID_ID || time - cacheTime[vertex] >= _cacheSize) {
+            cacheTime[vertex] = time++;
+        }
+    }
+    return time;
+}
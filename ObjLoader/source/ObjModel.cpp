@@ -1,4 +1,6 @@
 #include "..\include\ObjModel.h"
+#include "..\include\ObjMeshOptimizer.h"
+#include "..\include\PackFile.h"
 #include <cstdio>
 
 #include <d3dx9.h>
@@ -19,6 +21,9 @@ ObjModel::ObjModel (RenderDevice* _device, ObjManager* _manager):
         m_Scale.identity();
         m_Translation.identity();
         m_Rotation.identity();
+        m_TransformedColor = m_ModelColor;
+        m_IsTransformedPrepared = false;
+        ClearMeshStatistics ();
 }
 
 ObjModel::~ObjModel () {
@@ -46,6 +51,10 @@ void ObjModel::Unload () {
     }
     m_Meshes.clear();
     m_IsOutdated = true;
+    m_TransformedInfo.clear();
+    m_IsTransformedPrepared = false;
+    m_RenderingInfo.clear();
+    ClearMeshStatistics ();
 }
 
 UINT ObjModel::MakeCopy () {
@@ -131,156 +140,13 @@ UINT ObjModel::MakeCopy () {
 }
 
 void ObjModel::PrepareModelRendering () {
+    m_RenderingInfo.clear();
+    ClearMeshStatistics ();
+    MATRIX44 transformation = GetTransformation ();
     try {
         for (UINT i = 0; i < m_Meshes.size(); i++) {
             for (UINT j = 0; j < m_Meshes[i].Objects.size(); j++) {
-                ObjModelObject& object = m_Meshes[i].Objects[j];
-                if (!m_IsTexture && !m_IsNormal) {            
-                    vs3d::ULCVERTEX* modelData = new vs3d::ULCVERTEX[object.Faces.size() * 3];
-                    UINT numVertices = 0;
-                    for (UINT k = 0; k < object.Faces.size(); k++) {
-                        for (UINT l = 0; l < 3; l++) {
-                            UINT index = object.Faces[k].VertexIndex[l];
-                            //VECTOR3 vertex (m_Vertices[index].x, m_Vertices[index].y, m_Vertices[index].z);
-                            //vertex = cml::transform_point (m_Scale * m_Rotation * m_Translation, vertex);
-                            modelData[numVertices].Color = m_ModelColor;
-                            modelData[numVertices].X = m_Vertices[index].X;
-                            modelData[numVertices].Y = m_Vertices[index].Y;
-                            modelData[numVertices++].Z = m_Vertices[index].Z;
-                        }
-                    }
-                    D3DXVec3TransformCoordArray (
-                        (D3DXVECTOR3*)&(modelData[0].X), 
-                        sizeof (vs3d::ULCVERTEX), 
-                        (D3DXVECTOR3*)&(modelData[0].X), 
-                        sizeof (vs3d::ULCVERTEX),
-                        (D3DXMATRIX*)(m_Scale * m_Rotation * m_Translation).data(),
-                        numVertices);
-                    UINT skinId;
-                    if (m_IsMtlFile) {
-                        skinId = m_Meshes[i].SkinId;
-                    } else {
-                        skinId = m_SkinId;
-                    }
-                    ObjRenderingInfo info;
-                    try {
-                        info.BufferId = m_Manager->AddModelToRenderingBuffer (modelData, numVertices, VFT_ULC, info.StartVertex);
-                        info.PrimitiveCount = (UINT) (numVertices / 3);
-                        info.VertexFormat = VFT_ULC;
-                        info.SkinId = skinId;
-                        info.IsPrepared = true;
-                        delete[] modelData;
-                    } catch (ErrorMessage) {
-                        delete[] modelData;
-                        info.IsPrepared = false;
-                        throw;
-                    }
-                    m_RenderingInfo.push_back (info);
-                } else if (m_IsTexture && !m_IsNormal) {
-                    vs3d::ULVERTEX* modelData = new vs3d::ULVERTEX[object.Faces.size() * 3];
-                    UINT numVertices = 0;
-                    for (UINT k = 0; k < object.Faces.size(); k++) {
-                        for (UINT l = 0; l < 3; l++) {
-                            UINT index = object.Faces[k].VertexIndex[l];
-                            /*VECTOR3 vertex (m_Vertices[index].x, m_Vertices[index].y, m_Vertices[index].z);
-                            vertex = cml::transform_point (m_Scale * m_Rotation * m_Translation, vertex);*/
-                            modelData[numVertices].Color = m_ModelColor;
-                            modelData[numVertices].X = m_Vertices[index].X;
-                            modelData[numVertices].Y = m_Vertices[index].Y;
-                            modelData[numVertices].Z = m_Vertices[index].Z;
-                            index = object.Faces[k].TextureIndices[l];
-                            modelData[numVertices].Tu = m_Textures[index].U;
-                            modelData[numVertices].Tv = m_Textures[index].V;
-                            numVertices++;
-                        }
-                    }
-                    D3DXVec3TransformCoordArray (
-                        (D3DXVECTOR3*)&(modelData[0].X), 
-                        sizeof (vs3d::ULVERTEX), 
-                        (D3DXVECTOR3*)&(modelData[0].X), 
-                        sizeof (vs3d::ULVERTEX),
-                        (D3DXMATRIX*)(m_Scale * m_Rotation * m_Translation).data(),
-                        numVertices);
-                    UINT skinId;
-                    if (m_IsMtlFile) {
-                        skinId = m_Meshes[i].SkinId;
-                    } else {
-                        skinId = m_SkinId;
-                    }
-                    ObjRenderingInfo info;
-                    try {
-                        info.BufferId = m_Manager->AddModelToRenderingBuffer (modelData, numVertices, VFT_UL, info.StartVertex);
-                        info.PrimitiveCount = (UINT) (numVertices / 3);
-                        info.VertexFormat = VFT_UL;
-                        info.SkinId = skinId;
-                        info.IsPrepared = true;
-                        delete[] modelData;
-                    } catch (ErrorMessage) {
-                        delete[] modelData;
-                        info.IsPrepared = false;
-                        throw;
-                    }
-                    m_RenderingInfo.push_back (info);
-                } else if (!m_IsTexture && m_IsNormal) {
-                    THROW_ERROR (ERRC_BAD_FILE);
-                } else {
-                    vs3d::UUVERTEX* modelData = new vs3d::UUVERTEX[object.Faces.size() * 3];
-                    UINT numVertices = 0;
-                    for (UINT k = 0; k < object.Faces.size(); k++) {
-                        for (UINT l = 0; l < 3; l++) {
-                            UINT index = object.Faces[k].VertexIndex[l];
-                            /*VECTOR3 vertex (m_Vertices[index].x, m_Vertices[index].y, m_Vertices[index].z);
-                            vertex = cml::transform_point (m_Scale * m_Rotation * m_Translation, vertex);*/
-                            modelData[numVertices].X = m_Vertices[index].X;
-                            modelData[numVertices].Y = m_Vertices[index].Y;
-                            modelData[numVertices].Z = m_Vertices[index].Z;
-                            index = object.Faces[k].TextureIndices[l];
-                            modelData[numVertices].Tu = m_Textures[index].U;
-                            modelData[numVertices].Tv = m_Textures[index].V;
-                            index = object.Faces[k].NormalIndices[l];
-                            /*VECTOR3 normal (m_Normals[index].x, m_Normals[index].y, m_Normals[index].z);
-                            normal = cml::transform_vector (m_Rotation, normal);*/
-                            modelData[numVertices].Normal[0] = m_Normals[index].X;
-                            modelData[numVertices].Normal[1] = m_Normals[index].Y;
-                            modelData[numVertices].Normal[2] = m_Normals[index].Z;
-                            numVertices++;
-                        }
-                    }
-                    D3DXVec3TransformCoordArray (
-                        (D3DXVECTOR3*)&(modelData[0].X), 
-                        sizeof (vs3d::UUVERTEX), 
-                        (D3DXVECTOR3*)&(modelData[0].X), 
-                        sizeof (vs3d::UUVERTEX),
-                        (D3DXMATRIX*)(m_Scale * m_Rotation * m_Translation).data(),
-                        numVertices);
-                    D3DXVec3TransformNormalArray (
-                        (D3DXVECTOR3*)&(modelData[0].Normal[0]),
-                        sizeof (vs3d::UUVERTEX),
-                        (D3DXVECTOR3*)&(modelData[0].Normal[0]),
-                        sizeof (vs3d::UUVERTEX),
-                        (D3DXMATRIX*)(m_Scale * m_Rotation * m_Translation).data(),
-                        numVertices);
-                    UINT skinId;
-                    if (m_IsMtlFile) {
-                        skinId = m_Meshes[i].SkinId;
-                    } else {
-                        skinId = m_SkinId;
-                    }
-                    ObjRenderingInfo info;
-                    try {
-                        info.BufferId = m_Manager->AddModelToRenderingBuffer (modelData, numVertices, VFT_UU, info.StartVertex);
-                        info.PrimitiveCount = (UINT) (numVertices / 3);
-                        info.VertexFormat = VFT_UU;
-                        info.SkinId = skinId;
-                        info.IsPrepared = true;
-                        delete[] modelData;
-                    } catch (ErrorMessage) {
-                        info.IsPrepared = false;
-                        delete[] modelData;
-                        throw;
-                    }
-                    m_RenderingInfo.push_back (info);
-                }
+                m_RenderingInfo.push_back (PrepareObject (i, m_Meshes[i].Objects[j], &transformation));
             }
         }
     } catch (std::bad_alloc) {
@@ -288,6 +154,205 @@ void ObjModel::PrepareModelRendering () {
     }
 }
 
+ObjRenderingInfo ObjModel::PrepareObject (UINT _meshId, const ObjModelObject& _object, const MATRIX44* _transformation) {
+    VERTEXFORMATTYPE vft = GetVertexFormat ();
+    ObjRenderingInfo info;
+    info.BufferId = INVALID_ID;
+    info.StartVertex = 0;
+    info.IndexBufferId = INVALID_ID;
+    info.StartIndex = 0;
+    info.PrimitiveCount = _object.Faces.size();
+    info.VertexFormat = vft;
+    if (m_IsMtlFile) {
+        info.SkinId = m_Meshes[_meshId].SkinId;
+    } else {
+        info.SkinId = m_SkinId;
+    }
+    info.IsPrepared = false;
+    UINT numCorners = _object.Faces.size() * 3;
+    if (numCorners == 0) {
+        return info;
+    }
+    // weld the corners which share the position, the texture coordinates and the normal
+    std::vector<UINT> index (numCorners);
+    std::vector<UINT> uniqueCorner;
+    std::vector<UINT> nextUnique;
+    std::vector<UINT> firstUnique (m_Vertices.size(), INVALID_ID);
+    for (UINT i = 0; i < numCorners; i++) {
+        const ObjModelFace& face = _object.Faces[i / 3];
+        UINT vertex = face.VertexIndex[i % 3];
+        if (vertex >= m_Vertices.size()) {
+            THROW_ERROR (ERRC_BAD_FILE);
+        }
+        UINT unique = firstUnique[vertex];
+        for (; unique != INVALID_ID; unique = nextUnique[unique]) {
+            const ObjModelFace& uniqueFace = _object.Faces[uniqueCorner[unique] / 3];
+            UINT corner = uniqueCorner[unique] % 3;
+            if ((!m_IsTexture || uniqueFace.TextureIndices[corner] == face.TextureIndices[i % 3]) &&
+                (!m_IsNormal || uniqueFace.NormalIndices[corner] == face.NormalIndices[i % 3])) {
+                break;
+            }
+        }
+        if (unique == INVALID_ID) {
+            unique = uniqueCorner.size();
+            uniqueCorner.push_back (i);
+            nextUnique.push_back (firstUnique[vertex]);
+            firstUnique[vertex] = unique;
+        }
+        index[i] = unique;
+    }
+    UINT numVertices = uniqueCorner.size();
+    m_NumTriangles += _object.Faces.size();
+    m_NumCorners += numCorners;
+    m_CacheMissesBefore += ObjMeshOptimizer::CountCacheMisses (&index[0], numCorners, numVertices, OBJ_FIFO_CACHE_SIZE);
+
+    OptimizeTriangleOrder (&index[0], numCorners, numVertices);
+    std::vector<float> position (numVertices * 3);
+    for (UINT i = 0; i < numVertices; i++) {
+        const ObjModelVertex& vertex = m_Vertices[_object.Faces[uniqueCorner[i] / 3].VertexIndex[uniqueCorner[i] % 3]];
+        position[i * 3] = vertex.X;
+        position[i * 3 + 1] = vertex.Y;
+        position[i * 3 + 2] = vertex.Z;
+    }
+    ObjMeshOptimizer::OptimizeOverdraw (&index[0], numCorners, &position[0], numVertices);
+    std::vector<UINT> newVertex (numVertices);
+    ObjMeshOptimizer::OptimizeVertexOrder (&index[0], numCorners, numVertices, &newVertex[0]);
+    std::vector<UINT> vertexCorner (numVertices);
+    for (UINT i = 0; i < numVertices; i++) {
+        vertexCorner[newVertex[i]] = uniqueCorner[i];
+    }
+    m_CacheMissesAfter += ObjMeshOptimizer::CountCacheMisses (&index[0], numCorners, numVertices, OBJ_FIFO_CACHE_SIZE);
+
+    // the index buffers are 16-bit, larger objects keep the new order without indices
+    bool isIndexed = numVertices <= 0x10000;
+    if (!isIndexed) {
+        std::vector<UINT> corner (numCorners);
+        for (UINT i = 0; i < numCorners; i++) {
+            corner[i] = vertexCorner[index[i]];
+        }
+        vertexCorner.swap (corner);
+        numVertices = numCorners;
+    }
+    m_NumRenderVertices += numVertices;
+    void* modelData = CreateVertices (_object, &vertexCorner[0], numVertices);
+    try {
+        if (_transformation) {
+            TransformVertices (modelData, numVertices, *_transformation);
+        }
+        info.BufferId = m_Manager->AddModelToRenderingBuffer (modelData, numVertices, vft, info.StartVertex);
+        delete[] modelData;
+    } catch (ErrorMessage) {
+        delete[] modelData;
+        throw;
+    }
+    if (isIndexed) {
+        std::vector<WORD> shortIndex (index.begin(), index.end());
+        info.IndexBufferId = m_Manager->AddToIndexBuffer (&shortIndex[0], numCorners, info.StartIndex);
+    }
+    info.IsPrepared = true;
+    return info;
+}
+
+void* ObjModel::CreateVertices (const ObjModelObject& _object, const UINT* _corner, UINT _numVertices) const {
+    VERTEXFORMATTYPE vft = GetVertexFormat ();
+    if (vft == VFT_ULC) {
+        vs3d::ULCVERTEX* modelData = new vs3d::ULCVERTEX[_numVertices];
+        for (UINT i = 0; i < _numVertices; i++) {
+            UINT corner = _corner ? _corner[i] : i;
+            const ObjModelFace& face = _object.Faces[corner / 3];
+            UINT index = face.VertexIndex[corner % 3];
+            modelData[i].Color = m_ModelColor;
+            modelData[i].X = m_Vertices[index].X;
+            modelData[i].Y = m_Vertices[index].Y;
+            modelData[i].Z = m_Vertices[index].Z;
+        }
+        return modelData;
+    } else if (vft == VFT_UL) {
+        vs3d::ULVERTEX* modelData = new vs3d::ULVERTEX[_numVertices];
+        for (UINT i = 0; i < _numVertices; i++) {
+            UINT corner = _corner ? _corner[i] : i;
+            const ObjModelFace& face = _object.Faces[corner / 3];
+            UINT index = face.VertexIndex[corner % 3];
+            modelData[i].Color = m_ModelColor;
+            modelData[i].X = m_Vertices[index].X;
+            modelData[i].Y = m_Vertices[index].Y;
+            modelData[i].Z = m_Vertices[index].Z;
+            index = face.TextureIndices[corner % 3];
+            modelData[i].Tu = m_Textures[index].U;
+            modelData[i].Tv = m_Textures[index].V;
+        }
+        return modelData;
+    }
+    vs3d::UUVERTEX* modelData = new vs3d::UUVERTEX[_numVertices];
+    for (UINT i = 0; i < _numVertices; i++) {
+        UINT corner = _corner ? _corner[i] : i;
+        const ObjModelFace& face = _object.Faces[corner / 3];
+        UINT index = face.VertexIndex[corner % 3];
+        modelData[i].X = m_Vertices[index].X;
+        modelData[i].Y = m_Vertices[index].Y;
+        modelData[i].Z = m_Vertices[index].Z;
+        index = face.TextureIndices[corner % 3];
+        modelData[i].Tu = m_Textures[index].U;
+        modelData[i].Tv = m_Textures[index].V;
+        index = face.NormalIndices[corner % 3];
+        modelData[i].Normal[0] = m_Normals[index].X;
+        modelData[i].Normal[1] = m_Normals[index].Y;
+        modelData[i].Normal[2] = m_Normals[index].Z;
+    }
+    return modelData;
+}
+
+void ObjModel::TransformVertices (void* _modelData, UINT _numVertices, const MATRIX44& _transformation) const {
+    if (_numVertices == 0) {
+        return;
+    }
+    VERTEXFORMATTYPE vft = GetVertexFormat ();
+    D3DXMATRIX* transformation = (D3DXMATRIX*)_transformation.data();
+    if (vft == VFT_ULC) {
+        vs3d::ULCVERTEX* modelData = (vs3d::ULCVERTEX*)_modelData;
+        D3DXVec3TransformCoordArray (
+            (D3DXVECTOR3*)&(modelData[0].X), 
+            sizeof (vs3d::ULCVERTEX), 
+            (D3DXVECTOR3*)&(modelData[0].X), 
+            sizeof (vs3d::ULCVERTEX),
+            transformation,
+            _numVertices);
+    } else if (vft == VFT_UL) {
+        vs3d::ULVERTEX* modelData = (vs3d::ULVERTEX*)_modelData;
+        D3DXVec3TransformCoordArray (
+            (D3DXVECTOR3*)&(modelData[0].X), 
+            sizeof (vs3d::ULVERTEX), 
+            (D3DXVECTOR3*)&(modelData[0].X), 
+            sizeof (vs3d::ULVERTEX),
+            transformation,
+            _numVertices);
+    } else {
+        vs3d::UUVERTEX* modelData = (vs3d::UUVERTEX*)_modelData;
+        D3DXVec3TransformCoordArray (
+            (D3DXVECTOR3*)&(modelData[0].X), 
+            sizeof (vs3d::UUVERTEX), 
+            (D3DXVECTOR3*)&(modelData[0].X), 
+            sizeof (vs3d::UUVERTEX),
+            transformation,
+            _numVertices);
+        D3DXVec3TransformNormalArray (
+            (D3DXVECTOR3*)&(modelData[0].Normal[0]),
+            sizeof (vs3d::UUVERTEX),
+            (D3DXVECTOR3*)&(modelData[0].Normal[0]),
+            sizeof (vs3d::UUVERTEX),
+            transformation,
+            _numVertices);
+    }
+}
+
+void ObjModel::ClearMeshStatistics () {
+    m_NumTriangles = 0;
+    m_NumCorners = 0;
+    m_NumRenderVertices = 0;
+    m_CacheMissesBefore = 0;
+    m_CacheMissesAfter = 0;
+}
+
 void ObjModel::PrepareBoundsRendering () {
     vs3d::ULCVERTEX vertex[8];
     WORD index[24];
@@ -317,8 +382,7 @@ void ObjModel::PrepareBoundsRendering () {
         return VS3D_FAIL;
     }*/
     m_BoundsInfo.RenderingInfo.IsPrepared = false;
-    m_BoundsInfo.StartIndex = m_Manager->GetIndexBufferNumIndices();
-    m_BoundsInfo.IndexBufferId = m_Manager->AddToIndexBuffer (index, 24);
+    m_BoundsInfo.IndexBufferId = m_Manager->AddToIndexBuffer (index, 24, m_BoundsInfo.StartIndex);
     m_BoundsInfo.RenderingInfo.BufferId = m_Manager->AddModelToRenderingBuffer (vertex, 8, VFT_ULC, m_BoundsInfo.RenderingInfo.StartVertex);
     m_BoundsInfo.RenderingInfo.PrimitiveCount = 12;
     m_BoundsInfo.RenderingInfo.VertexFormat = VFT_ULC;
@@ -333,168 +397,117 @@ void ObjModel::Prepare () {
 
 void ObjModel::Render () {
     for (UINT i = 0; i < m_RenderingInfo.size(); i++) {
-        if (m_RenderingInfo[i].IsPrepared) {
-            m_Device->GetVCacheManager()->Render (
-                    PT_TRIANGLELIST, 
-                    m_RenderingInfo[i].BufferId, 
-                    m_RenderingInfo[i].StartVertex, 
-                    (WORD*)0, 0, 
-                    m_RenderingInfo[i].PrimitiveCount,
-                    m_RenderingInfo[i].VertexFormat, 
-                    m_RenderingInfo[i].SkinId);
-        }
+        RenderObject (m_RenderingInfo[i]);
+    }
+}
+
+void ObjModel::RenderObject (const ObjRenderingInfo& _info) {
+    if (!_info.IsPrepared) {
+        return;
+    }
+    if (_info.IndexBufferId != INVALID_ID) {
+        m_Device->GetVCacheManager()->Render (
+                PT_TRIANGLELIST, 
+                _info.BufferId, 
+                _info.StartVertex, 
+                _info.IndexBufferId,
+                _info.StartIndex,
+                _info.PrimitiveCount,
+                _info.VertexFormat, 
+                _info.SkinId);
+    } else {
+        m_Device->GetVCacheManager()->Render (
+                PT_TRIANGLELIST, 
+                _info.BufferId, 
+                _info.StartVertex, 
+                (WORD*)0, 0, 
+                _info.PrimitiveCount,
+                _info.VertexFormat, 
+                _info.SkinId);
     }
 }
 
 void ObjModel::RenderDynamic () {
     try {
+        VERTEXFORMATTYPE vft = GetVertexFormat ();
+        MATRIX44 transformation = GetTransformation ();
         for (UINT i = 0; i < m_Meshes.size(); i++) {
             for (UINT j = 0; j < m_Meshes[i].Objects.size(); j++) {
                 ObjModelObject& object = m_Meshes[i].Objects[j];
-                if (!m_IsTexture && !m_IsNormal) {
-                    if (m_IsOutdated) {
-                        delete[] object.ModelData;
-                        object.ModelData = new vs3d::ULCVERTEX[object.Faces.size() * 3];
-                        vs3d::ULCVERTEX* modelData = (vs3d::ULCVERTEX*)object.ModelData;
-                        object.NumVertices = 0;
-                        for (UINT k = 0; k < object.Faces.size(); k++) {
-                            for (UINT l = 0; l < 3; l++) {
-                                UINT index = object.Faces[k].VertexIndex[l];
-                                //VECTOR3 vertex (m_Vertices[index].x, m_Vertices[index].y, m_Vertices[index].z);
-                                //vertex = cml::transform_point (m_Scale * m_Rotation * m_Translation, vertex);
-                                modelData[object.NumVertices].Color = m_ModelColor;
-                                modelData[object.NumVertices].X = m_Vertices[index].X;
-                                modelData[object.NumVertices].Y = m_Vertices[index].Y;
-                                modelData[object.NumVertices++].Z = m_Vertices[index].Z;
-                            }
-                        }
-                        D3DXVec3TransformCoordArray (
-                            (D3DXVECTOR3*)&(modelData[0].X), 
-                            sizeof (vs3d::ULCVERTEX), 
-                            (D3DXVECTOR3*)&(modelData[0].X), 
-                            sizeof (vs3d::ULCVERTEX),
-                            (D3DXMATRIX*)(m_Scale * m_Rotation * m_Translation).data(),
-                            object.NumVertices);
-                        m_IsOutdated = false;
-                    }
-                    UINT skinId;
-                    if (m_IsMtlFile) {
-                        skinId = m_Meshes[i].SkinId;
-                    } else {
-                        skinId = m_SkinId;
-                    }
-                    m_Device->GetVCacheManager()->Render (
-                        PT_TRIANGLELIST, 
-                        object.ModelData, object.NumVertices,
-                        (WORD*)NULL, 0, 
-                        VFT_ULC, 
-                        skinId);
-                    //delete[] modelData;
-                } else if (m_IsTexture && !m_IsNormal) {
-                    if (m_IsOutdated) {
-                        delete[] object.ModelData;
-                        object.ModelData = new vs3d::ULVERTEX[object.Faces.size() * 3];
-                        vs3d::ULVERTEX* modelData = (vs3d::ULVERTEX*)object.ModelData;
-                        object.NumVertices = 0;
-                        for (UINT k = 0; k < object.Faces.size(); k++) {
-                            for (UINT l = 0; l < 3; l++) {
-                                UINT index = object.Faces[k].VertexIndex[l];
-                                //VECTOR3 vertex (m_Vertices[index].x, m_Vertices[index].y, m_Vertices[index].z);
-                                //vertex = cml::transform_point (m_Scale * m_Rotation * m_Translation, vertex);
-                                modelData[object.NumVertices].Color = m_ModelColor;
-                                modelData[object.NumVertices].X = m_Vertices[index].X;
-                                modelData[object.NumVertices].Y = m_Vertices[index].Y;
-                                modelData[object.NumVertices].Z = m_Vertices[index].Z;
-                                index = object.Faces[k].TextureIndices[l];
-                                modelData[object.NumVertices].Tu = m_Textures[index].U;
-                                modelData[object.NumVertices].Tv = m_Textures[index].V;
-                                object.NumVertices++;
-                            }
-                        }
-                        D3DXVec3TransformCoordArray (
-                            (D3DXVECTOR3*)&(modelData[0].X), 
-                            sizeof (vs3d::ULVERTEX), 
-                            (D3DXVECTOR3*)&(modelData[0].X), 
-                            sizeof (vs3d::ULVERTEX),
-                            (D3DXMATRIX*)(m_Scale * m_Rotation * m_Translation).data(),
-                            object.NumVertices);
-                        m_IsOutdated = false;
-                    }
-                    UINT skinId;
-                    if (m_IsMtlFile) {
-                        skinId = m_Meshes[i].SkinId;
-                    } else {
-                        skinId = m_SkinId;
-                    }
-                    m_Device->GetVCacheManager()->Render (
-                        PT_TRIANGLELIST, 
-                        object.ModelData, object.NumVertices,
-                        (WORD*)0, 0, 
-                        VFT_UL, 
-                        skinId);
-                } else if (!m_IsTexture && m_IsNormal) {
-                    THROW_ERROR (ERRC_BAD_FILE);
+                if (m_IsOutdated) {
+                    ExpandObject (object);
+                    TransformVertices (object.ModelData, object.NumVertices, transformation);
+                }
+                if (object.NumVertices == 0) {
+                    continue;
+                }
+                UINT skinId;
+                if (m_IsMtlFile) {
+                    skinId = m_Meshes[i].SkinId;
                 } else {
-                    if (m_IsOutdated) {
-                        delete[] object.ModelData;
-                        object.ModelData = new vs3d::UUVERTEX[object.Faces.size() * 3];
-                        vs3d::UUVERTEX* modelData = (vs3d::UUVERTEX*)object.ModelData;
-                        object.NumVertices = 0;
-                        for (UINT k = 0; k < object.Faces.size(); k++) {
-                            for (UINT l = 0; l < 3; l++) {
-                                UINT index = object.Faces[k].VertexIndex[l];
-                                //VECTOR3 vertex (m_Vertices[index].x, m_Vertices[index].y, m_Vertices[index].z);
-                                //vertex = cml::transform_point (m_Scale * m_Rotation * m_Translation, vertex);
-                                modelData[object.NumVertices].X = m_Vertices[index].X;
-                                modelData[object.NumVertices].Y = m_Vertices[index].Y;
-                                modelData[object.NumVertices].Z = m_Vertices[index].Z;
-                                index = object.Faces[k].TextureIndices[l];
-                                modelData[object.NumVertices].Tu = m_Textures[index].U;
-                                modelData[object.NumVertices].Tv = m_Textures[index].V;
-                                index = object.Faces[k].NormalIndices[l];
-                                //VECTOR3 normal (m_Normals[index].x, m_Normals[index].y, m_Normals[index].z);
-                                //normal = cml::transform_vector (m_Rotation, normal);
-                                modelData[object.NumVertices].Normal[0] = m_Normals[index].X;
-                                modelData[object.NumVertices].Normal[1] = m_Normals[index].Y;
-                                modelData[object.NumVertices].Normal[2] = m_Normals[index].Z;
-                                object.NumVertices++;
-                            }
-                        }
-                        D3DXVec3TransformCoordArray (
-                            (D3DXVECTOR3*)&(modelData[0].X), 
-                            sizeof (vs3d::UUVERTEX), 
-                            (D3DXVECTOR3*)&(modelData[0].X), 
-                            sizeof (vs3d::UUVERTEX),
-                            (D3DXMATRIX*)(m_Scale * m_Rotation * m_Translation).data(),
-                            object.NumVertices);
-                        D3DXVec3TransformNormalArray (
-                            (D3DXVECTOR3*)&(modelData[0].Normal[0]),
-                            sizeof (vs3d::UUVERTEX),
-                            (D3DXVECTOR3*)&(modelData[0].Normal[0]),
-                            sizeof (vs3d::UUVERTEX),
-                            (D3DXMATRIX*)(m_Scale * m_Rotation * m_Translation).data(),
-                            object.NumVertices);
-                        m_IsOutdated = false;
-                    }
-                    UINT skinId;
-                    if (m_IsMtlFile) {
-                        skinId = m_Meshes[i].SkinId;
-                    } else {
-                        skinId = m_SkinId;
-                    }
-                    m_Device->GetVCacheManager()->Render (
-                        PT_TRIANGLELIST, 
-                        object.ModelData, object.NumVertices,
-                        (WORD*)0, 0, 
-                        VFT_UU, 
-                        skinId);
-                    //delete[] modelData;
+                    skinId = m_SkinId;
                 }
+                m_Device->GetVCacheManager()->Render (
+                    PT_TRIANGLELIST, 
+                    object.ModelData, object.NumVertices,
+                    (WORD*)NULL, 0, 
+                    vft, 
+                    skinId);
+            }
+        }
+        m_IsOutdated = false;
+    } catch (std::bad_alloc) {
+        THROW_ERROR (ERRC_OUT_OF_MEM);
+    }
+}
+
+void ObjModel::RenderTransformed () {
+    if (!m_IsTransformedPrepared || m_TransformedColor != m_ModelColor) {
+        PrepareTransformedRendering ();
+    }
+    MATRIX44 world = m_Device->GetWorldMatrix ();
+    m_Device->SetWorldMatrix (GetTransformation () * world);
+    for (UINT i = 0; i < m_TransformedInfo.size(); i++) {
+        RenderObject (m_TransformedInfo[i]);
+    }
+    m_Device->SetWorldMatrix (world);   // flushes the model with its own world matrix
+}
+
+void ObjModel::PrepareTransformedRendering () {
+    m_TransformedInfo.clear();
+    m_IsTransformedPrepared = false;
+    ClearMeshStatistics ();
+    try {
+        for (UINT i = 0; i < m_Meshes.size(); i++) {
+            for (UINT j = 0; j < m_Meshes[i].Objects.size(); j++) {
+                m_TransformedInfo.push_back (PrepareObject (i, m_Meshes[i].Objects[j], NULL));
             }
         }
     } catch (std::bad_alloc) {
         THROW_ERROR (ERRC_OUT_OF_MEM);
     }
+    m_TransformedColor = m_ModelColor;
+    m_IsTransformedPrepared = true;
+}
+
+void ObjModel::ExpandObject (ObjModelObject& _object) {
+    delete[] _object.ModelData;
+    _object.ModelData = NULL;
+    _object.NumVertices = 0;
+    _object.ModelData = CreateVertices (_object, NULL, _object.Faces.size() * 3);
+    _object.NumVertices = _object.Faces.size() * 3;
+}
+
+VERTEXFORMATTYPE ObjModel::GetVertexFormat () const {
+    if (!m_IsTexture && m_IsNormal) {
+        THROW_ERROR (ERRC_BAD_FILE);
+    }
+    if (!m_IsTexture) {
+        return VFT_ULC;
+    } else if (!m_IsNormal) {
+        return VFT_UL;
+    }
+    return VFT_UU;
 }
 
 void ObjModel::RenderBounds () {
@@ -575,17 +588,19 @@ void ObjModel::UpdateActiveMesh (const char (&_materialName)[MAX_PATH]) {
 }
 
 void ObjModel::Load (const char* _filename) {
+    LoadGeometry (_filename);
+    LoadMaterials ();
+}
+
+void ObjModel::LoadGeometry (const char* _filename) {
     Unload ();
     strcpy (m_Filename, _filename);
-    FILE* file = fopen (_filename, "r");
-    if (!file) {
-        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _filename);
-    }
+    VirtualFile file (_filename);
     char fileLine[MAX_PATH];    // we will be reading by line
     char firstCharacters[MAX_PATH]; // a string to determine the type of a line
     m_FirstTimeBoundsUpdate = true;
     try {
-        while (fgets (fileLine, MAX_PATH, file) != NULL) {
+        while (file.Gets (fileLine, MAX_PATH) != NULL) {
             sscanf (fileLine, "%s", firstCharacters);        
             // skip comments
             if (strcmp(firstCharacters, "#") != 0) {
@@ -617,8 +632,6 @@ void ObjModel::Load (const char* _filename) {
     } catch (std::bad_alloc) {
         THROW_ERROR (ERRC_OUT_OF_MEM);
     }
-    fclose (file);
-    LoadMaterials ();
 }
 
 void ObjModel::LoadFace (const char (&_line)[MAX_PATH]) {
@@ -696,18 +709,18 @@ void ObjModel::LoadMaterials () {
         }
     }
     strcat (mtlFilepath, m_MtlFilename);
-    FILE* file = fopen (mtlFilepath, "r");
-    if (!file) {
+    if (!VirtualFile::Exists (mtlFilepath)) {
         m_IsMtlFile = false;
     } else {
         m_IsMtlFile = true;    
+        VirtualFile file (mtlFilepath);
         char fileLine[MAX_PATH];    // we will be reading by line
         char firstCharacters[MAX_PATH]; // a string to determine the type of a line
         UINT currentMesh = 0;
         vs3d::MATERIAL material;
         char textureFile[MAX_PATH];
         bool firstMaterial = true;  // to know if it's first material we read
-        while (fgets (fileLine, MAX_PATH, file) != NULL) {
+        while (file.Gets (fileLine, MAX_PATH) != NULL) {
             sscanf (fileLine, "%s", firstCharacters);        
             if (strcmp(firstCharacters, "#") != 0) {    // not a comment line
                 if (strcmp(firstCharacters, "newmtl") == 0) {
@@ -766,7 +779,6 @@ void ObjModel::LoadMaterials () {
                 }
             }
         }
-        fclose (file);
         if ((!firstMaterial) && (currentMesh != INVALID_ID)) {
             if (strlen (textureFile) > 0) {
                 UINT textureId = m_Device->GetSkinManager()->AddTexture (textureFile);
@@ -0,0 +1,267 @@
+#include "../include/PackFile.h"
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#ifdef _DEBUG
+    #pragma comment (lib, "lib/Debug/PackFile.lib")
+    #pragma comment (lib, "lib/Debug/ErrorMessage.lib")
+#else
+    #pragma comment (lib, "lib/PackFile.lib")
+    #pragma comment (lib, "lib/ErrorMessage.lib")
+#endif
+
+/* Packs the data directory of the game into a single archive.
+
+   PackBuilder [-align <bytes>] [-store] <archive> <file or directory>...
+   PackBuilder -test <archive>
+
+   The files are packed under their paths as they are given, run it from the
+   directory of the game, e.g. PackBuilder data.pak data c_level.terrain
+   An entry is compressed if that saves at least an eighth of it, -store
+   leaves all of them uncompressed. -test reads every entry from the archive
+   and as a loose file, compares them and prints both times. */
+
+/* an entry is kept compressed only if it saves at least 1/PACK_MIN_SAVING of the file */
+#define PACK_MIN_SAVING 8
+
+static double GetSeconds () {
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency (&frequency);
+    QueryPerformanceCounter (&counter);
+    return (double)counter.QuadPart / frequency.QuadPart;
+}
+
+static void FindFiles (const std::string& _path, std::vector<std::string>& _files) {
+    DWORD attributes = GetFileAttributesA (_path.c_str ());
+    if (attributes == INVALID_FILE_ATTRIBUTES) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _path.c_str ());
+    }
+    if ((attributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+        _files.push_back (_path);
+        return;
+    }
+    std::vector<std::string> names;
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA ((_path + "/*").c_str (), &data);
+    if (find != INVALID_HANDLE_VALUE) {
+        do {
+            if (strcmp (data.cFileName, ".") != 0 && strcmp (data.cFileName, "..") != 0) {
+                names.push_back (data.cFileName);
+            }
+        } while (FindNextFileA (find, &data));
+        FindClose (find);
+    }
+    std::sort (names.begin (), names.end ());
+    for (UINT i = 0; i < names.size (); i++) {
+        FindFiles (_path + "/" + names[i], _files);
+    }
+}
+
+static void ReadLooseFile (const char* _filename, std::vector<char>& _data) {
+    FILE* file = fopen (_filename, "rb");
+    if (!file) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _filename);
+    }
+    long size = -1;
+    if (fseek (file, 0, SEEK_END) == 0) {
+        size = ftell (file);
+    }
+    _data.resize (size > 0 ? size : 0);
+    bool isRead = size >= 0 && fseek (file, 0, SEEK_SET) == 0 &&
+        (size == 0 || fread (&_data[0], 1, size, file) == (size_t)size);
+    fclose (file);
+    if (!isRead) {
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+}
+
+static void Write (FILE* _file, const void* _data, UINT _size, const char* _filename) {
+    if (_size > 0 && fwrite (_data, 1, _size, _file) != _size) {
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+}
+
+static void Build (const char* _archive, const std::vector<std::string>& _files, UINT _alignment, bool _isStored) {
+    double start = GetSeconds ();
+    // the names, every one once
+    std::vector<std::string> names (_files.size ());
+    for (UINT i = 0; i < _files.size (); i++) {
+        names[i] = PackFile::NormalizeName (_files[i].c_str ());
+        for (UINT j = 0; j < i; j++) {
+            if (names[j] == names[i]) {
+                THROW_DETAILED_ERROR (ERRC_INVALID_PARAMETER, _files[i].c_str ());
+            }
+        }
+    }
+    FILE* file = fopen (_archive, "wb");
+    if (!file) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _archive);
+    }
+    try {
+        PackHeader header;
+        memset (&header, 0, sizeof (header));
+        Write (file, &header, sizeof (header), _archive);
+        UINT offset = sizeof (header);
+        std::vector<PackEntry> entries (_files.size ());
+        std::string nameTable;
+        unsigned long long totalSize = 0;
+        std::vector<char> data;
+        std::vector<char> compressed;
+        std::vector<char> padding (_alignment, 0);
+        for (UINT i = 0; i < _files.size (); i++) {
+            ReadLooseFile (_files[i].c_str (), data);
+            PackEntry& entry = entries[i];
+            entry.NameHash = PackFile::HashName (names[i]);
+            entry.NameOffset = nameTable.size ();
+            entry.OriginalSize = data.size ();
+            entry.Flags = 0;
+            nameTable += names[i];
+            nameTable += '\0';
+            const char* stored = data.empty () ? NULL : &data[0];
+            entry.Size = data.size ();
+            if (!_isStored && !data.empty ()) {
+                PackFile::Compress (&data[0], data.size (), compressed);
+                if (compressed.size () <= data.size () - data.size () / PACK_MIN_SAVING) {
+                    stored = &compressed[0];
+                    entry.Size = compressed.size ();
+                    entry.Flags = PACK_ENTRY_COMPRESSED;
+                }
+            }
+            UINT paddingSize = (_alignment - offset % _alignment) % _alignment;
+            Write (file, &padding[0], paddingSize, _archive);
+            offset += paddingSize;
+            if ((unsigned long long)offset + entry.Size > 0x7fffffff) {
+                THROW_DETAILED_ERROR (ERRC_OUT_OF_RANGE, _archive);
+            }
+            entry.Offset = offset;
+            Write (file, stored, entry.Size, _archive);
+            offset += entry.Size;
+            totalSize += entry.OriginalSize;
+            printf ("%s %u -> %u bytes%s\n", names[i].c_str (), entry.OriginalSize, entry.Size,
+                entry.Flags & PACK_ENTRY_COMPRESSED ? " compressed" : "");
+        }
+        // the hash table is at most half full, so the look-ups are short
+        UINT hashTableSize = 1;
+        while (hashTableSize < entries.size () * 2) {
+            hashTableSize <<= 1;
+        }
+        std::vector<UINT> hashTable (hashTableSize, PACK_INVALID_ENTRY);
+        for (UINT i = 0; i < entries.size (); i++) {
+            UINT slot = entries[i].NameHash & (hashTableSize - 1);
+            while (hashTable[slot] != PACK_INVALID_ENTRY) {
+                slot = (slot + 1) & (hashTableSize - 1);
+            }
+            hashTable[slot] = i;
+        }
+        memcpy (header.Id, PACK_FILE_ID, 4);
+        header.Version = PACK_FILE_VERSION;
+        header.NumEntries = entries.size ();
+        header.Alignment = _alignment;
+        header.DirectoryOffset = offset;
+        header.HashTableSize = hashTableSize;
+        header.NamesSize = nameTable.size ();
+        header.DirectorySize = entries.size () * sizeof (PackEntry) + hashTableSize * sizeof (UINT) + header.NamesSize;
+        Write (file, entries.empty () ? NULL : &entries[0], entries.size () * sizeof (PackEntry), _archive);
+        Write (file, &hashTable[0], hashTableSize * sizeof (UINT), _archive);
+        Write (file, nameTable.data (), nameTable.size (), _archive);
+        if (fseek (file, 0, SEEK_SET) != 0) {
+            THROW_DETAILED_ERROR (ERRC_BAD_FILE, _archive);
+        }
+        Write (file, &header, sizeof (header), _archive);
+        if (fclose (file) != 0) {
+            file = NULL;
+            THROW_DETAILED_ERROR (ERRC_BAD_FILE, _archive);
+        }
+        file = NULL;
+        printf ("total %u files %llu -> %u bytes saved %.1f%% in %.2f s\n", header.NumEntries, totalSize,
+            header.DirectoryOffset + header.DirectorySize,
+            totalSize > 0 ? 100.0 * (1.0 - (double)(header.DirectoryOffset + header.DirectorySize) / totalSize) : 0.0,
+            GetSeconds () - start);
+    } catch (ErrorMessage&) {
+        if (file) {
+            fclose (file);
+        }
+        remove (_archive);
+        throw;
+    }
+}
+
+/* every entry from the archive and as a loose file, the loose ones are opened one by one as the game did */
+static bool Test (const char* _archive) {
+    double start = GetSeconds ();
+    PackFile archive;
+    archive.Open (_archive);
+    double openTime = GetSeconds () - start;
+    double packedTime = 0.0;
+    double looseTime = 0.0;
+    UINT numDifferent = 0;
+    std::vector<char> packed;
+    std::vector<char> loose;
+    for (UINT i = 0; i < archive.GetNumEntries (); i++) {
+        const char* name = archive.GetEntryName (i);
+        start = GetSeconds ();
+        archive.Read (i, packed);
+        packedTime += GetSeconds () - start;
+        start = GetSeconds ();
+        try {
+            ReadLooseFile (name, loose);
+        } catch (ErrorMessage&) {
+            printf ("%s is not a loose file\n", name);
+            continue;
+        }
+        looseTime += GetSeconds () - start;
+        if (packed != loose) {
+            printf ("%s differs\n", name);
+            numDifferent++;
+        }
+    }
+    printf ("%u entries, packed %.2f ms (%.2f ms to open), loose %.2f ms, %u different\n", archive.GetNumEntries (),
+        (openTime + packedTime) * 1000.0, openTime * 1000.0, looseTime * 1000.0, numDifferent);
+    return numDifferent == 0;
+}
+
+int main (int _argc, char** _argv) {
+    UINT alignment = PACK_DEFAULT_ALIGNMENT;
+    bool isStored = false;
+    const char* archive = NULL;
+    std::vector<std::string> paths;
+    try {
+        if (_argc == 3 && strcmp (_argv[1], "-test") == 0) {
+            return Test (_argv[2]) ? 0 : 1;
+        }
+        for (int i = 1; i < _argc; i++) {
+            if (strcmp (_argv[i], "-align") == 0 && i + 1 < _argc) {
+                alignment = strtoul (_argv[++i], NULL, 10);
+            } else if (strcmp (_argv[i], "-store") == 0) {
+                isStored = true;
+            } else if (!archive) {
+                archive = _argv[i];
+            } else {
+                paths.push_back (_argv[i]);
+            }
+        }
+        if (!archive || paths.empty () || alignment == 0) {
+            fprintf (stderr, "usage: PackBuilder [-align <bytes>] [-store] <archive> <file or directory>...\n"
+                             "       PackBuilder -test <archive>\n");
+            return 1;
+        }
+        std::vector<std::string> files;
+        for (UINT i = 0; i < paths.size (); i++) {
+            FindFiles (paths[i], files);
+        }
+        // the archive is not packed into itself
+        std::string archiveName = PackFile::NormalizeName (archive);
+        for (UINT i = 0; i < files.size (); i++) {
+            if (PackFile::NormalizeName (files[i].c_str ()) == archiveName) {
+                files.erase (files.begin () + i);
+                break;
+            }
+        }
+        Build (archive, files, alignment, isStored);
+    } catch (ErrorMessage& e) {
+        fprintf (stderr, "%s\n", e.GetErrorMessage ());
+        return 1;
+    }
+    return 0;
+}
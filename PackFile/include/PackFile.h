@@ -0,0 +1,264 @@
+/** @file PackFile.h
+Single-file asset archive.
+The data directory is packed into one file by PackBuilder, the loaders read
+their files through VirtualFile, which looks in the mounted archive first
+and falls back to the loose file. Opening one archive instead of hundreds
+of files saves the per-file open latency of slow or scanned file systems.
+
+The archive is laid out as:
+@li PackHeader
+@li the data of the entries, every one starting at a multiple of the alignment
+@li the directory: PackEntry array, the hash table and the names
+*/
+#pragma once
+
+#include "../include/ErrorMessage.h"
+#include <cstdio>
+#include <vector>
+#include <string>
+
+/** Name of the archive which every module mounts when it is loaded, it is next to the data directory. */
+#define PACK_FILE_NAME "data.pak"
+/** Identifier at the start of the archive. */
+#define PACK_FILE_ID "TPAK"
+/** Version of the archive format. */
+#define PACK_FILE_VERSION 1
+/** Default alignment of the entries, a disk sector and a memory page. */
+#define PACK_DEFAULT_ALIGNMENT 4096
+/** Flag of the entry: the data is compressed by PackFile::Compress. */
+#define PACK_ENTRY_COMPRESSED 0x1
+/** No entry of such name. */
+#define PACK_INVALID_ENTRY ((UINT) -1)
+
+/** Header at the start of the archive. */
+struct PackHeader {
+    char Id[4];             /**< PACK_FILE_ID, without the terminating character. */
+    UINT Version;           /**< PACK_FILE_VERSION. */
+    UINT NumEntries;        /**< Number of the packed files. */
+    UINT Alignment;         /**< Alignment of the entries in bytes. */
+    UINT DirectoryOffset;   /**< Offset of the directory from the start of the archive. */
+    UINT DirectorySize;     /**< Size of the directory in bytes. */
+    UINT HashTableSize;     /**< Number of the hash table slots, a power of two. */
+    UINT NamesSize;         /**< Size of the names in bytes. */
+};
+
+/** Directory entry of a packed file. */
+struct PackEntry {
+    UINT NameHash;          /**< PackFile::HashName of the name. */
+    UINT NameOffset;        /**< Offset of the name in the names, it is normalized by PackFile::NormalizeName. */
+    UINT Offset;            /**< Offset of the data from the start of the archive. */
+    UINT Size;              /**< Size of the stored data. */
+    UINT OriginalSize;      /**< Size of the file. */
+    UINT Flags;             /**< PACK_ENTRY_COMPRESSED or 0. */
+};
+
+/** An opened archive.
+The directory is read once, when the archive is opened. The entries may be
+read from several threads at once. */
+class PackFile {
+public:
+    /** Constructor. */
+    PackFile ();
+
+    /** Destructor. Closes the archive. */
+    ~PackFile ();
+
+    /** Opens the archive and reads its directory.
+    @param[in] _filename archive filename
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_FILE_NOT_FOUND the archive cannot be opened
+        - @c ERRC_BAD_FILE it is not an archive or its directory is damaged
+        - @c ERRC_OUT_OF_MEM not enough memory */
+    void Open (const char* _filename);
+
+    /** Closes the archive. */
+    void Close ();
+
+    /** Checks if the archive is opened.
+    @return @c true if it is opened */
+    bool IsOpen () const;
+
+    /** Finds the entry by a hash table look-up.
+    @param[in] _name filename, it is normalized as the names in the archive are
+    @return entry index or PACK_INVALID_ENTRY */
+    UINT Find (const char* _name) const;
+
+    /** Getter: number of the entries.
+    @return number of the entries */
+    UINT GetNumEntries () const;
+
+    /** Getter: the entry.
+    @param[in] _index entry index
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_OUT_OF_RANGE invalid index
+
+    @return the entry */
+    const PackEntry& GetEntry (UINT _index) const;
+
+    /** Getter: the normalized name of the entry.
+    @param[in] _index entry index
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_OUT_OF_RANGE invalid index
+
+    @return the name */
+    const char* GetEntryName (UINT _index) const;
+
+    /** Reads and decompresses the entry. It can be called from any thread.
+    @param[in] _index entry index
+    @param[out] _data the data of the file
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_OUT_OF_RANGE invalid index
+        - @c ERRC_BAD_FILE the entry cannot be read or decompressed
+        - @c ERRC_OUT_OF_MEM not enough memory */
+    void Read (UINT _index, std::vector<char>& _data);
+
+    /** Normalizes the name for the archive: the separators are slashes, the letters are lower case
+    and a leading "./" is removed, as the names are found on a Windows file system.
+    @param[in] _name filename
+    @return the normalized name */
+    static std::string NormalizeName (const char* _name);
+
+    /** Hashes the normalized name, FNV-1a.
+    @param[in] _name normalized name
+    @return the hash */
+    static UINT HashName (const std::string& _name);
+
+    /** Compresses the data, LZ77 with a 64 KB window, byte aligned for fast decompression.
+    Every sequence is a token, whose high half is the number of the literals and low half
+    the match length minus 4, the literals, 2 bytes of the match offset and the lengths
+    which do not fit into the token, as bytes of 255 and the rest. The last sequence has
+    only the literals.
+    @param[in] _data the data
+    @param[in] _size size of the data
+    @param[out] _compressed the compressed data */
+    static void Compress (const char* _data, UINT _size, std::vector<char>& _compressed);
+
+    /** Decompresses the data of Compress.
+    @param[in] _compressed the compressed data
+    @param[in] _size size of the compressed data
+    @param[out] _data the data, _originalSize bytes
+    @param[in] _originalSize size of the data
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_BAD_FILE the compressed data is damaged */
+    static void Decompress (const char* _compressed, UINT _size, char* _data, UINT _originalSize);
+
+protected:
+    FILE* m_File;                       /**< The archive. */
+    CRITICAL_SECTION m_Lock;            /**< Guards the position of the archive file. */
+    PackHeader m_Header;                /**< Header of the archive. */
+    std::vector<PackEntry> m_Entries;   /**< The entries. */
+    std::vector<UINT> m_HashTable;      /**< Entry indices by the hash of the name, linear probing. */
+    std::vector<char> m_Names;          /**< The names. */
+};
+
+/** A file read whole into memory, from the mounted archive or the loose file.
+Text is read as by the C library in text mode, so the loaders which parse it
+line by line keep their code. */
+class VirtualFile {
+public:
+    /** Constructor. Nothing is opened. */
+    VirtualFile ();
+
+    /** Constructor. Opens the file.
+    @param[in] _filename filename
+    @see Open */
+    VirtualFile (const char* _filename);
+
+    /** Opens the file: the archive entry of such name, or the loose file if there is none.
+    @param[in] _filename filename
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_FILE_NOT_FOUND there is no such file
+        - @c ERRC_BAD_FILE the file cannot be read
+        - @c ERRC_OUT_OF_MEM not enough memory */
+    void Open (const char* _filename);
+
+    /** Closes the file and frees its memory. */
+    void Close ();
+
+    /** Reads as fread does.
+    @param[out] _buffer the buffer
+    @param[in] _size number of the bytes to read
+    @return number of the read bytes */
+    UINT Read (void* _buffer, UINT _size);
+
+    /** Reads a line as fgets does in text mode, "\r\n" becomes "\n".
+    @param[out] _line the buffer
+    @param[in] _size size of the buffer
+    @return _line or NULL at the end of the file */
+    char* Gets (char* _line, int _size);
+
+    /** Reads as fscanf does. White space, literal characters and the %d, %u, %f and %s
+    conversions are supported, %s with a field width.
+    @param[in] _format the format
+    @return number of the assigned values, EOF if the file ended before the first one */
+    int Scan (const char* _format, ...);
+
+    /** Checks if the whole file is read.
+    @return @c true at the end of the file */
+    bool IsEof () const;
+
+    /** Getter: the data of the file.
+    @return the data, followed by a terminating character */
+    const char* GetData () const;
+
+    /** Getter: size of the file.
+    @return size in bytes */
+    UINT GetSize () const;
+
+    /** Checks if the file was read from the archive.
+    @return @c true if it is packed */
+    bool IsPacked () const;
+
+    /** Reads the whole file, the archive entry or the loose file.
+    @param[in] _filename filename
+    @param[out] _data the data of the file
+    @param[out] _isPacked if not NULL, @c true is set if the file was read from the archive
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_FILE_NOT_FOUND there is no such file
+        - @c ERRC_BAD_FILE the file cannot be read
+        - @c ERRC_OUT_OF_MEM not enough memory */
+    static void Load (const char* _filename, std::vector<char>& _data, bool* _isPacked = NULL);
+
+    /** Checks if there is such file in the archive or on the disk. It can be called from any thread.
+    @param[in] _filename filename
+    @return @c true if the file is there */
+    static bool Exists (const char* _filename);
+
+    /** Mounts the archive of the module instead of PACK_FILE_NAME, which is mounted
+    when the module is loaded, if it is there. Every module (the game and every
+    engine DLL) has its own archive. No file may be read meanwhile.
+    @param[in] _filename archive filename
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_FILE_NOT_FOUND the archive cannot be opened
+        - @c ERRC_BAD_FILE it is not an archive */
+    static void Mount (const char* _filename);
+
+    /** Unmounts the archive of the module, only the loose files are read afterwards.
+    No file may be read meanwhile. */
+    static void Unmount ();
+
+    /** Getter: the mounted archive of the module.
+    @return the archive, it is not opened if none is mounted */
+    static PackFile& GetArchive ();
+
+protected:
+    std::vector<char> m_Data;   /**< The data of the file and a terminating character. */
+    UINT m_Position;            /**< Read position. */
+    bool m_IsPacked;            /**< Was the file read from the archive. */
+};
@@ -0,0 +1,318 @@
+#include "../include/PackFile.h"
+#include <cstring>
+
+/* Compression: the shortest match, the match window and the size of the match finder's hash table */
+#define PACK_MIN_MATCH 4
+#define PACK_MAX_OFFSET 65535
+#define PACK_HASH_BITS 14
+
+PackFile::PackFile (): m_File (NULL) {
+    InitializeCriticalSection (&m_Lock);
+    memset (&m_Header, 0, sizeof (m_Header));
+}
+
+PackFile::~PackFile () {
+    Close ();
+    DeleteCriticalSection (&m_Lock);
+}
+
+void PackFile::Open (const char* _filename) {
+    Close ();
+    FILE* file = fopen (_filename, "rb");
+    if (!file) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _filename);
+    }
+    PackHeader header;
+    if (fread (&header, sizeof (header), 1, file) != 1 || memcmp (header.Id, PACK_FILE_ID, 4) != 0 ||
+        header.Version != PACK_FILE_VERSION || header.HashTableSize < header.NumEntries ||
+        header.HashTableSize == 0 || (header.HashTableSize & (header.HashTableSize - 1)) != 0 ||
+        header.DirectorySize != (unsigned long long)header.NumEntries * sizeof (PackEntry) +
+            (unsigned long long)header.HashTableSize * sizeof (UINT) + header.NamesSize) {
+        fclose (file);
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+    // the whole directory at once
+    std::vector<char> directory;
+    try {
+        directory.resize (header.DirectorySize);
+        m_Entries.resize (header.NumEntries);
+        m_HashTable.resize (header.HashTableSize);
+        m_Names.resize (header.NamesSize);
+    } catch (std::bad_alloc) {
+        fclose (file);
+        Close ();
+        THROW_ERROR (ERRC_OUT_OF_MEM);
+    }
+    if (fseek (file, header.DirectoryOffset, SEEK_SET) != 0 ||
+        fread (&directory[0], 1, directory.size (), file) != directory.size ()) {
+        fclose (file);
+        Close ();
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+    UINT offset = 0;
+    if (header.NumEntries > 0) {
+        memcpy (&m_Entries[0], &directory[offset], header.NumEntries * sizeof (PackEntry));
+        offset += header.NumEntries * sizeof (PackEntry);
+    }
+    memcpy (&m_HashTable[0], &directory[offset], header.HashTableSize * sizeof (UINT));
+    offset += header.HashTableSize * sizeof (UINT);
+    if (header.NamesSize > 0) {
+        memcpy (&m_Names[0], &directory[offset], header.NamesSize);
+    }
+    // every name is terminated and every stored entry has its size
+    bool isValid = header.NamesSize > 0 && m_Names[header.NamesSize - 1] == '\0';
+    for (UINT i = 0; i < header.NumEntries && isValid; i++) {
+        const PackEntry& entry = m_Entries[i];
+        isValid = entry.NameOffset < header.NamesSize && entry.Offset <= header.DirectoryOffset &&
+            entry.Size <= header.DirectoryOffset - entry.Offset &&
+            ((entry.Flags & PACK_ENTRY_COMPRESSED) != 0 || entry.Size == entry.OriginalSize);
+    }
+    for (UINT i = 0; i < header.HashTableSize && isValid; i++) {
+        isValid = m_HashTable[i] == PACK_INVALID_ENTRY || m_HashTable[i] < header.NumEntries;
+    }
+    if (!isValid && header.NumEntries > 0) {
+        fclose (file);
+        Close ();
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+    m_Header = header;
+    m_File = file;
+}
+
+void PackFile::Close () {
+    if (m_File) {
+        fclose (m_File);
+        m_File = NULL;
+    }
+    memset (&m_Header, 0, sizeof (m_Header));
+    std::vector<PackEntry> ().swap (m_Entries);
+    std::vector<UINT> ().swap (m_HashTable);
+    std::vector<char> ().swap (m_Names);
+}
+
+bool PackFile::IsOpen () const {
+    return m_File != NULL;
+}
+
+UINT PackFile::Find (const char* _name) const {
+    if (!m_File || m_Header.NumEntries == 0) {
+        return PACK_INVALID_ENTRY;
+    }
+    std::string name = NormalizeName (_name);
+    UINT hash = HashName (name);
+    UINT mask = m_Header.HashTableSize - 1;
+    UINT slot = hash & mask;
+    for (UINT i = 0; i < m_Header.HashTableSize; i++) {
+        UINT index = m_HashTable[slot];
+        if (index == PACK_INVALID_ENTRY) {
+            break;
+        }
+        if (m_Entries[index].NameHash == hash && name == &m_Names[m_Entries[index].NameOffset]) {
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return PACK_INVALID_ENTRY;
+}
+
+UINT PackFile::GetNumEntries () const {
+    return m_Header.NumEntries;
+}
+
+const PackEntry& PackFile::GetEntry (UINT _index) const {
+    if (_index >= m_Entries.size ()) {
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    return m_Entries[_index];
+}
+
+const char* PackFile::GetEntryName (UINT _index) const {
+    if (_index >= m_Entries.size ()) {
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    return &m_Names[m_Entries[_index].NameOffset];
+}
+
+void PackFile::Read (UINT _index, std::vector<char>& _data) {
+    if (_index >= m_Entries.size ()) {
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    const PackEntry& entry = m_Entries[_index];
+    bool isCompressed = (entry.Flags & PACK_ENTRY_COMPRESSED) != 0;
+    std::vector<char> stored;
+    try {
+        _data.resize (entry.OriginalSize);
+        if (isCompressed) {
+            stored.resize (entry.Size);
+        }
+    } catch (std::bad_alloc) {
+        THROW_ERROR (ERRC_OUT_OF_MEM);
+    }
+    if (entry.Size == 0) {
+        if (entry.OriginalSize != 0) {
+            THROW_DETAILED_ERROR (ERRC_BAD_FILE, GetEntryName (_index));
+        }
+        return;
+    }
+    char* target = isCompressed ? &stored[0] : &_data[0];
+    // the workers of the asset loader share the file
+    EnterCriticalSection (&m_Lock);
+    bool isRead = fseek (m_File, entry.Offset, SEEK_SET) == 0 && fread (target, 1, entry.Size, m_File) == entry.Size;
+    LeaveCriticalSection (&m_Lock);
+    if (!isRead) {
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, GetEntryName (_index));
+    }
+    if (isCompressed) {
+        try {
+            Decompress (&stored[0], entry.Size, _data.empty () ? NULL : &_data[0], entry.OriginalSize);
+        } catch (ErrorMessage&) {
+            THROW_DETAILED_ERROR (ERRC_BAD_FILE, GetEntryName (_index));
+        }
+    }
+}
+
+std::string PackFile::NormalizeName (const char* _name) {
+    std::string name (_name);
+    for (UINT i = 0; i < name.size (); i++) {
+        if (name[i] == '\\') {
+            name[i] = '/';
+        } else if (name[i] >= 'A' && name[i] <= 'Z') {
+            name[i] = name[i] - 'A' + 'a';
+        }
+    }
+    while (name.compare (0, 2, "./") == 0) {
+        name.erase (0, 2);
+    }
+    return name;
+}
+
+UINT PackFile::HashName (const std::string& _name) {
+    UINT hash = 2166136261u;
+    for (UINT i = 0; i < _name.size (); i++) {
+        hash ^= (unsigned char)_name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* the part of a length which does not fit into the token */
+static void WriteLength (std::vector<char>& _compressed, UINT _length) {
+    while (_length >= 255) {
+        _compressed.push_back ((char)255);
+        _length -= 255;
+    }
+    _compressed.push_back ((char)_length);
+}
+
+static bool ReadLength (const unsigned char*& _in, const unsigned char* _end, UINT& _length) {
+    UINT byte = 255;
+    while (byte == 255) {
+        if (_in == _end || _length > 0x7fffffff) {
+            return false;
+        }
+        byte = *_in++;
+        _length += byte;
+    }
+    return true;
+}
+
+void PackFile::Compress (const char* _data, UINT _size, std::vector<char>& _compressed) {
+    _compressed.clear ();
+    _compressed.reserve (_size + _size / 255 + 16);
+    const unsigned char* data = (const unsigned char*)_data;
+    // the last position of every hashed 4 bytes
+    std::vector<UINT> lastPosition (1 << PACK_HASH_BITS, PACK_INVALID_ENTRY);
+    UINT literalStart = 0;
+    UINT position = 0;
+    while (position + PACK_MIN_MATCH <= _size) {
+        UINT bytes = data[position] | (data[position + 1] << 8) | (data[position + 2] << 16) | ((UINT)data[position + 3] << 24);
+        UINT slot = (bytes * 2654435761u) >> (32 - PACK_HASH_BITS);
+        UINT candidate = lastPosition[slot];
+        lastPosition[slot] = position;
+        if (candidate == PACK_INVALID_ENTRY || position - candidate > PACK_MAX_OFFSET ||
+            memcmp (data + candidate, data + position, PACK_MIN_MATCH) != 0) {
+            position++;
+            continue;
+        }
+        UINT length = PACK_MIN_MATCH;
+        while (position + length < _size && data[candidate + length] == data[position + length]) {
+            length++;
+        }
+        UINT numLiterals = position - literalStart;
+        UINT extraLength = length - PACK_MIN_MATCH;
+        _compressed.push_back ((char)(((numLiterals < 15 ? numLiterals : 15) << 4) | (extraLength < 15 ? extraLength : 15)));
+        if (numLiterals >= 15) {
+            WriteLength (_compressed, numLiterals - 15);
+        }
+        _compressed.insert (_compressed.end (), _data + literalStart, _data + position);
+        UINT offset = position - candidate;
+        _compressed.push_back ((char)(offset & 0xff));
+        _compressed.push_back ((char)(offset >> 8));
+        if (extraLength >= 15) {
+            WriteLength (_compressed, extraLength - 15);
+        }
+        position += length;
+        literalStart = position;
+    }
+    UINT numLiterals = _size - literalStart;
+    _compressed.push_back ((char)((numLiterals < 15 ? numLiterals : 15) << 4));
+    if (numLiterals >= 15) {
+        WriteLength (_compressed, numLiterals - 15);
+    }
+    _compressed.insert (_compressed.end (), _data + literalStart, _data + _size);
+}
+
+void PackFile::Decompress (const char* _compressed, UINT _size, char* _data, UINT _originalSize) {
+    const unsigned char* in = (const unsigned char*)_compressed;
+    const unsigned char* inEnd = in + _size;
+    unsigned char* out = (unsigned char*)_data;
+    unsigned char* outStart = out;
+    unsigned char* outEnd = out + _originalSize;
+    bool isEnded = false;
+    while (in < inEnd) {
+        UINT token = *in++;
+        UINT numLiterals = token >> 4;
+        if (numLiterals == 15 && !ReadLength (in, inEnd, numLiterals)) {
+            THROW_ERROR (ERRC_BAD_FILE);
+        }
+        if ((UINT)(inEnd - in) < numLiterals || (UINT)(outEnd - out) < numLiterals) {
+            THROW_ERROR (ERRC_BAD_FILE);
+        }
+        if (numLiterals > 0) {
+            memcpy (out, in, numLiterals);
+        }
+        in += numLiterals;
+        out += numLiterals;
+        if (in == inEnd) {
+            isEnded = true;
+            break;      // the last sequence has no match
+        }
+        if (inEnd - in < 2) {
+            THROW_ERROR (ERRC_BAD_FILE);
+        }
+        UINT offset = in[0] | (in[1] << 8);
+        in += 2;
+        UINT length = token & 15;
+        if (length == 15 && !ReadLength (in, inEnd, length)) {
+            THROW_ERROR (ERRC_BAD_FILE);
+        }
+        length += PACK_MIN_MATCH;
+        if (offset == 0 || offset > (UINT)(out - outStart) || (UINT)(outEnd - out) < length) {
+            THROW_ERROR (ERRC_BAD_FILE);
+        }
+        // the match may overlap the bytes it makes
+        const unsigned char* match = out - offset;
+        if (offset >= length) {
+            memcpy (out, match, length);
+        } else {
+            for (UINT i = 0; i < length; i++) {
+                out[i] = match[i];
+            }
+        }
+        out += length;
+    }
+    // data cut after a match lacks the last sequence
+    if (!isEnded || out != outEnd) {
+        THROW_ERROR (ERRC_BAD_FILE);
+    }
+}
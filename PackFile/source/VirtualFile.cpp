@@ -0,0 +1,228 @@
+#include "../include/PackFile.h"
+#include <cstring>
+#include <cstdlib>
+#include <cstdarg>
+#include <cctype>
+
+/* The archive of the module, PACK_FILE_NAME if it is there. A damaged
+   archive is left out, the loose files are read instead. */
+struct ArchiveMount {
+    PackFile Archive;
+
+    ArchiveMount () {
+        DWORD attributes = GetFileAttributesA (PACK_FILE_NAME);
+        if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+            try {
+                Archive.Open (PACK_FILE_NAME);
+            } catch (ErrorMessage&) {
+            }
+        }
+    }
+};
+
+VirtualFile::VirtualFile (): m_Position (0), m_IsPacked (false) {
+}
+
+VirtualFile::VirtualFile (const char* _filename): m_Position (0), m_IsPacked (false) {
+    Open (_filename);
+}
+
+void VirtualFile::Open (const char* _filename) {
+    Close ();
+    Load (_filename, m_Data, &m_IsPacked);
+    try {
+        m_Data.push_back ('\0');
+    } catch (std::bad_alloc) {
+        Close ();
+        THROW_ERROR (ERRC_OUT_OF_MEM);
+    }
+}
+
+void VirtualFile::Close () {
+    std::vector<char> ().swap (m_Data);
+    m_Position = 0;
+    m_IsPacked = false;
+}
+
+UINT VirtualFile::Read (void* _buffer, UINT _size) {
+    UINT available = GetSize () - m_Position;
+    UINT size = _size < available ? _size : available;
+    if (size > 0) {
+        memcpy (_buffer, &m_Data[m_Position], size);
+        m_Position += size;
+    }
+    return size;
+}
+
+char* VirtualFile::Gets (char* _line, int _size) {
+    UINT size = GetSize ();
+    if (m_Position >= size || _size < 1) {
+        return NULL;
+    }
+    int length = 0;
+    while (length < _size - 1 && m_Position < size) {
+        char character = m_Data[m_Position++];
+        if (character == '\r' && m_Position < size && m_Data[m_Position] == '\n') {
+            continue;
+        }
+        _line[length++] = character;
+        if (character == '\n') {
+            break;
+        }
+    }
+    _line[length] = '\0';
+    return _line;
+}
+
+int VirtualFile::Scan (const char* _format, ...) {
+    va_list args;
+    va_start (args, _format);
+    UINT size = GetSize ();
+    const char* data = m_Data.empty () ? "" : &m_Data[0];
+    int numAssigned = 0;
+    bool isMatching = true;
+    bool isEnd = false;
+    for (const char* format = _format; *format && isMatching; format++) {
+        if (isspace ((unsigned char)*format)) {
+            while (m_Position < size && isspace ((unsigned char)data[m_Position])) {
+                m_Position++;
+            }
+            continue;
+        }
+        if (*format != '%' || format[1] == '%') {
+            // a literal character, it is not preceded by white space
+            format += *format == '%' ? 1 : 0;
+            isEnd = m_Position >= size;
+            isMatching = !isEnd && data[m_Position] == *format;
+            m_Position += isMatching ? 1 : 0;
+            continue;
+        }
+        format++;
+        int width = 0;
+        while (isdigit ((unsigned char)*format)) {
+            width = width * 10 + *format++ - '0';
+        }
+        while (m_Position < size && isspace ((unsigned char)data[m_Position])) {
+            m_Position++;
+        }
+        isEnd = m_Position >= size;
+        if (isEnd) {
+            break;
+        }
+        // the data is terminated, so the conversions stop at its end
+        const char* start = data + m_Position;
+        char* end = (char*)start;
+        switch (*format) {
+            case 'd': {
+                long value = strtol (start, &end, 10);
+                if (end != start) {
+                    *va_arg (args, int*) = (int)value;
+                }
+                break;
+            }
+            case 'u': {
+                unsigned long value = strtoul (start, &end, 10);
+                if (end != start) {
+                    *va_arg (args, UINT*) = (UINT)value;
+                }
+                break;
+            }
+            case 'f': {
+                double value = strtod (start, &end);
+                if (end != start) {
+                    *va_arg (args, float*) = (float)value;
+                }
+                break;
+            }
+            case 's': {
+                char* target = va_arg (args, char*);
+                while (end < data + size && !isspace ((unsigned char)*end) && (width == 0 || end - start < width)) {
+                    *target++ = *end++;
+                }
+                *target = '\0';
+                break;
+            }
+        }
+        isMatching = end != start;
+        if (isMatching) {
+            m_Position = end - data;
+            numAssigned++;
+        }
+    }
+    va_end (args);
+    return numAssigned == 0 && isEnd ? EOF : numAssigned;
+}
+
+bool VirtualFile::IsEof () const {
+    return m_Position >= GetSize ();
+}
+
+const char* VirtualFile::GetData () const {
+    return m_Data.empty () ? NULL : &m_Data[0];
+}
+
+UINT VirtualFile::GetSize () const {
+    return m_Data.empty () ? 0 : m_Data.size () - 1;
+}
+
+bool VirtualFile::IsPacked () const {
+    return m_IsPacked;
+}
+
+void VirtualFile::Load (const char* _filename, std::vector<char>& _data, bool* _isPacked) {
+    PackFile& archive = GetArchive ();
+    UINT index = archive.Find (_filename);
+    if (_isPacked) {
+        *_isPacked = index != PACK_INVALID_ENTRY;
+    }
+    if (index != PACK_INVALID_ENTRY) {
+        archive.Read (index, _data);
+        return;
+    }
+    FILE* file = fopen (_filename, "rb");
+    if (!file) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _filename);
+    }
+    long size = -1;
+    if (fseek (file, 0, SEEK_END) == 0) {
+        size = ftell (file);
+    }
+    if (size < 0 || fseek (file, 0, SEEK_SET) != 0) {
+        fclose (file);
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+    try {
+        _data.resize (size);
+    } catch (std::bad_alloc) {
+        fclose (file);
+        THROW_ERROR (ERRC_OUT_OF_MEM);
+    }
+    if (size > 0 && fread (&_data[0], 1, size, file) != (size_t)size) {
+        fclose (file);
+        _data.clear ();
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+    fclose (file);
+}
+
+bool VirtualFile::Exists (const char* _filename) {
+    if (GetArchive ().Find (_filename) != PACK_INVALID_ENTRY) {
+        return true;
+    }
+    DWORD attributes = GetFileAttributesA (_filename);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) == 0;
+}
+
+void VirtualFile::Mount (const char* _filename) {
+    GetArchive ().Open (_filename);
+}
+
+void VirtualFile::Unmount () {
+    GetArchive ().Close ();
+}
+
+PackFile& VirtualFile::GetArchive () {
+    // mounted at the first use, the initialization of a local static is thread safe
+    static ArchiveMount mount;
+    return mount.Archive;
+}
@@ -50,11 +50,15 @@ void Bullet::PreRender() {
 void Bullet::SetPosition (const VECTOR3& _origin, const VECTOR3& _destination) {
     m_Direction = (_destination - _origin).normalize();
     m_Origin = _origin;
+    m_LifeTime = GetFlightTime (_origin, _destination);
+}
+
+float Bullet::GetFlightTime (const VECTOR3& _origin, const VECTOR3& _destination) const {
     float x = _origin[0] - _destination[0];
     float y = _origin[1] - _destination[1];
     float z = _origin[2] - _destination[2];
     float length = sqrtf (x * x + y * y + z * z);
-    m_LifeTime = length / m_MaxRange * m_MaxTime;
+    return length / m_MaxRange * m_MaxTime;
 }
 
 void Bullet::SetColor (DWORD _color) {
@@ -30,7 +30,8 @@ struct ShadowMap {
     IDirect3DSurface9* DepthStencil;
     IDirect3DSurface9* OldDepthStencil;
     UINT Size;
-    UINT EffectId;
+    MATRIX44 LightViewProj;
+    float FarClip;
 };
 
 /** Renderer. */
@@ -387,6 +388,14 @@ public:
     void EndRenderingToShadowMap ();
 
     void SetShadowMap (UINT _effectId, const char* _shadowMapParamName);
+
+    void CreateShadowCascades (UINT _numCascades, const UINT* _sizes);
+
+    void BeginRenderingToShadowCascade (UINT _cascade, const MATRIX44& _lightViewProj);
+
+    void SetShadowCascade (UINT _effectId, UINT _cascade, const char* _shadowMapParamName);
+
+    UINT GetNumShadowCascades () const;
     
     /** Enables fog.
     @param[in] _start the distance where the fog will start
@@ -448,6 +457,46 @@ private:
         - @c ERRC_OUT_OF_MEM not enough memory */
     void InitManagers ();
 
+    /** Creates render target and depth surfaces of the shadow map.
+    Nothing is done if the size did not change.
+    @param[in,out] _shadowMap shadow map
+    @param[in] _size size of the shadow map
+    @exception ErrorMessage 
+
+    - Possible error codes:
+        - @c ERRC_API_CALL */
+    void CreateShadowMapSurfaces (ShadowMap& _shadowMap, UINT _size);
+
+    /** Releases surfaces of the shadow map.
+    @param[in,out] _shadowMap shadow map */
+    void ReleaseShadowMapSurfaces (ShadowMap& _shadowMap);
+
+    /** Creates depth effect which is shared by all the shadow maps.
+    @exception ErrorMessage 
+
+    - Possible error codes:
+        - @c ERRC_API_CALL */
+    void CreateShadowMapEffect ();
+
+    /** Begins rendering to the shadow map.
+    @param[in] _shadowMap shadow map
+    @exception ErrorMessage 
+
+    - Possible error codes:
+        - @c ERRC_NOT_READY shadow map is not created
+        - @c ERRC_API_CALL */
+    void BeginRenderingToShadowMap (ShadowMap& _shadowMap);
+
+    /** Sets shadow map texture as an effect parameter.
+    @param[in] _effectId effect ID
+    @param[in] _shadowMapParamName name of the texture parameter
+    @param[in] _texture shadow map texture
+    @exception ErrorMessage 
+
+    - Possible error codes:
+        - @c ERRC_API_CALL */
+    void SetShadowMapTexture (UINT _effectId, const char* _shadowMapParamName, IDirect3DTexture9* _texture);
+
     IDirect3D9* m_d3d9;             /**< DirectX. */
     IDirect3DDevice9* m_Device;     /**< Rendering device. */
     D3DPRESENT_PARAMETERS m_d3dpp;  /**< DirectX parameters. */
@@ -461,6 +510,10 @@ private:
     MATRIX44 m_View;            /**< View matrix. */
 
     ShadowMap m_ShadowMap;      /**< ShadowMap information. */
+    ShadowMap m_ShadowCascades[MAX_SHADOW_CASCADES];    /**< Shadow map cascades. */
+    UINT m_NumShadowCascades;   /**< Number of the created cascades. */
+    ShadowMap* m_ActiveShadowMap;   /**< Shadow map which is being rendered. */
+    UINT m_ShadowMapEffectId;   /**< Depth effect shared by the shadow maps. */
 
     bool m_IsRunning;       /**< Renderer is ready and running. */
     bool m_IsRendering;     /**< Renderer is rendering. */
@@ -11,9 +11,11 @@
 #ifdef _DEBUG
     #pragma comment (lib, "lib/Debug/Log.lib")
     #pragma comment (lib, "lib/Debug/ErrorMessage.lib")
+    #pragma comment (lib, "lib/Debug/PackFile.lib")
 #else
     #pragma comment (lib, "lib/Log.lib")
     #pragma comment (lib, "lib/ErrorMessage.lib")
+    #pragma comment (lib, "lib/PackFile.lib")
 #endif
 
 #pragma comment (lib, "d3d9.lib")
@@ -59,6 +61,20 @@ public:
     @return texture ID */
     UINT AddTexture (const char* _filename);
 
+    /** Adds texture to the manager from the data of a texture file.
+    The file can be read on any thread, the texture is created on the calling one.
+    @param[in] _filename the name of the texture file, the texture is known by it
+    @param[in] _data the data of the file
+    @param[in] _size size of the data in bytes
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_OUT_OF_MEM not enough memory 
+        - @c ERRC_API_CALL D3DXCreateTextureFromFileInMemory failure
+
+    @return texture ID */
+    UINT AddTexture (const char* _filename, const void* _data, UINT _size);
+
     /** Getter: pointer to IDirect3DTexture9 interface.
     @param[in] _id texture ID
     @exception ErrorMessage 
@@ -109,6 +125,48 @@ public:
     @param[in] _filename texture filename
     @return @c true texture is loaded. @c false otherwise. */
     bool IsTextureLoaded (const char* _filename) const;
+
+    /** Checks if the texture file has a cooked version, AddTexture loads it instead.
+    The cooked texture is the file name followed by COOKED_TEXTURE_EXTENSION.
+    No texture of the manager is read, so it can be called on any thread.
+    @param[in] _filename texture filename
+    @return @c true if the cooked file is there */
+    bool HasCookedTexture (const char* _filename) const;
+
+    /** Getter: number of the textures.
+    @return number of the textures */
+    UINT GetNumTextures () const;
+
+    /** Checks if the texture was loaded from its cooked file.
+    @param[in] _id texture ID
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_OUT_OF_RANGE invalid ID
+
+    @return @c true if the texture is cooked */
+    bool IsTextureCooked (UINT _id) const;
+
+    /** Getter: video memory of all the levels of the texture.
+    @param[in] _id texture ID
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_OUT_OF_RANGE invalid ID
+
+    @return size in bytes */
+    UINT GetTextureMemory (UINT _id) const;
+
+    /** Loads a texture file as AddTexture does, but the texture is released at once.
+    @param[in] _filename texture filename
+    @param[in] _isCooked @c true loads the cooked file, @c false the source file
+    @param[out] _time seconds spent on the loading
+    @param[out] _memory video memory of the texture in bytes
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_API_CALL D3DXCreateTextureFromFile failure */
+    void MeasureTextureLoad (const char* _filename, bool _isCooked, float& _time, UINT& _memory);
     
     /** Adds material to the skin manager.
     @param[in] _material material information
@@ -434,16 +492,45 @@ public:
 
     /** Getter: pixel's size by its format.
     @param[in] _format pixel format
-    @return pixel's size */
-    UINT GetPixelSize (D3DFORMAT _format);
+    @return pixel's size, 0 for the block compressed formats */
+    static UINT GetPixelSize (D3DFORMAT _format);
 
 protected:
+    /** Creates a texture from a file, read through VirtualFile.
+    The cooked file has all the levels, they are taken as they are.
+    The source file is resized and filtered by D3DX.
+    @param[in] _filename the name of the texture file
+    @param[in] _isCooked @c true loads the cooked file of the texture
+    @param[out] _texture the new texture
+    @return result of D3DXCreateTextureFromFileInMemoryEx, an error of ERROR_FILE_NOT_FOUND if the file cannot be read */
+    HRESULT CreateTexture (const char* _filename, bool _isCooked, IDirect3DTexture9** _texture);
+
+    /** Adds the created texture to the manager.
+    @param[in] _filename the name of the texture file
+    @param[in] _texture the texture, it is released if it cannot be added
+    @param[in] _isCooked was the texture loaded from the cooked file
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_OUT_OF_MEM not enough memory 
+
+    @return texture ID */
+    UINT StoreTexture (const char* _filename, IDirect3DTexture9* _texture, bool _isCooked);
+
+    /** Getter: video memory of all the levels of the texture.
+    @param[in] _texture the texture
+    @return size in bytes */
+    static UINT ComputeTextureMemory (IDirect3DTexture9* _texture);
+
     /** Transparency of the texture which is drawn on the other texture. */
     float m_TexturePaintTransparency;   
 
     /** Texture backups. */
     std::vector<TextureBackup*> m_TextureBackups;
 
+    /** Is every texture loaded from its cooked file. */
+    std::vector<bool> m_IsTextureCooked;
+
     UINT m_NumTextures;             /**< Number of the textures. */
     vs3d::TEXTURE* m_Texture;       /**< Textures. */
     
@@ -0,0 +1,155 @@
+/** @file TextRenderer.h */
+
+#pragma once
+
+#include "../include/RenderDevice.h"
+#include "../include/Log.h"
+#include "../include/d3dfont.h"
+#include <d3d9.h>
+#include <vector>
+#include <map>
+#include <string>
+
+#define TEXT_ATLAS_FONT_SIZE 32     /**< Size at which the glyph atlas is rasterized. */
+#define TEXT_LAYOUT_CACHE_SIZE 128  /**< Number of layouts kept before unused ones are evicted. */
+
+/** Batched text renderer.
+Every font style gets one glyph atlas which is shared by all the text sizes.
+Glyph quads of a string are laid out once and reused while the string stays
+the same. All the text queued during the frame is rendered with one draw call
+per font style. */
+class TextRenderer {
+public:
+    /** Constructor.
+    @param[in] _device pointer to the rendering device
+    @param[in] _log pointer to the log manager */
+    TextRenderer (IDirect3DDevice9* _device, LogManager* _log);
+
+    /** Destructor. */
+    ~TextRenderer ();
+
+    /** Setter: text style.
+    @param[in] _style font name */
+    void SetStyle (const char* _style);
+
+    /** Setter: text size.
+    @param[in] _size text size */
+    void SetSize (int _size);
+
+    /** Queues text for the rendering.
+    @param[in] _text text
+    @param[in] _color color of the text
+    @param[in] _x position of the text on the x axis
+    @param[in] _y position of the text on the y axis
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_OUT_OF_MEM not enough memory
+        - @c ERRC_API_CALL */
+    void Add (const char* _text, DWORD _color, float _x, float _y);
+
+    /** Renders all the queued text and starts a new frame.
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_API_CALL */
+    void Render ();
+
+    /** Getter: statistics of the last rendered frame.
+    @return text statistics */
+    TEXTSTATISTICS GetStatistics () const;
+
+private:
+    /** Glyph quad relative to the text origin. */
+    struct GlyphQuad {
+        float X1;   /**< Left. */
+        float Y1;   /**< Top. */
+        float X2;   /**< Right. */
+        float Y2;   /**< Bottom. */
+        float U1;   /**< Left texture coordinate. */
+        float V1;   /**< Top texture coordinate. */
+        float U2;   /**< Right texture coordinate. */
+        float V2;   /**< Bottom texture coordinate. */
+    };
+
+    /** Cached layout of a string. */
+    struct TextLayout {
+        std::vector<GlyphQuad> Glyphs;  /**< Glyph quads. */
+        UINT LastFrame;                 /**< Last frame in which the layout was used. */
+    };
+
+    /** Layout cache key. */
+    struct LayoutKey {
+        UINT Font;          /**< Font index. */
+        int Size;           /**< Text size. */
+        std::string Text;   /**< Text. */
+
+        bool operator< (const LayoutKey& _key) const {
+            if (Font != _key.Font) {
+                return Font < _key.Font;
+            }
+            if (Size != _key.Size) {
+                return Size < _key.Size;
+            }
+            return Text < _key.Text;
+        }
+    };
+
+    /** Glyph atlas and the vertices queued for it. */
+    struct FontData {
+        char Style[MAX_PATH];                   /**< Font name. */
+        CD3DFont* Font;                         /**< Font with the glyph atlas. */
+        std::vector<vs3d::TLVERTEX> Vertices;   /**< Vertices queued this frame. */
+    };
+
+    /** Returns the font of the active style. The font is created if needed.
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_OUT_OF_MEM not enough memory
+        - @c ERRC_API_CALL
+
+    @return font index */
+    UINT GetActiveFont ();
+
+    /** Lays out the string.
+    @param[in] _font font index
+    @param[in] _text text
+    @param[out] _layout glyph quads */
+    void Layout (UINT _font, const char* _text, TextLayout& _layout);
+
+    /** Removes the layouts which were not used in the current frame. */
+    void EvictLayouts ();
+
+    /** Creates state blocks for the text rendering.
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_API_CALL */
+    void CreateStateBlocks ();
+
+    /** Makes sure that the vertex buffer holds the given number of vertices.
+    @param[in] _numVertices number of the vertices
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_API_CALL */
+    void ReserveVertexBuffer (UINT _numVertices);
+
+    std::vector<FontData> m_Fonts;              /**< Fonts, one per style. */
+    std::map<LayoutKey, TextLayout> m_Layouts;  /**< Cached layouts. */
+    char m_Style[MAX_PATH];                     /**< Active style. */
+    UINT m_ActiveFont;                          /**< Font of the active style. */
+    int m_Size;                                 /**< Active size. */
+    UINT m_Frame;                               /**< Frame counter. */
+
+    TEXTSTATISTICS m_FrameStatistics;           /**< Statistics of the current frame. */
+    TEXTSTATISTICS m_LastStatistics;            /**< Statistics of the last rendered frame. */
+
+    LPDIRECT3DVERTEXBUFFER9 m_VertexBuffer;     /**< Dynamic vertex buffer. */
+    UINT m_VertexBufferSize;                    /**< Capacity of the vertex buffer in vertices. */
+    LPDIRECT3DSTATEBLOCK9 m_StateBlockSaved;    /**< Render states before the text rendering. */
+    LPDIRECT3DSTATEBLOCK9 m_StateBlockText;     /**< Render states for the text rendering. */
+    IDirect3DDevice9* m_Device;                 /**< Pointer to the rendering device. */
+    LogManager* m_Log;                          /**< Pointer to the log manager. */
+};
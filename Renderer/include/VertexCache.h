@@ -62,8 +62,11 @@ public:
               WORD* _index, UINT _numIndices);
 
     /** Adds vertices.
+    The cache is flushed first if the vertices or the indices which follow
+    them do not fit.
     @param[in] _vertex array of the vertices
     @param[in] _numVertices number of the vertices
+    @param[in] _numIndices number of the indices which follow the vertices
     @exception ErrorMessage 
     
     - Possible error codes:
@@ -72,7 +75,7 @@ public:
         - @c ERRC_OUT_OF_MEM not enough memory
         - @c ERRC_API_CALL
         - @c ERRC_OUT_OF_RANGE */
-    void AddVertices (void* _vertex, UINT _numVertices);
+    void AddVertices (void* _vertex, UINT _numVertices, UINT _numIndices);
 
     /** Adds indices.
     @param[in] _index array of the indices
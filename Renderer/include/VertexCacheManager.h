@@ -8,7 +8,7 @@
 #include "../include/Log.h"
 //#include "../include/AVLTreeVertexFormats.h"
 #include "../include/RenderCache.h"
-#include "../include/d3dfont.h"
+#include "../include/TextRenderer.h"
 #include <d3d9.h>
 
 #pragma comment (lib, "d3d9.lib")
@@ -139,6 +139,20 @@ public:
         - @c ERRC_UNKNOWN_VF invalid vertex format */
     void AddToStaticVertexBuffer (UINT _vertexBufferId, void* _vertex, UINT _numVertices, VERTEXFORMATTYPE _vft);
 
+    /** Overwrites a range of vertices in the existing static vertex buffer.
+    @param[in] _vertexBufferId static buffer ID
+    @param[in] _startVertex index of the first vertex to overwrite
+    @param[in] _vertex the vertices
+    @param[in] _numVertices number of the vertices
+    @param[in] _vft vertex format
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_OUT_OF_RANGE vertex buffer ID or the vertex range is invalid
+        - @c ERRC_API_CALL
+        - @c ERRC_UNKNOWN_VF invalid vertex format */
+    void UpdateStaticVertexBuffer (UINT _vertexBufferId, UINT _startVertex, void* _vertex, UINT _numVertices, VERTEXFORMATTYPE _vft);
+
     /** Removes all the static vertex buffers. */
     void ClearStaticVertexBuffers ();
 
@@ -406,7 +420,7 @@ public:
     @param[in] _style text style */
     void SetTextStyle (const char* _style);
 
-    /** Renders text.
+    /** Queues text for the rendering.
     @param[in] _text text
     @param[in] _color color of the text
     @param[in] _x position of the text on the x axis
@@ -418,6 +432,23 @@ public:
         - @c ERRC_API_CALL */
     void RenderText (const char* _text, DWORD _color, float _x, float _y);
 
+    /** Getter: text rendering statistics of the last rendered frame.
+    @return text statistics */
+    TEXTSTATISTICS GetTextStatistics () const;
+
+    /** Renders all the queued text on top of the scene.
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_API_CALL */
+    void FlushText ();
+
+    /** Enables or disables the depth-only rendering.
+    While it is enabled, skins passed to Render() are ignored, so geometry of
+    all the skins is batched together and no textures or materials are bound.
+    @param[in] _isDepthOnly @c true to enable the depth-only rendering */
+    void SetDepthOnly (bool _isDepthOnly);
+
     /** Sets skin for rendering.
     @param[in] _skinId: id of skin in skin manager
     @exception ErrorMessage 
@@ -647,11 +678,10 @@ private:
     EffectData* m_ActiveEffect;     /**< Active effect. If effects are disabled, it is set to NULL. */
     SkinManager* m_Skin;            /**< Pointer to the skin manager. */
     UINT m_ActiveSkin;              /**< Skin which is set for the rendering. */
+    bool m_IsDepthOnly;             /**< Skins are ignored. */
     IDirect3DDevice9* m_Device;     /**< Pointer to the rendering device. */
     LogManager* m_Log;              /**< Pointer to the log manager. */
-    CD3DFont* m_Font;               /**< Font rendering class. */
-    int m_FontSize;                 /**< Font size. */
-    char m_FontStyle[MAX_PATH];     /**< Font style .*/
+    TextRenderer* m_Text;           /**< Batched text renderer. */
 
     std::vector<StaticVertexBuffer> m_StaticVertexBuffers;  /**< Static vertex buffers. */
     UINT m_ActiveStaticVertexBuffer;        /**< Active static vertex buffer. */
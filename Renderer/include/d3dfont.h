@@ -58,6 +58,10 @@ public:
     // Function to get extent of text
     HRESULT GetTextExtent( const TCHAR* strText, SIZE* pSize );
 
+    // Glyph atlas access for batched text rendering
+    LPDIRECT3DTEXTURE9 GetTexture() { return m_pTexture; }
+    BOOL GetGlyph( TCHAR c, FLOAT* pTexCoords, FLOAT* pWidth, FLOAT* pHeight );
+
     // Initializing and destroying device-dependent objects
     HRESULT InitDeviceObjects( LPDIRECT3DDEVICE9 pd3dDevice );
     HRESULT RestoreDeviceObjects();
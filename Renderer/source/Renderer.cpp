@@ -25,7 +25,10 @@ Renderer::Renderer (HINSTANCE _dll): m_DLL (_dll) {
     m_World.identity();
     ZeroMemory (&m_d3dpp, sizeof (D3DPRESENT_PARAMETERS));
     ZeroMemory (&m_ShadowMap, sizeof (m_ShadowMap));
-    m_ShadowMap.EffectId = INVALID_ID;
+    ZeroMemory (m_ShadowCascades, sizeof (m_ShadowCascades));
+    m_NumShadowCascades = 0;
+    m_ActiveShadowMap = NULL;
+    m_ShadowMapEffectId = INVALID_ID;
     #ifdef _DEBUG
     if (m_Log) {
         m_Log->Log ("Renderer is up and running.\n");
@@ -272,6 +275,7 @@ void Renderer::EndRendering () {
         return;
     }
     m_vcm->Flush ();
+    m_vcm->FlushText ();
     m_Device->EndScene ();
     HRESULT hr = m_Device->Present (NULL, NULL, NULL, NULL);
     if (hr == D3DERR_DEVICELOST) {
@@ -282,6 +286,12 @@ void Renderer::EndRendering () {
 
 // releases resources
 void Renderer::Release () {
+    ReleaseShadowMapSurfaces (m_ShadowMap);
+    for (UINT i = 0; i < MAX_SHADOW_CASCADES; i++) {
+        ReleaseShadowMapSurfaces (m_ShadowCascades[i]);
+    }
+    m_NumShadowCascades = 0;
+    m_ShadowMapEffectId = INVALID_ID;
     if (m_d3d9) {
         m_d3d9->Release ();
         m_d3d9 = NULL;
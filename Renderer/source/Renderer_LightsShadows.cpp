@@ -137,128 +137,200 @@ void Renderer::DisableFog () {
 }
 
 void Renderer::CreateShadowMap (UINT _size, const MATRIX44& _lightWorldView, float _farClip) {
-    if (m_ShadowMap.Size != _size) {
-        /* Create shadow map texture. */
-        if (m_ShadowMap.Texture) {
-            m_ShadowMap.Texture->Release ();
-            m_ShadowMap.Texture = NULL;
-        }
-        if (FAILED (D3DXCreateTexture (m_Device, _size, _size, 1, D3DUSAGE_RENDERTARGET, D3DFMT_R32F, D3DPOOL_DEFAULT, &m_ShadowMap.Texture))) {
-            THROW_DETAILED_ERROR (ERRC_API_CALL, "D3DXCreateTexture() failure.");
-        }
-        if (FAILED (m_Device->CreateDepthStencilSurface (_size, _size, m_d3dpp.AutoDepthStencilFormat, D3DMULTISAMPLE_NONE, 0, TRUE, &m_ShadowMap.DepthStencil, NULL))) {
-            THROW_DETAILED_ERROR (ERRC_API_CALL, "D3DXCreateDepthStencilSurface() failure.");
-        }
-        if (FAILED (m_ShadowMap.Texture->GetSurfaceLevel (0, &m_ShadowMap.Surface))) {
-            THROW_DETAILED_ERROR (ERRC_API_CALL, "GetSurfaceLevel() failure.");
-        }
-        if (FAILED (D3DXCreateRenderToSurface (m_Device, _size, _size, D3DFMT_R32F, TRUE, m_d3dpp.AutoDepthStencilFormat, &m_ShadowMap.RenderToSurface))) {
-            THROW_DETAILED_ERROR (ERRC_API_CALL, "D3DXCreateRenderToSurface() failure.");
-        }
-        m_ShadowMap.Size = _size;
-    }
-    if (m_ShadowMap.EffectId == INVALID_ID) {
-        char effectData[] = //"struct VSOutput { float4 Position: POSITION; }; struct PSInput { float4 Position: TEXCOORD0; }; struct PSOutput { float4 Color : COLOR0; }; float4x4 g_LightWorldViewProjection; float g_FarClip; VSOutput ShadowMapVertexShader (float4 inPos : POSITION) { VSOutput output = (VSOutput)0; output.Position = mul(inPos, g_LightWorldViewProjection); return output;  } PSOutput ShadowMapPixelShader(PSInput input) { PSOutput output = (PSOutput)0; output.Color = input.Position.z / input.Position.w; return output; } technique ShadowMap { pass Pass0 { VertexShader = compile vs_2_0 ShadowMapVertexShader(); PixelShader = compile ps_2_0 ShadowMapPixelShader(); } }";
-            "struct VSInput {                                                   \
-                float4 Position : POSITION;                                     \
-                float3 Normal : NORMAL;                                         \
-                float2 TexCoord : TEXCOORD0;                                    \
-            };                                                                  \
-            struct VSOutput {                                                   \
-                float4 Position : POSITION;                                     \
-                float Depth : TEXCOORD0;                                        \
-            };                                                                  \
-                                                                                \
-            struct PSInput {                                                    \
-                float Depth : TEXCOORD0;                                        \
-            };                                                                  \
-                                                                                \
-            struct PSOutput {                                                   \
-                float4 Color : COLOR0;                                          \
-            };                                                                  \
-                                                                                \
-            float4x4 g_LightWorldViewProjection;                                \
-            float g_FarClip;                                                    \
-                                                                                \
-            VSOutput ShadowMapVertexShader (VSInput input) {                    \
-                VSOutput output = (VSOutput)0;                                  \
-                output.Position = mul(input.Position, g_LightWorldViewProjection);       \
-                output.Depth = output.Position.z / g_FarClip;                   \
-                return output;                                                  \
-            }                                                                   \
-                                                                                \
-            PSOutput ShadowMapPixelShader(PSInput input) {                      \
-                PSOutput output = (PSOutput)0;                                                \
-                output.Color = float4 (input.Depth, 0.0, 0.0, 1.0);                                     \
-                                                     \
-                return output;                                                  \
-            }                                                                   \
-                                                                                \
-            technique ShadowMap {                                               \
-                pass Pass0 {                                                    \
-                    VertexShader = compile vs_2_0 ShadowMapVertexShader();      \
-                    PixelShader = compile ps_2_0 ShadowMapPixelShader();        \
-                }                                                               \
-            }";
-        m_ShadowMap.EffectId = m_vcm->CreateEffect (effectData, sizeof (effectData), false);
-    }
-    m_vcm->SetEffectParameter (m_ShadowMap.EffectId, "g_LightWorldViewProjection", (void*)_lightWorldView.data());
-    m_vcm->SetEffectParameter (m_ShadowMap.EffectId, "g_FarClip", &_farClip);
+    CreateShadowMapSurfaces (m_ShadowMap, _size);
+    CreateShadowMapEffect ();
+    m_ShadowMap.LightViewProj = _lightWorldView;
+    m_ShadowMap.FarClip = _farClip;
 }
 
-void Renderer::BeginRenderingToShadowMap () {
-    if (m_ShadowMap.EffectId == INVALID_ID) {
-        THROW_ERROR (ERRC_NOT_READY);
+void Renderer::CreateShadowCascades (UINT _numCascades, const UINT* _sizes) {
+    if (_numCascades == 0 || _numCascades > MAX_SHADOW_CASCADES) {
+        THROW_ERROR (ERRC_INVALID_PARAMETER);
     }
-    m_vcm->EnableEffect (m_ShadowMap.EffectId, "ShadowMap");
-    ID3DXEffect* effect = m_vcm->GetActiveEffect ();
-    D3DVIEWPORT9 viewport;
-    viewport.X = 0;
-    viewport.Y = 0;
-    viewport.Width = m_ShadowMap.Size;
-    viewport.Height = m_ShadowMap.Size;
-    viewport.MinZ = 0.0f;
-    viewport.MaxZ = 1.0f;
-    if (FAILED (m_Device->GetDepthStencilSurface (&m_ShadowMap.OldDepthStencil))) {
-        THROW_DETAILED_ERROR (ERRC_API_CALL, "GetDepthStencilSurface() failure.");
+    for (UINT i = 0; i < _numCascades; i++) {
+        CreateShadowMapSurfaces (m_ShadowCascades[i], _sizes[i]);
+        /* cascade depth is normalized by the orthographic light projection */
+        m_ShadowCascades[i].FarClip = 1.0f;
     }
-    if (FAILED (m_Device->SetDepthStencilSurface (m_ShadowMap.DepthStencil))) {
-        THROW_DETAILED_ERROR (ERRC_API_CALL, "SetDepthStencilSurface() failure.");
-    }
-    m_Device->Clear (0, NULL, D3DCLEAR_ZBUFFER, 0xffffffff, 1.0f, 0);
-    if (FAILED (m_ShadowMap.RenderToSurface->BeginScene (m_ShadowMap.Surface, &viewport))) {
-        THROW_DETAILED_ERROR (ERRC_API_CALL, "BeginScene() failure.");
+    for (UINT i = _numCascades; i < MAX_SHADOW_CASCADES; i++) {
+        ReleaseShadowMapSurfaces (m_ShadowCascades[i]);
     }
-    /*UINT numPasses;
-    if (FAILED (effect->Begin (&numPasses, 0))) {
-        THROW_DETAILED_ERROR (ERRC_API_CALL, "Begin() failure.");
+    m_NumShadowCascades = _numCascades;
+    CreateShadowMapEffect ();
+}
+
+void Renderer::BeginRenderingToShadowMap () {
+    BeginRenderingToShadowMap (m_ShadowMap);
+}
+
+void Renderer::BeginRenderingToShadowCascade (UINT _cascade, const MATRIX44& _lightViewProj) {
+    if (_cascade >= m_NumShadowCascades) {
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
     }
-    if (FAILED (effect->BeginPass (0))) {
-        THROW_DETAILED_ERROR (ERRC_API_CALL, "BeginPass() failure.");
-    }*/
+    m_ShadowCascades[_cascade].LightViewProj = _lightViewProj;
+    BeginRenderingToShadowMap (m_ShadowCascades[_cascade]);
 }
 
 void Renderer::EndRenderingToShadowMap () {
     /*ID3DXEffect* effect = m_vcm->GetActiveEffect ();
     effect->EndPass ();
     effect->End ();*/
+    if (!m_ActiveShadowMap) {
+        THROW_ERROR (ERRC_NOT_READY);
+    }
     m_vcm->Flush ();
-    if (FAILED (m_ShadowMap.RenderToSurface->EndScene (D3DX_FILTER_NONE))) {
+    m_vcm->SetDepthOnly (false);
+    if (FAILED (m_ActiveShadowMap->RenderToSurface->EndScene (D3DX_FILTER_NONE))) {
         THROW_DETAILED_ERROR (ERRC_API_CALL, "EndScene() failure.");
     }
     /*if (FAILED (D3DXSaveTextureToFileA ("texture.jpg", D3DXIFF_JPG, m_ShadowMap.Texture, NULL))) {
         THROW_ERROR (ERRC_API_CALL);
     }*/
-    if (FAILED (m_Device->SetDepthStencilSurface (m_ShadowMap.OldDepthStencil))) {
+    if (FAILED (m_Device->SetDepthStencilSurface (m_ActiveShadowMap->OldDepthStencil))) {
         THROW_DETAILED_ERROR (ERRC_API_CALL, "SetDepthStencilSurface() failure.");
     }
+    m_ActiveShadowMap->OldDepthStencil->Release ();
+    m_ActiveShadowMap->OldDepthStencil = NULL;
+    m_ActiveShadowMap = NULL;
     m_vcm->SetSkin (INVALID_ID);
 }
 
 void Renderer::SetShadowMap (UINT _effectId, const char* _shadowMapParamName) {
+    SetShadowMapTexture (_effectId, _shadowMapParamName, m_ShadowMap.Texture);
+}
+
+void Renderer::SetShadowCascade (UINT _effectId, UINT _cascade, const char* _shadowMapParamName) {
+    if (_cascade >= m_NumShadowCascades) {
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    SetShadowMapTexture (_effectId, _shadowMapParamName, m_ShadowCascades[_cascade].Texture);
+}
+
+UINT Renderer::GetNumShadowCascades () const {
+    return m_NumShadowCascades;
+}
+
+void Renderer::CreateShadowMapSurfaces (ShadowMap& _shadowMap, UINT _size) {
+    if (_shadowMap.Size == _size) {
+        return;
+    }
+    ReleaseShadowMapSurfaces (_shadowMap);
+    if (FAILED (D3DXCreateTexture (m_Device, _size, _size, 1, D3DUSAGE_RENDERTARGET, D3DFMT_R32F, D3DPOOL_DEFAULT, &_shadowMap.Texture))) {
+        THROW_DETAILED_ERROR (ERRC_API_CALL, "D3DXCreateTexture() failure.");
+    }
+    if (FAILED (m_Device->CreateDepthStencilSurface (_size, _size, m_d3dpp.AutoDepthStencilFormat, D3DMULTISAMPLE_NONE, 0, TRUE, &_shadowMap.DepthStencil, NULL))) {
+        THROW_DETAILED_ERROR (ERRC_API_CALL, "D3DXCreateDepthStencilSurface() failure.");
+    }
+    if (FAILED (_shadowMap.Texture->GetSurfaceLevel (0, &_shadowMap.Surface))) {
+        THROW_DETAILED_ERROR (ERRC_API_CALL, "GetSurfaceLevel() failure.");
+    }
+    if (FAILED (D3DXCreateRenderToSurface (m_Device, _size, _size, D3DFMT_R32F, TRUE, m_d3dpp.AutoDepthStencilFormat, &_shadowMap.RenderToSurface))) {
+        THROW_DETAILED_ERROR (ERRC_API_CALL, "D3DXCreateRenderToSurface() failure.");
+    }
+    _shadowMap.Size = _size;
+}
+
+void Renderer::ReleaseShadowMapSurfaces (ShadowMap& _shadowMap) {
+    if (_shadowMap.RenderToSurface) {
+        _shadowMap.RenderToSurface->Release ();
+        _shadowMap.RenderToSurface = NULL;
+    }
+    if (_shadowMap.Surface) {
+        _shadowMap.Surface->Release ();
+        _shadowMap.Surface = NULL;
+    }
+    if (_shadowMap.DepthStencil) {
+        _shadowMap.DepthStencil->Release ();
+        _shadowMap.DepthStencil = NULL;
+    }
+    if (_shadowMap.Texture) {
+        _shadowMap.Texture->Release ();
+        _shadowMap.Texture = NULL;
+    }
+    _shadowMap.Size = 0;
+}
+
+void Renderer::CreateShadowMapEffect () {
+    if (m_ShadowMapEffectId != INVALID_ID) {
+        return;
+    }
+    char effectData[] = //"struct VSOutput { float4 Position: POSITION; }; struct PSInput { float4 Position: TEXCOORD0; }; struct PSOutput { float4 Color : COLOR0; }; float4x4 g_LightWorldViewProjection; float g_FarClip; VSOutput ShadowMapVertexShader (float4 inPos : POSITION) { VSOutput output = (VSOutput)0; output.Position = mul(inPos, g_LightWorldViewProjection); return output;  } PSOutput ShadowMapPixelShader(PSInput input) { PSOutput output = (PSOutput)0; output.Color = input.Position.z / input.Position.w; return output; } technique ShadowMap { pass Pass0 { VertexShader = compile vs_2_0 ShadowMapVertexShader(); PixelShader = compile ps_2_0 ShadowMapPixelShader(); } }";
+        "struct VSInput {                                                   \
+            float4 Position : POSITION;                                     \
+            float3 Normal : NORMAL;                                         \
+            float2 TexCoord : TEXCOORD0;                                    \
+        };                                                                  \
+        struct VSOutput {                                                   \
+            float4 Position : POSITION;                                     \
+            float Depth : TEXCOORD0;                                        \
+        };                                                                  \
+                                                                            \
+        struct PSInput {                                                    \
+            float Depth : TEXCOORD0;                                        \
+        };                                                                  \
+                                                                            \
+        struct PSOutput {                                                   \
+            float4 Color : COLOR0;                                          \
+        };                                                                  \
+                                                                            \
+        float4x4 g_LightWorldViewProjection;                                \
+        float g_FarClip;                                                    \
+                                                                            \
+        VSOutput ShadowMapVertexShader (VSInput input) {                    \
+            VSOutput output = (VSOutput)0;                                  \
+            output.Position = mul(input.Position, g_LightWorldViewProjection);       \
+            output.Depth = output.Position.z / g_FarClip;                   \
+            return output;                                                  \
+        }                                                                   \
+                                                                            \
+        PSOutput ShadowMapPixelShader(PSInput input) {                      \
+            PSOutput output = (PSOutput)0;                                                \
+            output.Color = float4 (input.Depth, 0.0, 0.0, 1.0);                                     \
+                                                 \
+            return output;                                                  \
+        }                                                                   \
+                                                                            \
+        technique ShadowMap {                                               \
+            pass Pass0 {                                                    \
+                VertexShader = compile vs_2_0 ShadowMapVertexShader();      \
+                PixelShader = compile ps_2_0 ShadowMapPixelShader();        \
+            }                                                               \
+        }";
+    m_ShadowMapEffectId = m_vcm->CreateEffect (effectData, sizeof (effectData), false);
+}
+
+void Renderer::BeginRenderingToShadowMap (ShadowMap& _shadowMap) {
+    if (m_ShadowMapEffectId == INVALID_ID || !_shadowMap.RenderToSurface) {
+        THROW_ERROR (ERRC_NOT_READY);
+    }
+    m_vcm->SetEffectParameter (m_ShadowMapEffectId, "g_LightWorldViewProjection", (void*)_shadowMap.LightViewProj.data());
+    m_vcm->SetEffectParameter (m_ShadowMapEffectId, "g_FarClip", &_shadowMap.FarClip);
+    m_vcm->EnableEffect (m_ShadowMapEffectId, "ShadowMap");
+    m_vcm->SetDepthOnly (true);
+    D3DVIEWPORT9 viewport;
+    viewport.X = 0;
+    viewport.Y = 0;
+    viewport.Width = _shadowMap.Size;
+    viewport.Height = _shadowMap.Size;
+    viewport.MinZ = 0.0f;
+    viewport.MaxZ = 1.0f;
+    if (FAILED (m_Device->GetDepthStencilSurface (&_shadowMap.OldDepthStencil))) {
+        THROW_DETAILED_ERROR (ERRC_API_CALL, "GetDepthStencilSurface() failure.");
+    }
+    if (FAILED (m_Device->SetDepthStencilSurface (_shadowMap.DepthStencil))) {
+        THROW_DETAILED_ERROR (ERRC_API_CALL, "SetDepthStencilSurface() failure.");
+    }
+    m_Device->Clear (0, NULL, D3DCLEAR_ZBUFFER, 0xffffffff, 1.0f, 0);
+    if (FAILED (_shadowMap.RenderToSurface->BeginScene (_shadowMap.Surface, &viewport))) {
+        THROW_DETAILED_ERROR (ERRC_API_CALL, "BeginScene() failure.");
+    }
+    m_ActiveShadowMap = &_shadowMap;
+}
+
+void Renderer::SetShadowMapTexture (UINT _effectId, const char* _shadowMapParamName, IDirect3DTexture9* _texture) {
     ID3DXEffect* effect = m_vcm->GetEffect (_effectId);
     D3DXHANDLE shadowMap = effect->GetParameterByName (NULL, _shadowMapParamName);
-    if (FAILED (effect->SetTexture (shadowMap, m_ShadowMap.Texture))) {
+    if (FAILED (effect->SetTexture (shadowMap, _texture))) {
         THROW_DETAILED_ERROR (ERRC_API_CALL, "SetTexture() failure.");
     }
-}
\ No newline at end of file
+}
@@ -1,6 +1,9 @@
 #include "../include/SkinManager.h"
+#include "../include/PackFile.h"
+#include "../include/DxtTexel.h"
 
 #include <DxErr.h>
+#include <string>
 #pragma comment (lib, "dxerr.lib")
 
 using namespace vs3d;
@@ -54,9 +57,19 @@ UINT SkinManager::AddTexture (const char* _filename) {
         #endif
         return GetTextureId (_filename);
     }
-    // load texture
+    // load texture, the cooked one if there is
     IDirect3DTexture9* texture;
-    HRESULT hr = D3DXCreateTextureFromFileA (m_Device, _filename, &texture);
+    bool isCooked = HasCookedTexture (_filename);
+    HRESULT hr = CreateTexture (_filename, isCooked, &texture);
+    if (FAILED (hr) && isCooked) {
+        #ifdef _DEBUG
+        if (m_Log) {
+            m_Log->Log ("Warning: Unable to load cooked texture of %s, the source is loaded.\n", _filename);
+        }
+        #endif
+        isCooked = false;
+        hr = CreateTexture (_filename, false, &texture);
+    }
     if (FAILED (hr)) {
         #ifdef _DEBUG
         if (m_Log) {
@@ -70,22 +83,74 @@ UINT SkinManager::AddTexture (const char* _filename) {
 		#endif
         THROW_DETAILED_ERROR (ERRC_API_CALL, "D3DXCreateTextureFromFile() failed.");
     }
+    return StoreTexture (_filename, texture, isCooked);
+}
+
+UINT SkinManager::AddTexture (const char* _filename, const void* _data, UINT _size) {
+    if (IsTextureLoaded (_filename)) {
+        return GetTextureId (_filename);
+    }
+    // the file is decoded the same way as CreateTexture does
+    IDirect3DTexture9* texture;
+    bool isCooked = _size >= 4 && memcmp (_data, "DDS ", 4) == 0;
+    HRESULT hr;
+    if (isCooked) {
+        hr = D3DXCreateTextureFromFileInMemoryEx (m_Device, _data, _size, D3DX_DEFAULT, D3DX_DEFAULT, D3DX_FROM_FILE, 0,
+            D3DFMT_FROM_FILE, D3DPOOL_MANAGED, D3DX_FILTER_NONE, D3DX_FILTER_NONE, 0, NULL, NULL, &texture);
+        if (FAILED (hr)) {
+            // the device may lack the block format, the source is still there
+            return AddTexture (_filename);
+        }
+    } else {
+        hr = D3DXCreateTextureFromFileInMemory (m_Device, _data, _size, &texture);
+    }
+    if (FAILED (hr)) {
+        #ifdef _DEBUG
+        if (m_Log) {
+            m_Log->Log ("Error: Unable to load texture: %s\n", _filename);
+        }
+        #endif
+        THROW_DETAILED_ERROR (ERRC_API_CALL, "D3DXCreateTextureFromFileInMemory() failed.");
+    }
+    return StoreTexture (_filename, texture, isCooked);
+}
+
+HRESULT SkinManager::CreateTexture (const char* _filename, bool _isCooked, IDirect3DTexture9** _texture) {
+    // from the archive or the loose file
+    std::string file = _isCooked ? std::string (_filename) + COOKED_TEXTURE_EXTENSION : std::string (_filename);
+    std::vector<char> data;
+    try {
+        VirtualFile::Load (file.c_str (), data);
+    } catch (ErrorMessage& e) {
+        return e.GetErrorCode () == ERRC_OUT_OF_MEM ? E_OUTOFMEMORY : HRESULT_FROM_WIN32 (ERROR_FILE_NOT_FOUND);
+    }
+    if (data.empty ()) {
+        return D3DXERR_INVALIDDATA;
+    }
+    if (!_isCooked) {
+        return D3DXCreateTextureFromFileInMemory (m_Device, &data[0], data.size (), _texture);
+    }
+    return D3DXCreateTextureFromFileInMemoryEx (m_Device, &data[0], data.size (), D3DX_DEFAULT, D3DX_DEFAULT, D3DX_FROM_FILE, 0,
+        D3DFMT_FROM_FILE, D3DPOOL_MANAGED, D3DX_FILTER_NONE, D3DX_FILTER_NONE, 0, NULL, NULL, _texture);
+}
+
+UINT SkinManager::StoreTexture (const char* _filename, IDirect3DTexture9* _texture, bool _isCooked) {
     // check and allocate memory if it is necessary
     if (m_NumTextures % 50 == 0) {
-        m_Texture = (TEXTURE*) realloc (m_Texture, sizeof (TEXTURE) * (m_NumTextures + 50));
-        if (!m_Texture) {
+        TEXTURE* textures = (TEXTURE*) realloc (m_Texture, sizeof (TEXTURE) * (m_NumTextures + 50));
+        if (!textures) {
             #ifdef _DEBUG
             if (m_Log) {
                 m_Log->Log ("Error: Out of memory.\n");
             }
             #endif
+            _texture->Release ();
             THROW_ERROR (ERRC_OUT_OF_MEM);
         }
+        m_Texture = textures;
     }
-    // add texture
-    strcpy (m_Texture[m_NumTextures].Name, _filename);
-    m_Texture[m_NumTextures].Data = (void*) texture;
     try {
+        m_IsTextureCooked.reserve (m_NumTextures + 1);
         m_TextureBackups.push_back(new TextureBackup);
     } catch (std::bad_alloc) {
         #ifdef _DEBUG
@@ -93,8 +158,13 @@ UINT SkinManager::AddTexture (const char* _filename) {
             m_Log->Log ("Error: Out of memory.\n");
         }
         #endif
+        _texture->Release ();
         THROW_ERROR (ERRC_OUT_OF_MEM);
     }
+    // add texture
+    strcpy (m_Texture[m_NumTextures].Name, _filename);
+    m_Texture[m_NumTextures].Data = (void*) _texture;
+    m_IsTextureCooked.push_back (_isCooked);
 
     return m_NumTextures++;
 }
@@ -151,6 +221,19 @@ void SkinManager::GetTextureTexel (UINT _id, float _u, float _v, BYTE(& _texel)[
     if (FAILED (texture->LockRect (0, &source, NULL, D3DLOCK_READONLY))) {
         THROW_DETAILED_ERROR (ERRC_API_CALL, "LockRect() failure.");
     }
+    if (texDesc.Format == D3DFMT_DXT1 || texDesc.Format == D3DFMT_DXT5) {
+        // the pitch is of a row of the blocks
+        UINT blockSize = texDesc.Format == D3DFMT_DXT1 ? 8 : 16;
+        const BYTE* block = (BYTE*)source.pBits + source.Pitch * (point.y / 4) + blockSize * (point.x / 4);
+        BYTE bgra[4];
+        DecodeBlockTexel (texDesc.Format == D3DFMT_DXT5, block, point.x % 4, point.y % 4, bgra);
+        texture->UnlockRect (0);
+        _texel[3] = bgra[0];    // blue
+        _texel[2] = bgra[1];    // green
+        _texel[1] = bgra[2];    // red
+        _texel[0] = bgra[3];    // alpha
+        return;
+    }
     UINT index = point.x * GetPixelSize (texDesc.Format) + source.Pitch * point.y;
     _texel[3] = ((BYTE*)source.pBits)[index];       // blue
     _texel[2] = ((BYTE*)source.pBits)[index + 1];   // green
@@ -182,6 +265,7 @@ void SkinManager::RemoveTextures () {
         m_Texture = NULL;
         m_NumTextures = 0;
     }
+    m_IsTextureCooked.clear ();
     RemoveSkins ();
 }
 
@@ -192,6 +276,74 @@ bool SkinManager::IsTextureLoaded (const char* _name) const {
     return true;
 }
 
+bool SkinManager::HasCookedTexture (const char* _filename) const {
+    std::string cookedFile = std::string (_filename) + COOKED_TEXTURE_EXTENSION;
+    return VirtualFile::Exists (cookedFile.c_str ());
+}
+
+UINT SkinManager::GetNumTextures () const {
+    return m_NumTextures;
+}
+
+bool SkinManager::IsTextureCooked (UINT _id) const {
+    if (_id >= m_NumTextures) {
+        #ifdef _DEBUG
+        if (m_Log) {
+            m_Log->Log ("Error: texture id (%d) is out of range.\n", _id);
+        }
+        #endif
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    return m_IsTextureCooked[_id];
+}
+
+UINT SkinManager::GetTextureMemory (UINT _id) const {
+    if (_id >= m_NumTextures) {
+        #ifdef _DEBUG
+        if (m_Log) {
+            m_Log->Log ("Error: texture id (%d) is out of range.\n", _id);
+        }
+        #endif
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    return ComputeTextureMemory ((LPDIRECT3DTEXTURE9)m_Texture[_id].Data);
+}
+
+void SkinManager::MeasureTextureLoad (const char* _filename, bool _isCooked, float& _time, UINT& _memory) {
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency (&frequency);
+    QueryPerformanceCounter (&start);
+    IDirect3DTexture9* texture;
+    HRESULT hr = CreateTexture (_filename, _isCooked, &texture);
+    QueryPerformanceCounter (&end);
+    if (FAILED (hr)) {
+        #ifdef _DEBUG
+        if (m_Log) {
+            m_Log->Log ("Error: Unable to load texture %s. (SkinManager::MeasureTextureLoad)\n", _filename);
+        }
+        #endif
+        THROW_DETAILED_ERROR (ERRC_API_CALL, "D3DXCreateTextureFromFile() failed.");
+    }
+    _time = (float)(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+    _memory = ComputeTextureMemory (texture);
+    texture->Release ();
+}
+
+UINT SkinManager::ComputeTextureMemory (IDirect3DTexture9* _texture) {
+    UINT memory = 0;
+    for (UINT i = 0; i < _texture->GetLevelCount (); i++) {
+        D3DSURFACE_DESC desc;
+        _texture->GetLevelDesc (i, &desc);
+        if (desc.Format == D3DFMT_DXT1 || desc.Format == D3DFMT_DXT5) {
+            UINT blockSize = desc.Format == D3DFMT_DXT1 ? 8 : 16;
+            memory += ((desc.Width + 3) / 4) * ((desc.Height + 3) / 4) * blockSize;
+        } else {
+            memory += desc.Width * desc.Height * GetPixelSize (desc.Format);
+        }
+    }
+    return memory;
+}
+
 UINT SkinManager::AddMaterial (MATERIAL _material) {
     // check if material exists
     if (IsMaterialLoaded (_material)) {
@@ -778,6 +930,9 @@ void SkinManager::ChangeTexture (UINT _targetId, UINT _textureId, POINT _start,
     if ((UINT)_start.x > targetDesc.Width || (UINT)_start.y > targetDesc.Height) {
         THROW_ERROR (ERRC_INVALID_PARAMETER);
     }
+    if (GetPixelSize (texDesc.Format) == 0 || GetPixelSize (targetDesc.Format) == 0) {
+        THROW_DETAILED_ERROR (ERRC_INVALID_PARAMETER, "Compressed textures cannot be drawn on.");
+    }
     if (m_TextureBackups[_targetId]->Data.size() == 0) {
         InitTextureBackup(_targetId);
         BackupTexture (_targetId);
@@ -881,6 +1036,9 @@ void SkinManager::InitTextureBackup (UINT _textureId) {
         D3DSURFACE_DESC texDesc;
         texture->GetLevelDesc(i, &texDesc);
         UINT pixelSize = GetPixelSize (texDesc.Format);
+        if (pixelSize == 0) {
+            THROW_DETAILED_ERROR (ERRC_INVALID_PARAMETER, "Compressed textures cannot be drawn on.");
+        }
         m_TextureBackups[_textureId]->Size[i] = texDesc.Height * texDesc.Width * pixelSize;
         try {
             m_TextureBackups[_textureId]->Data[i] = new BYTE[m_TextureBackups[_textureId]->Size[i]];
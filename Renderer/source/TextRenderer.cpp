@@ -0,0 +1,315 @@
+#include "../include/TextRenderer.h"
+
+#define D3DFVF_TEXTVERTEX (D3DFVF_XYZRHW | D3DFVF_DIFFUSE | D3DFVF_TEX1)
+
+static TCHAR* GetWideStr (const char* _strC, TCHAR(& _str)[MAX_PATH]) {
+    int size = strlen (_strC) +  1;
+    if (MultiByteToWideChar(CP_ACP, 0, _strC, -1, _str, size) == 0) {
+        return NULL;
+    }
+
+    return _str;
+}
+
+TextRenderer::TextRenderer (IDirect3DDevice9* _device, LogManager* _log):
+    m_Device (_device),
+    m_Log (_log),
+    m_ActiveFont (INVALID_ID),
+    m_Size (16),
+    m_Frame (0),
+    m_VertexBuffer (NULL),
+    m_VertexBufferSize (0),
+    m_StateBlockSaved (NULL),
+    m_StateBlockText (NULL) {
+    strcpy (m_Style, "Times New Roman");
+    ZeroMemory (&m_FrameStatistics, sizeof (m_FrameStatistics));
+    ZeroMemory (&m_LastStatistics, sizeof (m_LastStatistics));
+}
+
+TextRenderer::~TextRenderer () {
+    for (UINT i = 0; i < m_Fonts.size (); i++) {
+        delete m_Fonts[i].Font;
+    }
+    if (m_VertexBuffer) {
+        m_VertexBuffer->Release ();
+    }
+    if (m_StateBlockSaved) {
+        m_StateBlockSaved->Release ();
+    }
+    if (m_StateBlockText) {
+        m_StateBlockText->Release ();
+    }
+}
+
+void TextRenderer::SetStyle (const char* _style) {
+    if (strcmp (m_Style, _style) != 0) {
+        strcpy (m_Style, _style);
+        m_ActiveFont = INVALID_ID;
+    }
+}
+
+void TextRenderer::SetSize (int _size) {
+    m_Size = _size;
+}
+
+void TextRenderer::Add (const char* _text, DWORD _color, float _x, float _y) {
+    UINT font = GetActiveFont ();
+    LayoutKey key;
+    key.Font = font;
+    key.Size = m_Size;
+    key.Text = _text;
+    std::map<LayoutKey, TextLayout>::iterator layout = m_Layouts.find (key);
+    if (layout == m_Layouts.end ()) {
+        try {
+            layout = m_Layouts.insert (std::make_pair (key, TextLayout ())).first;
+        } catch (std::bad_alloc) {
+            THROW_ERROR (ERRC_OUT_OF_MEM);
+        }
+        Layout (font, _text, layout->second);
+        m_FrameStatistics.NumLayoutMisses++;
+    } else {
+        m_FrameStatistics.NumLayoutHits++;
+    }
+    layout->second.LastFrame = m_Frame;
+    m_FrameStatistics.NumStrings++;
+
+    std::vector<GlyphQuad>& glyphs = layout->second.Glyphs;
+    if (glyphs.empty ()) {
+        return;
+    }
+    std::vector<vs3d::TLVERTEX>& vertices = m_Fonts[font].Vertices;
+    UINT first = vertices.size ();
+    try {
+        vertices.resize (first + glyphs.size () * 6);
+    } catch (std::bad_alloc) {
+        THROW_ERROR (ERRC_OUT_OF_MEM);
+    }
+    vs3d::TLVERTEX* vertex = &vertices[first];
+    for (UINT i = 0; i < glyphs.size (); i++) {
+        float x1 = _x + glyphs[i].X1;
+        float y1 = _y + glyphs[i].Y1;
+        float x2 = _x + glyphs[i].X2;
+        float y2 = _y + glyphs[i].Y2;
+        *vertex++ = vs3d::TLVERTEX (x1, y2, 0.9f, 1.0f, _color, glyphs[i].U1, glyphs[i].V2);
+        *vertex++ = vs3d::TLVERTEX (x1, y1, 0.9f, 1.0f, _color, glyphs[i].U1, glyphs[i].V1);
+        *vertex++ = vs3d::TLVERTEX (x2, y2, 0.9f, 1.0f, _color, glyphs[i].U2, glyphs[i].V2);
+        *vertex++ = vs3d::TLVERTEX (x2, y1, 0.9f, 1.0f, _color, glyphs[i].U2, glyphs[i].V1);
+        *vertex++ = vs3d::TLVERTEX (x2, y2, 0.9f, 1.0f, _color, glyphs[i].U2, glyphs[i].V2);
+        *vertex++ = vs3d::TLVERTEX (x1, y1, 0.9f, 1.0f, _color, glyphs[i].U1, glyphs[i].V1);
+    }
+    m_FrameStatistics.NumGlyphs += glyphs.size ();
+}
+
+void TextRenderer::Render () {
+    UINT numVertices = 0;
+    for (UINT i = 0; i < m_Fonts.size (); i++) {
+        if (m_Fonts[i].Vertices.size () > numVertices) {
+            numVertices = m_Fonts[i].Vertices.size ();
+        }
+    }
+    if (numVertices > 0) {
+        ReserveVertexBuffer (numVertices);
+        if (!m_StateBlockSaved) {
+            CreateStateBlocks ();
+        }
+        m_StateBlockSaved->Capture ();
+        m_StateBlockText->Apply ();
+        m_Device->SetFVF (D3DFVF_TEXTVERTEX);
+        m_Device->SetVertexShader (NULL);
+        m_Device->SetPixelShader (NULL);
+        m_Device->SetStreamSource (0, m_VertexBuffer, 0, sizeof (vs3d::TLVERTEX));
+        for (UINT i = 0; i < m_Fonts.size (); i++) {
+            std::vector<vs3d::TLVERTEX>& vertices = m_Fonts[i].Vertices;
+            if (vertices.empty ()) {
+                continue;
+            }
+            void* data;
+            if (FAILED (m_VertexBuffer->Lock (0, vertices.size () * sizeof (vs3d::TLVERTEX), &data, D3DLOCK_DISCARD))) {
+                m_StateBlockSaved->Apply ();
+                THROW_DETAILED_ERROR (ERRC_API_CALL, "Vertex buffer Lock() failure.");
+            }
+            memcpy (data, &vertices[0], vertices.size () * sizeof (vs3d::TLVERTEX));
+            m_VertexBuffer->Unlock ();
+            m_Device->SetTexture (0, m_Fonts[i].Font->GetTexture ());
+            if (FAILED (m_Device->DrawPrimitive (D3DPT_TRIANGLELIST, 0, vertices.size () / 3))) {
+                m_StateBlockSaved->Apply ();
+                THROW_DETAILED_ERROR (ERRC_API_CALL, "DrawPrimitive() failure.");
+            }
+            m_FrameStatistics.NumDrawCalls++;
+            vertices.clear ();
+        }
+        m_StateBlockSaved->Apply ();
+    }
+    m_LastStatistics = m_FrameStatistics;
+    ZeroMemory (&m_FrameStatistics, sizeof (m_FrameStatistics));
+    if (m_Layouts.size () > TEXT_LAYOUT_CACHE_SIZE) {
+        EvictLayouts ();
+    }
+    m_Frame++;
+}
+
+TEXTSTATISTICS TextRenderer::GetStatistics () const {
+    return m_LastStatistics;
+}
+
+UINT TextRenderer::GetActiveFont () {
+    if (m_ActiveFont != INVALID_ID) {
+        return m_ActiveFont;
+    }
+    for (UINT i = 0; i < m_Fonts.size (); i++) {
+        if (strcmp (m_Fonts[i].Style, m_Style) == 0) {
+            m_ActiveFont = i;
+            return i;
+        }
+    }
+    TCHAR wideStr[MAX_PATH];
+    FontData font;
+    strcpy (font.Style, m_Style);
+    try {
+        font.Font = new CD3DFont (GetWideStr (m_Style, wideStr), TEXT_ATLAS_FONT_SIZE, 0);
+    } catch (std::bad_alloc) {
+        THROW_ERROR (ERRC_OUT_OF_MEM);
+    }
+    if (FAILED (font.Font->InitDeviceObjects (m_Device))) {
+        delete font.Font;
+        #ifdef _DEBUG
+        if (m_Log) {
+            m_Log->Log ("Error: Font's InitDeviceObjects() failed. (TextRenderer::GetActiveFont)\n");
+        }
+        #endif
+        THROW_DETAILED_ERROR (ERRC_API_CALL, "Font's InitDeviceObjects() failure.");
+    }
+    try {
+        m_Fonts.push_back (font);
+    } catch (std::bad_alloc) {
+        delete font.Font;
+        THROW_ERROR (ERRC_OUT_OF_MEM);
+    }
+    m_ActiveFont = m_Fonts.size () - 1;
+    return m_ActiveFont;
+}
+
+void TextRenderer::Layout (UINT _font, const char* _text, TextLayout& _layout) {
+    CD3DFont* font = m_Fonts[_font].Font;
+    float scale = (float)m_Size / TEXT_ATLAS_FONT_SIZE;
+    float texCoords[4];
+    float width, height;
+    float lineHeight = 0.0f;
+    if (font->GetGlyph (_T(' '), texCoords, &width, &height)) {
+        lineHeight = height * scale;
+    }
+    float x = 0.0f;
+    float y = 0.0f;
+    _layout.Glyphs.clear ();
+    _layout.Glyphs.reserve (strlen (_text));
+    for (const char* c = _text; *c; c++) {
+        if (*c == '\n') {
+            x = 0.0f;
+            y += lineHeight;
+            continue;
+        }
+        if (!font->GetGlyph ((TCHAR)(unsigned char)*c, texCoords, &width, &height)) {
+            continue;
+        }
+        width *= scale;
+        height *= scale;
+        if (*c != ' ') {
+            GlyphQuad glyph;
+            glyph.X1 = x - 0.5f;
+            glyph.Y1 = y - 0.5f;
+            glyph.X2 = x + width - 0.5f;
+            glyph.Y2 = y + height - 0.5f;
+            glyph.U1 = texCoords[0];
+            glyph.V1 = texCoords[1];
+            glyph.U2 = texCoords[2];
+            glyph.V2 = texCoords[3];
+            _layout.Glyphs.push_back (glyph);
+        }
+        x += width;
+    }
+}
+
+void TextRenderer::EvictLayouts () {
+    /* m_Frame is not advanced yet, so this keeps the layouts of the last frame */
+    std::map<LayoutKey, TextLayout>::iterator i = m_Layouts.begin ();
+    while (i != m_Layouts.end ()) {
+        if (i->second.LastFrame != m_Frame) {
+            m_Layouts.erase (i++);
+        } else {
+            i++;
+        }
+    }
+}
+
+void TextRenderer::CreateStateBlocks () {
+    for (UINT which = 0; which < 2; which++) {
+        m_Device->BeginStateBlock ();
+        m_Device->SetRenderState (D3DRS_ZENABLE, FALSE);
+        m_Device->SetRenderState (D3DRS_ALPHABLENDENABLE, TRUE);
+        m_Device->SetRenderState (D3DRS_SRCBLEND, D3DBLEND_SRCALPHA);
+        m_Device->SetRenderState (D3DRS_DESTBLEND, D3DBLEND_INVSRCALPHA);
+        m_Device->SetRenderState (D3DRS_ALPHATESTENABLE, TRUE);
+        m_Device->SetRenderState (D3DRS_ALPHAREF, 0x08);
+        m_Device->SetRenderState (D3DRS_ALPHAFUNC, D3DCMP_GREATEREQUAL);
+        m_Device->SetRenderState (D3DRS_FILLMODE, D3DFILL_SOLID);
+        m_Device->SetRenderState (D3DRS_CULLMODE, D3DCULL_CCW);
+        m_Device->SetRenderState (D3DRS_STENCILENABLE, FALSE);
+        m_Device->SetRenderState (D3DRS_CLIPPING, TRUE);
+        m_Device->SetRenderState (D3DRS_CLIPPLANEENABLE, FALSE);
+        m_Device->SetRenderState (D3DRS_VERTEXBLEND, D3DVBF_DISABLE);
+        m_Device->SetRenderState (D3DRS_INDEXEDVERTEXBLENDENABLE, FALSE);
+        m_Device->SetRenderState (D3DRS_FOGENABLE, FALSE);
+        m_Device->SetRenderState (D3DRS_COLORWRITEENABLE,
+            D3DCOLORWRITEENABLE_RED | D3DCOLORWRITEENABLE_GREEN |
+            D3DCOLORWRITEENABLE_BLUE | D3DCOLORWRITEENABLE_ALPHA);
+        m_Device->SetTextureStageState (0, D3DTSS_COLOROP, D3DTOP_MODULATE);
+        m_Device->SetTextureStageState (0, D3DTSS_COLORARG1, D3DTA_TEXTURE);
+        m_Device->SetTextureStageState (0, D3DTSS_COLORARG2, D3DTA_DIFFUSE);
+        m_Device->SetTextureStageState (0, D3DTSS_ALPHAOP, D3DTOP_MODULATE);
+        m_Device->SetTextureStageState (0, D3DTSS_ALPHAARG1, D3DTA_TEXTURE);
+        m_Device->SetTextureStageState (0, D3DTSS_ALPHAARG2, D3DTA_DIFFUSE);
+        m_Device->SetTextureStageState (0, D3DTSS_TEXCOORDINDEX, 0);
+        m_Device->SetTextureStageState (0, D3DTSS_TEXTURETRANSFORMFLAGS, D3DTTFF_DISABLE);
+        m_Device->SetTextureStageState (1, D3DTSS_COLOROP, D3DTOP_DISABLE);
+        m_Device->SetTextureStageState (1, D3DTSS_ALPHAOP, D3DTOP_DISABLE);
+        /* the atlas is shared by all the sizes, so it has to be filtered */
+        m_Device->SetSamplerState (0, D3DSAMP_MINFILTER, D3DTEXF_LINEAR);
+        m_Device->SetSamplerState (0, D3DSAMP_MAGFILTER, D3DTEXF_LINEAR);
+        m_Device->SetSamplerState (0, D3DSAMP_MIPFILTER, D3DTEXF_NONE);
+        HRESULT hr;
+        if (which == 0) {
+            hr = m_Device->EndStateBlock (&m_StateBlockSaved);
+        } else {
+            hr = m_Device->EndStateBlock (&m_StateBlockText);
+        }
+        if (FAILED (hr)) {
+            THROW_DETAILED_ERROR (ERRC_API_CALL, "EndStateBlock() failure.");
+        }
+    }
+}
+
+void TextRenderer::ReserveVertexBuffer (UINT _numVertices) {
+    if (m_VertexBuffer && m_VertexBufferSize >= _numVertices) {
+        return;
+    }
+    UINT size = m_VertexBufferSize > 0 ? m_VertexBufferSize : 600;
+    while (size < _numVertices) {
+        size *= 2;
+    }
+    if (m_VertexBuffer) {
+        m_VertexBuffer->Release ();
+        m_VertexBuffer = NULL;
+    }
+    if (FAILED (m_Device->CreateVertexBuffer (size * sizeof (vs3d::TLVERTEX),
+                                              D3DUSAGE_WRITEONLY | D3DUSAGE_DYNAMIC, 0,
+                                              D3DPOOL_DEFAULT, &m_VertexBuffer, NULL))) {
+        m_VertexBufferSize = 0;
+        #ifdef _DEBUG
+        if (m_Log) {
+            m_Log->Log ("Error: CreateVertexBuffer failed. (TextRenderer::ReserveVertexBuffer)\n");
+        }
+        #endif
+        THROW_DETAILED_ERROR (ERRC_API_CALL, "CreateVertexBuffer() failure.");
+    }
+    m_VertexBufferSize = size;
+}
@@ -138,7 +138,7 @@ void VertexCache::Add (void* _vertex, UINT _numVertices,
     if (_index) {
         m_IsAddingWithoutIndices = false;
     }
-    AddVertices (_vertex, _numVertices);
+    AddVertices (_vertex, _numVertices, _index ? _numIndices : _numVertices);
     if (_index) {
         WORD* index = NULL;
         try {
@@ -156,14 +156,14 @@ void VertexCache::Add (void* _vertex, UINT _numVertices,
     m_IsEmpty = false;
 }
 
-void VertexCache::AddVertices (void* _vertex, UINT _numVertices) {
+void VertexCache::AddVertices (void* _vertex, UINT _numVertices, UINT _numIndices) {
     /*if (m_VertexFormat == FVF_UL2) {
         for (UINT i = 0; i < _numVertices; i++) {
             m_vcm->GetLog()->Log("%f %f %f\n", ((ULVERTEX2*)_Vertex)[i].x, ((ULVERTEX2*)_Vertex)[i].y, ((ULVERTEX2*)_Vertex)[i].z);
         }
     }*/
     bool m_IsFlushed = false;
-    if (m_NumVertices + _numVertices >= m_MaxVertices || m_NumIndices + _numVertices >= m_MaxIndices) {
+    if (m_NumVertices + _numVertices >= m_MaxVertices || m_NumIndices + _numIndices >= m_MaxIndices) {
         if (m_vcm->GetActiveSkinId() != m_SkinId) {
             m_vcm->SetSkin(m_SkinId);
         }
@@ -331,6 +331,10 @@ bool VertexCache::JoinStaticRendering (const StaticRendering& _staticRendering)
                         break;
                 }
                 if (m_StaticRendering[i].IndexBufferId != INVALID_ID) {
+                    // the joined indices are drawn from the same base vertex
+                    if (m_StaticRendering[i].BaseVertexIndex != _staticRendering.BaseVertexIndex) {
+                        continue;
+                    }
                     //m_vcm->GetLog()->Log("%u %u %u\n", primVertices, m_StaticRendering[i].StartIndex + m_StaticRendering[i].NumPrimitives * primVertices, _staticRendering.StartIndex);
                     if (m_StaticRendering[i].StartIndex + m_StaticRendering[i].NumPrimitives * primVertices == _staticRendering.StartIndex) {
                         m_StaticRendering[i].NumPrimitives += _staticRendering.NumPrimitives;
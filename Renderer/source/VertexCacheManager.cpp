@@ -82,18 +82,17 @@ VertexCacheManager::VertexCacheManager (LPDIRECT3DDEVICE9 _device,
     m_Skin (_skin),
     m_Log (_log),
     m_ActiveSkin (INVALID_ID),
+    m_IsDepthOnly (false),
     m_ActiveEffect (NULL) {
     try {
         m_VertexFormatCaches = new RenderCache*[NUM_VERTEX_FORMATS];
         for (UINT i = 0; i < NUM_VERTEX_FORMATS; i++) {
             m_VertexFormatCaches[i] = new RenderCache(this);
         }
+        m_Text = new TextRenderer (m_Device, m_Log);
     } catch (std::bad_alloc) {
         THROW_ERROR (ERRC_OUT_OF_MEM);
     }
-    m_Font = NULL;
-    strcpy (m_FontStyle, "Times New Roman");
-    m_FontSize = 16;
     CreateVertexDeclarations ();
 }
 
@@ -109,7 +108,7 @@ VertexCacheManager::~VertexCacheManager () {
     delete[] m_VertexFormatCaches;
     ClearStaticVertexBuffers ();
     ClearStaticIndexBuffers ();
-    delete m_Font;
+    delete m_Text;
 }
 
 UINT VertexCacheManager::CreateStaticVertexBuffer (void* _vertex, UINT _numVertices, VERTEXFORMATTYPE _vft) {
@@ -205,6 +204,30 @@ void VertexCacheManager::AddToStaticVertexBuffer (UINT _vertexBufferId, void* _v
     delete[] vertex;
 }
 
+void VertexCacheManager::UpdateStaticVertexBuffer (UINT _vertexBufferId, UINT _startVertex, void* _vertex, UINT _numVertices, VERTEXFORMATTYPE _vft) {
+    if (_vertexBufferId >= m_StaticVertexBuffers.size()) {
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    if (_startVertex + _numVertices > m_StaticVertexBuffers[_vertexBufferId].NumVertices) {
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    if (_numVertices == 0) {
+        return;
+    }
+    UINT vertexSize = GetVertexSize (_vft);
+    void* data;
+    if (FAILED (m_StaticVertexBuffers[_vertexBufferId].Buffer->Lock (_startVertex * vertexSize, _numVertices * vertexSize, &data, 0))) {
+        #ifdef _DEBUG
+        if (m_Log) {
+            m_Log->Log ("Error: Lock failed. (VertexCacheManager::UpdateStaticVertexBuffer)\n");
+        }
+        #endif
+        THROW_DETAILED_ERROR (ERRC_API_CALL, "Vertex buffer Lock() failure.");
+    }
+    memcpy (data, _vertex, _numVertices * vertexSize);
+    m_StaticVertexBuffers[_vertexBufferId].Buffer->Unlock ();
+}
+
 void VertexCacheManager::ClearStaticVertexBuffers () {
     for (UINT i = 0; i < m_StaticVertexBuffers.size(); i++) {
         m_StaticVertexBuffers[i].Buffer->Release ();
@@ -347,6 +370,9 @@ void VertexCacheManager::Render (PRIMITIVETYPE _type,
                                  UINT _indexBufferId, UINT _startIndex,
                                  UINT _numPrimitives,
                                  VERTEXFORMATTYPE _vft, UINT _skinId) {
+    if (m_IsDepthOnly) {
+        _skinId = INVALID_ID;
+    }
     m_VertexFormatCaches[(UINT)_vft]->Insert(_skinId, _type, _vft);
     VertexCache* vertexCache = m_VertexFormatCaches[(UINT)_vft]->GetVertexCache(_skinId, _type);//m_VertexFormatsTree->GetVertexCache(_vft);
 
@@ -364,6 +390,9 @@ void VertexCacheManager::Render (PRIMITIVETYPE _type,
                                  void* _vertex, UINT _numVertices,
                                  UINT _indexBufferId, UINT _startIndex,
                                  UINT _numPrimitives, VERTEXFORMATTYPE _vft, UINT _skinId) {
+    if (m_IsDepthOnly) {
+        _skinId = INVALID_ID;
+    }
     m_VertexFormatCaches[(UINT)_vft]->Insert(_skinId, _type, _vft);
     VertexCache* vertexCache = m_VertexFormatCaches[(UINT)_vft]->GetVertexCache(_skinId, _type);//m_VertexFormatsTree->GetVertexCache(_vft);
 
@@ -382,6 +411,9 @@ void VertexCacheManager::Render (PRIMITIVETYPE _type,
                                  UINT _vertexBufferId, UINT _startVertex,
                                  WORD* _index, UINT _numIndices,
                                  UINT _numPrimitives, VERTEXFORMATTYPE _vft, UINT _skinId) {
+    if (m_IsDepthOnly) {
+        _skinId = INVALID_ID;
+    }
     m_VertexFormatCaches[(UINT)_vft]->Insert(_skinId, _type, _vft);
     VertexCache* vertexCache = m_VertexFormatCaches[(UINT)_vft]->GetVertexCache(_skinId, _type);//m_VertexFormatsTree->GetVertexCache(_vft);
 
@@ -402,6 +434,9 @@ void VertexCacheManager::Render (PRIMITIVETYPE _type,
                                  void* _vertex, UINT _numVertices, 
                                  WORD* _index, UINT _numIndices, 
                                  VERTEXFORMATTYPE _vft, UINT _skinId) {
+    if (m_IsDepthOnly) {
+        _skinId = INVALID_ID;
+    }
     m_VertexFormatCaches[(UINT)_vft]->Insert(_skinId, _type, _vft);
     VertexCache* vertexCache = m_VertexFormatCaches[(UINT)_vft]->GetVertexCache(_skinId, _type);//m_VertexFormatsTree->GetVertexCache(_vft);
 
@@ -564,50 +599,27 @@ void VertexCacheManager::DisableEffects () {
 }
 
 void VertexCacheManager::SetTextSize (int _size) {
-    m_FontSize = _size;
-    delete m_Font;
-    m_Font = NULL;
+    m_Text->SetSize (_size);
 }
 
 void VertexCacheManager::SetTextStyle (const char* _style) {
-    strcpy (m_FontStyle, _style);
-    delete m_Font;
-    m_Font = NULL;
+    m_Text->SetStyle (_style);
 }
 
-TCHAR* GetWideStr (const char* _strC, TCHAR(& _str)[MAX_PATH]) {
-    int size = strlen (_strC) +  1;
-    if (MultiByteToWideChar(CP_ACP, 0, _strC, -1, _str, size) == 0) {
-        return NULL;
-    }
-    
-    return _str;
+void VertexCacheManager::RenderText (const char* _text, DWORD _color, float _x, float _y) {
+    m_Text->Add (_text, _color, _x, _y);
 }
 
-void VertexCacheManager::RenderText (const char* _text, DWORD _color, float _x, float _y) {
-    TCHAR wideStr[MAX_PATH];
-    if (!m_Font) {
-        try {
-            m_Font = new CD3DFont (GetWideStr(m_FontStyle, wideStr), m_FontSize, 0);
-        } catch (std::bad_alloc) {
-            THROW_ERROR (ERRC_OUT_OF_MEM);
-        }
-        if (FAILED (m_Font->InitDeviceObjects (m_Device))) {
-            THROW_DETAILED_ERROR (ERRC_API_CALL, "Font's InitDeviceObjects() failure.");
-        }
-        if (FAILED (m_Font->RestoreDeviceObjects ())) {
-            THROW_DETAILED_ERROR (ERRC_API_CALL, "Font's RestoreDeviceObjects() failure.");
-        }
-    }
-    
-    if (FAILED (m_Font->DrawTextW(_x, _y, _color, GetWideStr(_text, wideStr), 0))) {
-        #ifdef _DEBUG
-        if (m_Log) {
-            m_Log->Log ("Error: DrawText failed. (VertexCacheManager::RenderText)\n");
-        }
-        #endif
-        THROW_DETAILED_ERROR (ERRC_API_CALL, "Font's DrawText() failure.");;
-    }
+TEXTSTATISTICS VertexCacheManager::GetTextStatistics () const {
+    return m_Text->GetStatistics ();
+}
+
+void VertexCacheManager::FlushText () {
+    m_Text->Render ();
+}
+
+void VertexCacheManager::SetDepthOnly (bool _isDepthOnly) {
+    m_IsDepthOnly = _isDepthOnly;
 }
 
 void VertexCacheManager::SetSkin (UINT _skinId) {
@@ -325,6 +325,29 @@ HRESULT CD3DFont::DeleteDeviceObjects()
 
 
 
+//-----------------------------------------------------------------------------
+// Name: GetGlyph()
+// Desc: Get the atlas texture coordinates and the size of a character
+//-----------------------------------------------------------------------------
+BOOL CD3DFont::GetGlyph( TCHAR c, FLOAT* pTexCoords, FLOAT* pWidth, FLOAT* pHeight )
+{
+    if( (c-32) < 0 || (c-32) >= 128-32 )
+        return FALSE;
+
+    pTexCoords[0] = m_fTexCoords[c-32][0];
+    pTexCoords[1] = m_fTexCoords[c-32][1];
+    pTexCoords[2] = m_fTexCoords[c-32][2];
+    pTexCoords[3] = m_fTexCoords[c-32][3];
+
+    *pWidth  = (pTexCoords[2]-pTexCoords[0]) *  m_dwTexWidth / m_fTextScale;
+    *pHeight = (pTexCoords[3]-pTexCoords[1]) * m_dwTexHeight / m_fTextScale;
+
+    return TRUE;
+}
+
+
+
+
 //-----------------------------------------------------------------------------
 // Name: GetTextExtent()
 // Desc: Get the dimensions of a text string
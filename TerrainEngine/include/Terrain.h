@@ -14,10 +14,12 @@
     #pragma comment (lib, "lib/Debug/Log.lib")
     #pragma comment (lib, "lib/Debug/RendererLoader.lib")
     #pragma comment (lib, "lib/Debug/ErrorMessage.lib")
+    #pragma comment (lib, "lib/Debug/PackFile.lib")
 #else
     #pragma comment (lib, "lib/Log.lib")
     #pragma comment (lib, "lib/RendererLoader.lib")
     #pragma comment (lib, "lib/ErrorMessage.lib")
+    #pragma comment (lib, "lib/PackFile.lib")
 #endif
 
 /** Maximum number of the tiles. */
@@ -50,6 +52,8 @@ struct Patch {
     /*WORD* IndexData;
     UINT NumIndices;*/
     PatchBounds Bounds; /**< Bounds of the patch. */
+    float MinHeight;    /**< Lowest scaled height in the patch. */
+    float MaxHeight;    /**< Highest scaled height in the patch. */
 };
 
 /** Patch neighbor. */
@@ -244,6 +248,22 @@ public:
     inline UINT GetSize () const {
         return m_HeightmapSize;
     }
+
+    /** Getter: heightmap revision.
+    The revision changes whenever the heights or the scale change, 
+    so copies of the heightmap can tell when to refresh.
+    @return heightmap revision */
+    inline UINT GetHeightmapRevision () const {
+        return m_HeightmapRevision;
+    }
+
+    /** Copies scaled heights of the whole terrain.
+    @param[out] _heights GetSize() * GetSize() heights, row after row along z
+    @exception ErrorMessage
+    
+    - Possible error codes: 
+        - @c ERRC_NOT_READY heightmap is not loaded */
+    void GetScaledHeights (float* _heights) const;
     
     /** Enables terrain brute force rendering.
     @param[in] _enable brute force should be enabled */
@@ -512,12 +532,10 @@ protected:
         - @c ERRC_OUT_OF_RANGE */
     void InitPatchData (UINT _patchX, UINT _patchZ);
 
-    /** Checks if patch is in frustum.
-    @param[in] _x coordinate x
-    @param[in] _y coordinate y
-    @param[in] _z coordinate z
+    /** Checks if the bounding box of the patch is in frustum.
+    @param[in] _patch patch index
     @return @c true patch is in frustum. @c false otherwise */
-    bool IsPatchInFrustum (float _x, float _y, float _z);
+    bool IsPatchInFrustum (UINT _patch);
 
     /** Generates patch part bounds.
     @param[in] _x coordinate x
@@ -623,6 +641,7 @@ protected:
     UINT m_HeightmapSize;   /**< Size of the heightmap. */
     char m_HeightmapFile[MAX_PATH]; /**< Heightmap filename. */ 
     UCHAR* m_Heightmap;     /**< Heightmap data. */
+    UINT m_HeightmapRevision;   /**< Changes with every heightmap or scale modification. */
 
     // lightmap
     UINT m_LightmapSize;    /**< Lightmap size. */
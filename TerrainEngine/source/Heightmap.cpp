@@ -11,11 +11,13 @@ void Terrain::NewHeightmap (UINT _size) {
     }
     m_HeightmapSize = _size;
     memset (m_Heightmap, 128, sizeof (UCHAR) * _size * _size);
+    m_HeightmapRevision++;
 }
 
 void Terrain::LoadHeightmap (const char* _heightmapFile) {
     strcpy (m_HeightmapFile, _heightmapFile);
     LoadData (_heightmapFile, m_Heightmap, m_HeightmapSize);
+    m_HeightmapRevision++;
 }
 
 void Terrain::SaveHeightmap (const char* _heightmapFile) {
@@ -27,6 +29,7 @@ void Terrain::UnloadHeightmap () {
     m_HeightmapFile[0] = '\0';
     UnloadData (m_Heightmap, m_HeightmapSize);
     m_Scale[0] = m_Scale[1] = m_Scale[2] = 1.0f;
+    m_HeightmapRevision++;
 }
 
 float Terrain::GetScaledHeight (UINT _x, UINT _z) const {
@@ -41,6 +44,16 @@ float Terrain::GetScaledHeight (UINT _x, UINT _z) const {
     return m_Heightmap[_z * m_HeightmapSize + _x] * m_Scale[1];
 }
 
+void Terrain::GetScaledHeights (float* _heights) const {
+    if (!m_Heightmap) {
+        THROW_ERROR (ERRC_NOT_READY);
+    }
+    UINT numHeights = m_HeightmapSize * m_HeightmapSize;
+    for (UINT i = 0; i < numHeights; i++) {
+        _heights[i] = m_Heightmap[i] * m_Scale[1];
+    }
+}
+
 UCHAR Terrain::GetHeight (UINT _x, UINT _z) const {
     if (_x >= m_HeightmapSize || _z >= m_HeightmapSize) {
         #ifdef _DEBUG
@@ -63,6 +76,7 @@ void Terrain::SetHeight (UINT _x, UINT _z, UCHAR _height) {
         THROW_ERROR (ERRC_OUT_OF_RANGE);
     }
     m_Heightmap[_z * m_HeightmapSize + _x] = _height;
+    m_HeightmapRevision++;
 }
 
 void Terrain::SetScale (float _ScaleX, float _ScaleY, float _ScaleZ) {
@@ -72,4 +86,5 @@ void Terrain::SetScale (float _ScaleX, float _ScaleY, float _ScaleZ) {
     m_Scale[0] = _ScaleX;
     m_Scale[1] = _ScaleY;
     m_Scale[2] = _ScaleZ;
+    m_HeightmapRevision++;
 }
\ No newline at end of file
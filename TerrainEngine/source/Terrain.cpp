@@ -1,4 +1,5 @@
 #include "../include/Terrain.h"
+#include "../include/PackFile.h"
 
 using namespace vs3d;
 
@@ -6,6 +7,7 @@ Terrain::Terrain (LogManager* _log, RenderDevice* _device) {
     m_Scale[0] = m_Scale[1] = m_Scale[2] = 1.0f;
     m_HeightmapSize = 0;
     m_Heightmap = NULL;
+    m_HeightmapRevision = 0;
     m_Log = _log;
     m_Device = _device;
     m_NumTiles = 0;
@@ -27,6 +29,7 @@ Terrain::Terrain (RenderDevice* _device) {
     m_Scale[0] = m_Scale[1] = m_Scale[2] = 1.0f;
     m_HeightmapSize = 0;
     m_Heightmap = NULL;
+    m_HeightmapRevision = 0;
     m_Log = NULL;
     m_Device = _device;
     m_NumTiles = 0;
@@ -56,26 +59,19 @@ void Terrain::EnableLog (LogManager* _log) {
 }
 
 void Terrain::LoadData (const char* _filename, UCHAR*& _data, UINT& _size) {
-    FILE* dataFile = fopen (_filename, "rb");
-    if (!dataFile) {
+    // the heightmap is read from the archive or the loose file
+    VirtualFile dataFile;
+    try {
+        dataFile.Open (_filename);
+    } catch (ErrorMessage&) {
         #ifdef _DEBUG
         if (m_Log) {
             m_Log->Log ("Error: cannot open heightmap %s (Terrain::LoadData)\n", _filename);
         }
         #endif
-        THROW_ERROR (ERRC_FILE_NOT_FOUND);
+        throw;
     }
-    // find out the file size
-    if (fseek (dataFile, 0, SEEK_END)) {   // non zero value = error
-        #ifdef _DEBUG
-        if (m_Log) {
-            m_Log->Log ("Error: cannot seek to the end of the file %s (Terrain::LoadData)\n", _filename);
-        }
-        #endif
-        fclose (dataFile);
-        THROW_ERROR (ERRC_BAD_FILE);
-    }
-    DWORD fileSize = ftell (dataFile);
+    DWORD fileSize = dataFile.GetSize ();
     // check if file is valid
     float size = sqrt ((float) fileSize);
     if (size - ceil (size) != 0.0f) {
@@ -84,11 +80,8 @@ void Terrain::LoadData (const char* _filename, UCHAR*& _data, UINT& _size) {
             m_Log->Log ("File size is invalid. (Terrain::LoadData)\n");
         }
         #endif
-        fclose (dataFile);
         THROW_ERROR (ERRC_BAD_FILE);
     }
-    // go back to file begining
-    rewind (dataFile);
     // read data
     if (_data) {
         UnloadData (_data, _size);
@@ -98,19 +91,15 @@ void Terrain::LoadData (const char* _filename, UCHAR*& _data, UINT& _size) {
     } catch (std::bad_alloc) {
         THROW_ERROR (ERRC_OUT_OF_MEM);
     }
-    fread (_data, 1, fileSize, dataFile);
-    if (ferror (dataFile) || feof (dataFile)) {
+    if (dataFile.Read (_data, fileSize) != fileSize) {
         #ifdef _DEBUG
         if (m_Log) {
-            m_Log->Log ("Error: cannot read data from file %s (Terrain::LoadData)\n", _filename);
+            m_Log->Log ("Error: cannot read heightmap %s (Terrain::LoadData)\n", _filename);
         }
         #endif
-        delete[] _data;
-        _data = NULL;
-        fclose (dataFile);
+        UnloadData (_data, _size);
         THROW_ERROR (ERRC_BAD_FILE);
     }
-    fclose (dataFile);
     _size = (UINT) size;
 }
 
@@ -197,12 +186,19 @@ void Terrain::UpdateData () {
     for (UINT i = 0; i < m_PatchesPerSide; i++) {
         for (UINT j = 0; j < m_PatchesPerSide; j++) {
             UINT index = i * m_PatchesPerSide + j;
+            m_Patch[index].MinHeight = GetScaledHeight (j * (m_PatchSize - 1), i * (m_PatchSize - 1));
+            m_Patch[index].MaxHeight = m_Patch[index].MinHeight;
             for (UINT k = 0; k < m_PatchSize; k++) {
                 for (UINT l = 0; l < m_PatchSize; l++) {
                     UINT x = j * (m_PatchSize - 1) + l;
                     UINT z = i * (m_PatchSize - 1) + k;
                     DWORD color = GetColor (x, z);
                     float scaledHeight = GetScaledHeight (x, z);
+                    if (scaledHeight < m_Patch[index].MinHeight) {
+                        m_Patch[index].MinHeight = scaledHeight;
+                    } else if (scaledHeight > m_Patch[index].MaxHeight) {
+                        m_Patch[index].MaxHeight = scaledHeight;
+                    }
                     UINT vertIndex = k * m_PatchSize + l;
                     switch (m_VertexFormat) {
                         case VFT_UL:
@@ -256,12 +252,19 @@ void Terrain::InitPatchData (UINT _patchX, UINT _patchZ) {
     }
     /*m_Patch[index].IndexData = new WORD[m_PatchSize * m_PatchSize * 4];
     m_Patch[index].NumIndices = 0;*/
+    m_Patch[index].MinHeight = GetScaledHeight (_patchX * (m_PatchSize - 1), _patchZ * (m_PatchSize - 1));
+    m_Patch[index].MaxHeight = m_Patch[index].MinHeight;
     for (UINT i = 0; i < m_PatchSize; i++) {
         for (UINT j = 0; j < m_PatchSize; j++) {
             UINT x = _patchX * (m_PatchSize - 1) + j;
             UINT z = _patchZ * (m_PatchSize - 1) + i;
             DWORD color = GetColor (x, z);
             float scaledHeight = GetScaledHeight (x, z);
+            if (scaledHeight < m_Patch[index].MinHeight) {
+                m_Patch[index].MinHeight = scaledHeight;
+            } else if (scaledHeight > m_Patch[index].MaxHeight) {
+                m_Patch[index].MaxHeight = scaledHeight;
+            }
             float texU = (float)x / m_HeightmapSize;
             float texV = (float)z / m_HeightmapSize;
             UINT vertIndex = i * m_PatchSize + j;
@@ -655,10 +658,14 @@ void Terrain::Shutdown () {
     m_PatchSize = m_PatchesPerSide = m_MaxLod = 0;
 }
 
-bool Terrain::IsPatchInFrustum (float _x, float _y, float _z) {
+bool Terrain::IsPatchInFrustum (UINT _patch) {
+    /* box spans the patch and its actual height range */
     float sizeX = (m_PatchSize - 1) * m_Scale[0] / 2;
-    float sizeY = 128.0f * m_Scale[1];
+    float sizeY = (m_Patch[_patch].MaxHeight - m_Patch[_patch].MinHeight) / 2;
     float sizeZ = (m_PatchSize - 1) * m_Scale[2] / 2;
+    float x = m_Patch[_patch].Bounds.Min[0] + sizeX;
+    float y = m_Patch[_patch].MinHeight + sizeY;
+    float z = m_Patch[_patch].Bounds.Min[2] + sizeZ;
     // draw bounds
     /*ULCVERTEX* bound = new ULCVERTEX[8];
     WORD* index = new WORD[48];
@@ -756,21 +763,21 @@ bool Terrain::IsPatchInFrustum (float _x, float _y, float _z) {
     delete[] index;*/
 
     for(UINT i = 0; i < 6; i++) {
-        if(m_Frustum[i][0] * (_x - sizeX) + m_Frustum[i][1] * (_y - sizeY) + m_Frustum[i][2] * (_z - sizeZ) + m_Frustum[i][3] > 0)
+        if(m_Frustum[i][0] * (x - sizeX) + m_Frustum[i][1] * (y - sizeY) + m_Frustum[i][2] * (z - sizeZ) + m_Frustum[i][3] > 0)
             continue;
-        if(m_Frustum[i][0] * (_x + sizeX) + m_Frustum[i][1] * (_y - sizeY) + m_Frustum[i][2] * (_z - sizeZ) + m_Frustum[i][3] > 0)
+        if(m_Frustum[i][0] * (x + sizeX) + m_Frustum[i][1] * (y - sizeY) + m_Frustum[i][2] * (z - sizeZ) + m_Frustum[i][3] > 0)
             continue;
-        if(m_Frustum[i][0] * (_x - sizeX) + m_Frustum[i][1] * (_y + sizeY) + m_Frustum[i][2] * (_z - sizeZ) + m_Frustum[i][3] > 0)
+        if(m_Frustum[i][0] * (x - sizeX) + m_Frustum[i][1] * (y + sizeY) + m_Frustum[i][2] * (z - sizeZ) + m_Frustum[i][3] > 0)
             continue;
-        if(m_Frustum[i][0] * (_x + sizeX) + m_Frustum[i][1] * (_y + sizeY) + m_Frustum[i][2] * (_z - sizeZ) + m_Frustum[i][3] > 0)
+        if(m_Frustum[i][0] * (x + sizeX) + m_Frustum[i][1] * (y + sizeY) + m_Frustum[i][2] * (z - sizeZ) + m_Frustum[i][3] > 0)
             continue;
-        if(m_Frustum[i][0] * (_x - sizeX) + m_Frustum[i][1] * (_y - sizeY) + m_Frustum[i][2] * (_z + sizeZ) + m_Frustum[i][3] > 0)
+        if(m_Frustum[i][0] * (x - sizeX) + m_Frustum[i][1] * (y - sizeY) + m_Frustum[i][2] * (z + sizeZ) + m_Frustum[i][3] > 0)
             continue;
-        if(m_Frustum[i][0] * (_x + sizeX) + m_Frustum[i][1] * (_y - sizeY) + m_Frustum[i][2] * (_z + sizeZ) + m_Frustum[i][3] > 0)
+        if(m_Frustum[i][0] * (x + sizeX) + m_Frustum[i][1] * (y - sizeY) + m_Frustum[i][2] * (z + sizeZ) + m_Frustum[i][3] > 0)
             continue;
-        if(m_Frustum[i][0] * (_x - sizeX) + m_Frustum[i][1] * (_y + sizeY) + m_Frustum[i][2] * (_z + sizeZ) + m_Frustum[i][3] > 0)
+        if(m_Frustum[i][0] * (x - sizeX) + m_Frustum[i][1] * (y + sizeY) + m_Frustum[i][2] * (z + sizeZ) + m_Frustum[i][3] > 0)
             continue;
-        if(m_Frustum[i][0] * (_x + sizeX) + m_Frustum[i][1] * (_y + sizeY) + m_Frustum[i][2] * (_z + sizeZ) + m_Frustum[i][3] > 0)
+        if(m_Frustum[i][0] * (x + sizeX) + m_Frustum[i][1] * (y + sizeY) + m_Frustum[i][2] * (z + sizeZ) + m_Frustum[i][3] > 0)
             continue;
         return false;
     }
@@ -925,7 +932,7 @@ void Terrain::Update (VECTOR3 _cameraPos, MATRIX44 _view, MATRIX44 _proj) {
             float y = GetScaledHeight ((UINT)x, (UINT)z);
             x *= m_Scale[0];
             z *= m_Scale[2];
-            m_Patch[patchNum].IsCulled = !IsPatchInFrustum (x, y, z);
+            m_Patch[patchNum].IsCulled = !IsPatchInFrustum (patchNum);
             if (!m_Patch[patchNum].IsCulled) {
                 if (m_IsBruteForceEnabled) {
                     m_Patch[patchNum].Lod = 0;
@@ -18,8 +18,8 @@
  *
  */
 #include "../include/TgaImage.h"
+#include "../include/PackFile.h"
 #include <string>
-#include <fstream>
 
 typedef unsigned short ushort;
 typedef unsigned char uchar;
@@ -44,58 +44,55 @@ void TgaImage::copy (const TgaImage& _TgaImage) {
 void TgaImage::Load (string _Filename) {
     delete m_TgaHeader;
     delete[] m_ImageData;
+    m_TgaHeader = NULL;
+    m_ImageData = NULL;
     m_Error = false;
-    fstream input (_Filename.c_str (), ios::in | ios::binary);
-    if (!input.fail ()) {
-        m_TgaHeader = new (nothrow) TgaHeader;
-        if (m_TgaHeader == NULL) {
+    // the image is read from the archive or the loose file
+    VirtualFile input;
+    try {
+        input.Open (_Filename.c_str ());
+    } catch (ErrorMessage&) {
+        m_Error = true;
+        return;
+    }
+    m_TgaHeader = new (nothrow) TgaHeader;
+    if (m_TgaHeader == NULL) {
+        m_Error = true;
+    } else {
+        input.Read (&m_TgaHeader->IdLength, sizeof (char));
+        input.Read (&m_TgaHeader->ColorMapType, sizeof (char));
+        if (input.Read (&m_TgaHeader->ImageType, sizeof (char)) != sizeof (char)) {
+            m_Error = true;
+        // only supports uncompressed true-color images
+        } else if (m_TgaHeader->ImageType != 2) {
             m_Error = true;
         } else {
-            input.read ((char*)&m_TgaHeader->IdLength, sizeof (char));
-            input.read ((char*)&m_TgaHeader->ColorMapType, sizeof (char));
-            input.read ((char*)&m_TgaHeader->ImageType, sizeof (char));
-            // only supports uncompressed true-color images
-            if (m_TgaHeader->ImageType != 2) {
-                m_Error = true;
-            } else {
-                char* headerMember;
-                headerMember = (char*) &m_TgaHeader->ColorMapFirstEntry;
-                input.read (headerMember, sizeof (short));
-                headerMember = (char*) &m_TgaHeader->ColorMapLength;
-                input.read (headerMember, sizeof (short));
-                headerMember = (char*)&m_TgaHeader->ColorMapEntrySize;
-                input.read (headerMember, sizeof (char));
-                input.read ((char*)&m_TgaHeader->OriginX, sizeof (short));
-                input.read ((char*)&m_TgaHeader->OriginY, sizeof (short));
-                input.read ((char*)&m_TgaHeader->Width, sizeof (short));
-                input.read ((char*)&m_TgaHeader->Height, sizeof (short));
-                input.read ((char*)&m_TgaHeader->Depth, sizeof (char));
-                input.read ((char*)&m_TgaHeader->Descriptor, sizeof (char));
-                if (!input.fail () && !input.eof ()) {
-                    if (m_TgaHeader->Depth % 8 == 0 && m_TgaHeader->Depth <= 32) {
-                        int depthBytes = m_TgaHeader->Depth / 8;
-                        m_ImageSize = m_TgaHeader->Width * m_TgaHeader->Height;
-                        m_ImageSize *= depthBytes;
-                        m_ImageData = new (nothrow) uchar[m_ImageSize];
-                        if (m_ImageData == NULL) {
-                            m_Error = true;
-                        } else {                        
-                            input.read ((char*) m_ImageData, m_ImageSize);
-                            if (input.fail ()) {
-                                m_Error = true;
-                            }
-                        }
-                    } else {
+            input.Read (&m_TgaHeader->ColorMapFirstEntry, sizeof (short));
+            input.Read (&m_TgaHeader->ColorMapLength, sizeof (short));
+            input.Read (&m_TgaHeader->ColorMapEntrySize, sizeof (char));
+            input.Read (&m_TgaHeader->OriginX, sizeof (short));
+            input.Read (&m_TgaHeader->OriginY, sizeof (short));
+            input.Read (&m_TgaHeader->Width, sizeof (short));
+            input.Read (&m_TgaHeader->Height, sizeof (short));
+            input.Read (&m_TgaHeader->Depth, sizeof (char));
+            if (input.Read (&m_TgaHeader->Descriptor, sizeof (char)) == sizeof (char) && !input.IsEof ()) {
+                if (m_TgaHeader->Depth % 8 == 0 && m_TgaHeader->Depth <= 32) {
+                    int depthBytes = m_TgaHeader->Depth / 8;
+                    m_ImageSize = m_TgaHeader->Width * m_TgaHeader->Height;
+                    m_ImageSize *= depthBytes;
+                    m_ImageData = new (nothrow) uchar[m_ImageSize];
+                    if (m_ImageData == NULL) {
+                        m_Error = true;
+                    } else if (input.Read (m_ImageData, m_ImageSize) != (UINT)m_ImageSize) {
                         m_Error = true;
                     }
                 } else {
                     m_Error = true;
                 }
+            } else {
+                m_Error = true;
             }
         }
-        input.close ();
-    } else {
-        m_Error = true;
     }
 }
 
@@ -5,6 +5,12 @@
 #include "../include/Engine.h"
 #include "../include/ErrorMessage.h"
 
+/** Maximum number of the shadow map cascades. */
+#define MAX_SHADOW_CASCADES 4
+
+/** Extension of the cooked textures, it follows the name of the source file. */
+#define COOKED_TEXTURE_EXTENSION ".dds"
+
 /** Skin Manager interface. */
 class ISkinManager {
 public:
@@ -25,6 +31,20 @@ public:
     @return texture ID */
     virtual UINT AddTexture (const char* _filename) = 0;
 
+    /** Adds texture to the manager from the data of a texture file.
+    The file can be read on any thread, the texture is created on the calling one.
+    @param[in] _filename the name of the texture file, the texture is known by it
+    @param[in] _data the data of the file
+    @param[in] _size size of the data in bytes
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_OUT_OF_MEM not enough memory 
+        - @c ERRC_API_CALL D3DXCreateTextureFromFileInMemory failure
+
+    @return texture ID */
+    virtual UINT AddTexture (const char* _filename, const void* _data, UINT _size) = 0;
+
     /** Getter: pointer to IDirect3DTexture9 interface.
     @param[in] _id texture ID
     @exception ErrorMessage 
@@ -75,6 +95,48 @@ public:
     @param[in] _filename  texture filename
     @return @c true texture is loaded. @c false otherwise. */
     virtual bool IsTextureLoaded (const char* _filename) const = 0;
+
+    /** Checks if the texture file has a cooked version, AddTexture loads it instead.
+    The cooked texture is the file name followed by COOKED_TEXTURE_EXTENSION.
+    No texture of the manager is read, so it can be called on any thread.
+    @param[in] _filename texture filename
+    @return @c true if the cooked file is there */
+    virtual bool HasCookedTexture (const char* _filename) const = 0;
+
+    /** Getter: number of the textures.
+    @return number of the textures */
+    virtual UINT GetNumTextures () const = 0;
+
+    /** Checks if the texture was loaded from its cooked file.
+    @param[in] _id texture ID
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_OUT_OF_RANGE invalid ID
+
+    @return @c true if the texture is cooked */
+    virtual bool IsTextureCooked (UINT _id) const = 0;
+
+    /** Getter: video memory of all the levels of the texture.
+    @param[in] _id texture ID
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_OUT_OF_RANGE invalid ID
+
+    @return size in bytes */
+    virtual UINT GetTextureMemory (UINT _id) const = 0;
+
+    /** Loads a texture file as AddTexture does, but the texture is released at once.
+    @param[in] _filename texture filename
+    @param[in] _isCooked @c true loads the cooked file, @c false the source file
+    @param[out] _time seconds spent on the loading
+    @param[out] _memory video memory of the texture in bytes
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_API_CALL D3DXCreateTextureFromFile failure */
+    virtual void MeasureTextureLoad (const char* _filename, bool _isCooked, float& _time, UINT& _memory) = 0;
     
     /** Adds material to the skin manager.
     @param[in] _material material information
@@ -350,6 +412,15 @@ public:
     virtual void SetTexturePaintTransparency (float _transparency) = 0;
 };
 
+/** Text rendering statistics of one frame. */
+struct TEXTSTATISTICS {
+    UINT NumStrings;        /**< Number of the rendered strings. */
+    UINT NumGlyphs;         /**< Number of the rendered glyphs. */
+    UINT NumLayoutHits;     /**< Number of the strings whose layout was found in the cache. */
+    UINT NumLayoutMisses;   /**< Number of the strings which had to be laid out. */
+    UINT NumDrawCalls;      /**< Number of the draw calls used for the text. */
+};
+
 /** Vertex cache manager. */
 class IVertexCacheManager {
 public:
@@ -388,6 +459,21 @@ public:
         - @c ERRC_UNKNOWN_FVF invalid vertex format */
     virtual void AddToStaticVertexBuffer (UINT _vertexBufferId, void* _vertex, UINT _numVertices, VERTEXFORMATTYPE _vft) = 0;
 
+    /** Overwrites a range of vertices in the existing static vertex buffer.
+    The buffer is not resized, so the range must fit into it.
+    @param[in] _vertexBufferId static buffer ID
+    @param[in] _startVertex index of the first vertex to overwrite
+    @param[in] _vertex the vertices
+    @param[in] _numVertices number of the vertices
+    @param[in] _vft vertex format 
+    @exception ErrorMessage 
+    
+    - Possible error codes:
+        - @c ERRC_OUT_OF_RANGE vertex buffer ID or the vertex range is invalid
+        - @c ERRC_API_CALL
+        - @c ERRC_UNKNOWN_FVF invalid vertex format */
+    virtual void UpdateStaticVertexBuffer (UINT _vertexBufferId, UINT _startVertex, void* _vertex, UINT _numVertices, VERTEXFORMATTYPE _vft) = 0;
+
     /** Removes all the static vertex buffers. */
     virtual void ClearStaticVertexBuffers () = 0;
 
@@ -656,6 +742,8 @@ public:
     virtual void SetTextStyle (const char* _style) = 0;
 
     /** Renders text.
+    Text is queued and rendered on top of the scene with one draw call
+    when the rendering ends. Layouts of the repeated strings are cached.
     @param[in] _text text
     @param[in] _color color of the text
     @param[in] _x position of the text on the x axis
@@ -667,6 +755,11 @@ public:
         - @c ERRC_API_CALL */
     virtual void RenderText (const char* _text, DWORD _color, float _x, float _y) = 0;
 
+    /** Getter: text rendering statistics of the last rendered frame.
+    Layout cache hit rate is NumLayoutHits / (NumLayoutHits + NumLayoutMisses).
+    @return text statistics */
+    virtual TEXTSTATISTICS GetTextStatistics () const = 0;
+
     /** Forces all the data to be flushed to the GPU. 
     @exception ErrorMessage 
     
@@ -1018,6 +1111,42 @@ public:
     virtual void EndRenderingToShadowMap () = 0;
 
     virtual void SetShadowMap (UINT _effectId, const char* _shadowMapParamName) = 0;
+
+    /** Creates cascaded shadow maps. Cascades are expected to be rendered with
+    orthographic light matrices, so the stored depth is the projected depth.
+    @param[in] _numCascades number of the cascades, up to @c MAX_SHADOW_CASCADES
+    @param[in] _sizes size of every cascade
+    @exception ErrorMessage 
+
+    - Possible error codes:
+        - @c ERRC_INVALID_PARAMETER invalid number of the cascades
+        - @c ERRC_API_CALL */
+    virtual void CreateShadowCascades (UINT _numCascades, const UINT* _sizes) = 0;
+
+    /** Begins rendering to the shadow map cascade. Finish it with EndRenderingToShadowMap().
+    @param[in] _cascade cascade index
+    @param[in] _lightViewProj light view projection matrix of the cascade
+    @exception ErrorMessage 
+
+    - Possible error codes:
+        - @c ERRC_OUT_OF_RANGE cascade is not created
+        - @c ERRC_API_CALL */
+    virtual void BeginRenderingToShadowCascade (UINT _cascade, const MATRIX44& _lightViewProj) = 0;
+
+    /** Sets the shadow map cascade as an effect texture.
+    @param[in] _effectId effect ID
+    @param[in] _cascade cascade index
+    @param[in] _shadowMapParamName name of the texture parameter
+    @exception ErrorMessage 
+
+    - Possible error codes:
+        - @c ERRC_OUT_OF_RANGE cascade is not created
+        - @c ERRC_API_CALL */
+    virtual void SetShadowCascade (UINT _effectId, UINT _cascade, const char* _shadowMapParamName) = 0;
+
+    /** Getter: number of the created shadow map cascades.
+    @return number of the cascades */
+    virtual UINT GetNumShadowCascades () const = 0;
     
     /** Enables fog.
     @param[in] _start the distance where the fog will start
@@ -255,6 +255,20 @@ public:
     @return terrain size */
     virtual UINT GetSize () const = 0;
 
+    /** Getter: heightmap revision.
+    The revision changes whenever the heights or the scale change, 
+    so copies of the heightmap can tell when to refresh.
+    @return heightmap revision */
+    virtual UINT GetHeightmapRevision () const = 0;
+
+    /** Copies scaled heights of the whole terrain.
+    @param[out] _heights GetSize() * GetSize() heights, row after row along z
+    @exception ErrorMessage
+    
+    - Possible error codes: 
+        - @c ERRC_NOT_READY heightmap is not loaded */
+    virtual void GetScaledHeights (float* _heights) const = 0;
+
     /** Setter: height.
     @param[in] _x coordinate x of the terrain
     @param[in] _z coordinate z of the terrain
@@ -0,0 +1,40 @@
+/** @file DxtCompressor.h */
+#pragma once
+
+#define DXT1_BLOCK_SIZE 8   /**< Bytes of a DXT1 block of 4x4 texels. */
+#define DXT5_BLOCK_SIZE 16  /**< Bytes of a DXT5 block of 4x4 texels. */
+
+/** Block compression formats of the cooked textures. */
+enum DxtFormat {
+    DXT_FORMAT_DXT1,    /**< Opaque colors, 4 bits per texel. */
+    DXT_FORMAT_DXT5     /**< Colors and interpolated alpha, 8 bits per texel. */
+};
+
+/** Compresses blocks of 4x4 texels to DXT1 and DXT5.
+The end colors lie on the principal axis of the block colors,
+they are refined once by least squares over the chosen indices. */
+class DxtCompressor {
+public:
+    /** Compresses a block.
+    @param[in] _rgba 16 texels in 8-bit RGBA, row by row
+    @param[in] _format block format
+    @param[out] _block DXT1_BLOCK_SIZE or DXT5_BLOCK_SIZE bytes of the block */
+    static void CompressBlock (const unsigned char* _rgba, DxtFormat _format, unsigned char* _block);
+
+    /** Decompresses a block, the way the hardware does.
+    @param[in] _block the block
+    @param[in] _format block format
+    @param[out] _rgba 16 texels in 8-bit RGBA, row by row */
+    static void DecompressBlock (const unsigned char* _block, DxtFormat _format, unsigned char* _rgba);
+
+    /** Getter: bytes of a block.
+    @param[in] _format block format
+    @return DXT1_BLOCK_SIZE or DXT5_BLOCK_SIZE */
+    static unsigned int GetBlockSize (DxtFormat _format);
+
+private:
+    static void CompressColors (const unsigned char* _rgba, unsigned char* _block);
+    static void CompressAlpha (const unsigned char* _rgba, unsigned char* _block);
+    static void DecompressColors (const unsigned char* _block, bool _isDxt1, unsigned char* _rgba);
+    static void DecompressAlpha (const unsigned char* _block, unsigned char* _rgba);
+};
@@ -0,0 +1,37 @@
+/** @file ImageReader.h */
+#pragma once
+
+#include <vector>
+#include <string>
+
+/** Image in 8-bit RGBA. */
+struct Image {
+    unsigned int Width;                 /**< Width in pixels. */
+    unsigned int Height;                /**< Height in pixels. */
+    std::vector<unsigned char> Pixels;  /**< Red, green, blue and alpha of every pixel, row by row from the top. */
+};
+
+/** Reads the image files of the game: TGA, BMP, PNG and baseline JPEG.
+Nothing but the standard library is used, so the cooker builds on any platform. */
+class ImageReader {
+public:
+    /** Reads an image file, the format is chosen by the extension.
+    @param[in] _filename image file
+    @param[out] _image the decoded image
+    @exception std::runtime_error the file cannot be read or its format is not supported */
+    static void Read (const char* _filename, Image& _image);
+
+    /** Checks the extension of the file.
+    @param[in] _filename image file
+    @return @c true if the file can be read */
+    static bool IsSupported (const char* _filename);
+
+private:
+    static void ReadTga (const std::vector<unsigned char>& _data, Image& _image);
+    static void ReadBmp (const std::vector<unsigned char>& _data, Image& _image);
+    /* PngReader.cpp */
+    static void ReadPng (const std::vector<unsigned char>& _data, Image& _image);
+    /* JpegReader.cpp */
+    static void ReadJpeg (const std::vector<unsigned char>& _data, Image& _image);
+    static std::string GetExtension (const char* _filename);
+};
@@ -0,0 +1,64 @@
+/** @file TextureCooker.h */
+#pragma once
+
+#include "../include/ImageReader.h"
+#include "../include/DxtCompressor.h"
+
+/** Extension of the cooked texture, added to the name of the source file.
+The renderer's skin manager looks for the same name. */
+#define COOKED_TEXTURE_EXTENSION ".dds"
+
+/** What was cooked and how much it saves. */
+struct CookedTexture {
+    unsigned int SourceWidth;           /**< Width of the source image. */
+    unsigned int SourceHeight;          /**< Height of the source image. */
+    unsigned int Width;                 /**< Width of the cooked texture, a power of two. */
+    unsigned int Height;                /**< Height of the cooked texture, a power of two. */
+    unsigned int NumLevels;             /**< Number of the mipmap levels. */
+    DxtFormat Format;                   /**< Block format. */
+    unsigned int UncompressedMemory;    /**< Bytes of the 32-bit texture with all its levels, as D3DX makes it from the source. */
+    unsigned int CookedMemory;          /**< Bytes of the compressed levels. */
+    float RmsError;                     /**< Root mean square error of the top level against the resized source. */
+    float CookTime;                     /**< Seconds spent on the texture. */
+};
+
+/** Cooks the textures offline: block compressed DDS with all the mipmap levels.
+The texture is resized to powers of two as D3DXCreateTextureFromFile does,
+DXT1 is used for opaque images and DXT5 for the ones with alpha. */
+class TextureCooker {
+public:
+    /** Cooks a texture.
+    @param[in] _sourceFile the image file
+    @param[in] _cookedFile the DDS file to write
+    @param[out] _result the cooked texture
+    @exception std::runtime_error the source cannot be read or the DDS cannot be written */
+    static void Cook (const char* _sourceFile, const char* _cookedFile, CookedTexture& _result);
+
+    /** Resizes the image with a triangle filter, bilinear when it is enlarged.
+    @param[in] _source the image
+    @param[in] _width new width
+    @param[in] _height new height
+    @param[out] _target the resized image */
+    static void Resize (const Image& _source, unsigned int _width, unsigned int _height, Image& _target);
+
+    /** Makes the next mipmap level by averaging 2x2 texels.
+    @param[in] _source the level, larger than 1x1
+    @param[out] _target the next level */
+    static void MakeMipLevel (const Image& _source, Image& _target);
+
+    /** Compresses a level, the blocks over the edge repeat the last texels.
+    @param[in] _image the level
+    @param[in] _format block format
+    @param[out] _blocks the blocks are added at the end
+    @return squared error of all the texels */
+    static double CompressLevel (const Image& _image, DxtFormat _format, std::vector<unsigned char>& _blocks);
+
+    /** Getter: the smallest power of two which is not smaller than the value.
+    @param[in] _value the value
+    @return the power of two */
+    static unsigned int GetPowerOfTwo (unsigned int _value);
+
+private:
+    static void WriteDds (const char* _filename, unsigned int _width, unsigned int _height, unsigned int _numLevels,
+                          DxtFormat _format, const std::vector<unsigned char>& _blocks);
+};
@@ -0,0 +1,292 @@
+#include "../include/DxtCompressor.h"
+#include <cmath>
+
+static void Expand565 (unsigned int _color, int* _rgb) {
+    int red = (_color >> 11) & 31;
+    int green = (_color >> 5) & 63;
+    int blue = _color & 31;
+    _rgb[0] = (red << 3) | (red >> 2);
+    _rgb[1] = (green << 2) | (green >> 4);
+    _rgb[2] = (blue << 3) | (blue >> 2);
+}
+
+static unsigned int Quantize565 (const float* _rgb) {
+    static const float MAX_VALUE[3] = {31.0f, 63.0f, 31.0f};
+    unsigned int value[3];
+    for (unsigned int k = 0; k < 3; k++) {
+        float channel = _rgb[k] < 0.0f ? 0.0f : (_rgb[k] > 255.0f ? 255.0f : _rgb[k]);
+        value[k] = (unsigned int)floorf (channel * MAX_VALUE[k] / 255.0f + 0.5f);
+    }
+    return (value[0] << 11) | (value[1] << 5) | value[2];
+}
+
+/* The four colors of the block when the first end color is the greater one. */
+static void MakePalette (unsigned int _color0, unsigned int _color1, int (*_palette)[3]) {
+    Expand565 (_color0, _palette[0]);
+    Expand565 (_color1, _palette[1]);
+    for (unsigned int k = 0; k < 3; k++) {
+        _palette[2][k] = (2 * _palette[0][k] + _palette[1][k]) / 3;
+        _palette[3][k] = (_palette[0][k] + 2 * _palette[1][k]) / 3;
+    }
+}
+
+/* Chooses the closest palette color of every texel, returns the squared error of the block. */
+static unsigned int FitIndices (const unsigned char* _rgba, unsigned int _color0, unsigned int _color1, unsigned char* _indices) {
+    int palette[4][3];
+    MakePalette (_color0, _color1, palette);
+    unsigned int error = 0;
+    for (unsigned int i = 0; i < 16; i++) {
+        unsigned int bestError = 0xffffffff;
+        for (unsigned int j = 0; j < 4; j++) {
+            unsigned int distance = 0;
+            for (unsigned int k = 0; k < 3; k++) {
+                int difference = _rgba[i * 4 + k] - palette[j][k];
+                distance += difference * difference;
+            }
+            if (distance < bestError) {
+                bestError = distance;
+                _indices[i] = (unsigned char)j;
+            }
+        }
+        error += bestError;
+    }
+    return error;
+}
+
+/* End colors which fit the texels best for the chosen indices, by least squares. */
+static bool RefineEnds (const unsigned char* _rgba, const unsigned char* _indices, unsigned int& _color0, unsigned int& _color1) {
+    static const float WEIGHT[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float weight00 = 0.0f;
+    float weight01 = 0.0f;
+    float weight11 = 0.0f;
+    float sum0[3] = {0.0f, 0.0f, 0.0f};
+    float sum1[3] = {0.0f, 0.0f, 0.0f};
+    for (unsigned int i = 0; i < 16; i++) {
+        float weight0 = WEIGHT[_indices[i]];
+        float weight1 = 1.0f - weight0;
+        weight00 += weight0 * weight0;
+        weight01 += weight0 * weight1;
+        weight11 += weight1 * weight1;
+        for (unsigned int k = 0; k < 3; k++) {
+            sum0[k] += weight0 * _rgba[i * 4 + k];
+            sum1[k] += weight1 * _rgba[i * 4 + k];
+        }
+    }
+    float determinant = weight00 * weight11 - weight01 * weight01;
+    if (fabsf (determinant) < 1e-6f) {
+        return false;   // a single index, the ends cannot be told apart
+    }
+    float end0[3];
+    float end1[3];
+    for (unsigned int k = 0; k < 3; k++) {
+        end0[k] = (sum0[k] * weight11 - sum1[k] * weight01) / determinant;
+        end1[k] = (sum1[k] * weight00 - sum0[k] * weight01) / determinant;
+    }
+    _color0 = Quantize565 (end0);
+    _color1 = Quantize565 (end1);
+    return true;
+}
+
+void DxtCompressor::CompressBlock (const unsigned char* _rgba, DxtFormat _format, unsigned char* _block) {
+    if (_format == DXT_FORMAT_DXT5) {
+        CompressAlpha (_rgba, _block);
+        CompressColors (_rgba, _block + 8);
+    } else {
+        CompressColors (_rgba, _block);
+    }
+}
+
+void DxtCompressor::DecompressBlock (const unsigned char* _block, DxtFormat _format, unsigned char* _rgba) {
+    if (_format == DXT_FORMAT_DXT5) {
+        DecompressColors (_block + 8, false, _rgba);
+        DecompressAlpha (_block, _rgba);
+    } else {
+        DecompressColors (_block, true, _rgba);
+    }
+}
+
+unsigned int DxtCompressor::GetBlockSize (DxtFormat _format) {
+    return _format == DXT_FORMAT_DXT5 ? DXT5_BLOCK_SIZE : DXT1_BLOCK_SIZE;
+}
+
+void DxtCompressor::CompressColors (const unsigned char* _rgba, unsigned char* _block) {
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (unsigned int i = 0; i < 16; i++) {
+        for (unsigned int k = 0; k < 3; k++) {
+            mean[k] += _rgba[i * 4 + k] / 16.0f;
+        }
+    }
+    // covariance: rr, rg, rb, gg, gb, bb
+    float covariance[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    for (unsigned int i = 0; i < 16; i++) {
+        float r = _rgba[i * 4] - mean[0];
+        float g = _rgba[i * 4 + 1] - mean[1];
+        float b = _rgba[i * 4 + 2] - mean[2];
+        covariance[0] += r * r;
+        covariance[1] += r * g;
+        covariance[2] += r * b;
+        covariance[3] += g * g;
+        covariance[4] += g * b;
+        covariance[5] += b * b;
+    }
+    // the principal axis by power iteration
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (unsigned int iteration = 0; iteration < 8; iteration++) {
+        float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]};
+        float largest = fabsf (next[0]) > fabsf (next[1]) ? fabsf (next[0]) : fabsf (next[1]);
+        largest = fabsf (next[2]) > largest ? fabsf (next[2]) : largest;
+        if (largest < 1e-6f) {
+            break;      // a flat block keeps the last axis
+        }
+        for (unsigned int k = 0; k < 3; k++) {
+            axis[k] = next[k] / largest;
+        }
+    }
+    float length = sqrtf (axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    for (unsigned int k = 0; k < 3; k++) {
+        axis[k] /= length;
+    }
+    float minimum = 0.0f;
+    float maximum = 0.0f;
+    for (unsigned int i = 0; i < 16; i++) {
+        float projection = (_rgba[i * 4] - mean[0]) * axis[0] + (_rgba[i * 4 + 1] - mean[1]) * axis[1] +
+            (_rgba[i * 4 + 2] - mean[2]) * axis[2];
+        minimum = projection < minimum ? projection : minimum;
+        maximum = projection > maximum ? projection : maximum;
+    }
+    // the extremes are pulled in a little, the interpolated colors fit the rest better
+    float inset = (maximum - minimum) / 16.0f;
+    minimum += inset;
+    maximum -= inset;
+    float end0[3];
+    float end1[3];
+    for (unsigned int k = 0; k < 3; k++) {
+        end0[k] = mean[k] + axis[k] * maximum;
+        end1[k] = mean[k] + axis[k] * minimum;
+    }
+    unsigned int color0 = Quantize565 (end0);
+    unsigned int color1 = Quantize565 (end1);
+    unsigned char indices[16];
+    unsigned int error = FitIndices (_rgba, color0, color1, indices);
+    unsigned int refined0;
+    unsigned int refined1;
+    if (error > 0 && RefineEnds (_rgba, indices, refined0, refined1)) {
+        unsigned char refinedIndices[16];
+        if (FitIndices (_rgba, refined0, refined1, refinedIndices) < error) {
+            color0 = refined0;
+            color1 = refined1;
+            for (unsigned int i = 0; i < 16; i++) {
+                indices[i] = refinedIndices[i];
+            }
+        }
+    }
+    // the greater color goes first, otherwise DXT1 has three colors and transparent black
+    if (color0 < color1) {
+        static const unsigned char SWAPPED[4] = {1, 0, 3, 2};
+        unsigned int color = color0;
+        color0 = color1;
+        color1 = color;
+        for (unsigned int i = 0; i < 16; i++) {
+            indices[i] = SWAPPED[indices[i]];
+        }
+    } else if (color0 == color1) {
+        for (unsigned int i = 0; i < 16; i++) {
+            indices[i] = 0;
+        }
+    }
+    _block[0] = (unsigned char)(color0 & 0xff);
+    _block[1] = (unsigned char)(color0 >> 8);
+    _block[2] = (unsigned char)(color1 & 0xff);
+    _block[3] = (unsigned char)(color1 >> 8);
+    for (unsigned int row = 0; row < 4; row++) {
+        _block[4 + row] = (unsigned char)(indices[row * 4] | (indices[row * 4 + 1] << 2) |
+            (indices[row * 4 + 2] << 4) | (indices[row * 4 + 3] << 6));
+    }
+}
+
+void DxtCompressor::CompressAlpha (const unsigned char* _rgba, unsigned char* _block) {
+    int alpha0 = 0;
+    int alpha1 = 255;
+    for (unsigned int i = 0; i < 16; i++) {
+        alpha0 = _rgba[i * 4 + 3] > alpha0 ? _rgba[i * 4 + 3] : alpha0;
+        alpha1 = _rgba[i * 4 + 3] < alpha1 ? _rgba[i * 4 + 3] : alpha1;
+    }
+    // the greater alpha first gives six interpolated values
+    int palette[8];
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+    for (int i = 2; i < 8; i++) {
+        palette[i] = ((8 - i) * alpha0 + (i - 1) * alpha1) / 7;
+    }
+    unsigned long long bits = 0;
+    for (unsigned int i = 0; i < 16; i++) {
+        unsigned int best = 0;
+        if (alpha0 != alpha1) {
+            int bestError = 256;
+            for (unsigned int j = 0; j < 8; j++) {
+                int error = _rgba[i * 4 + 3] > palette[j] ? _rgba[i * 4 + 3] - palette[j] : palette[j] - _rgba[i * 4 + 3];
+                if (error < bestError) {
+                    bestError = error;
+                    best = j;
+                }
+            }
+        }
+        bits |= (unsigned long long)best << (i * 3);
+    }
+    _block[0] = (unsigned char)alpha0;
+    _block[1] = (unsigned char)alpha1;
+    for (unsigned int i = 0; i < 6; i++) {
+        _block[2 + i] = (unsigned char)(bits >> (i * 8));
+    }
+}
+
+void DxtCompressor::DecompressColors (const unsigned char* _block, bool _isDxt1, unsigned char* _rgba) {
+    unsigned int color0 = _block[0] | (_block[1] << 8);
+    unsigned int color1 = _block[2] | (_block[3] << 8);
+    int palette[4][3];
+    MakePalette (color0, color1, palette);
+    // only the compressor's four color blocks are expected, but the other mode is decoded too,
+    // the color block of DXT5 has four colors either way
+    bool isTransparent = false;
+    if (_isDxt1 && color0 <= color1) {
+        for (unsigned int k = 0; k < 3; k++) {
+            palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+            palette[3][k] = 0;
+        }
+        isTransparent = true;
+    }
+    for (unsigned int i = 0; i < 16; i++) {
+        unsigned int index = (_block[4 + i / 4] >> ((i % 4) * 2)) & 3;
+        for (unsigned int k = 0; k < 3; k++) {
+            _rgba[i * 4 + k] = (unsigned char)palette[index][k];
+        }
+        _rgba[i * 4 + 3] = (unsigned char)(isTransparent && index == 3 ? 0 : 255);
+    }
+}
+
+void DxtCompressor::DecompressAlpha (const unsigned char* _block, unsigned char* _rgba) {
+    int palette[8];
+    palette[0] = _block[0];
+    palette[1] = _block[1];
+    if (palette[0] > palette[1]) {
+        for (int i = 2; i < 8; i++) {
+            palette[i] = ((8 - i) * palette[0] + (i - 1) * palette[1]) / 7;
+        }
+    } else {
+        for (int i = 2; i < 6; i++) {
+            palette[i] = ((6 - i) * palette[0] + (i - 1) * palette[1]) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    unsigned long long bits = 0;
+    for (unsigned int i = 0; i < 6; i++) {
+        bits |= (unsigned long long)_block[2 + i] << (i * 8);
+    }
+    for (unsigned int i = 0; i < 16; i++) {
+        _rgba[i * 4 + 3] = (unsigned char)palette[(bits >> (i * 3)) & 7];
+    }
+}
@@ -0,0 +1,234 @@
+#include "../include/ImageReader.h"
+#include <cstdio>
+#include <cctype>
+#include <stdexcept>
+#include <algorithm>
+
+static unsigned int ReadLittle16 (const unsigned char* _data) {
+    return _data[0] | (_data[1] << 8);
+}
+
+static unsigned int ReadLittle32 (const unsigned char* _data) {
+    return _data[0] | (_data[1] << 8) | (_data[2] << 16) | ((unsigned int)_data[3] << 24);
+}
+
+void ImageReader::Read (const char* _filename, Image& _image) {
+    FILE* file = fopen (_filename, "rb");
+    if (!file) {
+        throw std::runtime_error (std::string (_filename) + ": cannot open the file");
+    }
+    std::vector<unsigned char> data;
+    unsigned char buffer[65536];
+    size_t size;
+    while ((size = fread (buffer, 1, sizeof (buffer), file)) > 0) {
+        data.insert (data.end (), buffer, buffer + size);
+    }
+    fclose (file);
+    std::string extension = GetExtension (_filename);
+    try {
+        if (extension == "tga") {
+            ReadTga (data, _image);
+        } else if (extension == "bmp") {
+            ReadBmp (data, _image);
+        } else if (extension == "png") {
+            ReadPng (data, _image);
+        } else if (extension == "jpg" || extension == "jpeg") {
+            ReadJpeg (data, _image);
+        } else {
+            throw std::runtime_error ("unknown image format");
+        }
+    } catch (std::runtime_error& e) {
+        throw std::runtime_error (std::string (_filename) + ": " + e.what ());
+    }
+}
+
+bool ImageReader::IsSupported (const char* _filename) {
+    std::string extension = GetExtension (_filename);
+    return extension == "tga" || extension == "bmp" || extension == "png" || extension == "jpg" || extension == "jpeg";
+}
+
+std::string ImageReader::GetExtension (const char* _filename) {
+    std::string name (_filename);
+    size_t dot = name.find_last_of ('.');
+    if (dot == std::string::npos || name.find_first_of ("/\\", dot) != std::string::npos) {
+        return "";
+    }
+    std::string extension = name.substr (dot + 1);
+    for (size_t i = 0; i < extension.size (); i++) {
+        extension[i] = (char)tolower ((unsigned char)extension[i]);
+    }
+    return extension;
+}
+
+/* Converts a TGA or BMP pixel of 8, 16, 24 or 32 bits, stored as BGR(A), to RGBA. */
+static void ConvertPixel (const unsigned char* _source, unsigned int _bits, bool _hasAlpha, unsigned char* _rgba) {
+    switch (_bits) {
+        case 8:
+            _rgba[0] = _rgba[1] = _rgba[2] = _source[0];
+            _rgba[3] = 255;
+            break;
+        case 15:
+        case 16: {
+            unsigned int value = ReadLittle16 (_source);
+            _rgba[0] = (unsigned char)(((value >> 10) & 31) * 255 / 31);
+            _rgba[1] = (unsigned char)(((value >> 5) & 31) * 255 / 31);
+            _rgba[2] = (unsigned char)((value & 31) * 255 / 31);
+            _rgba[3] = (_bits == 16 && _hasAlpha && !(value & 0x8000)) ? 0 : 255;
+            break;
+        }
+        default:
+            _rgba[0] = _source[2];
+            _rgba[1] = _source[1];
+            _rgba[2] = _source[0];
+            _rgba[3] = (_bits == 32 && _hasAlpha) ? _source[3] : 255;
+            break;
+    }
+}
+
+void ImageReader::ReadTga (const std::vector<unsigned char>& _data, Image& _image) {
+    if (_data.size () < 18) {
+        throw std::runtime_error ("truncated TGA header");
+    }
+    const unsigned char* header = &_data[0];
+    unsigned int idLength = header[0];
+    unsigned int colorMapType = header[1];
+    unsigned int imageType = header[2];
+    unsigned int colorMapStart = ReadLittle16 (header + 3);
+    unsigned int colorMapLength = ReadLittle16 (header + 5);
+    unsigned int colorMapBits = header[7];
+    _image.Width = ReadLittle16 (header + 12);
+    _image.Height = ReadLittle16 (header + 14);
+    unsigned int bits = header[16];
+    unsigned int descriptor = header[17];
+    bool isRle = imageType >= 9;
+    bool isMapped = imageType == 1 || imageType == 9;
+    if ((imageType & 7) < 1 || (imageType & 7) > 3 || (imageType > 3 && imageType < 9) || imageType > 11 ||
+        _image.Width == 0 || _image.Height == 0) {
+
+        throw std::runtime_error ("unsupported TGA type");
+    }
+    if (isMapped ? bits != 8 : (bits != 8 && bits != 15 && bits != 16 && bits != 24 && bits != 32)) {
+        throw std::runtime_error ("unsupported TGA pixel size");
+    }
+    bool hasAlpha = (descriptor & 15) > 0;
+    size_t offset = 18 + idLength;
+    // the color map is converted to RGBA once
+    std::vector<unsigned char> colorMap;
+    if (colorMapType == 1) {
+        unsigned int entrySize = (colorMapBits + 7) / 8;
+        if (offset + colorMapLength * entrySize > _data.size ()) {
+            throw std::runtime_error ("truncated TGA color map");
+        }
+        colorMap.resize (colorMapLength * 4);
+        for (unsigned int i = 0; i < colorMapLength; i++) {
+            ConvertPixel (&_data[offset + i * entrySize], colorMapBits, colorMapBits == 32 || hasAlpha, &colorMap[i * 4]);
+        }
+        offset += colorMapLength * entrySize;
+    } else if (isMapped) {
+        throw std::runtime_error ("TGA color map is missing");
+    }
+    unsigned int pixelSize = (bits + 7) / 8;
+    unsigned int numPixels = _image.Width * _image.Height;
+    std::vector<unsigned char> pixels (numPixels * pixelSize);
+    if (isRle) {
+        unsigned int pixel = 0;
+        while (pixel < numPixels) {
+            if (offset >= _data.size ()) {
+                throw std::runtime_error ("truncated TGA data");
+            }
+            unsigned int packet = _data[offset++];
+            unsigned int count = (packet & 0x7f) + 1;
+            if (pixel + count > numPixels) {
+                throw std::runtime_error ("corrupt TGA data");
+            }
+            unsigned int length = (packet & 0x80) ? pixelSize : count * pixelSize;
+            if (offset + length > _data.size ()) {
+                throw std::runtime_error ("truncated TGA data");
+            }
+            for (unsigned int i = 0; i < count; i++) {
+                const unsigned char* source = &_data[offset + ((packet & 0x80) ? 0 : i * pixelSize)];
+                std::copy (source, source + pixelSize, &pixels[(pixel + i) * pixelSize]);
+            }
+            offset += length;
+            pixel += count;
+        }
+    } else {
+        if (offset + pixels.size () > _data.size ()) {
+            throw std::runtime_error ("truncated TGA data");
+        }
+        std::copy (_data.begin () + offset, _data.begin () + offset + pixels.size (), pixels.begin ());
+    }
+    // the rows are stored from the bottom unless the descriptor says otherwise
+    bool isTopDown = (descriptor & 0x20) != 0;
+    bool isRightToLeft = (descriptor & 0x10) != 0;
+    _image.Pixels.resize (numPixels * 4);
+    for (unsigned int y = 0; y < _image.Height; y++) {
+        unsigned int row = isTopDown ? y : _image.Height - 1 - y;
+        for (unsigned int x = 0; x < _image.Width; x++) {
+            unsigned int column = isRightToLeft ? _image.Width - 1 - x : x;
+            const unsigned char* source = &pixels[(row * _image.Width + column) * pixelSize];
+            unsigned char* target = &_image.Pixels[(y * _image.Width + x) * 4];
+            if (isMapped) {
+                unsigned int index = source[0] - colorMapStart;
+                if (source[0] < colorMapStart || index >= colorMapLength) {
+                    throw std::runtime_error ("TGA color index out of the map");
+                }
+                std::copy (&colorMap[index * 4], &colorMap[index * 4] + 4, target);
+            } else {
+                ConvertPixel (source, bits, hasAlpha, target);
+            }
+        }
+    }
+}
+
+void ImageReader::ReadBmp (const std::vector<unsigned char>& _data, Image& _image) {
+    if (_data.size () < 54 || _data[0] != 'B' || _data[1] != 'M') {
+        throw std::runtime_error ("not a BMP file");
+    }
+    unsigned int dataOffset = ReadLittle32 (&_data[10]);
+    unsigned int headerSize = ReadLittle32 (&_data[14]);
+    int width = (int)ReadLittle32 (&_data[18]);
+    int height = (int)ReadLittle32 (&_data[22]);
+    unsigned int bits = ReadLittle16 (&_data[28]);
+    unsigned int compression = ReadLittle32 (&_data[30]);
+    unsigned int numColors = ReadLittle32 (&_data[46]);
+    // bit fields are accepted only in the usual BGR(A) order
+    if (headerSize < 40 || width <= 0 || height == 0 || (compression != 0 && compression != 3) ||
+        (bits != 8 && bits != 24 && bits != 32)) {
+
+        throw std::runtime_error ("unsupported BMP format");
+    }
+    bool isTopDown = height < 0;
+    _image.Width = width;
+    _image.Height = isTopDown ? -height : height;
+    std::vector<unsigned char> palette (256 * 4, 255);
+    if (bits == 8) {
+        numColors = numColors == 0 || numColors > 256 ? 256 : numColors;
+        size_t paletteOffset = 14 + headerSize;
+        if (paletteOffset + numColors * 4 > _data.size ()) {
+            throw std::runtime_error ("truncated BMP palette");
+        }
+        for (unsigned int i = 0; i < numColors; i++) {
+            palette[i * 4] = _data[paletteOffset + i * 4 + 2];
+            palette[i * 4 + 1] = _data[paletteOffset + i * 4 + 1];
+            palette[i * 4 + 2] = _data[paletteOffset + i * 4];
+        }
+    }
+    unsigned int pitch = (_image.Width * bits / 8 + 3) & ~3u;
+    if (dataOffset + (size_t)pitch * _image.Height > _data.size ()) {
+        throw std::runtime_error ("truncated BMP data");
+    }
+    _image.Pixels.resize (_image.Width * _image.Height * 4);
+    for (unsigned int y = 0; y < _image.Height; y++) {
+        const unsigned char* row = &_data[dataOffset + (size_t)pitch * (isTopDown ? y : _image.Height - 1 - y)];
+        for (unsigned int x = 0; x < _image.Width; x++) {
+            unsigned char* target = &_image.Pixels[(y * _image.Width + x) * 4];
+            if (bits == 8) {
+                std::copy (&palette[row[x] * 4], &palette[row[x] * 4] + 4, target);
+            } else {
+                // the alpha of 32-bit bitmaps is rarely meant as alpha
+                ConvertPixel (row + x * bits / 8, 24, false, target);
+            }
+        }
+    }
+}
@@ -0,0 +1,409 @@
+#include "../include/ImageReader.h"
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+
+#define JPEG_MAX_COMPONENTS 3
+
+static const unsigned char ZIGZAG[64] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+/* Huffman table of JPEG, decoded by the largest code of every length. */
+struct JpegHuffman {
+    int MaxCode[18];
+    int ValueOffset[17];
+    unsigned char Value[256];
+    bool IsDefined;
+};
+
+struct JpegComponent {
+    unsigned int Id;
+    unsigned int H;
+    unsigned int V;
+    unsigned int QuantTable;
+    unsigned int DcTable;
+    unsigned int AcTable;
+    int DcPrediction;
+    unsigned int PlaneWidth;    /* in samples, whole MCUs */
+    unsigned int PlaneHeight;
+    std::vector<unsigned char> Plane;
+};
+
+/* Reads the entropy coded data, the stuffed zero after 0xff is dropped and
+   a marker ends the data, only zeros are read after it. */
+class JpegBitStream {
+public:
+    JpegBitStream (const std::vector<unsigned char>& _data, size_t _offset): m_Data (_data), m_Offset (_offset), m_Bits (0), m_NumBits (0) {}
+
+    unsigned int Read (unsigned int _numBits) {
+        while (m_NumBits < _numBits) {
+            unsigned int byte = 0;
+            if (m_Offset < m_Data.size ()) {
+                byte = m_Data[m_Offset];
+                if (byte == 0xff) {
+                    unsigned int next = m_Offset + 1 < m_Data.size () ? m_Data[m_Offset + 1] : 0;
+                    if (next == 0) {
+                        m_Offset += 2;
+                    } else {
+                        byte = 0;   /* a marker, stay in front of it */
+                    }
+                } else {
+                    m_Offset++;
+                }
+            }
+            m_Bits = (m_Bits << 8) | byte;
+            m_NumBits += 8;
+        }
+        m_NumBits -= _numBits;
+        return (m_Bits >> m_NumBits) & ((1u << _numBits) - 1);
+    }
+
+    /* skips to the restart marker after the interval */
+    void Restart () {
+        m_NumBits = 0;
+        while (m_Offset + 1 < m_Data.size () && !(m_Data[m_Offset] == 0xff && m_Data[m_Offset + 1] >= 0xd0 && m_Data[m_Offset + 1] <= 0xd7)) {
+            m_Offset++;
+        }
+        m_Offset += 2;
+    }
+
+    /* the offset of the marker after the scan */
+    size_t GetEnd () {
+        while (m_Offset + 1 < m_Data.size () && !(m_Data[m_Offset] == 0xff && m_Data[m_Offset + 1] != 0 &&
+               (m_Data[m_Offset + 1] < 0xd0 || m_Data[m_Offset + 1] > 0xd7))) {
+            m_Offset++;
+        }
+        return m_Offset;
+    }
+
+private:
+    const std::vector<unsigned char>& m_Data;
+    size_t m_Offset;
+    unsigned int m_Bits;
+    unsigned int m_NumBits;
+};
+
+static void BuildHuffman (const unsigned char* _counts, const unsigned char* _values, unsigned int _numValues, JpegHuffman& _table) {
+    memcpy (_table.Value, _values, _numValues);
+    int code = 0;
+    int index = 0;
+    for (unsigned int length = 1; length <= 16; length++) {
+        _table.ValueOffset[length] = index - code;
+        code += _counts[length - 1];
+        index += _counts[length - 1];
+        _table.MaxCode[length] = _counts[length - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+    _table.MaxCode[17] = 0x7fffffff;
+    _table.IsDefined = true;
+}
+
+static unsigned int DecodeHuffman (JpegBitStream& _stream, const JpegHuffman& _table) {
+    int code = 0;
+    for (unsigned int length = 1; length <= 16; length++) {
+        code = (code << 1) | _stream.Read (1);
+        if (code <= _table.MaxCode[length]) {
+            return _table.Value[_table.ValueOffset[length] + code];
+        }
+    }
+    throw std::runtime_error ("invalid JPEG Huffman code");
+}
+
+/* The value of _size bits, the ones with a leading zero are negative. */
+static int Extend (unsigned int _value, unsigned int _size) {
+    if (_size == 0) {
+        return 0;
+    }
+    return _value < (1u << (_size - 1)) ? (int)_value - (1 << _size) + 1 : (int)_value;
+}
+
+static float s_IdctTable[8][8];
+
+static void InitIdct () {
+    static bool isInitialized = false;
+    if (isInitialized) {
+        return;
+    }
+    const float PI = 3.14159265358979f;
+    for (unsigned int u = 0; u < 8; u++) {
+        for (unsigned int x = 0; x < 8; x++) {
+            s_IdctTable[u][x] = (u == 0 ? sqrtf (0.5f) : 1.0f) * 0.5f * cosf ((2 * x + 1) * u * PI / 16.0f);
+        }
+    }
+    isInitialized = true;
+}
+
+/* Inverse DCT of the dequantized coefficients in row order, the samples are written to the plane. */
+static void Idct (const float* _coefficients, unsigned char* _target, unsigned int _pitch) {
+    float rows[64];
+    for (unsigned int v = 0; v < 8; v++) {
+        for (unsigned int x = 0; x < 8; x++) {
+            float sum = 0.0f;
+            for (unsigned int u = 0; u < 8; u++) {
+                sum += s_IdctTable[u][x] * _coefficients[v * 8 + u];
+            }
+            rows[v * 8 + x] = sum;
+        }
+    }
+    for (unsigned int y = 0; y < 8; y++) {
+        for (unsigned int x = 0; x < 8; x++) {
+            float sum = 128.0f;
+            for (unsigned int v = 0; v < 8; v++) {
+                sum += s_IdctTable[v][y] * rows[v * 8 + x];
+            }
+            int sample = (int)floorf (sum + 0.5f);
+            _target[y * _pitch + x] = (unsigned char)(sample < 0 ? 0 : (sample > 255 ? 255 : sample));
+        }
+    }
+}
+
+static void DecodeBlock (JpegBitStream& _stream, JpegComponent& _component, const JpegHuffman* _dcTables, const JpegHuffman* _acTables,
+                         const unsigned short (*_quantTables)[64], unsigned char* _target) {
+    const JpegHuffman& dcTable = _dcTables[_component.DcTable];
+    const JpegHuffman& acTable = _acTables[_component.AcTable];
+    if (!dcTable.IsDefined || !acTable.IsDefined) {
+        throw std::runtime_error ("JPEG Huffman table is missing");
+    }
+    const unsigned short* quant = _quantTables[_component.QuantTable];
+    float coefficients[64];
+    memset (coefficients, 0, sizeof (coefficients));
+    unsigned int size = DecodeHuffman (_stream, dcTable);
+    if (size > 11) {
+        throw std::runtime_error ("invalid JPEG DC coefficient");
+    }
+    _component.DcPrediction += Extend (_stream.Read (size), size);
+    coefficients[0] = (float)(_component.DcPrediction * quant[0]);
+    for (unsigned int k = 1; k < 64; k++) {
+        unsigned int symbol = DecodeHuffman (_stream, acTable);
+        unsigned int run = symbol >> 4;
+        size = symbol & 15;
+        if (size == 0) {
+            if (run != 15) {
+                break;      // end of block
+            }
+            k += 15;
+            continue;
+        }
+        k += run;
+        if (k > 63) {
+            throw std::runtime_error ("invalid JPEG AC coefficient");
+        }
+        coefficients[ZIGZAG[k]] = (float)(Extend (_stream.Read (size), size) * quant[k]);
+    }
+    Idct (coefficients, _target, _component.PlaneWidth);
+}
+
+void ImageReader::ReadJpeg (const std::vector<unsigned char>& _data, Image& _image) {
+    if (_data.size () < 4 || _data[0] != 0xff || _data[1] != 0xd8) {
+        throw std::runtime_error ("not a JPEG file");
+    }
+    InitIdct ();
+    unsigned short quantTables[4][64];
+    JpegHuffman dcTables[4];
+    JpegHuffman acTables[4];
+    for (unsigned int i = 0; i < 4; i++) {
+        dcTables[i].IsDefined = false;
+        acTables[i].IsDefined = false;
+    }
+    JpegComponent components[JPEG_MAX_COMPONENTS];
+    unsigned int numComponents = 0;
+    unsigned int maxH = 1;
+    unsigned int maxV = 1;
+    unsigned int numMcusX = 0;
+    unsigned int numMcusY = 0;
+    unsigned int restartInterval = 0;
+    bool isFrameRead = false;
+    size_t offset = 2;
+    while (true) {
+        // markers may be padded with 0xff
+        while (offset < _data.size () && _data[offset] == 0xff && offset + 1 < _data.size () && _data[offset + 1] == 0xff) {
+            offset++;
+        }
+        if (offset + 2 > _data.size () || _data[offset] != 0xff) {
+            throw std::runtime_error ("truncated JPEG file");
+        }
+        unsigned int marker = _data[offset + 1];
+        if (marker == 0xd9) {
+            break;
+        }
+        if (offset + 4 > _data.size ()) {
+            throw std::runtime_error ("truncated JPEG file");
+        }
+        unsigned int length = (_data[offset + 2] << 8) | _data[offset + 3];
+        if (length < 2 || offset + 2 + length > _data.size ()) {
+            throw std::runtime_error ("truncated JPEG segment");
+        }
+        const unsigned char* segment = &_data[offset + 4];
+        const unsigned char* end = segment + length - 2;
+        offset += 2 + length;
+        if (marker == 0xdb) {
+            while (segment < end) {
+                unsigned int precision = segment[0] >> 4;
+                unsigned int id = segment[0] & 3;
+                segment++;
+                for (unsigned int k = 0; k < 64; k++) {
+                    quantTables[id][k] = precision ? (unsigned short)((segment[k * 2] << 8) | segment[k * 2 + 1]) : segment[k];
+                }
+                segment += precision ? 128 : 64;
+            }
+        } else if (marker == 0xc4) {
+            while (segment + 17 <= end) {
+                unsigned int tableClass = segment[0] >> 4;
+                unsigned int id = segment[0] & 3;
+                unsigned int numValues = 0;
+                for (unsigned int i = 0; i < 16; i++) {
+                    numValues += segment[1 + i];
+                }
+                if (numValues > 256 || segment + 17 + numValues > end) {
+                    throw std::runtime_error ("invalid JPEG Huffman table");
+                }
+                BuildHuffman (segment + 1, segment + 17, numValues, tableClass == 0 ? dcTables[id] : acTables[id]);
+                segment += 17 + numValues;
+            }
+        } else if (marker == 0xdd) {
+            restartInterval = (segment[0] << 8) | segment[1];
+        } else if (marker == 0xc0 || marker == 0xc1) {
+            if (segment[0] != 8) {
+                throw std::runtime_error ("only 8-bit JPEG is supported");
+            }
+            _image.Height = (segment[1] << 8) | segment[2];
+            _image.Width = (segment[3] << 8) | segment[4];
+            numComponents = segment[5];
+            if ((numComponents != 1 && numComponents != 3) || _image.Width == 0 || _image.Height == 0) {
+                throw std::runtime_error ("unsupported JPEG frame");
+            }
+            for (unsigned int i = 0; i < numComponents; i++) {
+                components[i].Id = segment[6 + i * 3];
+                components[i].H = segment[7 + i * 3] >> 4;
+                components[i].V = segment[7 + i * 3] & 15;
+                components[i].QuantTable = segment[8 + i * 3] & 3;
+                if (components[i].H < 1 || components[i].H > 4 || components[i].V < 1 || components[i].V > 4) {
+                    throw std::runtime_error ("invalid JPEG sampling factor");
+                }
+                maxH = components[i].H > maxH ? components[i].H : maxH;
+                maxV = components[i].V > maxV ? components[i].V : maxV;
+            }
+            numMcusX = (_image.Width + maxH * 8 - 1) / (maxH * 8);
+            numMcusY = (_image.Height + maxV * 8 - 1) / (maxV * 8);
+            for (unsigned int i = 0; i < numComponents; i++) {
+                components[i].PlaneWidth = numMcusX * components[i].H * 8;
+                components[i].PlaneHeight = numMcusY * components[i].V * 8;
+                components[i].Plane.assign ((size_t)components[i].PlaneWidth * components[i].PlaneHeight, 0);
+            }
+            isFrameRead = true;
+        } else if (marker >= 0xc2 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc) {
+            throw std::runtime_error ("progressive, lossless and arithmetic JPEG are not supported");
+        } else if (marker == 0xda) {
+            if (!isFrameRead) {
+                throw std::runtime_error ("JPEG scan before the frame");
+            }
+            unsigned int numScanComponents = segment[0];
+            JpegComponent* scan[JPEG_MAX_COMPONENTS];
+            if (numScanComponents < 1 || numScanComponents > numComponents) {
+                throw std::runtime_error ("invalid JPEG scan");
+            }
+            for (unsigned int i = 0; i < numScanComponents; i++) {
+                scan[i] = NULL;
+                for (unsigned int c = 0; c < numComponents; c++) {
+                    if (components[c].Id == segment[1 + i * 2]) {
+                        scan[i] = &components[c];
+                    }
+                }
+                if (!scan[i]) {
+                    throw std::runtime_error ("unknown JPEG scan component");
+                }
+                scan[i]->DcTable = segment[2 + i * 2] >> 4 & 3;
+                scan[i]->AcTable = segment[2 + i * 2] & 3;
+                scan[i]->DcPrediction = 0;
+            }
+            JpegBitStream stream (_data, offset);
+            // a single component is not interleaved, its blocks cover only the image
+            unsigned int numUnitsX = numMcusX;
+            unsigned int numUnitsY = numMcusY;
+            if (numScanComponents == 1) {
+                numUnitsX = ((_image.Width * scan[0]->H + maxH - 1) / maxH + 7) / 8;
+                numUnitsY = ((_image.Height * scan[0]->V + maxV - 1) / maxV + 7) / 8;
+            }
+            unsigned int numUnits = 0;
+            for (unsigned int unitY = 0; unitY < numUnitsY; unitY++) {
+                for (unsigned int unitX = 0; unitX < numUnitsX; unitX++) {
+                    if (restartInterval > 0 && numUnits > 0 && numUnits % restartInterval == 0) {
+                        stream.Restart ();
+                        for (unsigned int i = 0; i < numScanComponents; i++) {
+                            scan[i]->DcPrediction = 0;
+                        }
+                    }
+                    numUnits++;
+                    if (numScanComponents == 1) {
+                        JpegComponent& component = *scan[0];
+                        DecodeBlock (stream, component, dcTables, acTables, quantTables,
+                            &component.Plane[((size_t)unitY * component.PlaneWidth + unitX) * 8]);
+                        continue;
+                    }
+                    for (unsigned int i = 0; i < numScanComponents; i++) {
+                        JpegComponent& component = *scan[i];
+                        for (unsigned int v = 0; v < component.V; v++) {
+                            for (unsigned int h = 0; h < component.H; h++) {
+                                size_t x = (unitX * component.H + h) * 8;
+                                size_t y = (unitY * component.V + v) * 8;
+                                DecodeBlock (stream, component, dcTables, acTables, quantTables,
+                                    &component.Plane[y * component.PlaneWidth + x]);
+                            }
+                        }
+                    }
+                }
+            }
+            offset = stream.GetEnd ();
+        }
+    }
+    if (!isFrameRead) {
+        throw std::runtime_error ("JPEG frame is missing");
+    }
+    // the subsampled components are interpolated between the centers of their samples
+    _image.Pixels.resize ((size_t)_image.Width * _image.Height * 4);
+    for (unsigned int y = 0; y < _image.Height; y++) {
+        for (unsigned int x = 0; x < _image.Width; x++) {
+            float sample[JPEG_MAX_COMPONENTS];
+            for (unsigned int c = 0; c < numComponents; c++) {
+                const JpegComponent& component = components[c];
+                if (component.H == maxH && component.V == maxV) {
+                    sample[c] = component.Plane[(size_t)y * component.PlaneWidth + x];
+                    continue;
+                }
+                unsigned int width = (_image.Width * component.H + maxH - 1) / maxH;
+                unsigned int height = (_image.Height * component.V + maxV - 1) / maxV;
+                float u = (x + 0.5f) * component.H / maxH - 0.5f;
+                float v = (y + 0.5f) * component.V / maxV - 0.5f;
+                u = u < 0.0f ? 0.0f : (u > width - 1.0f ? width - 1.0f : u);
+                v = v < 0.0f ? 0.0f : (v > height - 1.0f ? height - 1.0f : v);
+                unsigned int left = (unsigned int)u;
+                unsigned int top = (unsigned int)v;
+                unsigned int right = left + 1 < width ? left + 1 : left;
+                unsigned int bottom = top + 1 < height ? top + 1 : top;
+                const unsigned char* upper = &component.Plane[(size_t)top * component.PlaneWidth];
+                const unsigned char* lower = &component.Plane[(size_t)bottom * component.PlaneWidth];
+                float blendX = u - left;
+                float blendY = v - top;
+                sample[c] = (upper[left] * (1.0f - blendX) + upper[right] * blendX) * (1.0f - blendY) +
+                    (lower[left] * (1.0f - blendX) + lower[right] * blendX) * blendY;
+            }
+            unsigned char* target = &_image.Pixels[((size_t)y * _image.Width + x) * 4];
+            if (numComponents == 1) {
+                target[0] = target[1] = target[2] = (unsigned char)sample[0];
+            } else {
+                float rgb[3] = {
+                    sample[0] + 1.402f * (sample[2] - 128.0f),
+                    sample[0] - 0.344136f * (sample[1] - 128.0f) - 0.714136f * (sample[2] - 128.0f),
+                    sample[0] + 1.772f * (sample[1] - 128.0f)};
+                for (unsigned int k = 0; k < 3; k++) {
+                    int value = (int)floorf (rgb[k] + 0.5f);
+                    target[k] = (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+                }
+            }
+            target[3] = 255;
+        }
+    }
+}
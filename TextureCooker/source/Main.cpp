@@ -0,0 +1,176 @@
+#include "../include/TextureCooker.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dirent.h>
+#endif
+
+/* Cooks the textures of the game into block compressed DDS files, each one
+   next to its source, the name followed by COOKED_TEXTURE_EXTENSION.
+
+   TextureCooker [-force] [-report <file>] [-exclude <image file>]... <image file or directory>...
+
+   The directories are searched for TGA, BMP, PNG and JPEG files. A texture
+   is cooked again only when its source is newer, unless -force is given.
+   An excluded file is skipped, given by its path or its end, e.g. the
+   textures read as data must stay lossless, the game data is cooked with
+   -exclude data/terrain_texture/BuildingField.jpg
+   Every cooked texture is listed with its memory before and after, the
+   list is also written to the report file.
+
+   Only the standard library is used, so the cooker builds with the solution
+   on Windows and anywhere else, e.g. in TextureCooker/source:
+   g++ -O2 -o TextureCooker *.cpp */
+
+static bool IsDirectory (const std::string& _path) {
+    struct stat info;
+    return stat (_path.c_str (), &info) == 0 && (info.st_mode & S_IFDIR) != 0;
+}
+
+/* true if the cooked file is there and not older than the source */
+static bool IsUpToDate (const std::string& _source, const std::string& _cooked) {
+    struct stat sourceInfo;
+    struct stat cookedInfo;
+    return stat (_source.c_str (), &sourceInfo) == 0 && stat (_cooked.c_str (), &cookedInfo) == 0 &&
+        cookedInfo.st_mtime >= sourceInfo.st_mtime;
+}
+
+static void FindImages (const std::string& _directory, std::vector<std::string>& _files) {
+    std::vector<std::string> names;
+    #ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA ((_directory + "/*").c_str (), &data);
+    if (find != INVALID_HANDLE_VALUE) {
+        do {
+            names.push_back (data.cFileName);
+        } while (FindNextFileA (find, &data));
+        FindClose (find);
+    }
+    #else
+    DIR* directory = opendir (_directory.c_str ());
+    if (directory) {
+        while (dirent* entry = readdir (directory)) {
+            names.push_back (entry->d_name);
+        }
+        closedir (directory);
+    }
+    #endif
+    std::sort (names.begin (), names.end ());
+    for (size_t i = 0; i < names.size (); i++) {
+        if (names[i] == "." || names[i] == "..") {
+            continue;
+        }
+        std::string path = _directory + "/" + names[i];
+        if (IsDirectory (path)) {
+            FindImages (path, _files);
+        } else if (ImageReader::IsSupported (path.c_str ())) {
+            _files.push_back (path);
+        }
+    }
+}
+
+/* true if the path is an excluded file or ends with one, either slash separates */
+static bool IsExcluded (std::string _path, const std::vector<std::string>& _excluded) {
+    std::replace (_path.begin (), _path.end (), '\\', '/');
+    for (size_t i = 0; i < _excluded.size (); i++) {
+        std::string excluded = _excluded[i];
+        std::replace (excluded.begin (), excluded.end (), '\\', '/');
+        if (_path == excluded || (_path.size () > excluded.size () &&
+            _path.compare (_path.size () - excluded.size () - 1, std::string::npos, "/" + excluded) == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* prints to the console and to the report */
+static void Print (FILE* _report, const char* _line) {
+    fputs (_line, stdout);
+    if (_report) {
+        fputs (_line, _report);
+    }
+}
+
+int main (int _argc, char** _argv) {
+    bool isForced = false;
+    FILE* report = NULL;
+    std::vector<std::string> files;
+    std::vector<std::string> excluded;
+    for (int i = 1; i < _argc; i++) {
+        if (strcmp (_argv[i], "-force") == 0) {
+            isForced = true;
+        } else if (strcmp (_argv[i], "-report") == 0 && i + 1 < _argc) {
+            report = fopen (_argv[++i], "w");
+            if (!report) {
+                fprintf (stderr, "%s: cannot create the report\n", _argv[i]);
+                return 1;
+            }
+        } else if (strcmp (_argv[i], "-exclude") == 0 && i + 1 < _argc) {
+            excluded.push_back (_argv[++i]);
+        } else if (IsDirectory (_argv[i])) {
+            FindImages (_argv[i], files);
+        } else {
+            files.push_back (_argv[i]);
+        }
+    }
+    // the files are filtered once all the exclusions are known
+    std::vector<std::string> included;
+    for (size_t i = 0; i < files.size (); i++) {
+        if (!IsExcluded (files[i], excluded)) {
+            included.push_back (files[i]);
+        }
+    }
+    files.swap (included);
+    if (files.empty ()) {
+        fprintf (stderr, "usage: TextureCooker [-force] [-report <file>] [-exclude <image file>]... <image file or directory>...\n");
+        return 1;
+    }
+    CookedTexture total;
+    memset (&total, 0, sizeof (total));
+    unsigned int numCooked = 0;
+    unsigned int numFailed = 0;
+    char line[1024];
+    for (size_t i = 0; i < files.size (); i++) {
+        std::string cookedFile = files[i] + COOKED_TEXTURE_EXTENSION;
+        if (!isForced && IsUpToDate (files[i], cookedFile)) {
+            snprintf (line, sizeof (line), "%s up to date\n", files[i].c_str ());
+            Print (report, line);
+            continue;
+        }
+        try {
+            CookedTexture texture;
+            TextureCooker::Cook (files[i].c_str (), cookedFile.c_str (), texture);
+            snprintf (line, sizeof (line), "%s %ux%u -> %ux%u %s levels %u memory %u -> %u bytes saved %.1f%% rms %.2f cook %.1f ms\n",
+                files[i].c_str (), texture.SourceWidth, texture.SourceHeight, texture.Width, texture.Height,
+                texture.Format == DXT_FORMAT_DXT5 ? "DXT5" : "DXT1", texture.NumLevels,
+                texture.UncompressedMemory, texture.CookedMemory,
+                100.0f * (1.0f - (float)texture.CookedMemory / texture.UncompressedMemory),
+                texture.RmsError, texture.CookTime * 1000.0f);
+            Print (report, line);
+            total.UncompressedMemory += texture.UncompressedMemory;
+            total.CookedMemory += texture.CookedMemory;
+            total.CookTime += texture.CookTime;
+            numCooked++;
+        } catch (std::exception& e) {
+            fprintf (stderr, "%s\n", e.what ());
+            numFailed++;
+        }
+    }
+    if (numCooked > 0) {
+        snprintf (line, sizeof (line), "total %u textures memory %u -> %u bytes saved %.1f%% cook %.2f s\n", numCooked,
+            total.UncompressedMemory, total.CookedMemory,
+            100.0f * (1.0f - (float)total.CookedMemory / total.UncompressedMemory), total.CookTime);
+        Print (report, line);
+    }
+    if (report) {
+        fclose (report);
+    }
+    return numFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,351 @@
+#include "../include/ImageReader.h"
+#include <stdexcept>
+#include <cstring>
+
+/* Reads the bits of a deflate stream, least significant bit first. */
+class BitStream {
+public:
+    BitStream (const unsigned char* _data, size_t _size): m_Data (_data), m_Size (_size), m_Offset (0), m_Bits (0), m_NumBits (0) {}
+
+    unsigned int Read (unsigned int _numBits) {
+        while (m_NumBits < _numBits) {
+            if (m_Offset >= m_Size) {
+                throw std::runtime_error ("truncated deflate stream");
+            }
+            m_Bits |= (unsigned int)m_Data[m_Offset++] << m_NumBits;
+            m_NumBits += 8;
+        }
+        unsigned int value = m_Bits & ((1u << _numBits) - 1);
+        m_Bits >>= _numBits;
+        m_NumBits -= _numBits;
+        return value;
+    }
+
+    /* the stored blocks start at a byte */
+    void AlignToByte () {
+        m_Bits = 0;
+        m_NumBits = 0;
+    }
+
+    const unsigned char* ReadBytes (size_t _size) {
+        if (m_Offset + _size > m_Size) {
+            throw std::runtime_error ("truncated deflate stream");
+        }
+        m_Offset += _size;
+        return m_Data + m_Offset - _size;
+    }
+
+private:
+    const unsigned char* m_Data;
+    size_t m_Size;
+    size_t m_Offset;
+    unsigned int m_Bits;
+    unsigned int m_NumBits;
+};
+
+/* Canonical Huffman code of deflate, decoded a bit at a time by the number
+   of codes of every length. */
+struct Huffman {
+    unsigned short Count[16];
+    unsigned short Symbol[288];
+
+    void Build (const unsigned char* _lengths, unsigned int _numSymbols) {
+        memset (Count, 0, sizeof (Count));
+        for (unsigned int i = 0; i < _numSymbols; i++) {
+            Count[_lengths[i]]++;
+        }
+        Count[0] = 0;
+        unsigned short offset[16];
+        offset[1] = 0;
+        for (unsigned int i = 1; i < 15; i++) {
+            offset[i + 1] = offset[i] + Count[i];
+        }
+        for (unsigned int i = 0; i < _numSymbols; i++) {
+            if (_lengths[i] != 0) {
+                Symbol[offset[_lengths[i]]++] = (unsigned short)i;
+            }
+        }
+    }
+
+    unsigned int Decode (BitStream& _stream) const {
+        int code = 0;
+        int first = 0;
+        int index = 0;
+        for (unsigned int length = 1; length < 16; length++) {
+            code |= _stream.Read (1);
+            int count = Count[length];
+            if (code - first < count) {
+                return Symbol[index + code - first];
+            }
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        throw std::runtime_error ("invalid Huffman code");
+    }
+};
+
+static const unsigned short LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned short LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const unsigned short DISTANCE_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned short DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static void InflateBlock (BitStream& _stream, const Huffman& _lengths, const Huffman& _distances, std::vector<unsigned char>& _output) {
+    while (true) {
+        unsigned int symbol = _lengths.Decode (_stream);
+        if (symbol < 256) {
+            _output.push_back ((unsigned char)symbol);
+        } else if (symbol == 256) {
+            return;
+        } else {
+            symbol -= 257;
+            if (symbol >= 29) {
+                throw std::runtime_error ("invalid deflate length");
+            }
+            unsigned int length = LENGTH_BASE[symbol] + _stream.Read (LENGTH_EXTRA[symbol]);
+            unsigned int code = _distances.Decode (_stream);
+            if (code >= 30) {
+                throw std::runtime_error ("invalid deflate distance");
+            }
+            unsigned int distance = DISTANCE_BASE[code] + _stream.Read (DISTANCE_EXTRA[code]);
+            if (distance > _output.size ()) {
+                throw std::runtime_error ("deflate distance too far back");
+            }
+            // the copy may overlap its own output
+            size_t from = _output.size () - distance;
+            for (unsigned int i = 0; i < length; i++) {
+                _output.push_back (_output[from + i]);
+            }
+        }
+    }
+}
+
+/* Decompresses a zlib stream. */
+static void Inflate (const unsigned char* _data, size_t _size, std::vector<unsigned char>& _output) {
+    if (_size < 2 || (_data[0] & 15) != 8 || ((_data[0] << 8) | _data[1]) % 31 != 0 || (_data[1] & 0x20)) {
+        throw std::runtime_error ("invalid zlib header");
+    }
+    BitStream stream (_data + 2, _size - 2);
+    bool isLast = false;
+    while (!isLast) {
+        isLast = stream.Read (1) == 1;
+        unsigned int type = stream.Read (2);
+        if (type == 0) {
+            stream.AlignToByte ();
+            const unsigned char* header = stream.ReadBytes (4);
+            unsigned int length = header[0] | (header[1] << 8);
+            if ((length ^ 0xffff) != (unsigned int)(header[2] | (header[3] << 8))) {
+                throw std::runtime_error ("corrupt stored deflate block");
+            }
+            const unsigned char* bytes = stream.ReadBytes (length);
+            _output.insert (_output.end (), bytes, bytes + length);
+        } else if (type == 1) {
+            unsigned char lengths[288 + 30];
+            memset (lengths, 8, 144);
+            memset (lengths + 144, 9, 112);
+            memset (lengths + 256, 7, 24);
+            memset (lengths + 280, 8, 8);
+            memset (lengths + 288, 5, 30);
+            Huffman lengthCode;
+            Huffman distanceCode;
+            lengthCode.Build (lengths, 288);
+            distanceCode.Build (lengths + 288, 30);
+            InflateBlock (stream, lengthCode, distanceCode, _output);
+        } else if (type == 2) {
+            unsigned int numLengths = stream.Read (5) + 257;
+            unsigned int numDistances = stream.Read (5) + 1;
+            unsigned int numCodeLengths = stream.Read (4) + 4;
+            static const unsigned char ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+            unsigned char codeLengths[19];
+            memset (codeLengths, 0, sizeof (codeLengths));
+            for (unsigned int i = 0; i < numCodeLengths; i++) {
+                codeLengths[ORDER[i]] = (unsigned char)stream.Read (3);
+            }
+            Huffman codeLengthCode;
+            codeLengthCode.Build (codeLengths, 19);
+            unsigned char lengths[288 + 32];
+            unsigned int numRead = 0;
+            while (numRead < numLengths + numDistances) {
+                unsigned int symbol = codeLengthCode.Decode (stream);
+                unsigned int repeat = 1;
+                unsigned char value = (unsigned char)symbol;
+                if (symbol == 16) {
+                    if (numRead == 0) {
+                        throw std::runtime_error ("nothing to repeat in deflate code lengths");
+                    }
+                    value = lengths[numRead - 1];
+                    repeat = 3 + stream.Read (2);
+                } else if (symbol == 17) {
+                    value = 0;
+                    repeat = 3 + stream.Read (3);
+                } else if (symbol == 18) {
+                    value = 0;
+                    repeat = 11 + stream.Read (7);
+                }
+                if (numRead + repeat > numLengths + numDistances) {
+                    throw std::runtime_error ("too many deflate code lengths");
+                }
+                memset (lengths + numRead, value, repeat);
+                numRead += repeat;
+            }
+            Huffman lengthCode;
+            Huffman distanceCode;
+            lengthCode.Build (lengths, numLengths);
+            distanceCode.Build (lengths + numLengths, numDistances);
+            InflateBlock (stream, lengthCode, distanceCode, _output);
+        } else {
+            throw std::runtime_error ("invalid deflate block type");
+        }
+    }
+}
+
+static unsigned int ReadBig32 (const unsigned char* _data) {
+    return ((unsigned int)_data[0] << 24) | (_data[1] << 16) | (_data[2] << 8) | _data[3];
+}
+
+static int Paeth (int _left, int _up, int _upLeft) {
+    int estimate = _left + _up - _upLeft;
+    int toLeft = estimate > _left ? estimate - _left : _left - estimate;
+    int toUp = estimate > _up ? estimate - _up : _up - estimate;
+    int toUpLeft = estimate > _upLeft ? estimate - _upLeft : _upLeft - estimate;
+    if (toLeft <= toUp && toLeft <= toUpLeft) {
+        return _left;
+    }
+    return toUp <= toUpLeft ? _up : _upLeft;
+}
+
+void ImageReader::ReadPng (const std::vector<unsigned char>& _data, Image& _image) {
+    static const unsigned char SIGNATURE[8] = {137, 'P', 'N', 'G', 13, 10, 26, 10};
+    if (_data.size () < 8 || memcmp (&_data[0], SIGNATURE, 8) != 0) {
+        throw std::runtime_error ("not a PNG file");
+    }
+    unsigned int bitDepth = 0;
+    unsigned int colorType = 0;
+    std::vector<unsigned char> compressed;
+    std::vector<unsigned char> palette (256 * 4, 255);
+    bool isHeaderRead = false;
+    size_t offset = 8;
+    while (offset + 12 <= _data.size ()) {
+        unsigned int length = ReadBig32 (&_data[offset]);
+        const unsigned char* type = &_data[offset + 4];
+        const unsigned char* chunk = &_data[offset + 8];
+        if (offset + 12 + (size_t)length > _data.size ()) {
+            throw std::runtime_error ("truncated PNG chunk");
+        }
+        if (memcmp (type, "IHDR", 4) == 0 && length >= 13) {
+            _image.Width = ReadBig32 (chunk);
+            _image.Height = ReadBig32 (chunk + 4);
+            bitDepth = chunk[8];
+            colorType = chunk[9];
+            if (chunk[12] != 0) {
+                throw std::runtime_error ("interlaced PNG is not supported");
+            }
+            isHeaderRead = true;
+        } else if (memcmp (type, "PLTE", 4) == 0) {
+            for (unsigned int i = 0; i < length / 3 && i < 256; i++) {
+                palette[i * 4] = chunk[i * 3];
+                palette[i * 4 + 1] = chunk[i * 3 + 1];
+                palette[i * 4 + 2] = chunk[i * 3 + 2];
+            }
+        } else if (memcmp (type, "tRNS", 4) == 0 && colorType == 3) {
+            for (unsigned int i = 0; i < length && i < 256; i++) {
+                palette[i * 4 + 3] = chunk[i];
+            }
+        } else if (memcmp (type, "IDAT", 4) == 0) {
+            compressed.insert (compressed.end (), chunk, chunk + length);
+        } else if (memcmp (type, "IEND", 4) == 0) {
+            break;
+        }
+        offset += 12 + length;
+    }
+    unsigned int numChannels;
+    switch (colorType) {
+        case 0: numChannels = 1; break;
+        case 2: numChannels = 3; break;
+        case 3: numChannels = 1; break;
+        case 4: numChannels = 2; break;
+        case 6: numChannels = 4; break;
+        default: numChannels = 0; break;
+    }
+    bool isDepthValid = bitDepth == 8 || (bitDepth == 16 && colorType != 3) ||
+        ((bitDepth == 1 || bitDepth == 2 || bitDepth == 4) && (colorType == 0 || colorType == 3));
+    if (!isHeaderRead || numChannels == 0 || !isDepthValid || _image.Width == 0 || _image.Height == 0) {
+        throw std::runtime_error ("unsupported PNG format");
+    }
+    std::vector<unsigned char> filtered;
+    filtered.reserve (_image.Height * (1 + (_image.Width * numChannels * bitDepth + 7) / 8));
+    Inflate (compressed.empty () ? NULL : &compressed[0], compressed.size (), filtered);
+    // the filters work on bytes, a pixel is at least one byte away
+    unsigned int pitch = (_image.Width * numChannels * bitDepth + 7) / 8;
+    unsigned int step = (numChannels * bitDepth + 7) / 8;
+    if (filtered.size () < (size_t)(pitch + 1) * _image.Height) {
+        throw std::runtime_error ("truncated PNG data");
+    }
+    std::vector<unsigned char> rows ((size_t)pitch * _image.Height);
+    for (unsigned int y = 0; y < _image.Height; y++) {
+        unsigned int filter = filtered[(size_t)y * (pitch + 1)];
+        const unsigned char* source = &filtered[(size_t)y * (pitch + 1) + 1];
+        unsigned char* row = &rows[(size_t)y * pitch];
+        const unsigned char* previous = y > 0 ? row - pitch : NULL;
+        for (unsigned int x = 0; x < pitch; x++) {
+            int left = x >= step ? row[x - step] : 0;
+            int up = previous ? previous[x] : 0;
+            int upLeft = previous && x >= step ? previous[x - step] : 0;
+            int predicted;
+            switch (filter) {
+                case 0: predicted = 0; break;
+                case 1: predicted = left; break;
+                case 2: predicted = up; break;
+                case 3: predicted = (left + up) / 2; break;
+                case 4: predicted = Paeth (left, up, upLeft); break;
+                default: throw std::runtime_error ("invalid PNG filter");
+            }
+            row[x] = (unsigned char)(source[x] + predicted);
+        }
+    }
+    _image.Pixels.resize ((size_t)_image.Width * _image.Height * 4);
+    for (unsigned int y = 0; y < _image.Height; y++) {
+        const unsigned char* row = &rows[(size_t)y * pitch];
+        for (unsigned int x = 0; x < _image.Width; x++) {
+            unsigned char* target = &_image.Pixels[((size_t)y * _image.Width + x) * 4];
+            // the high byte of a 16-bit sample is enough
+            unsigned char sample[4];
+            if (bitDepth < 8) {
+                unsigned int bit = x * bitDepth;
+                unsigned int value = (row[bit / 8] >> (8 - bitDepth - bit % 8)) & ((1 << bitDepth) - 1);
+                sample[0] = (unsigned char)(colorType == 3 ? value : value * 255 / ((1 << bitDepth) - 1));
+            } else {
+                for (unsigned int c = 0; c < numChannels; c++) {
+                    sample[c] = row[(x * numChannels + c) * (bitDepth / 8)];
+                }
+            }
+            switch (colorType) {
+                case 0:
+                    target[0] = target[1] = target[2] = sample[0];
+                    target[3] = 255;
+                    break;
+                case 2:
+                    target[0] = sample[0];
+                    target[1] = sample[1];
+                    target[2] = sample[2];
+                    target[3] = 255;
+                    break;
+                case 3:
+                    memcpy (target, &palette[sample[0] * 4], 4);
+                    break;
+                case 4:
+                    target[0] = target[1] = target[2] = sample[0];
+                    target[3] = sample[1];
+                    break;
+                default:
+                    memcpy (target, sample, 4);
+                    break;
+            }
+        }
+    }
+}
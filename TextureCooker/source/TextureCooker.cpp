@@ -0,0 +1,225 @@
+#include "../include/TextureCooker.h"
+#include <cstdio>
+#include <cmath>
+#include <ctime>
+#include <stdexcept>
+
+/* DDS header flags */
+#define DDSD_CAPS 0x1
+#define DDSD_HEIGHT 0x2
+#define DDSD_WIDTH 0x4
+#define DDSD_PIXELFORMAT 0x1000
+#define DDSD_MIPMAPCOUNT 0x20000
+#define DDSD_LINEARSIZE 0x80000
+#define DDPF_FOURCC 0x4
+#define DDSCAPS_COMPLEX 0x8
+#define DDSCAPS_TEXTURE 0x1000
+#define DDSCAPS_MIPMAP 0x400000
+
+void TextureCooker::Cook (const char* _sourceFile, const char* _cookedFile, CookedTexture& _result) {
+    clock_t start = clock ();
+    Image source;
+    ImageReader::Read (_sourceFile, source);
+    bool hasAlpha = false;
+    for (size_t i = 3; i < source.Pixels.size () && !hasAlpha; i += 4) {
+        hasAlpha = source.Pixels[i] != 255;
+    }
+    _result.SourceWidth = source.Width;
+    _result.SourceHeight = source.Height;
+    _result.Width = GetPowerOfTwo (source.Width);
+    _result.Height = GetPowerOfTwo (source.Height);
+    _result.Format = hasAlpha ? DXT_FORMAT_DXT5 : DXT_FORMAT_DXT1;
+    _result.NumLevels = 0;
+    _result.UncompressedMemory = 0;
+    Image level;
+    if (_result.Width != source.Width || _result.Height != source.Height) {
+        Resize (source, _result.Width, _result.Height, level);
+    } else {
+        level.Width = source.Width;
+        level.Height = source.Height;
+        level.Pixels.swap (source.Pixels);
+    }
+    std::vector<unsigned char> blocks;
+    double error = 0.0;
+    while (true) {
+        double levelError = CompressLevel (level, _result.Format, blocks);
+        if (_result.NumLevels == 0) {
+            error = levelError;
+        }
+        _result.UncompressedMemory += level.Width * level.Height * 4;
+        _result.NumLevels++;
+        if (level.Width == 1 && level.Height == 1) {
+            break;
+        }
+        Image next;
+        MakeMipLevel (level, next);
+        level.Width = next.Width;
+        level.Height = next.Height;
+        level.Pixels.swap (next.Pixels);
+    }
+    WriteDds (_cookedFile, _result.Width, _result.Height, _result.NumLevels, _result.Format, blocks);
+    _result.CookedMemory = blocks.size ();
+    unsigned int numChannels = hasAlpha ? 4 : 3;
+    _result.RmsError = (float)sqrt (error / ((double)_result.Width * _result.Height * numChannels));
+    _result.CookTime = (float)(clock () - start) / CLOCKS_PER_SEC;
+}
+
+void TextureCooker::Resize (const Image& _source, unsigned int _width, unsigned int _height, Image& _target) {
+    // first along the rows, then along the columns, the edges are repeated
+    std::vector<float> rows ((size_t)_width * _source.Height * 4, 0.0f);
+    std::vector<float> columns ((size_t)_width * _height * 4, 0.0f);
+    for (unsigned int pass = 0; pass < 2; pass++) {
+        unsigned int sourceSize = pass == 0 ? _source.Width : _source.Height;
+        unsigned int targetSize = pass == 0 ? _width : _height;
+        unsigned int numLines = pass == 0 ? _source.Height : _width;
+        float scale = (float)sourceSize / targetSize;
+        float support = scale > 1.0f ? scale : 1.0f;
+        for (unsigned int t = 0; t < targetSize; t++) {
+            float center = (t + 0.5f) * scale - 0.5f;
+            int first = (int)ceilf (center - support);
+            int last = (int)floorf (center + support);
+            float totalWeight = 0.0f;
+            for (int s = first; s <= last; s++) {
+                float weight = 1.0f - fabsf (s - center) / support;
+                if (weight <= 0.0f) {
+                    continue;
+                }
+                unsigned int clamped = s < 0 ? 0 : (s >= (int)sourceSize ? sourceSize - 1 : s);
+                totalWeight += weight;
+                for (unsigned int line = 0; line < numLines; line++) {
+                    for (unsigned int k = 0; k < 4; k++) {
+                        if (pass == 0) {
+                            rows[((size_t)line * _width + t) * 4 + k] += weight * _source.Pixels[((size_t)line * _source.Width + clamped) * 4 + k];
+                        } else {
+                            columns[((size_t)t * _width + line) * 4 + k] += weight * rows[((size_t)clamped * _width + line) * 4 + k];
+                        }
+                    }
+                }
+            }
+            for (unsigned int line = 0; line < numLines; line++) {
+                for (unsigned int k = 0; k < 4; k++) {
+                    if (pass == 0) {
+                        rows[((size_t)line * _width + t) * 4 + k] /= totalWeight;
+                    } else {
+                        columns[((size_t)t * _width + line) * 4 + k] /= totalWeight;
+                    }
+                }
+            }
+        }
+    }
+    _target.Width = _width;
+    _target.Height = _height;
+    _target.Pixels.resize (columns.size ());
+    for (size_t i = 0; i < columns.size (); i++) {
+        float value = floorf (columns[i] + 0.5f);
+        _target.Pixels[i] = (unsigned char)(value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value));
+    }
+}
+
+void TextureCooker::MakeMipLevel (const Image& _source, Image& _target) {
+    _target.Width = _source.Width > 1 ? _source.Width / 2 : 1;
+    _target.Height = _source.Height > 1 ? _source.Height / 2 : 1;
+    _target.Pixels.resize ((size_t)_target.Width * _target.Height * 4);
+    // a side of a single texel is not halved
+    unsigned int stepX = _source.Width > 1 ? 1 : 0;
+    unsigned int stepY = _source.Height > 1 ? 1 : 0;
+    for (unsigned int y = 0; y < _target.Height; y++) {
+        for (unsigned int x = 0; x < _target.Width; x++) {
+            const unsigned char* top = &_source.Pixels[((size_t)(y * 2) * _source.Width + x * 2) * 4];
+            const unsigned char* bottom = top + (size_t)stepY * _source.Width * 4;
+            for (unsigned int k = 0; k < 4; k++) {
+                unsigned int sum = top[k] + top[stepX * 4 + k] + bottom[k] + bottom[stepX * 4 + k];
+                _target.Pixels[((size_t)y * _target.Width + x) * 4 + k] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+double TextureCooker::CompressLevel (const Image& _image, DxtFormat _format, std::vector<unsigned char>& _blocks) {
+    unsigned int blockSize = DxtCompressor::GetBlockSize (_format);
+    unsigned int numChannels = _format == DXT_FORMAT_DXT5 ? 4 : 3;
+    unsigned int numBlocksX = (_image.Width + 3) / 4;
+    unsigned int numBlocksY = (_image.Height + 3) / 4;
+    size_t offset = _blocks.size ();
+    _blocks.resize (offset + (size_t)numBlocksX * numBlocksY * blockSize);
+    double error = 0.0;
+    for (unsigned int blockY = 0; blockY < numBlocksY; blockY++) {
+        for (unsigned int blockX = 0; blockX < numBlocksX; blockX++) {
+            unsigned char texels[64];
+            for (unsigned int i = 0; i < 16; i++) {
+                unsigned int x = blockX * 4 + i % 4;
+                unsigned int y = blockY * 4 + i / 4;
+                x = x < _image.Width ? x : _image.Width - 1;
+                y = y < _image.Height ? y : _image.Height - 1;
+                for (unsigned int k = 0; k < 4; k++) {
+                    texels[i * 4 + k] = _image.Pixels[((size_t)y * _image.Width + x) * 4 + k];
+                }
+            }
+            unsigned char* block = &_blocks[offset];
+            DxtCompressor::CompressBlock (texels, _format, block);
+            offset += blockSize;
+            unsigned char decoded[64];
+            DxtCompressor::DecompressBlock (block, _format, decoded);
+            for (unsigned int i = 0; i < 16; i++) {
+                if (blockX * 4 + i % 4 >= _image.Width || blockY * 4 + i / 4 >= _image.Height) {
+                    continue;
+                }
+                for (unsigned int k = 0; k < numChannels; k++) {
+                    double difference = (double)texels[i * 4 + k] - decoded[i * 4 + k];
+                    error += difference * difference;
+                }
+            }
+        }
+    }
+    return error;
+}
+
+unsigned int TextureCooker::GetPowerOfTwo (unsigned int _value) {
+    unsigned int power = 1;
+    while (power < _value) {
+        power <<= 1;
+    }
+    return power;
+}
+
+static void WriteLittle32 (FILE* _file, unsigned int _value) {
+    unsigned char bytes[4] = {
+        (unsigned char)(_value & 0xff), (unsigned char)((_value >> 8) & 0xff),
+        (unsigned char)((_value >> 16) & 0xff), (unsigned char)(_value >> 24)};
+    fwrite (bytes, 1, 4, _file);
+}
+
+void TextureCooker::WriteDds (const char* _filename, unsigned int _width, unsigned int _height, unsigned int _numLevels,
+                              DxtFormat _format, const std::vector<unsigned char>& _blocks) {
+    FILE* file = fopen (_filename, "wb");
+    if (!file) {
+        throw std::runtime_error (std::string (_filename) + ": cannot create the file");
+    }
+    unsigned int topLevelSize = ((_width + 3) / 4) * ((_height + 3) / 4) * DxtCompressor::GetBlockSize (_format);
+    fwrite ("DDS ", 1, 4, file);
+    WriteLittle32 (file, 124);      // header size
+    WriteLittle32 (file, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE);
+    WriteLittle32 (file, _height);
+    WriteLittle32 (file, _width);
+    WriteLittle32 (file, topLevelSize);
+    WriteLittle32 (file, 0);        // depth
+    WriteLittle32 (file, _numLevels);
+    for (unsigned int i = 0; i < 11; i++) {
+        WriteLittle32 (file, 0);
+    }
+    WriteLittle32 (file, 32);       // pixel format size
+    WriteLittle32 (file, DDPF_FOURCC);
+    fwrite (_format == DXT_FORMAT_DXT5 ? "DXT5" : "DXT1", 1, 4, file);
+    for (unsigned int i = 0; i < 5; i++) {
+        WriteLittle32 (file, 0);    // bit count and masks
+    }
+    WriteLittle32 (file, DDSCAPS_TEXTURE | (_numLevels > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0));
+    for (unsigned int i = 0; i < 4; i++) {
+        WriteLittle32 (file, 0);    // caps2, caps3, caps4 and reserved
+    }
+    bool isWritten = _blocks.empty () || fwrite (&_blocks[0], 1, _blocks.size (), file) == _blocks.size ();
+    if (fclose (file) != 0 || !isWritten) {
+        remove (_filename);
+        throw std::runtime_error (std::string (_filename) + ": cannot write the file");
+    }
+}
@@ -28,6 +28,48 @@ sampler ShadowMapSampler = sampler_state {
   AddressV = clamp;
 };
 
+float4x4 g_CascadeViewProjection[4];
+float4 g_CascadeSplits;     // far view distance of every cascade, 0 if unused
+
+Texture g_ShadowCascade0;
+Texture g_ShadowCascade1;
+Texture g_ShadowCascade2;
+Texture g_ShadowCascade3;
+
+sampler ShadowCascadeSampler0 = sampler_state { texture = <g_ShadowCascade0>; magfilter = POINT; minfilter = POINT; mipfilter = NONE; AddressU = clamp; AddressV = clamp; };
+sampler ShadowCascadeSampler1 = sampler_state { texture = <g_ShadowCascade1>; magfilter = POINT; minfilter = POINT; mipfilter = NONE; AddressU = clamp; AddressV = clamp; };
+sampler ShadowCascadeSampler2 = sampler_state { texture = <g_ShadowCascade2>; magfilter = POINT; minfilter = POINT; mipfilter = NONE; AddressU = clamp; AddressV = clamp; };
+sampler ShadowCascadeSampler3 = sampler_state { texture = <g_ShadowCascade3>; magfilter = POINT; minfilter = POINT; mipfilter = NONE; AddressU = clamp; AddressV = clamp; };
+
+// returns 1 if the point is lit, 0 if it is in shadow
+float CascadeShadowFactor (float4 position3D, float viewDepth) {
+  int cascade;
+  if (viewDepth < g_CascadeSplits.x) {
+    cascade = 0;
+  } else if (viewDepth < g_CascadeSplits.y) {
+    cascade = 1;
+  } else if (viewDepth < g_CascadeSplits.z) {
+    cascade = 2;
+  } else if (viewDepth < g_CascadeSplits.w) {
+    cascade = 3;
+  } else {
+    return 1.0f;    // beyond the shadow distance
+  }
+  float4 lightPosition = mul(position3D, g_CascadeViewProjection[cascade]);
+  float4 lookup = float4(lightPosition.x / 2.0f + 0.5f, 1.0f - (lightPosition.y / 2.0f + 0.5f), 0.0f, 0.0f);
+  float depthStoredInShadowMap;
+  if (cascade == 0) {
+    depthStoredInShadowMap = tex2Dlod(ShadowCascadeSampler0, lookup).x;
+  } else if (cascade == 1) {
+    depthStoredInShadowMap = tex2Dlod(ShadowCascadeSampler1, lookup).x;
+  } else if (cascade == 2) {
+    depthStoredInShadowMap = tex2Dlod(ShadowCascadeSampler2, lookup).x;
+  } else {
+    depthStoredInShadowMap = tex2Dlod(ShadowCascadeSampler3, lookup).x;
+  }
+  return (lightPosition.z - 0.002f) < depthStoredInShadowMap ? 1.0f : 0.0f;
+}
+
 float DotProduct(float3 lightPos, float3 pos3D, float3 normal) {
   float3 lightDir = normalize(pos3D - lightPos);
   return dot(-lightDir, normal);    
@@ -91,6 +133,43 @@ PSOutput ShadowedScenePS (PSInput input) {
   return output;
 }
 
+struct CascadedVSOutput {
+  float4 Position : POSITION;
+  float2 TexCoords : TEXCOORD0;
+  float3 Normal : TEXCOORD1;
+  float4 Position3D : TEXCOORD2;
+  float ViewDepth : TEXCOORD3;
+};
+
+struct CascadedPSInput {
+  float2 TexCoords : TEXCOORD0;
+  float3 Normal : TEXCOORD1;
+  float4 Position3D : TEXCOORD2;
+  float ViewDepth : TEXCOORD3;
+};
+
+CascadedVSOutput CascadedShadowedSceneVS (VSInput input) {
+  CascadedVSOutput output = (CascadedVSOutput)0;
+
+  output.Position = mul(input.Position, g_WorldViewProjection);
+  output.Normal = normalize(mul(input.Normal, (float3x3)g_World));
+  output.Position3D = mul(input.Position, g_World);
+  output.ViewDepth = output.Position.w;
+  output.TexCoords = input.TexCoords;
+
+  return output;
+}
+
+PSOutput CascadedShadowedScenePS (CascadedPSInput input) {
+  PSOutput output = (PSOutput)0;
+
+  float lit = CascadeShadowFactor(input.Position3D, input.ViewDepth);
+  float diffuseLightingFactor = lit * saturate (DotProduct(g_LightPos, input.Position3D, input.Normal)) + g_Ambient;
+  output.Color = tex2D(TextureSampler, input.TexCoords) * saturate (diffuseLightingFactor);
+
+  return output;
+}
+
 PSOutput UnlitScenePS (PSInput input) {
   PSOutput output = (PSOutput)0;
   
@@ -110,4 +189,11 @@ technique UnlitScene {
     VertexShader = compile vs_2_0 ShadowedSceneVS();
     PixelShader = compile ps_2_0 UnlitScenePS();
   }
+}
+
+technique CascadedShadowedScene {
+  pass Pass0 {
+    VertexShader = compile vs_3_0 CascadedShadowedSceneVS();
+    PixelShader = compile ps_3_0 CascadedShadowedScenePS();
+  }
 }
\ No newline at end of file
@@ -48,6 +48,47 @@ sampler BuildingFieldSampler = sampler_state {
   AddressV = wrap;
 };
 
+float4x4 g_CascadeViewProjection[4];
+float4 g_CascadeSplits;     // far view distance of every cascade, 0 if unused
+
+Texture g_ShadowCascade0;
+Texture g_ShadowCascade1;
+Texture g_ShadowCascade2;
+Texture g_ShadowCascade3;
+
+sampler ShadowCascadeSampler0 = sampler_state { texture = <g_ShadowCascade0>; magfilter = POINT; minfilter = POINT; mipfilter = NONE; AddressU = clamp; AddressV = clamp; };
+sampler ShadowCascadeSampler1 = sampler_state { texture = <g_ShadowCascade1>; magfilter = POINT; minfilter = POINT; mipfilter = NONE; AddressU = clamp; AddressV = clamp; };
+sampler ShadowCascadeSampler2 = sampler_state { texture = <g_ShadowCascade2>; magfilter = POINT; minfilter = POINT; mipfilter = NONE; AddressU = clamp; AddressV = clamp; };
+sampler ShadowCascadeSampler3 = sampler_state { texture = <g_ShadowCascade3>; magfilter = POINT; minfilter = POINT; mipfilter = NONE; AddressU = clamp; AddressV = clamp; };
+
+// returns 1 if the point is lit, 0 if it is in shadow
+float CascadeShadowFactor (float4 position3D, float viewDepth) {
+  int cascade;
+  if (viewDepth < g_CascadeSplits.x) {
+    cascade = 0;
+  } else if (viewDepth < g_CascadeSplits.y) {
+    cascade = 1;
+  } else if (viewDepth < g_CascadeSplits.z) {
+    cascade = 2;
+  } else if (viewDepth < g_CascadeSplits.w) {
+    cascade = 3;
+  } else {
+    return 1.0f;    // beyond the shadow distance
+  }
+  float4 lightPosition = mul(position3D, g_CascadeViewProjection[cascade]);
+  float4 lookup = float4(lightPosition.x / 2.0f + 0.5f, 1.0f - (lightPosition.y / 2.0f + 0.5f), 0.0f, 0.0f);
+  float depthStoredInShadowMap;
+  if (cascade == 0) {
+    depthStoredInShadowMap = tex2Dlod(ShadowCascadeSampler0, lookup).x;
+  } else if (cascade == 1) {
+    depthStoredInShadowMap = tex2Dlod(ShadowCascadeSampler1, lookup).x;
+  } else if (cascade == 2) {
+    depthStoredInShadowMap = tex2Dlod(ShadowCascadeSampler2, lookup).x;
+  } else {
+    depthStoredInShadowMap = tex2Dlod(ShadowCascadeSampler3, lookup).x;
+  }
+  return (lightPosition.z - 0.002f) < depthStoredInShadowMap ? 1.0f : 0.0f;
+}
 
 struct VSInput1 {
   float4 Position : POSITION;
@@ -189,6 +230,56 @@ PSOutput ShadowedSceneWithBuildingFieldPS (PSInput1 input) {
   return output;
 }
 
+struct CascadedVSOutput {
+  float4 Position : POSITION;
+  float2 TexCoords : TEXCOORD0;
+  float4 Color : COLOR0;
+  float4 Position3D : TEXCOORD1;
+  float ViewDepth : TEXCOORD2;
+};
+
+struct CascadedPSInput {
+  float2 TexCoords : TEXCOORD0;
+  float4 Color : COLOR0;
+  float4 Position3D : TEXCOORD1;
+  float ViewDepth : TEXCOORD2;
+};
+
+CascadedVSOutput CascadedShadowedSceneVS (VSInput1 input) {
+  CascadedVSOutput output = (CascadedVSOutput)0;
+
+  output.Position = mul(input.Position, g_WorldViewProjection);
+  output.Color = input.Color;
+  output.Position3D = mul(input.Position, g_World);
+  output.ViewDepth = output.Position.w;
+  output.TexCoords = input.TexCoords;
+
+  return output;
+}
+
+PSOutput CascadedShadowedScenePS (CascadedPSInput input) {
+  PSOutput output = (PSOutput)0;
+
+  float diffuseLightingFactor = lerp(g_Ambient, 1.0f, CascadeShadowFactor(input.Position3D, input.ViewDepth));
+  output.Color = tex2D(TextureSampler, input.TexCoords) * input.Color * diffuseLightingFactor;
+
+  return output;
+}
+
+PSOutput CascadedShadowedSceneWithBuildingFieldPS (CascadedPSInput input) {
+  PSOutput output = (PSOutput)0;
+
+  float diffuseLightingFactor = lerp(g_Ambient, 1.0f, CascadeShadowFactor(input.Position3D, input.ViewDepth));
+  float4 buildingField = tex2D(BuildingFieldSampler, input.TexCoords);
+  float4 buildingFieldColor = float4(0.81f, 0.33f, 0.74f, 1.0f);
+  if (buildingField.r < 0.1f && buildingField.g < 0.1f && buildingField.b < 0.1f) {
+    buildingFieldColor = float4(0.55f, 0.81f, 0.74f, 1.0f);
+  }
+  output.Color = tex2D(TextureSampler, input.TexCoords) * input.Color * diffuseLightingFactor * buildingFieldColor;
+
+  return output;
+}
+
 technique ShadowedScene {
   pass Pass0 {
     VertexShader = compile vs_2_0 ShadowedSceneVS();
@@ -208,4 +299,18 @@ technique ShadowedSceneWithBuildingField {
     VertexShader = compile vs_2_0 ShadowedSceneVS();
     PixelShader = compile ps_2_0 ShadowedSceneWithBuildingFieldPS();
   }
+}
+
+technique CascadedShadowedScene {
+  pass Pass0 {
+    VertexShader = compile vs_3_0 CascadedShadowedSceneVS();
+    PixelShader = compile ps_3_0 CascadedShadowedScenePS();
+  }
+}
+
+technique CascadedShadowedSceneWithBuildingField {
+  pass Pass0 {
+    VertexShader = compile vs_3_0 CascadedShadowedSceneVS();
+    PixelShader = compile ps_3_0 CascadedShadowedSceneWithBuildingFieldPS();
+  }
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "../include/RenderDevice.h"
+#include "../include/ObjManager.h"
+#include "../include/Ms3dManager.h"
+#include <vector>
+#include <deque>
+#include <string>
+
+#define ASSET_MAX_THREADS 8
+
+enum AssetType {
+    ASSET_TEXTURE,
+    ASSET_OBJ_MODEL,
+    ASSET_MS3D_FILE
+};
+
+enum AssetState {
+    ASSET_QUEUED,   /* waiting for a worker */
+    ASSET_STAGED,   /* read and decoded, waiting for the render thread */
+    ASSET_READY,
+    ASSET_FAILED
+};
+
+/* Loads the assets in the background.
+   The worker threads read the files and decode them into memory, only the
+   device resources are created on the render thread, in Update, as many as
+   fit in the time budget of a frame. A request returns a handle at once,
+   its result is valid when the state of the handle is ASSET_READY. */
+class AssetLoader {
+public:
+    AssetLoader (RenderDevice* _device, ObjManager* _objManager, Ms3dLoader* _ms3dLoader);
+    ~AssetLoader ();
+    /* 0 uses a thread per processor, without threads Update loads everything */
+    void Start (UINT _numThreads);
+    void Stop ();
+    /* the result is the texture ID */
+    UINT RequestTexture (const char* _filename);
+    /* the result is the ID of a new model in the obj manager */
+    UINT RequestObjModel (const char* _filename);
+    /* the file is cached by the ms3d loader, the models are parsed when they are spawned */
+    UINT RequestMs3dFile (const char* _filename);
+    /* creates the staged assets for up to _budget seconds, true when all are finished */
+    bool Update (float _budget);
+    AssetState GetState (UINT _handle) const;
+    /* throws the error of a failed request, a request asked for again is retried */
+    UINT GetResult (UINT _handle) const;
+    /* finished share of the requests since the last Clear, decoding counts half */
+    float GetProgress () const;
+    bool IsFinished () const;
+    /* forgets the finished requests and their handles, the assets stay loaded */
+    void Clear ();
+private:
+    struct Request {
+        AssetType Type;
+        std::string Filename;
+        volatile LONG State;
+        ERROR_CODE Error;
+        std::vector<char> Data;     /* file data for the device */
+        ObjModel* Model;            /* decoded obj model */
+        UINT Result;
+    };
+    static DWORD WINAPI WorkerProc (LPVOID _loader);
+    void Work ();
+    UINT FindRequest (AssetType _type, const char* _filename) const;
+    Request* NewRequest (AssetType _type, const char* _filename);
+    void Queue (Request* _request);
+    /* an asset which is already loaded needs no worker */
+    void Finish (Request* _request, UINT _result);
+    void Decode (Request& _request);
+    void Create (Request& _request);
+    static void ReadFileData (const char* _filename, std::vector<char>& _data);
+
+    RenderDevice* m_Device;
+    ObjManager* m_ObjManager;
+    Ms3dLoader* m_Ms3dLoader;
+    std::vector<Request*> m_Requests;   /* by handle */
+    std::deque<Request*> m_Queued;
+    std::deque<Request*> m_Staged;
+    CRITICAL_SECTION m_Lock;            /* guards the two queues */
+    HANDLE m_QueuedSemaphore;           /* a count per queued request */
+    HANDLE m_StagedEvent;
+    std::vector<HANDLE> m_Threads;
+    UINT m_NumFinished;
+    volatile LONG m_NumDecoded;
+    volatile LONG m_IsStopping;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Windows.h>
+
+struct GameSnapshot;
+
+/* Periodic save written on a worker thread.
+   The game captures its state into one of two snapshot buffers while the
+   worker writes the other one, so the frame only pays for copying the
+   packed records. A snapshot larger than the memory budget is skipped
+   before anything is captured. The file is replaced atomically by
+   Game::WriteSnapshot. */
+class Autosave {
+public:
+    Autosave ();
+    ~Autosave ();
+    void Start (const char* _filename, float _interval, UINT _memoryBudget);
+    void Stop ();
+    bool IsRunning () const;
+    /* counts down the interval, true when a snapshot is due */
+    bool Update (float _delta);
+    /* buffer the worker does not touch until EndCapture, NULL when a
+       snapshot of _size bytes is over the budget */
+    GameSnapshot* BeginCapture (size_t _size);
+    /* hands the captured snapshot to the worker */
+    void EndCapture ();
+    /* blocks until the queued snapshots are written */
+    void WaitIdle ();
+    /* true once after a write has failed */
+    bool HasFailed ();
+    /* true once when the snapshots start to be skipped, again only after one fitted */
+    bool HasStartedSkipping ();
+private:
+    static DWORD WINAPI WorkerProc (LPVOID _autosave);
+    void Work ();
+
+    char m_Filename[MAX_PATH];
+    float m_Interval;
+    float m_TimeLeft;
+    UINT m_MemoryBudget;
+    GameSnapshot* m_Snapshots[2];
+    int m_Capturing;    /* buffer indices, -1 when none */
+    int m_Pending;
+    int m_Writing;
+    bool m_IsStopping;
+    bool m_HasFailed;
+    bool m_IsSkipping;
+    bool m_HasStartedSkipping;
+    HANDLE m_Thread;
+    HANDLE m_WakeEvent;
+    HANDLE m_IdleEvent;
+    CRITICAL_SECTION m_Lock;
+};
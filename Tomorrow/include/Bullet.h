@@ -41,6 +41,12 @@ public:
         return m_LifeTime;
     }
 
+    /** Getter: how long a shot flies.
+    @param[in] _origin initial particles' position
+    @param[in] _destination the position where particles will fly
+    @return the life time SetPosition() gives the particles */
+    float GetFlightTime (const VECTOR3& _origin, const VECTOR3& _destination) const;
+
     /** Getter: maximum time of the shot.
     @return maximum time of the shot */
     float GetMaxTime () const {
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "../include/RenderDevice.h"
+#include <vector>
+
+#define COMMAND_LOG_VERSION 1
+#define COMMAND_LOG_HASH_SEED 2166136261u
+
+enum CommandType {
+    CMD_PLACE_TOWER = 0,
+    CMD_UPGRADE_TOWER = 1,
+    CMD_SPEED_UP = 2,
+    CMD_CAMERA = 3
+};
+
+/* A player action, applied before simulation step Tick. */
+struct GameCommand {
+    UINT Tick;
+    UINT Type;
+    UINT Param;         /* tower type to place, tower id to upgrade */
+    POINT Location;     /* heightmap grid of the placed tower */
+    float Values[6];    /* speed-up factor; camera position and looking point */
+};
+
+struct CommandLogHeader {
+    char Magic[4];
+    UINT Version;
+    char Scenario[MAX_PATH];
+    float Step;         /* simulation step the session ran at */
+    UINT NumCommands;
+    UINT NumTicks;
+    UINT NumHashes;     /* one per tick or none */
+};
+
+/* Commands of one session, recorded at the tick they were issued and
+   played back against the same scenario at the same fixed step.
+   A rolling hash of the simulation state may be stored for every tick,
+   the replay compares against it and remembers the first tick that
+   differs. The file is the header followed by the commands and hashes. */
+class CommandLog {
+public:
+    CommandLog ();
+    void StartRecording (const char* _scenario, float _step, bool _isHashing);
+    void Save (const char* _filename);
+    void StartReplay (const char* _filename);
+    void Stop ();
+    bool IsRecording () const;
+    bool IsReplaying () const;
+    const char* GetScenario () const;
+    float GetStep () const;
+    UINT GetNumTicks () const;
+    void Record (const GameCommand& _command);
+    /* replay: the next command due before _tick, false when there is none */
+    bool NextCommand (UINT _tick, GameCommand& _command);
+    /* replay: true once the recorded ticks are played */
+    bool IsFinished (UINT _tick) const;
+    /* after step _tick; records its state hash or compares it to the recorded one */
+    void EndTick (UINT _tick, UINT _hash);
+    bool IsHashing () const;
+    /* INVALID_ID while the replay matches the recording */
+    UINT GetDivergentTick () const;
+    static UINT Hash (UINT _hash, const void* _data, UINT _size);
+private:
+    enum Mode {
+        MODE_NONE,
+        MODE_RECORDING,
+        MODE_REPLAYING
+    };
+    Mode m_Mode;
+    CommandLogHeader m_Header;
+    std::vector<GameCommand> m_Commands;
+    std::vector<UINT> m_Hashes;
+    bool m_IsHashing;
+    UINT m_NextCommand;
+    UINT m_DivergentTick;
+};
@@ -0,0 +1,51 @@
+/** @file DxtTexel.h
+Decoding of single texels of block compressed textures.
+*/
+#pragma once
+
+#include <Windows.h>
+
+/** Decodes a texel of a DXT1 or DXT5 block to blue, green, red and alpha.
+The color block of DXT5 always has four colors, a DXT1 block has three and
+transparent black when its first end color is not the greater one.
+@param[in] _isDxt5 the block is DXT5, its alpha block comes first
+@param[in] _block the block
+@param[in] _x column of the texel in the block
+@param[in] _y row of the texel in the block
+@param[out] _bgra blue, green, red and alpha of the texel */
+inline void DecodeBlockTexel (bool _isDxt5, const BYTE* _block, UINT _x, UINT _y, BYTE* _bgra) {
+    UINT index = _y * 4 + _x;
+    _bgra[3] = 255;
+    if (_isDxt5) {
+        // eight alphas, or six and the two extremes, by 3-bit indices
+        UINT alpha[8] = {_block[0], _block[1]};
+        for (UINT i = 2; i < 8; i++) {
+            alpha[i] = _block[0] > _block[1] ? ((8 - i) * alpha[0] + (i - 1) * alpha[1]) / 7 :
+                (i < 6 ? ((6 - i) * alpha[0] + (i - 1) * alpha[1]) / 5 : (i == 6 ? 0 : 255));
+        }
+        UINT bit = 16 + index * 3;
+        UINT code = ((_block[bit / 8] | (_block[bit / 8 + 1] << 8)) >> (bit % 8)) & 7;
+        _bgra[3] = (BYTE)alpha[code];
+        _block += 8;
+    }
+    UINT color[2] = {(UINT)(_block[0] | (_block[1] << 8)), (UINT)(_block[2] | (_block[3] << 8))};
+    UINT code = (_block[4 + _y] >> (_x * 2)) & 3;
+    for (UINT k = 0; k < 3; k++) {
+        // blue, green and red of the 5:6:5 end colors
+        UINT shift[3] = {0, 5, 11};
+        UINT bits[3] = {5, 6, 5};
+        UINT end[2];
+        for (UINT i = 0; i < 2; i++) {
+            UINT value = (color[i] >> shift[k]) & ((1 << bits[k]) - 1);
+            end[i] = (value << (8 - bits[k])) | (value >> (2 * bits[k] - 8));
+        }
+        if (color[0] > color[1] || _isDxt5) {
+            UINT palette[4] = {end[0], end[1], (2 * end[0] + end[1]) / 3, (end[0] + 2 * end[1]) / 3};
+            _bgra[k] = (BYTE)palette[code];
+        } else {
+            UINT palette[4] = {end[0], end[1], (end[0] + end[1]) / 2, 0};
+            _bgra[k] = (BYTE)palette[code];
+            _bgra[3] = code == 3 ? 0 : _bgra[3];
+        }
+    }
+}
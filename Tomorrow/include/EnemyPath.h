@@ -0,0 +1,34 @@
+#pragma once
+
+#include "../include/RenderDevice.h"
+#include <vector>
+
+/* Enemy path through the waypoints, measured by arc length.
+   Cumulative segment lengths give the segment of any distance along the path
+   by a binary search, and the terrain height is sampled along the path at a
+   fixed spacing, so a position is looked up without touching the terrain. */
+class EnemyPath {
+public:
+    EnemyPath ();
+    void Build (const std::vector<VECTOR3>& _Points, float _HeightSpacing);
+    void Clear ();
+    /* fill the height samples after Build */
+    UINT GetNumHeightSamples () const;
+    VECTOR3 GetHeightSamplePoint (UINT _Sample) const;
+    void SetHeightSample (UINT _Sample, float _Height);
+
+    float GetLength () const;
+    UINT GetNumPoints () const;
+    float GetSegmentStart (UINT _Segment) const;
+    const VECTOR3& GetDirection (UINT _Segment) const;
+    UINT FindSegment (float _Distance) const;
+    VECTOR3 GetPosition (float _Distance) const;
+    VECTOR3 GetPosition (float _Distance, UINT _Segment) const;
+    float GetHeight (float _Distance) const;
+private:
+    std::vector<VECTOR3> m_Points;
+    std::vector<VECTOR3> m_Directions;  // per segment, the last point repeats the last segment
+    std::vector<float> m_Starts;        // arc length at every point
+    std::vector<float> m_Heights;       // sampled every m_HeightSpacing units of arc length
+    float m_HeightSpacing;
+};
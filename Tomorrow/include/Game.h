@@ -16,6 +16,17 @@
 #include "../include/Beam.h"
 #include "../include/Bullet.h"
 #include "../include/GameUI.h"
+#include "../include/RingMeshCache.h"
+#include "../include/ShadowCascades.h"
+#include "../include/EnemyPath.h"
+#include "../include/HeightField.h"
+#include "../include/TargetingKernel.h"
+#include "../include/Scenario.h"
+#include "../include/Autosave.h"
+#include "../include/CommandLog.h"
+#include "../include/GameEvents.h"
+#include "../include/JobSystem.h"
+#include "../include/AssetLoader.h"
 #include "../include/Descriptions.h"
 #include <vector>
 #include <list>
@@ -32,6 +43,7 @@
     #pragma comment (lib, "lib/Debug/ObjManager.lib")
     #pragma comment (lib, "lib/Debug/Ms3dManager.lib")
     #pragma comment (lib, "lib/Debug/ParticleSystem.lib")
+    #pragma comment (lib, "lib/Debug/PackFile.lib")
 #else
     #pragma comment (lib, "lib/RendererLoader.lib")
     #pragma comment (lib, "lib/AudioEngineLoader.lib")
@@ -43,22 +55,61 @@
     #pragma comment (lib, "lib/ObjManager.lib")
     #pragma comment (lib, "lib/Ms3dManager.lib")
     #pragma comment (lib, "lib/ParticleSystem.lib")
+    #pragma comment (lib, "lib/PackFile.lib")
 #endif
 
 #define MIN_HEIGHT 180.0f
-#define MAX_TOWER_LEVEL 5
+#define TOWER_RANGE_SEGMENTS 30
+#define TOWER_RANGE_COLOR 0x330000ff
+#define CAMERA_NEAR_CLIP 1.0f
+#define CAMERA_FAR_CLIP 3000.0f
+#define SHADOW_NUM_CASCADES 3   /* 0 renders a single shadow map */
+#define SHADOW_DISTANCE 1800.0f
+#define SIMULATION_STEP_RATE 60.0f  /* fixed simulation steps per second */
+#define SIMULATION_MAX_STEPS 40     /* catch-up cap per rendered frame */
+#define PATH_HEIGHT_SPACING 5.0f    /* terrain sampled along the enemy path */
+#define DEFAULT_SCENARIO "data/scenario/Default.scenario"
+#define SNAPSHOT_FILE "Save.sav"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_NAME_LENGTH 32     /* animation names in the snapshot */
+#define AUTOSAVE_INTERVAL 60.0f     /* seconds of play between autosaves */
+#define AUTOSAVE_MEMORY_BUDGET (8 * 1024 * 1024)    /* bytes per snapshot buffer */
+#define EVENT_VISIBLE_RADIUS 50.0f      /* shots this far outside the frustum get no particle */
+#define EVENT_AUDIBLE_DISTANCE 1500.0f  /* from the camera */
+#define EVENT_MAX_SOUNDS 8              /* per event type and frame */
+#define JOB_THREADS 0           /* 0 uses a thread per processor */
+#define JOB_ENEMY_GRAIN 128     /* enemies per job */
+#define JOB_TOWER_GRAIN 8       /* towers per job */
+#define ANIMATION_LOD_NEAR 800.0f       /* closer enemies get a pose every frame */
+#define ANIMATION_LOD_FAR 1600.0f       /* from the camera */
+#define ANIMATION_LOD_MID_INTERVAL 2    /* frames per pose between the two distances */
+#define ANIMATION_LOD_FAR_INTERVAL 4    /* frames per pose beyond the far distance */
+#define POSE_SAMPLE_RATE 30.0f          /* baked palettes per second of an enemy clip, 0 interpolates the keyframes */
+#define ASSET_THREADS 2                 /* background file reads and decoding */
+#define ASSET_FRAME_BUDGET 0.010f       /* seconds of device work between loading screen frames */
 
-enum TowerType {
-    BASIC_TOWER = 0,
-    SLOWING_TOWER = 1,
-    AREA_TOWER = 2
-};
+/* TOMORROW_TESTS is defined by the Test configuration only; the release
+   game has no -selftest, -targetbench and -ms3dbench */
+#ifdef TOMORROW_TESTS
+struct SelfTestReport;
+#endif
 
 struct EnemyAnimation {
     float Start;
     float End;
 };
 
+/* Enemy poses are evaluated every frame near the camera and every few frames
+   farther away, staggered by the model so the poses spread over the frames.
+   Enemies outside the view and shadow frustums only advance their clip time. */
+struct AnimationLod {
+    bool IsEnabled;
+    float NearDistance;
+    float FarDistance;
+    UINT MidInterval;
+    UINT FarInterval;
+};
+
 struct EnemyInfo {
     UINT Id;
     UINT WaveId;
@@ -76,15 +127,25 @@ struct EnemyInfo {
     float MaxAmmo;
     UINT Power;
     VECTOR3 Position;
+    VECTOR3 PreviousPosition;   /* before the last simulation step */
+    VECTOR3 RenderPosition;     /* where the model is placed */
     VECTOR3 Direction;
-    float Distance;
+    float PathDistance;         /* along m_Path, ActiveWaypoint is derived from it */
+    UINT TargetIndex;           /* in m_Targets, INVALID_ID when not targetable */
+    UINT MapMark;
     UINT NumAttackers;
     UINT NumResources;
     UINT SoundId;
+    UINT CastleHits;            /* shots at the castle in the last step */
+    bool HasMoved;              /* along the path in the last step */
+    bool HasStartedShooting;    /* in the last step */
+    UINT PoseInterval;          /* frames per pose in the last frame, 0 when not seen */
+    bool IsPoseEvaluated;       /* in the last frame */
     std::map<std::string, EnemyAnimation> Animation;
     std::string CurrentAnimation;
     float AnimationSpeed;
     bool LoopAnimation;
+    float ClipTimeLeft;         /* of PrepareToShoot, counted by the simulation steps */
     bool IsDead;
     float SelfDestructionTime;
 };
@@ -129,17 +190,14 @@ struct TowerInfo {
     Bullet* Gun;
     std::list<TowerGunInfo> GunInfo;
     UINT SoundId;
+    UINT MapMark;
     UINT Size;
     float BuildingTime;
     float MaxBuildingTime;
-};
-
-struct TowerUpgradeInfo {
-    float UpgradeTime[MAX_TOWER_LEVEL];
-    float RadiusIncrease[MAX_TOWER_LEVEL];
-    float AttackSpeedDecrease[MAX_TOWER_LEVEL];
-    UINT PowerIncrease[MAX_TOWER_LEVEL];
-    UINT Price[MAX_TOWER_LEVEL];
+    std::vector<vs3d::ULCVERTEX> RangeOutline;  /* terrain-conforming range, rebuilt on placement and upgrade */
+    TowerAim Aim;               /* refreshed on placement and upgrade */
+    bool IsFiring;              /* in this step, set by Game::AimTowers */
+    std::vector<UINT> Candidates;   /* targets in range when firing, in m_TargetEnemies */
 };
 
 struct ResourceInfo {
@@ -155,21 +213,80 @@ struct WaypointInfo {
     VECTOR3 Direction;
 };
 
-struct EnemyAdditionDetails {
-    float Delay;
-    float SpawnTime;
-    std::string Filename;
-    std::string AnimInfoFile;
-    UINT HitPoints;
+/* Binary save. A snapshot holds the simulation state only, in flat records
+   that are read and written in bulk; models, guns, sounds and map marks are
+   attached again on restore. */
+struct SnapshotHeader {
+    char Magic[4];
+    UINT Version;
+    char Scenario[MAX_PATH];
+    UINT CastleHitPoints;
+    float CameraPosition[3];
+    float CameraLookingPoint[3];
+    ResourceInfo Resource;
+    UINT Score;
+    float NextWaveTimeLeft;
+    UINT NumWaves;
+    UINT NumEnemies;
+    UINT NumTowers;
+    UINT NumGuns;
+    UINT OccupiedSize;
+};
+
+struct EnemySnapshot {
+    UINT WaveId;
+    int HitPoints;
+    int MaxHitPoints;
+    UINT IsFast;
     float Speed;
+    float SlowDownFactor;
+    UINT NumSlowedDown;
     float AttackSpeed;
+    float RemainingTimeToShoot;
+    float Ammo;
     float MaxAmmo;
     UINT Power;
+    float Position[3];
+    float PreviousPosition[3];
+    float Direction[3];
+    float PathDistance;
+    UINT NumAttackers;
     UINT NumResources;
-    UINT NumEnemies; 
-    float ShotTime; 
-    float ShotPauseTime; 
-    bool IsFast;
+    char CurrentAnimation[SNAPSHOT_NAME_LENGTH];
+    float AnimationSpeed;
+    UINT LoopAnimation;
+    float ClipTimeLeft;
+    UINT IsDead;
+    float SelfDestructionTime;
+};
+
+struct TowerSnapshot {
+    UINT Type;
+    UINT Level;
+    POINT Location;
+    float Radius;
+    float AttackSpeed;
+    float ShootDelay;
+    UINT Power;
+    float BuildingTime;
+    float MaxBuildingTime;
+    UINT NumGuns;
+};
+
+struct GunSnapshot {
+    float ShootingTime;
+    UINT IsTargetAcquired;
+    UINT IsShootingUpdated;
+    UINT Target;            /* index in GameSnapshot::Enemies, INVALID_ID without a target */
+};
+
+struct GameSnapshot {
+    SnapshotHeader Header;
+    std::vector<WaveInfo> Waves;
+    std::vector<EnemySnapshot> Enemies;
+    std::vector<TowerSnapshot> Towers;
+    std::vector<GunSnapshot> Guns;      /* NumGuns of each tower in tower order */
+    std::vector<BYTE> Occupied;         /* row after row, OccupiedSize * OccupiedSize */
 };
 
 class Game {
@@ -185,17 +302,58 @@ public:
 
     /* Update */
     void Update ();
+    void SetSimulationRate (float _StepsPerSecond, UINT _MaxSteps);
 
     /* Setup */
+    void SetScenario (const char* _scenarioFile);
     void StartNew ();
+    void PlaceScenarioTowers ();
+    void RunLoadTest (float _Seconds, const char* _ReportFile);
+#ifdef TOMORROW_TESTS
+    UINT RunSelfTest (const char* _ReportFile);
+    void TestCommandReplay (SelfTestReport& _report);
+    void TestSnapshotRestore (SelfTestReport& _report);
+    void TestHeightField (SelfTestReport& _report);
+#endif
     
     void UnloadLevel ();
+    void RequestScenarioAssets ();
     void LoadLevel (const char* _levelFile);
+    void WaitForAssets ();
     void Save ();
     void Load ();
+    void SetAutosave (float _interval, UINT _memoryBudget);
+    size_t GetSnapshotSize ();
+    /* Commands */
+    void StartRecording (const char* _filename, bool _isHashing);
+    void StartReplay (const char* _filename);
+    void SaveRecording ();
+    void RunReplay (const char* _replayFile, const char* _ReportFile);
+    bool IsReplaying () const;
+    bool IssueCommand (GameCommand& _command);
+    bool ExecuteCommand (const GameCommand& _command);
+    void ExecuteReplayCommands ();
+    void RecordCamera ();
+    UINT HashState (UINT _hash);
+    void CaptureSnapshot (GameSnapshot& _snapshot);
+    void RestoreSnapshot (const GameSnapshot& _snapshot);
+    static void WriteSnapshot (const GameSnapshot& _snapshot, const char* _filename);
+    static void ReadSnapshot (GameSnapshot& _snapshot, const char* _filename);
+    static bool ReadSnapshotHeader (SnapshotHeader& _header, const char* _filename);
 
+    void Simulate (float _Step);
+    void SetNumThreads (UINT _numThreads);
+    bool RunJobBenchmark (float _Seconds, const char* _ReportFile);
+#ifdef TOMORROW_TESTS
+    void RunTargetingBenchmark (UINT _Rounds, const char* _ReportFile);
+    void RunMs3dBenchmark (UINT _Loads, const char* _ReportFile);
+#endif
+    void SetAnimationLod (bool _isEnabled, float _nearDistance, float _farDistance, UINT _midInterval, UINT _farInterval);
+    void SetPoseSampleRate (float _rate);
     void RenderMainScreen ();
     void RenderShadowMap (float _delta);
+    void RenderShadowCasters (const VECTOR3& _LightEye, const MATRIX44& _LightView, const MATRIX44& _LightProj);
+    void SetObjectEffectWorld (const MATRIX44& _World);
     /* Terrain */
     void UpdateTerrain ();
     void RenderTerrain ();
@@ -210,30 +368,61 @@ public:
     void ShowUpgradeInfo (UINT _towerId);
     void SetupTowersInfo (); 
     void RenderTowerRange (float _x, float _y, float _z, float _range);
+    void BuildTowerRangeOutline (UINT _towerId);
+    void RenderTowerRangeOutline (UINT _towerId);
     bool CreateTower (TowerType _type, POINT _point);
+    bool PlaceTower (TowerType _type, POINT _point);     /* CreateTower without the sound and the message */
+    VECTOR3 GetTowerPosition (POINT _point);
+    void AttachTowerResources (TowerInfo& _tower, const VECTOR3& _position);
     void RenderTowers (bool _isRenderingShadowMap, bool _isRenderingInactive);
     void UpdateTowers (float _delta);
+    void UpdateTowerBuilding (float _delta);
     void RenderBuildingTime (UINT _towerId);
     void MakeTowerUpgrade (UINT _towerId);
+    void ApplyTowerUpgrade (UINT _towerId);             /* only the stats of the next level */
     void RenderTowerGhost (TowerType _type);
     void UpdateTowerShooting (UINT _towerId, float _delta);
+    void UpdateTowerAim (UINT _towerId);
+    void AimTowers (UINT _begin, UINT _end, float _Delta);
+    void PackTargets ();
+    UINT FindTowerTargets (UINT _TowerId);
+    VECTOR3 GetLeadPosition (UINT _TowerId, std::list<EnemyInfo>::iterator _Enemy);
     void TowerShoot (float _TowerX, float _TowerY, UINT _TowerId, std::list<EnemyInfo>::iterator _Enemy, const VECTOR3& _NextPosition);
     void UpdateBasicTowerShooting (float _towerX, float _towerY, UINT _towerId, float _delta);
     void UpdateSlowingTowerShooting (float _towerX, float _towerY, UINT _towerId, float _delta);
     void UpdateAreaTowerShooting (float _towerX, float _towerY, UINT _towerId, float _delta);
-    bool IsEnemyInTowerRange (float _TowerX, float _TowerY, UINT _TowerId, std::list<EnemyInfo>::iterator _Enemy, VECTOR3& _NextPosition);
+    bool IsEnemyInTowerRange (UINT _TowerId, std::list<EnemyInfo>::iterator _Enemy);
     bool IsObjectVisible (float _frustum[6][4], UINT _id);
     /* Enemies */
     bool IsEnemyVisible (float _frustum[6][4], const std::list<EnemyInfo>::iterator _enemy);
-    void AddEnemyWave (const EnemyAdditionDetails& _details);
+    void AddEnemyWave (const EnemyAdditionDetails& _details, float _strengthBonus);
     void UpdateEnemyWaves (float _delta);
     void AddEnemyWaves ();
     void NewEnemy (UINT _waveIndex, float _animSpeed);
+    void AttachEnemyResources (EnemyInfo& _enemy);
+    void BakeEnemyPoses (const char* _modelFile, const char* _animationFile, const std::map<std::string, EnemyAnimation>& _animations);
+    void WritePoseCacheReport (FILE* _report);
+    void WriteMeshReport (FILE* _report);
+    void WriteTextureReport (FILE* _report);
     void ChangeEnemyDirection (std::list<EnemyInfo>::iterator _enemy);
+    void UpdateEnemyOrder ();
     void UpdateEnemyMovement (float _delta);
+    void MoveEnemies (UINT _begin, UINT _end, float _Delta);
+    void AnimateEnemies (UINT _begin, UINT _end);
+    UINT GetPoseInterval (const std::list<EnemyInfo>::iterator _enemy);
     void UpdateEnemies (float _delta);
-    void RenderEnemies (float _delta);
+    void UpdateDeadEnemies (float _delta);
+    void InterpolateEnemies (float _Alpha);
+    void RenderEnemies ();
     void RenderEnemyHealthBar (const std::list<EnemyInfo>::iterator _enemy);
+    /* Events */
+    void ProcessEvents (float _delta);
+    void ProcessShotEvents ();
+    void ProcessEnemyShotEvents (float _delta);
+    void ProcessHitEvents ();
+    void ProcessDeathEvents ();
+    bool IsPointVisible (float _frustum[6][4], const VECTOR3& _point, float _radius);
+    bool IsPointAudible (const VECTOR3& _point);
     /* Sound */
     void PauseSounds ();
     void UnpauseSounds ();
@@ -260,7 +449,6 @@ protected:
                              const VECTOR3& _min, const VECTOR3& _max, float& _distance);
     void ReadEnemyAnimation (const char* _filename, EnemyInfo& _enemy);
     float GetHeight (const VECTOR3& _position);
-    float GetDistanceTime (UINT _towerId, const VECTOR3& _origin, const VECTOR3& _destination);
 private:
     RendererLoader* m_RendererLoader;
     TerrainEngineLoader* m_TerrainLoader;
@@ -272,6 +460,7 @@ private:
     InputSystem* m_Input;
     Ms3dLoader* m_Ms3dLoader;
     TerrainEngine* m_Terrain;
+    HeightField m_HeightField;
     GameUI* m_GameUI;
 
     FpsCounter m_Timer;
@@ -291,6 +480,8 @@ private:
     VECTOR3 m_ShadowMapLightDir;
     VECTOR3 m_ShadowMapLightEye;
     VECTOR3 m_ShadowMapLightTarget;
+    float m_ShadowMapFrustum[6][4];
+    ShadowCascades m_ShadowCascades;
 
     bool m_IsLevelLoaded;
     bool m_IsContinuing;
@@ -310,22 +501,55 @@ private:
     std::vector<WaveInfo> m_EnemyWaves;
     float m_NextWaveTimeLeft;
     std::list<EnemyInfo> m_Enemies;
+    std::map<std::string, std::map<std::string, EnemyAnimation>> m_EnemyAnimations;   /* by animation file */
+    std::map<std::string, float> m_PoseSampleRates;     /* by animation file, from its SampleRate line */
+    std::vector<std::pair<const EnemyInfo*, UINT>> m_SnapshotEnemyIndex;   /* sorted by address */
+    Autosave m_Autosave;
+    CommandLog m_CommandLog;
+    std::string m_RecordFile;   /* empty when not recording */
+    bool m_IsHashingRecord;
+    float m_RecordedCamera[6];
+    UINT m_Tick;                /* simulation steps since the level started */
+    UINT m_StateHash;
     std::vector<WaypointInfo> m_Waypoints;
+    EnemyPath m_Path;
     int m_FinalWaypointIndex;
 
     bool m_KeepInfoMessage;
     UINT m_BuildingFieldTextureId;
     std::vector<std::vector<bool>> m_Occupied;
     ObjManager* m_ObjManager;
+    std::string m_ScenarioFile;
+    Scenario m_Scenario;
     std::vector<TowerInfo> m_Towers;
+    TargetingKernel m_Targets;  /* live enemies packed once per simulation step */
+    std::vector<std::list<EnemyInfo>::iterator> m_TargetEnemies;
+    std::vector<std::list<EnemyInfo>::iterator> m_EnemyOrder;  /* random access for the jobs */
+    JobSystem m_Jobs;
+    AssetLoader* m_Assets;
+    std::vector<UINT> m_TowerAssets;    /* texture and model handles of every tower type */
+    AnimationLod m_AnimationLod;
+    VECTOR3 m_AnimationEye;     /* camera position of the frame */
+    UINT m_AnimationFrame;      /* frames animated, staggers the poses */
+    UINT m_NumPoses;            /* evaluated in the last frame */
+    UINT m_NumHiddenEnemies;
+    UINT m_NumReducedEnemies;   /* animated at a reduced rate */
+    float m_PoseSampleRate;
     std::vector<TowerInfo> m_PreparedTowers;
     std::vector<TowerUpgradeInfo> m_UpgradeInfo;
     TowerType m_BuildingTowerType;
     UINT m_SelectedTowerId;
     std::vector<UINT> m_TowerGhost;
     bool m_ShouldRenderTowerGhost;
+    bool m_IsTowerGhostPlaced;
+    VECTOR3 m_TowerGhostPosition;
+    RingMeshCache* m_RingMeshes;
 
     float m_SpeedUpFactor;
+    float m_SimulationStep;
+    UINT m_MaxSimulationSteps;
+    float m_SimulationTime;     /* real time not yet simulated, scaled by the speed-up */
+    GameEventBuffer m_Events;   /* from the simulation steps of the frame */
 
     ResourceInfo m_Resource;
     UINT m_Score;
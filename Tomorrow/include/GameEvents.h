@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../include/RenderDevice.h"
+#include <vector>
+
+enum GameEventType {
+    EVENT_SHOT = 0,     /* a tower fired */
+    EVENT_HIT = 1,      /* a shot reached a living enemy */
+    EVENT_DEATH = 2,    /* an enemy was killed */
+    EVENT_ENEMY_SHOT = 3,   /* an enemy at the castle began to fire */
+    NUM_EVENT_TYPES = 4
+};
+
+struct GameEvent {
+    UINT TowerId;       /* shot */
+    UINT EnemyId;       /* enemy shot */
+    UINT SoundId;       /* death: the enemy's steps */
+    VECTOR3 Position;   /* shot origin, hit and death position */
+    VECTOR3 Target;     /* shot destination, hit direction */
+};
+
+/* Side effects of the simulation steps of one frame.
+   The steps only append events; sounds, particles and the hood are updated
+   from them in batches of one type after the steps, where events that are
+   not seen or heard can be culled. Counters are kept per type. */
+class GameEventBuffer {
+public:
+    GameEventBuffer ();
+    void Add (GameEventType _type, const GameEvent& _event);
+    const std::vector<GameEvent>& GetEvents (GameEventType _type) const;
+    /* marks one event of the current batch as dropped by its consumer */
+    void Cull (GameEventType _type);
+    /* empties the buffer for the next frame, the memory is kept */
+    void Clear ();
+    UINT GetNumCulled (GameEventType _type) const;
+    /* events added since the last ResetTotals */
+    UINT GetTotal (GameEventType _type) const;
+    UINT GetTotalCulled (GameEventType _type) const;
+    void ResetTotals ();
+private:
+    std::vector<GameEvent> m_Events[NUM_EVENT_TYPES];
+    UINT m_NumCulled[NUM_EVENT_TYPES];
+    UINT m_Totals[NUM_EVENT_TYPES];
+    UINT m_TotalsCulled[NUM_EVENT_TYPES];
+};
@@ -1,4 +1,5 @@
 #include "../include/RenderDevice.h"
+#include "../include/Minimap.h"
 #include <map>
 #include <list>
 
@@ -80,6 +81,11 @@
 #define MAIN_SCREEN_EXIT_LOWER_X 166.0f
 #define MAIN_SCREEN_EXIT_LOWER_Y 300.0f
 
+#define LOADING_BAR_WIDTH 400.0f
+#define LOADING_BAR_HEIGHT 12.0f
+#define LOADING_BAR_BOTTOM 60.0f     /* from the bottom of the window */
+#define LOADING_BAR_COLOR 0xccffffff
+
 #define MAX_NUM_MESSAGES 5
 
 class GameUI {
@@ -87,7 +93,7 @@ public:
     GameUI (RenderDevice* _Device, UINT _WindowWidth, UINT _WindowHeight);
     ~GameUI ();
     void RenderMainScreen (bool _isSaved);
-    void RenderLoadingScreen ();
+    void RenderLoadingScreen (float _progress);
     void RenderControlsScreen ();
     bool IsCursorOnNewGame (POINT _cursor);
     bool IsCursorOnContinueGame (POINT _cursor);
@@ -105,10 +111,11 @@ public:
     void IncreaseCastleHitPoints (UINT _hitPoints);
     UINT GetCastleHitPoints ();
     void SetMaxCastleHitPoints (UINT _maxHitPoints);
-    void UpdateEnemyMark (UINT _EnemyId, VECTOR3 _Position);
-    void RemoveEnemyMark (UINT _EnemyId);
-    void UpdateTowerMark (UINT _TowerId, VECTOR3 _Position);
-    void RemoveTowerMark (UINT _TowerId);
+    UINT AddEnemyMark (VECTOR3 _Position);
+    void UpdateEnemyMark (UINT _MarkId, VECTOR3 _Position);
+    void RemoveEnemyMark (UINT _MarkId);
+    UINT AddTowerMark (VECTOR3 _Position);
+    void RemoveTowerMark (UINT _MarkId);
     void RemoveAllMarks ();
     bool IsCursorOnHood (POINT _cursor);
     bool IsCursorOnTowerA (POINT _cursor);
@@ -140,11 +147,6 @@ private:
         Offset Position;
     };
 
-    struct MapObject {
-        DWORD Color;
-        cml::vector2f Location;
-    };
-
     struct MainScreenSkin {
         UINT Background;
         UINT NewGame;
@@ -161,7 +163,6 @@ private:
     };
 
     void SetupMainScreen ();
-    void UpdateMark (UINT _Id, VECTOR3 _Position, DWORD _Color);
 
     bool m_IsMainHoodEnabled;
 
@@ -177,7 +178,7 @@ private:
     UINT m_HoodMapSkinId;
     vs3d::TLVERTEX* m_HoodMapVertex;
     vs3d::TLCVERTEX* m_HoodMapPos;
-    std::map<UINT, MapObject> m_MapObjects; // Key = type * 10000 + id where type = {enemy = 1, tower = 2, object = 3}
+    Minimap* m_Minimap;
 
     vs3d::TLCVERTEX* m_MainInfoVertex;
     vs3d::TLCVERTEX* m_CastleHitPointsVertex;
@@ -193,6 +194,7 @@ private:
     Offset m_ResourceTextPos;
 
     char m_NextWaveTimeMsg[MAX_PATH];
+    UINT m_NextWaveTimeShown;
     Offset m_NextWaveTimeMsgPos;
 
     vs3d::TLVERTEX* m_MessageBox;
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "../include/TerrainEngine.h"
+#include <vector>
+
+/* Game side copy of the scaled terrain heights in one flat array.
+   It is refreshed only when the terrain reports a new heightmap revision,
+   so height queries neither cross the DLL boundary nor check bounds per
+   sample. Heights are interpolated over the same triangles the terrain
+   mesh is built of; positions outside the terrain are clamped to its edge. */
+class HeightField {
+public:
+    HeightField ();
+    bool Refresh (ITerrain* _Terrain);
+    void Clear ();
+    bool IsEmpty () const;
+    float GetGridHeight (UINT _X, UINT _Z) const;
+    float GetHeight (float _X, float _Z) const;
+    void GetHeights (const float* _X, const float* _Z, float* _Heights, UINT _Count) const;
+private:
+    std::vector<float> m_Heights;   // row after row along z
+    UINT m_Size;
+    UINT m_Revision;
+    float m_InvScaleX;
+    float m_InvScaleZ;
+};
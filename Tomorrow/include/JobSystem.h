@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../include/RenderDevice.h"
+#include <vector>
+#include <deque>
+
+#define JOB_MAX_THREADS 16
+
+/* Work done over a range of items, Run may be called from any thread
+   with any part of the range. */
+class JobTask {
+public:
+    virtual ~JobTask () {}
+    virtual void Run (UINT _begin, UINT _end) = 0;
+};
+
+/* Fork-join pool of worker threads.
+   ParallelFor cuts the range into jobs of _grain items and deals them out
+   to the queues of all threads, the calling thread included. A thread takes
+   jobs from the back of its own queue and steals from the front of the
+   others when it runs out. The call returns when every job is done, so the
+   task only has to outlive the call. The first error thrown by a job is
+   thrown again from the call. Idle workers sleep on a semaphore. */
+class JobSystem {
+public:
+    JobSystem ();
+    ~JobSystem ();
+    /* 0 uses a thread per processor, 1 runs everything on the calling thread */
+    void Start (UINT _numThreads);
+    void Stop ();
+    /* the calling thread included */
+    UINT GetNumThreads () const;
+    void ParallelFor (JobTask& _task, UINT _count, UINT _grain);
+private:
+    struct Job {
+        JobTask* Task;
+        UINT Begin;
+        UINT End;
+    };
+    struct Worker {
+        CRITICAL_SECTION Lock;
+        std::deque<Job> Jobs;
+        HANDLE Thread;
+        JobSystem* System;
+        UINT Index;
+    };
+    static DWORD WINAPI WorkerProc (LPVOID _worker);
+    void Work (UINT _index);
+    bool PopJob (UINT _index, Job& _job);
+    void RunJobs (UINT _index);
+
+    std::vector<Worker*> m_Workers;     /* 0 is the calling thread */
+    HANDLE m_WakeSemaphore;             /* a count for each worker to wake */
+    HANDLE m_DoneEvent;                 /* set by the thread finishing the last job */
+    volatile LONG m_NumPending;
+    volatile LONG m_IsStopping;
+    volatile LONG m_HasFailed;
+    ErrorMessage m_Error;               /* of the first failed job */
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../include/RenderDevice.h"
+#include <vector>
+
+#define MINIMAP_INITIAL_CAPACITY 256
+
+/* Minimap marks kept in one persistent vertex buffer.
+   Static marks (towers) occupy the front of the buffer and dynamic marks
+   (enemies) the back, so only the dirty range is uploaded each frame. */
+class Minimap {
+public:
+    Minimap (RenderDevice* _Device);
+    ~Minimap ();
+    void SetArea (float _X, float _Y, float _Width, float _Height, float _MapSizeX, float _MapSizeY);
+    UINT AddStaticMark (const VECTOR3& _Position, DWORD _Color);
+    UINT AddDynamicMark (const VECTOR3& _Position, DWORD _Color);
+    void UpdateMark (UINT _MarkId, const VECTOR3& _Position);
+    void RemoveMark (UINT _MarkId);
+    void RemoveAllMarks ();
+    void Render (float _PointSize);
+    UINT GetNumMarks () const;
+private:
+    UINT AddMark (const VECTOR3& _Position, DWORD _Color);
+    void SetLocation (UINT _Slot, const VECTOR3& _Position);
+    void MoveSlot (UINT _From, UINT _To);
+    void MarkDirty (UINT _Slot);
+    void Upload ();
+
+    std::vector<vs3d::TLCVERTEX> m_Vertices;    // dense, [0, m_NumStatic) are static marks
+    std::vector<UINT> m_SlotOwner;              // slot -> mark ID
+    std::vector<UINT> m_MarkSlot;               // mark ID -> slot, INVALID_ID if free
+    std::vector<UINT> m_FreeMarks;
+    UINT m_NumStatic;
+
+    UINT m_DirtyStart;
+    UINT m_DirtyEnd;
+
+    UINT m_BufferId;
+    UINT m_BufferCapacity;
+
+    float m_AreaX;
+    float m_AreaY;
+    float m_AreaWidth;
+    float m_AreaHeight;
+    float m_MapSizeX;
+    float m_MapSizeY;
+
+    RenderDevice* m_Device;
+};
@@ -15,11 +15,13 @@ class ObjManager;
     #include <crtdbg.h>*/
     #pragma comment (lib, "lib/Debug/RendererLoader.lib")
     #pragma comment (lib, "lib/Debug/ErrorMessage.lib")
+    #pragma comment (lib, "lib/Debug/PackFile.lib")
     /*#define DEBUG_NEW new(_NORMAL_BLOCK, __FILE__, __LINE__)
     #define new DEBUG_NEW*/
 #else
     #pragma comment (lib, "lib/RendererLoader.lib")
     #pragma comment (lib, "lib/ErrorMessage.lib")
+    #pragma comment (lib, "lib/PackFile.lib")
 #endif
 
 /** obj model vertex. */
@@ -55,7 +57,8 @@ This structure describes the object.
 ObjModelObject::ModelData is used for rendering the object dynamically.
 The vertices prepared for the rendering are restored there and
 in this way the preparation for the rendering every frame is avoided.
-It is done only when vertex information has been changed.*/
+It is done only when vertex information has been changed.
+@see ObjModel::RenderTransformed() renders without the rebuilds */
 struct ObjModelObject {
     std::vector<ObjModelFace> Faces;    /**< Object faces (aka triangles). */
     void* ModelData;                    /**< Model data. */
@@ -73,6 +76,8 @@ struct ObjModelMesh {
 struct ObjRenderingInfo {
     UINT BufferId;          /**< Static buffer ID of the model. */
     UINT StartVertex;       /**< At which vertex the rendering should start. */
+    UINT IndexBufferId;     /**< Static index buffer ID, INVALID_ID if the vertices are not indexed. */
+    UINT StartIndex;        /**< At which index the rendering should start. */
     UINT PrimitiveCount;    /**< Number of the primitives. */
     UINT SkinId;            /**< Skin ID. */
     VERTEXFORMATTYPE VertexFormat;  /**< Vertex format. */
@@ -109,11 +114,36 @@ public:
         - @c ERRC_API_CALL D3DXCreateTextureFromFile failure */
     void Load (const char* _filename);
 
+    /** Loads the geometry of the *.obj format model, without the materials.
+    It does not use the device, so it can be called from any thread.
+    The model is complete when ObjModel::LoadMaterials() is called.
+    @param[in] _filename A filename of the model.
+    @exception ErrorMessage 
+
+    - Possible error codes:
+        - @c ERRC_FILE_NOT_FOUND specified file does not exist.
+        - @c ERRC_BAD_FILE file is either corrupted or not *.obj format
+        - @c ERRC_OUT_OF_MEM not enough memory to load the model */
+    void LoadGeometry (const char* _filename);
+
+    /** Loads the material infomation of the model.
+    The skins are added on the calling thread, the one which renders.
+    @exception ErrorMessage 
+
+    - Possible error codes:
+        - @c ERRC_OUT_OF_MEM not enough memory to load materials 
+        - @c ERRC_OUT_OF_RANGE invalid ID 
+        - @c ERRC_API_CALL D3DXCreateTextureFromFile failure */
+    void LoadMaterials ();
+
     /** Unloads the model. */
     void Unload ();
 
     /** Prepares the model for the rendering.
     It needs to be called before the static rendering.
+    The identical vertices of every object are welded into an indexed
+    triangle list, which is reordered for the post-transform vertex cache,
+    the overdraw and the vertex fetch.
     @exception ErrorMessage 
 
     - Possible error codes:
@@ -143,6 +173,22 @@ public:
         - @c ERRC_API_CALL index buffer Lock() failure */
     void RenderDynamic ();
 
+    /** Renders the untransformed model, transformed by the world matrix.
+    The vertices of every object are put into the static buffers once,
+    so moving, rotating and scaling the model only changes the world matrix
+    of its rendering. Changing the color of the model puts the vertices
+    into the buffers again. The world matrix is restored after the call.
+    An active effect should take its world matrix from
+    ObjModel::GetTransformation() multiplied by the world matrix.
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_BAD_FILE models without textures and with normals are not supported
+        - @c ERRC_OUT_OF_MEM not enough memory
+        - @c ERRC_API_CALL SetTransform() failure
+        - @c ERRC_UNKNOWN_VF invalid vertex format */
+    void RenderTransformed ();
+
     /** Renders the bounds of the model using static buffers.
     @exception ErrorMessage 
 
@@ -230,6 +276,12 @@ public:
     /** Clears the translation, rotation and scale transformations. */
     void ClearTransformations ();
 
+    /** Getter: transformation of the model.
+    @return scale, rotation and translation matrices multiplied in this order */
+    inline MATRIX44 GetTransformation () const {
+        return m_Scale * m_Rotation * m_Translation;
+    }
+
     /** Sets the size of the model.
     @param[in] _size a scale factor which value must be > 0.0f */
     inline void SetSize (float _size) {
@@ -302,6 +354,36 @@ public:
         m_ModelColor = _color;
     }
 
+    /** Getter: number of the triangles put into the static buffers by the last preparation.
+    @return number of the triangles */
+    inline UINT GetNumTriangles () const {
+        return m_NumTriangles;
+    }
+
+    /** Getter: number of the vertices the model had before the welding.
+    @return number of the triangle corners */
+    inline UINT GetNumCorners () const {
+        return m_NumCorners;
+    }
+
+    /** Getter: number of the vertices put into the static buffers by the last preparation.
+    @return number of the welded vertices */
+    inline UINT GetNumRenderVertices () const {
+        return m_NumRenderVertices;
+    }
+
+    /** Getter: average cache miss ratio of the welded triangles in the file order.
+    @return transformed vertices per triangle, with a FIFO cache of OBJ_FIFO_CACHE_SIZE */
+    inline float GetAcmrBefore () const {
+        return m_NumTriangles > 0 ? (float)m_CacheMissesBefore / m_NumTriangles : 0.0f;
+    }
+
+    /** Getter: average cache miss ratio of the optimised triangles.
+    @return transformed vertices per triangle, with a FIFO cache of OBJ_FIFO_CACHE_SIZE */
+    inline float GetAcmrAfter () const {
+        return m_NumTriangles > 0 ? (float)m_CacheMissesAfter / m_NumTriangles : 0.0f;
+    }
+
     /** Should the loader use the mtl file to get the material information. 
     @param[in] _shouldUse @c true if it should use mtl file. @c false otherwise */
     inline void UseMtlFile (bool _shouldUse) {
@@ -333,15 +415,6 @@ private:
         - @c ERRC_OUT_OF_MEM not enough memory to load faces */
     void LoadFace (const char (&_line)[MAX_PATH]);
 
-    /** Loads the material infomation of the model.
-    @exception ErrorMessage 
-
-    - Possible error codes:
-        - @c ERRC_OUT_OF_MEM not enough memory to load materials 
-        - @c ERRC_OUT_OF_RANGE invalid ID 
-        - @c ERRC_API_CALL D3DXCreateTextureFromFile failure */
-    void LoadMaterials ();
-
     /** Transforms the vertices of the model by the specified transformation.
     @param[in] _transformation transformation which should be applied */
     void MakeTransformation (const MATRIX44& _transformation);
@@ -371,6 +444,77 @@ private:
         - @c ERRC_UNKNOWN_FVF invalid vertex format */
     void PrepareBoundsRendering ();
 
+    /** Welds, optimises and puts the vertices of an object into the static buffers.
+    @param[in] _meshId index of the mesh of the object
+    @param[in] _object the object of the model
+    @param[in] _transformation transformation applied to the vertices, NULL for none
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_BAD_FILE the object refers to a missing vertex or
+          models without textures and with normals are not supported
+        - @c ERRC_OUT_OF_MEM not enough memory
+        - @c ERRC_API_CALL
+        - @c ERRC_UNKNOWN_VF invalid vertex format
+
+    @return rendering information of the object, not prepared if it has no triangles */
+    ObjRenderingInfo PrepareObject (UINT _meshId, const ObjModelObject& _object, const MATRIX44* _transformation);
+
+    /** Creates the vertices of the triangle corners of an object.
+    @param[in] _object the object of the model
+    @param[in] _corner corner (3 * face + vertex of the face) of every vertex, NULL for all corners in order
+    @param[in] _numVertices number of the vertices
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_BAD_FILE models without textures and with normals are not supported
+        - @c std::bad_alloc not enough memory
+
+    @return the vertices in the vertex format of the model, they are released with delete[] */
+    void* CreateVertices (const ObjModelObject& _object, const UINT* _corner, UINT _numVertices) const;
+
+    /** Transforms the positions and the normals of the vertices.
+    @param[in,out] _modelData the vertices in the vertex format of the model
+    @param[in] _numVertices number of the vertices
+    @param[in] _transformation the transformation */
+    void TransformVertices (void* _modelData, UINT _numVertices, const MATRIX44& _transformation) const;
+
+    /** Resets the statistics of the prepared meshes. */
+    void ClearMeshStatistics ();
+
+    /** Renders an object from the static buffers.
+    @param[in] _info rendering information of the object */
+    void RenderObject (const ObjRenderingInfo& _info);
+
+    /** Puts the untransformed vertices of the objects into the static buffers.
+    It is called by ObjModel::RenderTransformed() method.
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_BAD_FILE models without textures and with normals are not supported
+        - @c ERRC_OUT_OF_MEM not enough memory
+        - @c ERRC_API_CALL
+        - @c ERRC_UNKNOWN_VF invalid vertex format */
+    void PrepareTransformedRendering ();
+
+    /** Fills the model data of the object with its untransformed vertices.
+    @param[in,out] _object the object of the model
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_BAD_FILE models without textures and with normals are not supported
+        - @c std::bad_alloc not enough memory */
+    void ExpandObject (ObjModelObject& _object);
+
+    /** Getter: vertex format of the model.
+    @exception ErrorMessage
+
+    - Possible error codes:
+        - @c ERRC_BAD_FILE models without textures and with normals are not supported
+
+    @return vertex format used for the rendering */
+    VERTEXFORMATTYPE GetVertexFormat () const;
+
     /** Setter: bounds vertex information.
     @param[out] _vertex the vertex of the bounds
     @param[in] _x the x coordinate of the vertex
@@ -407,6 +551,14 @@ private:
     MATRIX44 m_Rotation;            /**< Rotation transformation matrix. */
 
     std::vector<ObjRenderingInfo> m_RenderingInfo;  /**< The rendering information of the model. */
+    std::vector<ObjRenderingInfo> m_TransformedInfo;    /**< The rendering information of the untransformed objects. */
+    DWORD m_TransformedColor;       /**< The color of the untransformed objects in the buffers. */
+    bool m_IsTransformedPrepared;   /**< Are the untransformed objects in the buffers. */
+    UINT m_NumTriangles;            /**< Triangles of the last preparation. */
+    UINT m_NumCorners;              /**< Triangle corners of the last preparation. */
+    UINT m_NumRenderVertices;       /**< Welded vertices of the last preparation. */
+    UINT m_CacheMissesBefore;       /**< Cache misses of the welded triangles in the file order. */
+    UINT m_CacheMissesAfter;        /**< Cache misses of the optimised triangles. */
     ObjBoundsRenderingInfo m_BoundsInfo;    /**< The rendering information of the bounds. */
     ObjManager* m_Manager;          /**< A pointer to ObjManager object. */
 
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../include/RenderDevice.h"
+#include <vector>
+#include <map>
+
+/* Unit disc meshes (center vertex plus a ring of perimeter vertices in the
+   XY plane) kept in static buffers, one per segment count and color.
+   Circles and progress arcs are placed through the world matrix, so no
+   vertices are rebuilt per frame. */
+class RingMeshCache {
+public:
+    RingMeshCache (RenderDevice* _Device);
+    ~RingMeshCache ();
+    void RenderCircle (const VECTOR3& _Center, float _Radius, UINT _NumSegments, DWORD _Color);
+    void RenderArc (const VECTOR3& _Center, const VECTOR3& _Right, const VECTOR3& _Up, float _Radius, float _Fraction, UINT _NumSegments, DWORD _Color);
+    void BuildCircle (const VECTOR3& _Center, float _Radius, UINT _NumSegments, DWORD _Color, std::vector<vs3d::ULCVERTEX>& _Vertices);
+    void RenderVertices (std::vector<vs3d::ULCVERTEX>& _Vertices);
+private:
+    struct UnitMesh {
+        UINT VertexBufferId;
+        UINT IndexBufferId;
+    };
+
+    const std::vector<float>& GetUnitRing (UINT _NumSegments);
+    const UnitMesh& GetMesh (UINT _NumSegments, DWORD _Color);
+    UINT GetIndexBuffer (UINT _NumSegments);
+    void RenderMesh (const MATRIX44& _World, const UnitMesh& _Mesh, UINT _NumPrimitives);
+
+    std::map<std::pair<UINT, DWORD>, UnitMesh> m_Meshes;   // (segments, color) -> buffers
+    std::map<UINT, UINT> m_IndexBuffers;                    // segments -> index buffer
+    std::map<UINT, std::vector<float> > m_UnitRings;        // segments -> cos/sin pairs
+
+    RenderDevice* m_Device;
+};
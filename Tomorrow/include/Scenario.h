@@ -0,0 +1,108 @@
+#pragma once
+
+#include "../include/RenderDevice.h"
+#include "../include/PackFile.h"
+#include <vector>
+#include <map>
+#include <string>
+
+#define MAX_TOWER_LEVEL 5
+#define NUM_TOWER_TYPES 3
+#define SCENARIO_MAX_INCLUDES 8     /* nesting depth of include lines */
+
+enum TowerType {
+    BASIC_TOWER = 0,
+    SLOWING_TOWER = 1,
+    AREA_TOWER = 2
+};
+
+struct TowerUpgradeInfo {
+    float UpgradeTime[MAX_TOWER_LEVEL];
+    float RadiusIncrease[MAX_TOWER_LEVEL];
+    float AttackSpeedDecrease[MAX_TOWER_LEVEL];
+    UINT PowerIncrease[MAX_TOWER_LEVEL];
+    UINT Price[MAX_TOWER_LEVEL];
+};
+
+struct TowerDefinition {
+    std::string Model;
+    std::string Texture;
+    UINT Price;
+    float AttackSpeed;
+    UINT Power;
+    float Radius;
+    UINT Size;
+    float BuildingTime;
+    TowerUpgradeInfo Upgrade;
+};
+
+struct EnemyAdditionDetails {
+    float Delay;
+    float SpawnTime;
+    std::string Filename;
+    std::string AnimInfoFile;
+    UINT HitPoints;
+    float Speed;
+    float AttackSpeed;
+    float MaxAmmo;
+    UINT Power;
+    UINT NumResources;
+    UINT NumEnemies;
+    float ShotTime;
+    float ShotPauseTime;
+    bool IsFast;
+};
+
+struct TowerPlacement {
+    TowerType Type;
+    POINT Location;     /* heightmap grid */
+    UINT Level;
+};
+
+/* Tower types, enemy archetypes and the wave script of a level.
+   A scenario is a text file of keyword lines; '#' starts a comment.
+
+       include <file>                   reads another scenario first
+       tower basic|slowing|area ... end tower definition and upgrade table
+       enemy <name> ... end             enemy archetype
+       wave <enemy> <count> <delay> <spawn time>
+       repeat_strength <bonus>          strength added per script repetition
+       repeat_count <bonus>             enemy count added per script repetition
+       place <tower> <x> <z> <level>    tower built when the level starts
+
+   The wave script is played again after its last wave; every repetition
+   raises hit points and power by the strength bonus and the number of
+   enemies by the count bonus, both relative to the scripted values.
+   Waves given in a file replace the waves of the files it includes. */
+class Scenario {
+public:
+    Scenario ();
+    void Load (const char* _filename);
+    void Clear ();
+    bool IsLoaded () const;
+    const char* GetFilename () const;
+    const TowerDefinition& GetTower (TowerType _type) const;
+    UINT GetNumScriptWaves () const;
+    /* _wave counts from the first wave of the first repetition */
+    EnemyAdditionDetails GetWave (UINT _wave) const;
+    float GetStrengthBonus (UINT _wave) const;
+    UINT GetNumPlacements () const;
+    const TowerPlacement& GetPlacement (UINT _placement) const;
+private:
+    void Parse (const char* _filename, UINT _depth);
+    void ParseTower (VirtualFile& _file, const char* _filename);
+    void ParseEnemy (VirtualFile& _file, const char* _filename);
+    static bool ReadToken (VirtualFile& _file, char* _token);
+    static float ReadFloat (VirtualFile& _file, const char* _filename);
+    static UINT ReadUint (VirtualFile& _file, const char* _filename);
+    static TowerType ReadTowerType (VirtualFile& _file, const char* _filename);
+
+    std::string m_Filename;
+    TowerDefinition m_Towers[NUM_TOWER_TYPES];
+    bool m_IsTowerDefined[NUM_TOWER_TYPES];
+    std::map<std::string, EnemyAdditionDetails> m_Enemies;
+    std::vector<EnemyAdditionDetails> m_Waves;
+    float m_RepeatStrength;
+    float m_RepeatCount;
+    std::vector<TowerPlacement> m_Placements;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "../include/RenderDevice.h"
+
+/* Cascaded shadow map partitioning.
+   The camera frustum is split into slices up to the shadow distance and every
+   slice gets an orthographic light matrix fitted to its bounding sphere.
+   Far cascades can be refreshed less often than the near ones; a cascade keeps
+   the matrix it was last rendered with until it is refreshed again. */
+class ShadowCascades {
+public:
+    ShadowCascades ();
+    void Setup (UINT _NumCascades, float _Near, float _ShadowDistance, float _SplitLambda);
+    void SetSplit (UINT _Cascade, float _Distance);
+    void SetResolution (UINT _Cascade, UINT _Size);
+    void SetUpdateInterval (UINT _Cascade, UINT _Frames);
+    void SetCasterDistance (float _Distance);
+    void Update (const MATRIX44& _View, const MATRIX44& _Projection, float _Near, float _Far, const VECTOR3& _LightDir);
+    void Invalidate ();
+    bool IsDirty (UINT _Cascade) const;
+    UINT GetNumCascades () const;
+    float GetSplit (UINT _Cascade) const;
+    UINT GetResolution (UINT _Cascade) const;
+    const VECTOR3& GetLightEye (UINT _Cascade) const;
+    const MATRIX44& GetLightView (UINT _Cascade) const;
+    const MATRIX44& GetLightProj (UINT _Cascade) const;
+    const MATRIX44& GetLightViewProj (UINT _Cascade) const;
+
+    static float ComputeSplit (UINT _Index, UINT _NumCascades, float _Near, float _Far, float _Lambda);
+    static void GetFrustumCorners (const MATRIX44& _View, const MATRIX44& _Projection, VECTOR3 _Corners[8]);
+    static void GetSliceCorners (const VECTOR3 _FrustumCorners[8], float _Near, float _Far, float _SliceNear, float _SliceFar, VECTOR3 _Corners[8]);
+    static void FitLight (const VECTOR3 _Corners[8], const VECTOR3& _LightDir, UINT _Size, float _CasterDistance,
+                          VECTOR3& _Eye, MATRIX44& _View, MATRIX44& _Proj);
+private:
+    struct Cascade {
+        float Split;            // far distance of the slice in view space
+        UINT Size;
+        UINT UpdateInterval;    // in frames
+        bool IsDirty;
+        bool IsValid;           // matrices were fitted at least once
+        VECTOR3 LightEye;
+        MATRIX44 LightView;
+        MATRIX44 LightProj;
+        MATRIX44 LightViewProj;
+    };
+
+    Cascade m_Cascades[MAX_SHADOW_CASCADES];
+    UINT m_NumCascades;
+    float m_CasterDistance;
+    UINT m_Frame;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "../include/RenderDevice.h"
+#include <vector>
+
+/* Per tower targeting constants, refreshed when the tower is built or upgraded. */
+struct TowerAim {
+    VECTOR3 Origin;     /* muzzle, the bullet flight time is measured from it */
+    float RadiusSq;
+    float LeadTime;     /* bullet flight time per unit of distance */
+};
+
+/* Range test of one tower against all targets at once.
+   Targets are packed as separate position and velocity arrays. A target is
+   in range when its position, led by the bullet flight time, lies inside the
+   tower radius on the XZ plane; the test uses squared distances only. */
+class TargetingKernel {
+public:
+    static TowerAim MakeAim (const VECTOR3& _Origin, float _Radius, float _FlightTime);
+
+    void Clear ();
+    void Reserve (UINT _NumTargets);
+    UINT AddTarget (const VECTOR3& _Position, const VECTOR3& _Velocity);
+    UINT GetNumTargets () const;
+    bool IsInRange (const TowerAim& _Aim, UINT _Target) const;
+    /* appends the targets in range in the order they were added, returns their count */
+    UINT FindTargets (const TowerAim& _Aim, std::vector<UINT>& _Targets) const;
+private:
+    std::vector<float> m_X;
+    std::vector<float> m_Y;
+    std::vector<float> m_Z;
+    std::vector<float> m_VelocityX;
+    std::vector<float> m_VelocityZ;
+};
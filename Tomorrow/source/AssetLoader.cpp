@@ -0,0 +1,345 @@
+#include "../include/AssetLoader.h"
+#include "../include/PackFile.h"
+
+AssetLoader::AssetLoader (RenderDevice* _device, ObjManager* _objManager, Ms3dLoader* _ms3dLoader) {
+    m_Device = _device;
+    m_ObjManager = _objManager;
+    m_Ms3dLoader = _ms3dLoader;
+    m_NumFinished = 0;
+    m_NumDecoded = 0;
+    m_IsStopping = 0;
+    InitializeCriticalSection (&m_Lock);
+    m_QueuedSemaphore = CreateSemaphore (NULL, 0, 0x7fffffff, NULL);
+    m_StagedEvent = CreateEvent (NULL, FALSE, FALSE, NULL);
+    if (!m_QueuedSemaphore || !m_StagedEvent) {
+        if (m_QueuedSemaphore) {
+            CloseHandle (m_QueuedSemaphore);
+        }
+        if (m_StagedEvent) {
+            CloseHandle (m_StagedEvent);
+        }
+        DeleteCriticalSection (&m_Lock);
+        THROW_ERROR (ERRC_API_CALL);
+    }
+}
+
+AssetLoader::~AssetLoader () {
+    Stop ();
+    for (UINT i = 0; i < m_Requests.size (); i++) {
+        delete m_Requests[i]->Model;
+        delete m_Requests[i];
+    }
+    CloseHandle (m_QueuedSemaphore);
+    CloseHandle (m_StagedEvent);
+    DeleteCriticalSection (&m_Lock);
+}
+
+void AssetLoader::Start (UINT _numThreads) {
+    Stop ();
+    if (_numThreads == 0) {
+        SYSTEM_INFO info;
+        GetSystemInfo (&info);
+        _numThreads = info.dwNumberOfProcessors;
+    }
+    _numThreads = _numThreads > ASSET_MAX_THREADS ? ASSET_MAX_THREADS : _numThreads;
+    for (UINT i = 0; i < _numThreads; i++) {
+        HANDLE thread = CreateThread (NULL, 0, WorkerProc, this, 0, NULL);
+        if (!thread) {
+            Stop ();
+            THROW_ERROR (ERRC_API_CALL);
+        }
+        m_Threads.push_back (thread);
+    }
+    /* the requests queued before are counted again, a worker skips an empty queue */
+    EnterCriticalSection (&m_Lock);
+    if (!m_Queued.empty ()) {
+        ReleaseSemaphore (m_QueuedSemaphore, m_Queued.size (), NULL);
+    }
+    LeaveCriticalSection (&m_Lock);
+}
+
+void AssetLoader::Stop () {
+    if (m_Threads.empty ()) {
+        return;
+    }
+    InterlockedExchange (&m_IsStopping, 1);
+    ReleaseSemaphore (m_QueuedSemaphore, m_Threads.size (), NULL);
+    for (UINT i = 0; i < m_Threads.size (); i++) {
+        WaitForSingleObject (m_Threads[i], INFINITE);
+        CloseHandle (m_Threads[i]);
+    }
+    m_Threads.clear ();
+    InterlockedExchange (&m_IsStopping, 0);
+}
+
+UINT AssetLoader::RequestTexture (const char* _filename) {
+    UINT handle = FindRequest (ASSET_TEXTURE, _filename);
+    if (handle != INVALID_ID) {
+        return handle;
+    }
+    Request* request = NewRequest (ASSET_TEXTURE, _filename);
+    ISkinManager* skins = m_Device->GetSkinManager ();
+    if (skins->IsTextureLoaded (_filename)) {
+        Finish (request, skins->GetTextureId (_filename));
+    } else {
+        Queue (request);
+    }
+    return m_Requests.size () - 1;
+}
+
+UINT AssetLoader::RequestObjModel (const char* _filename) {
+    Request* request = NewRequest (ASSET_OBJ_MODEL, _filename);
+    try {
+        request->Model = new ObjModel (m_Device, m_ObjManager);
+    } catch (std::bad_alloc) {
+        Finish (request, INVALID_ID);
+        request->State = ASSET_FAILED;
+        request->Error = ERRC_OUT_OF_MEM;
+        return m_Requests.size () - 1;
+    }
+    Queue (request);
+    return m_Requests.size () - 1;
+}
+
+UINT AssetLoader::RequestMs3dFile (const char* _filename) {
+    UINT handle = FindRequest (ASSET_MS3D_FILE, _filename);
+    if (handle != INVALID_ID) {
+        return handle;
+    }
+    Request* request = NewRequest (ASSET_MS3D_FILE, _filename);
+    if (m_Ms3dLoader->IsFileCached (_filename)) {
+        Finish (request, INVALID_ID);
+    } else {
+        Queue (request);
+    }
+    return m_Requests.size () - 1;
+}
+
+bool AssetLoader::Update (float _budget) {
+    LARGE_INTEGER frequency, start, now;
+    QueryPerformanceFrequency (&frequency);
+    QueryPerformanceCounter (&start);
+    LONGLONG budget = (LONGLONG)(_budget * frequency.QuadPart);
+    now = start;
+    while (!IsFinished () && now.QuadPart - start.QuadPart < budget) {
+        Request* request = NULL;
+        bool isDecoded = true;
+        EnterCriticalSection (&m_Lock);
+        if (!m_Staged.empty ()) {
+            request = m_Staged.front ();
+            m_Staged.pop_front ();
+        } else if (m_Threads.empty () && !m_Queued.empty ()) {
+            request = m_Queued.front ();
+            m_Queued.pop_front ();
+            isDecoded = false;
+        }
+        LeaveCriticalSection (&m_Lock);
+        if (request) {
+            if (!isDecoded) {
+                Decode (*request);
+            }
+            Create (*request);
+            m_NumFinished++;
+        } else {
+            /* the workers are still reading, wait for them for the rest of the budget */
+            LONGLONG left = budget - (now.QuadPart - start.QuadPart);
+            WaitForSingleObject (m_StagedEvent, (DWORD)(left * 1000 / frequency.QuadPart) + 1);
+        }
+        QueryPerformanceCounter (&now);
+    }
+    return IsFinished ();
+}
+
+AssetState AssetLoader::GetState (UINT _handle) const {
+    if (_handle >= m_Requests.size ()) {
+        THROW_DETAILED_ERROR (ERRC_OUT_OF_RANGE, "Invalid asset handle.");
+    }
+    return (AssetState)m_Requests[_handle]->State;
+}
+
+UINT AssetLoader::GetResult (UINT _handle) const {
+    AssetState state = GetState (_handle);
+    const Request* request = m_Requests[_handle];
+    if (state == ASSET_FAILED) {
+        THROW_DETAILED_ERROR (request->Error, request->Filename.c_str ());
+    }
+    if (state != ASSET_READY) {
+        THROW_DETAILED_ERROR (ERRC_INVALID_PARAMETER, "The asset is still loading.");
+    }
+    return request->Result;
+}
+
+float AssetLoader::GetProgress () const {
+    if (m_Requests.empty ()) {
+        return 1.0f;
+    }
+    return (m_NumDecoded + m_NumFinished) / (2.0f * m_Requests.size ());
+}
+
+bool AssetLoader::IsFinished () const {
+    return m_NumFinished == m_Requests.size ();
+}
+
+void AssetLoader::Clear () {
+    if (!IsFinished ()) {
+        THROW_DETAILED_ERROR (ERRC_INVALID_PARAMETER, "The assets are still loading.");
+    }
+    for (UINT i = 0; i < m_Requests.size (); i++) {
+        delete m_Requests[i];
+    }
+    m_Requests.clear ();
+    m_NumFinished = 0;
+    m_NumDecoded = 0;
+}
+
+DWORD WINAPI AssetLoader::WorkerProc (LPVOID _loader) {
+    ((AssetLoader*)_loader)->Work ();
+    return 0;
+}
+
+void AssetLoader::Work () {
+    while (true) {
+        WaitForSingleObject (m_QueuedSemaphore, INFINITE);
+        if (m_IsStopping) {
+            return;
+        }
+        Request* request = NULL;
+        EnterCriticalSection (&m_Lock);
+        if (!m_Queued.empty ()) {
+            request = m_Queued.front ();
+            m_Queued.pop_front ();
+        }
+        LeaveCriticalSection (&m_Lock);
+        if (!request) {
+            continue;
+        }
+        Decode (*request);
+        EnterCriticalSection (&m_Lock);
+        m_Staged.push_back (request);
+        LeaveCriticalSection (&m_Lock);
+        SetEvent (m_StagedEvent);
+    }
+}
+
+/* a failed request is not shared, asking for its file again retries it */
+UINT AssetLoader::FindRequest (AssetType _type, const char* _filename) const {
+    for (UINT i = 0; i < m_Requests.size (); i++) {
+        if (m_Requests[i]->Type == _type && m_Requests[i]->Filename == _filename &&
+            m_Requests[i]->State != ASSET_FAILED) {
+            return i;
+        }
+    }
+    return INVALID_ID;
+}
+
+AssetLoader::Request* AssetLoader::NewRequest (AssetType _type, const char* _filename) {
+    Request* request = NULL;
+    try {
+        request = new Request;
+        request->Type = _type;
+        request->Filename = _filename;
+        request->State = ASSET_QUEUED;
+        request->Error = ERRC_UNDEFINED;
+        request->Model = NULL;
+        request->Result = INVALID_ID;
+        m_Requests.push_back (request);
+    } catch (std::bad_alloc) {
+        delete request;
+        THROW_ERROR (ERRC_OUT_OF_MEM);
+    }
+    return request;
+}
+
+void AssetLoader::Queue (Request* _request) {
+    EnterCriticalSection (&m_Lock);
+    try {
+        m_Queued.push_back (_request);
+    } catch (std::bad_alloc) {
+        LeaveCriticalSection (&m_Lock);
+        Finish (_request, INVALID_ID);
+        _request->State = ASSET_FAILED;
+        _request->Error = ERRC_OUT_OF_MEM;
+        return;
+    }
+    LeaveCriticalSection (&m_Lock);
+    ReleaseSemaphore (m_QueuedSemaphore, 1, NULL);
+}
+
+void AssetLoader::Finish (Request* _request, UINT _result) {
+    _request->Result = _result;
+    _request->State = ASSET_READY;
+    InterlockedIncrement (&m_NumDecoded);
+    m_NumFinished++;
+}
+
+/* Worker thread, nothing here may touch the device */
+void AssetLoader::Decode (Request& _request) {
+    try {
+        switch (_request.Type) {
+            case ASSET_TEXTURE: {
+                /* the cooked file is read when there is one, the texture is still known by the source name */
+                if (m_Device->GetSkinManager ()->HasCookedTexture (_request.Filename.c_str ())) {
+                    ReadFileData ((_request.Filename + COOKED_TEXTURE_EXTENSION).c_str (), _request.Data);
+                } else {
+                    ReadFileData (_request.Filename.c_str (), _request.Data);
+                }
+                /* D3DX decodes the pixels while it creates the texture, it needs
+                   the device, so only the header is checked here */
+                D3DXIMAGE_INFO info;
+                if (FAILED (D3DXGetImageInfoFromFileInMemory (&_request.Data[0], _request.Data.size (), &info))) {
+                    THROW_DETAILED_ERROR (ERRC_BAD_FILE, _request.Filename.c_str ());
+                }
+                break;
+            }
+            case ASSET_OBJ_MODEL:
+                _request.Model->LoadGeometry (_request.Filename.c_str ());
+                break;
+            case ASSET_MS3D_FILE:
+                ReadFileData (_request.Filename.c_str (), _request.Data);
+                break;
+        }
+        InterlockedExchange (&_request.State, ASSET_STAGED);
+    } catch (ErrorMessage& e) {
+        _request.Error = e.GetErrorCode ();
+        InterlockedExchange (&_request.State, ASSET_FAILED);
+    } catch (std::bad_alloc) {
+        _request.Error = ERRC_OUT_OF_MEM;
+        InterlockedExchange (&_request.State, ASSET_FAILED);
+    }
+    InterlockedIncrement (&m_NumDecoded);
+}
+
+/* Render thread */
+void AssetLoader::Create (Request& _request) {
+    if (_request.State == ASSET_STAGED) {
+        try {
+            switch (_request.Type) {
+                case ASSET_TEXTURE:
+                    _request.Result = m_Device->GetSkinManager ()->AddTexture (_request.Filename.c_str (), &_request.Data[0], _request.Data.size ());
+                    break;
+                case ASSET_OBJ_MODEL:
+                    _request.Model->LoadMaterials ();
+                    _request.Result = m_ObjManager->AddModel (_request.Model);
+                    _request.Model = NULL;  /* the manager owns it */
+                    break;
+                case ASSET_MS3D_FILE:
+                    m_Ms3dLoader->AddFileData (_request.Filename.c_str (), _request.Data);
+                    break;
+            }
+            _request.State = ASSET_READY;
+        } catch (ErrorMessage& e) {
+            _request.Error = e.GetErrorCode ();
+            _request.State = ASSET_FAILED;
+        }
+    }
+    delete _request.Model;
+    _request.Model = NULL;
+    std::vector<char> ().swap (_request.Data);  /* the staging memory */
+}
+
+void AssetLoader::ReadFileData (const char* _filename, std::vector<char>& _data) {
+    VirtualFile::Load (_filename, _data);
+    if (_data.empty ()) {
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+}
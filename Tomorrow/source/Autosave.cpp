@@ -0,0 +1,193 @@
+#include "../include/Autosave.h"
+#include "../include/Game.h"
+
+Autosave::Autosave () {
+    m_Filename[0] = '\0';
+    m_Interval = 0.0f;
+    m_TimeLeft = 0.0f;
+    m_MemoryBudget = 0;
+    m_Snapshots[0] = NULL;
+    m_Snapshots[1] = NULL;
+    m_Capturing = -1;
+    m_Pending = -1;
+    m_Writing = -1;
+    m_IsStopping = false;
+    m_HasFailed = false;
+    m_IsSkipping = false;
+    m_HasStartedSkipping = false;
+    m_Thread = NULL;
+    m_WakeEvent = NULL;
+    m_IdleEvent = NULL;
+    InitializeCriticalSection (&m_Lock);
+}
+
+Autosave::~Autosave () {
+    Stop ();
+    DeleteCriticalSection (&m_Lock);
+}
+
+void Autosave::Start (const char* _filename, float _interval, UINT _memoryBudget) {
+    if (_interval <= 0.0f || _memoryBudget == 0 || strlen (_filename) >= MAX_PATH) {
+        THROW_ERROR (ERRC_INVALID_PARAMETER);
+    }
+    Stop ();
+    strcpy (m_Filename, _filename);
+    m_Interval = _interval;
+    m_TimeLeft = _interval;
+    m_MemoryBudget = _memoryBudget;
+    m_Snapshots[0] = new GameSnapshot;
+    m_Snapshots[1] = new GameSnapshot;
+    m_IsStopping = false;
+    m_HasFailed = false;
+    m_IsSkipping = false;
+    m_HasStartedSkipping = false;
+    m_WakeEvent = CreateEvent (NULL, FALSE, FALSE, NULL);
+    m_IdleEvent = CreateEvent (NULL, FALSE, FALSE, NULL);
+    m_Thread = CreateThread (NULL, 0, WorkerProc, this, 0, NULL);
+    if (!m_WakeEvent || !m_IdleEvent || !m_Thread) {
+        Stop ();
+        THROW_ERROR (ERRC_API_CALL);
+    }
+}
+
+void Autosave::Stop () {
+    if (m_Thread) {
+        /* the worker writes what is queued before it quits */
+        EnterCriticalSection (&m_Lock);
+        m_IsStopping = true;
+        LeaveCriticalSection (&m_Lock);
+        SetEvent (m_WakeEvent);
+        WaitForSingleObject (m_Thread, INFINITE);
+        CloseHandle (m_Thread);
+        m_Thread = NULL;
+    }
+    if (m_WakeEvent) {
+        CloseHandle (m_WakeEvent);
+        m_WakeEvent = NULL;
+    }
+    if (m_IdleEvent) {
+        CloseHandle (m_IdleEvent);
+        m_IdleEvent = NULL;
+    }
+    delete m_Snapshots[0];
+    delete m_Snapshots[1];
+    m_Snapshots[0] = NULL;
+    m_Snapshots[1] = NULL;
+    m_Capturing = -1;
+    m_Pending = -1;
+    m_Writing = -1;
+}
+
+bool Autosave::IsRunning () const {
+    return m_Thread != NULL;
+}
+
+bool Autosave::Update (float _delta) {
+    if (!IsRunning ()) {
+        return false;
+    }
+    m_TimeLeft -= _delta;
+    if (m_TimeLeft > 0.0f) {
+        return false;
+    }
+    m_TimeLeft = m_Interval;
+    return true;
+}
+
+GameSnapshot* Autosave::BeginCapture (size_t _size) {
+    if (!IsRunning ()) {
+        THROW_ERROR (ERRC_NOT_READY);
+    }
+    if (_size > m_MemoryBudget) {
+        m_HasStartedSkipping = m_HasStartedSkipping || !m_IsSkipping;
+        m_IsSkipping = true;
+        return NULL;
+    }
+    m_IsSkipping = false;
+    EnterCriticalSection (&m_Lock);
+    if (m_Pending != -1) {
+        /* not taken by the worker yet, a newer snapshot replaces it */
+        m_Capturing = m_Pending;
+        m_Pending = -1;
+    } else {
+        m_Capturing = m_Writing == 0 ? 1 : 0;
+    }
+    LeaveCriticalSection (&m_Lock);
+    return m_Snapshots[m_Capturing];
+}
+
+void Autosave::EndCapture () {
+    if (m_Capturing == -1) {
+        THROW_ERROR (ERRC_NOT_READY);
+    }
+    EnterCriticalSection (&m_Lock);
+    m_Pending = m_Capturing;
+    LeaveCriticalSection (&m_Lock);
+    m_Capturing = -1;
+    SetEvent (m_WakeEvent);
+}
+
+void Autosave::WaitIdle () {
+    if (!IsRunning ()) {
+        return;
+    }
+    while (true) {
+        EnterCriticalSection (&m_Lock);
+        bool isIdle = m_Pending == -1 && m_Writing == -1;
+        LeaveCriticalSection (&m_Lock);
+        if (isIdle) {
+            return;
+        }
+        WaitForSingleObject (m_IdleEvent, INFINITE);
+    }
+}
+
+bool Autosave::HasFailed () {
+    EnterCriticalSection (&m_Lock);
+    bool hasFailed = m_HasFailed;
+    m_HasFailed = false;
+    LeaveCriticalSection (&m_Lock);
+    return hasFailed;
+}
+
+bool Autosave::HasStartedSkipping () {
+    bool hasStartedSkipping = m_HasStartedSkipping;
+    m_HasStartedSkipping = false;
+    return hasStartedSkipping;
+}
+
+DWORD WINAPI Autosave::WorkerProc (LPVOID _autosave) {
+    ((Autosave*)_autosave)->Work ();
+    return 0;
+}
+
+void Autosave::Work () {
+    while (true) {
+        WaitForSingleObject (m_WakeEvent, INFINITE);
+        while (true) {
+            EnterCriticalSection (&m_Lock);
+            if (m_Pending == -1) {
+                bool isStopping = m_IsStopping;
+                LeaveCriticalSection (&m_Lock);
+                if (isStopping) {
+                    return;
+                }
+                break;
+            }
+            m_Writing = m_Pending;
+            m_Pending = -1;
+            LeaveCriticalSection (&m_Lock);
+            bool isWritten = true;
+            try {
+                Game::WriteSnapshot (*m_Snapshots[m_Writing], m_Filename);
+            } catch (...) {
+                isWritten = false;
+            }
+            EnterCriticalSection (&m_Lock);
+            m_HasFailed = m_HasFailed || !isWritten;
+            m_Writing = -1;
+            LeaveCriticalSection (&m_Lock);
+            SetEvent (m_IdleEvent);
+        }
+    }
+}
@@ -0,0 +1,171 @@
+#include "../include/CommandLog.h"
+
+static const char g_CommandLogMagic[4] = {'T', 'M', 'R', 'C'};
+
+CommandLog::CommandLog () {
+    Stop ();
+}
+
+void CommandLog::StartRecording (const char* _scenario, float _step, bool _isHashing) {
+    if (strlen (_scenario) >= MAX_PATH || _step <= 0.0f) {
+        THROW_ERROR (ERRC_INVALID_PARAMETER);
+    }
+    Stop ();
+    memcpy (m_Header.Magic, g_CommandLogMagic, sizeof (m_Header.Magic));
+    m_Header.Version = COMMAND_LOG_VERSION;
+    strcpy (m_Header.Scenario, _scenario);
+    m_Header.Step = _step;
+    m_IsHashing = _isHashing;
+    m_Mode = MODE_RECORDING;
+}
+
+void CommandLog::Save (const char* _filename) {
+    if (m_Mode != MODE_RECORDING) {
+        THROW_ERROR (ERRC_NOT_READY);
+    }
+    m_Header.NumCommands = m_Commands.size ();
+    m_Header.NumHashes = m_Hashes.size ();
+    FILE* file = fopen (_filename, "wb");
+    if (!file) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _filename);
+    }
+    bool isWritten = fwrite (&m_Header, sizeof (CommandLogHeader), 1, file) == 1;
+    if (isWritten && !m_Commands.empty ()) {
+        isWritten = fwrite (&m_Commands[0], sizeof (GameCommand), m_Commands.size (), file) == m_Commands.size ();
+    }
+    if (isWritten && !m_Hashes.empty ()) {
+        isWritten = fwrite (&m_Hashes[0], sizeof (UINT), m_Hashes.size (), file) == m_Hashes.size ();
+    }
+    fclose (file);
+    if (!isWritten) {
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+}
+
+void CommandLog::StartReplay (const char* _filename) {
+    Stop ();
+    FILE* file = fopen (_filename, "rb");
+    if (!file) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _filename);
+    }
+    bool isRead = fread (&m_Header, sizeof (CommandLogHeader), 1, file) == 1 &&
+        memcmp (m_Header.Magic, g_CommandLogMagic, sizeof (m_Header.Magic)) == 0 &&
+        m_Header.Version == COMMAND_LOG_VERSION &&
+        m_Header.Scenario[MAX_PATH - 1] == '\0' &&
+        m_Header.Step > 0.0f &&
+        (m_Header.NumHashes == 0 || m_Header.NumHashes == m_Header.NumTicks);
+    if (isRead) {
+        /* the counts must match the file size before anything is allocated */
+        long offset = ftell (file);
+        fseek (file, 0, SEEK_END);
+        long size = ftell (file);
+        fseek (file, offset, SEEK_SET);
+        isRead = (unsigned long)(size - offset) ==
+            (unsigned long)m_Header.NumCommands * sizeof (GameCommand) +
+            (unsigned long)m_Header.NumHashes * sizeof (UINT);
+    }
+    if (isRead && m_Header.NumCommands > 0) {
+        m_Commands.resize (m_Header.NumCommands);
+        isRead = fread (&m_Commands[0], sizeof (GameCommand), m_Commands.size (), file) == m_Commands.size ();
+    }
+    if (isRead && m_Header.NumHashes > 0) {
+        m_Hashes.resize (m_Header.NumHashes);
+        isRead = fread (&m_Hashes[0], sizeof (UINT), m_Hashes.size (), file) == m_Hashes.size ();
+    }
+    fclose (file);
+    for (UINT i = 1; isRead && i < m_Commands.size (); i++) {
+        isRead = m_Commands[i - 1].Tick <= m_Commands[i].Tick;
+    }
+    if (!isRead) {
+        Stop ();
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+    m_IsHashing = !m_Hashes.empty ();
+    m_Mode = MODE_REPLAYING;
+}
+
+void CommandLog::Stop () {
+    memset (&m_Header, 0, sizeof (CommandLogHeader));
+    m_Commands.clear ();
+    m_Hashes.clear ();
+    m_IsHashing = false;
+    m_NextCommand = 0;
+    m_DivergentTick = INVALID_ID;
+    m_Mode = MODE_NONE;
+}
+
+bool CommandLog::IsRecording () const {
+    return m_Mode == MODE_RECORDING;
+}
+
+bool CommandLog::IsReplaying () const {
+    return m_Mode == MODE_REPLAYING;
+}
+
+const char* CommandLog::GetScenario () const {
+    return m_Header.Scenario;
+}
+
+float CommandLog::GetStep () const {
+    return m_Header.Step;
+}
+
+UINT CommandLog::GetNumTicks () const {
+    return m_Header.NumTicks;
+}
+
+void CommandLog::Record (const GameCommand& _command) {
+    if (m_Mode != MODE_RECORDING) {
+        return;
+    }
+    m_Commands.push_back (_command);
+    if (_command.Tick + 1 > m_Header.NumTicks) {
+        m_Header.NumTicks = _command.Tick + 1;
+    }
+}
+
+bool CommandLog::NextCommand (UINT _tick, GameCommand& _command) {
+    if (m_Mode != MODE_REPLAYING || m_NextCommand >= m_Commands.size () || m_Commands[m_NextCommand].Tick > _tick) {
+        return false;
+    }
+    _command = m_Commands[m_NextCommand++];
+    return true;
+}
+
+bool CommandLog::IsFinished (UINT _tick) const {
+    return m_Mode == MODE_REPLAYING && _tick >= m_Header.NumTicks && m_NextCommand >= m_Commands.size ();
+}
+
+void CommandLog::EndTick (UINT _tick, UINT _hash) {
+    if (m_Mode == MODE_RECORDING) {
+        if (m_IsHashing) {
+            m_Hashes.resize (_tick + 1, 0);
+            m_Hashes[_tick] = _hash;
+        }
+        if (_tick + 1 > m_Header.NumTicks) {
+            m_Header.NumTicks = _tick + 1;
+        }
+    } else if (m_Mode == MODE_REPLAYING && m_IsHashing && m_DivergentTick == INVALID_ID) {
+        if (_tick < m_Hashes.size () && m_Hashes[_tick] != _hash) {
+            m_DivergentTick = _tick;
+        }
+    }
+}
+
+bool CommandLog::IsHashing () const {
+    return m_IsHashing;
+}
+
+UINT CommandLog::GetDivergentTick () const {
+    return m_DivergentTick;
+}
+
+/* FNV-1a, continued from _hash */
+UINT CommandLog::Hash (UINT _hash, const void* _data, UINT _size) {
+    const BYTE* bytes = (const BYTE*)_data;
+    for (UINT i = 0; i < _size; i++) {
+        _hash ^= bytes[i];
+        _hash *= 16777619u;
+    }
+    return _hash;
+}
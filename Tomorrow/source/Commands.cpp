@@ -0,0 +1,197 @@
+#include "../include/Game.h"
+
+void Game::StartRecording (const char* _filename, bool _isHashing) {
+    m_RecordFile = _filename;
+    m_IsHashingRecord = _isHashing;
+}
+
+void Game::StartReplay (const char* _filename) {
+    m_RecordFile.clear ();
+    m_CommandLog.StartReplay (_filename);
+    m_ScenarioFile = m_CommandLog.GetScenario ();
+    SetSimulationRate (1.0f / m_CommandLog.GetStep (), m_MaxSimulationSteps);
+    /* the replay starts right away as a new game */
+    m_IsContinuing = false;
+    m_IsLevelLoaded = false;
+    m_IsPaused = false;
+}
+
+/* Called wherever a level is left: the menu, a new game, quitting, game over */
+void Game::SaveRecording () {
+    if (m_CommandLog.IsRecording ()) {
+        m_CommandLog.Save (m_RecordFile.c_str ());
+    }
+}
+
+bool Game::IsReplaying () const {
+    return m_CommandLog.IsReplaying ();
+}
+
+/* The player's commands are executed at once, between two simulation steps,
+   which is where the replay executes them: before step Tick. */
+bool Game::IssueCommand (GameCommand& _command) {
+    if (m_CommandLog.IsReplaying ()) {
+        return false;   /* only the recording plays */
+    }
+    _command.Tick = m_Tick;
+    if (!ExecuteCommand (_command)) {
+        return false;
+    }
+    m_CommandLog.Record (_command);
+    return true;
+}
+
+bool Game::ExecuteCommand (const GameCommand& _command) {
+    switch (_command.Type) {
+        case CMD_PLACE_TOWER: {
+            if (_command.Param >= NUM_TOWER_TYPES) {
+                THROW_ERROR (ERRC_OUT_OF_RANGE);
+            }
+            TowerType type = (TowerType)_command.Param;
+            if (m_Resource.NumResources < m_PreparedTowers[type].Price) {
+                m_GameUI->ShowMessage ("Not enough resources.", 0xffff0000, 3.0f);
+                return false;
+            }
+            if (!CreateTower (type, _command.Location)) {
+                return false;
+            }
+            m_Resource.NumResources -= m_PreparedTowers[type].Price;
+            m_GameUI->UpdateNumResources (m_Resource.NumResources);
+            return true;
+        }
+        case CMD_UPGRADE_TOWER: {
+            if (_command.Param >= m_Towers.size ()) {
+                THROW_ERROR (ERRC_OUT_OF_RANGE);
+            }
+            TowerInfo& tower = m_Towers[_command.Param];
+            UINT lvl = tower.Level;
+            if (lvl >= MAX_TOWER_LEVEL || tower.BuildingTime > 0.0f) {
+                return false;
+            }
+            if (m_Resource.NumResources < m_UpgradeInfo[tower.Type].Price[lvl]) {
+                m_GameUI->ShowMessage ("Not enough resources", 0xffff0000, 3.0f);
+                return false;
+            }
+            m_Resource.NumResources -= m_UpgradeInfo[tower.Type].Price[lvl];
+            m_GameUI->UpdateNumResources (m_Resource.NumResources);
+            tower.BuildingTime = m_UpgradeInfo[tower.Type].UpgradeTime[lvl];
+            tower.MaxBuildingTime = m_UpgradeInfo[tower.Type].UpgradeTime[lvl];
+            return true;
+        }
+        case CMD_SPEED_UP:
+            m_SpeedUpFactor = _command.Values[0];
+            return true;
+        case CMD_CAMERA:
+            m_Camera->SetPosition (VECTOR3 (_command.Values[0], _command.Values[1], _command.Values[2]));
+            m_Camera->SetLookingPoint (VECTOR3 (_command.Values[3], _command.Values[4], _command.Values[5]));
+            return true;
+    }
+    THROW_ERROR (ERRC_INVALID_PARAMETER);
+}
+
+void Game::ExecuteReplayCommands () {
+    GameCommand command;
+    while (m_CommandLog.NextCommand (m_Tick, command)) {
+        ExecuteCommand (command);
+    }
+}
+
+/* The camera is not simulated, it is recorded as it moves. */
+void Game::RecordCamera () {
+    if (!m_CommandLog.IsRecording ()) {
+        return;
+    }
+    GameCommand command;
+    ZeroMemory (&command, sizeof (GameCommand));
+    command.Tick = m_Tick;
+    command.Type = CMD_CAMERA;
+    for (UINT i = 0; i < 3; i++) {
+        command.Values[i] = m_Camera->GetPosition ()[i];
+        command.Values[i + 3] = m_Camera->GetLookingPoint ()[i];
+    }
+    if (memcmp (command.Values, m_RecordedCamera, sizeof (m_RecordedCamera)) != 0) {
+        memcpy (m_RecordedCamera, command.Values, sizeof (m_RecordedCamera));
+        m_CommandLog.Record (command);
+    }
+}
+
+/* Rolling hash over what the simulation steps change; models, sounds and
+   animation frames are left out. */
+UINT Game::HashState (UINT _hash) {
+    UINT castleHitPoints = m_GameUI->GetCastleHitPoints ();
+    UINT numWaves = m_EnemyWaves.size ();
+    _hash = CommandLog::Hash (_hash, &castleHitPoints, sizeof (UINT));
+    _hash = CommandLog::Hash (_hash, &m_Resource, sizeof (ResourceInfo));
+    _hash = CommandLog::Hash (_hash, &m_Score, sizeof (UINT));
+    _hash = CommandLog::Hash (_hash, &m_NextWaveTimeLeft, sizeof (float));
+    _hash = CommandLog::Hash (_hash, &numWaves, sizeof (UINT));
+    std::list<EnemyInfo>::const_iterator enemy;
+    for (enemy = m_Enemies.begin (); enemy != m_Enemies.end (); enemy++) {
+        _hash = CommandLog::Hash (_hash, enemy->Position.data (), 3 * sizeof (float));
+        _hash = CommandLog::Hash (_hash, &enemy->PathDistance, sizeof (float));
+        _hash = CommandLog::Hash (_hash, &enemy->HitPoints, sizeof (int));
+        _hash = CommandLog::Hash (_hash, &enemy->SlowDownFactor, sizeof (float));
+        _hash = CommandLog::Hash (_hash, &enemy->Ammo, sizeof (float));
+        _hash = CommandLog::Hash (_hash, &enemy->ClipTimeLeft, sizeof (float));
+        _hash = CommandLog::Hash (_hash, &enemy->IsDead, sizeof (bool));
+    }
+    for (UINT i = 0; i < m_Towers.size (); i++) {
+        const TowerInfo& tower = m_Towers[i];
+        _hash = CommandLog::Hash (_hash, &tower.Level, sizeof (UINT));
+        _hash = CommandLog::Hash (_hash, &tower.BuildingTime, sizeof (float));
+        _hash = CommandLog::Hash (_hash, &tower.ShootDelay, sizeof (float));
+        std::list<TowerGunInfo>::const_iterator gun;
+        for (gun = tower.GunInfo.begin (); gun != tower.GunInfo.end (); gun++) {
+            _hash = CommandLog::Hash (_hash, &gun->ShootingTime, sizeof (float));
+            _hash = CommandLog::Hash (_hash, &gun->IsTargetAcquired, sizeof (bool));
+        }
+    }
+    return _hash;
+}
+
+void Game::RunReplay (const char* _replayFile, const char* _ReportFile) {
+    StartReplay (_replayFile);
+    StartNew ();
+    /* simulation only, nothing is rendered or animated */
+    double totalTime = 0.0;
+    double maxStepTime = 0.0;
+    UINT maxEnemies = 0;
+    FpsCounter timer;
+    m_Events.ResetTotals ();
+    while (!m_CommandLog.IsFinished (m_Tick)) {
+        timer.StartCounter ();
+        Simulate (m_SimulationStep);
+        m_Events.Clear ();
+        timer.EndCounter ();
+        double stepTime = (double)timer.GetTimeDelta ();
+        totalTime += stepTime;
+        maxStepTime = stepTime > maxStepTime ? stepTime : maxStepTime;
+        maxEnemies = m_Enemies.size () > maxEnemies ? m_Enemies.size () : maxEnemies;
+    }
+    FILE* report = fopen (_ReportFile, "w");
+    if (!report) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _ReportFile);
+    }
+    fprintf (report, "replay %s\n", _replayFile);
+    fprintf (report, "scenario %s\n", m_Scenario.GetFilename ());
+    fprintf (report, "steps %u of %f s\n", m_Tick, m_SimulationStep);
+    fprintf (report, "real time %f s\n", totalTime);
+    fprintf (report, "step time mean %f ms max %f ms\n",
+        m_Tick > 0 ? totalTime * 1000.0 / m_Tick : 0.0, maxStepTime * 1000.0);
+    fprintf (report, "towers %u\n", m_Towers.size ());
+    fprintf (report, "enemies max %u left %u\n", maxEnemies, m_Enemies.size ());
+    fprintf (report, "castle hit points %u\n", m_GameUI->GetCastleHitPoints ());
+    fprintf (report, "score %u\n", m_Score);
+    fprintf (report, "events shots %u hits %u deaths %u enemy shots %u\n",
+        m_Events.GetTotal (EVENT_SHOT), m_Events.GetTotal (EVENT_HIT), m_Events.GetTotal (EVENT_DEATH),
+        m_Events.GetTotal (EVENT_ENEMY_SHOT));
+    fprintf (report, "final state hash %08x\n", m_StateHash);
+    if (!m_CommandLog.IsHashing ()) {
+        fprintf (report, "not hashed\n");
+    } else if (m_CommandLog.GetDivergentTick () == INVALID_ID) {
+        fprintf (report, "matches the recording\n");
+    } else {
+        fprintf (report, "diverged at step %u\n", m_CommandLog.GetDivergentTick ());
+    }
+    fclose (report);
+}
@@ -1,13 +1,13 @@
 #include "../include/Game.h"
 
-void Game::AddEnemyWave (const EnemyAdditionDetails& _details) {
+void Game::AddEnemyWave (const EnemyAdditionDetails& _details, float _strengthBonus) {
     WaveInfo wave;
     wave.Delay = _details.Delay;
     wave.EnemySpawnTime = _details.SpawnTime;
     wave.SpawnTimeRemaining = 0.0f;
     strcpy (wave.Filename, _details.Filename.c_str());
     strcpy (wave.AnimationFile, _details.AnimInfoFile.c_str());
-    wave.StrengthBonus = floor (m_EnemyWaves.size () / 5.0f) / 100.0f * 50.0f;   /* +50% for each iteration */
+    wave.StrengthBonus = _strengthBonus;
     wave.HitPoints = _details.HitPoints + (UINT)(_details.HitPoints * wave.StrengthBonus);
     wave.IsFast = _details.IsFast;
     wave.Speed = _details.Speed;
@@ -22,55 +22,11 @@ void Game::AddEnemyWave (const EnemyAdditionDetails& _details) {
 }
 
 void Game::AddEnemyWaves () {
-    /* First wave */
-    EnemyAdditionDetails details;
-    details.Delay = 120.0f;
-    details.SpawnTime = 20.321f;
-    details.Filename = "data/ms3d/AlienScout/AlienScout.ms3d";
-    details.AnimInfoFile = "data/ms3d/AlienScout/AlienScoutAnimInfo.txt";
-    details.HitPoints = 100;
-    details.Speed = 20.0f;
-    details.AttackSpeed = 1.0f;
-    details.MaxAmmo = 6.0f;
-    details.Power = 10;
-    details.NumResources = 2;
-    details.NumEnemies = 5;
-    details.ShotTime = 0.3f;
-    details.ShotPauseTime = 0.95f;
-    details.IsFast = false;
-    AddEnemyWave (details);
-    details.Speed = 40.0f;
-    details.NumResources = 5;
-    details.IsFast = true;
-    AddEnemyWave (details);
-    details.Filename = "data/ms3d/AlienInfantry/AlienInfantry.ms3d";
-    details.AnimInfoFile = "data/ms3d/AlienInfantry/AlienInfantryAnimInfo.txt";
-    details.HitPoints = 200;
-    details.Speed = 20.0f;
-    details.AttackSpeed = 0.1f;
-    details.MaxAmmo = 5.0f;
-    details.Power = 3;
-    details.ShotTime = 50.0f;
-    details.ShotPauseTime = 0.0f;
-    details.IsFast = false;
-    AddEnemyWave (details);
-    details.Speed = 40.0f;
-    details.NumResources = 10;
-    details.IsFast = true;
-    AddEnemyWave (details);
-    details.Filename = "data/ms3d/AlienBoss/AlienBoss.ms3d";
-    details.AnimInfoFile = "data/ms3d/AlienBoss/AlienBossAnimInfo.txt";
-    details.HitPoints = 500;
-    details.Speed = 10.0f;
-    details.AttackSpeed = 0.1f;
-    details.MaxAmmo = 5.0f;
-    details.Power = 6;
-    details.NumResources = 20;
-    details.NumEnemies = 1;
-    details.ShotTime = 50.0f;
-    details.ShotPauseTime = 0.0f;
-    details.IsFast = false;
-    AddEnemyWave (details);
+    /* one more run of the scenario wave script */
+    UINT first = m_EnemyWaves.size ();
+    for (UINT i = 0; i < m_Scenario.GetNumScriptWaves (); i++) {
+        AddEnemyWave (m_Scenario.GetWave (first + i), m_Scenario.GetStrengthBonus (first + i));
+    }
 }
 
 void Game::UpdateEnemyWaves (float _delta) {
@@ -78,13 +34,13 @@ void Game::UpdateEnemyWaves (float _delta) {
     UINT numWaves = m_EnemyWaves.size();
     while (i < numWaves) {
         if (m_EnemyWaves[i].Delay > 0) {
-            m_EnemyWaves[i].Delay -= _delta * m_SpeedUpFactor;
+            m_EnemyWaves[i].Delay -= _delta;
             m_NextWaveTimeLeft = m_EnemyWaves[i].Delay > 0 ? m_EnemyWaves[i].Delay : 0.0f;
             break;
         }
         if (m_EnemyWaves[i].Delay <= 0) {
             if (m_EnemyWaves[i].NumEnemies > 0) {
-                m_EnemyWaves[i].SpawnTimeRemaining -= _delta * m_SpeedUpFactor;
+                m_EnemyWaves[i].SpawnTimeRemaining -= _delta;
                 if (m_EnemyWaves[i].SpawnTimeRemaining <= 0.0f) {
                     NewEnemy (i, 1.0f);
                     m_EnemyWaves[i].SpawnTimeRemaining = m_EnemyWaves[i].EnemySpawnTime;
@@ -100,18 +56,26 @@ void Game::UpdateEnemyWaves (float _delta) {
 }
 
 void Game::ReadEnemyAnimation (const char* _filename, EnemyInfo& _enemy) {
-    FILE* file = fopen (_filename, "r");
-    if (file) {
-        while (!feof (file)) {
+    std::map<std::string, std::map<std::string, EnemyAnimation>>::iterator cached = m_EnemyAnimations.find (_filename);
+    if (cached == m_EnemyAnimations.end ()) {
+        VirtualFile file (_filename);
+        std::map<std::string, EnemyAnimation> animations;
+        while (!file.IsEof ()) {
             char name[MAX_PATH];
             EnemyAnimation animation;
-            if (fscanf (file, "%s start: %f end: %f", name, &animation.Start, &animation.End) == 3) {
-                _enemy.Animation.insert (std::pair<std::string,EnemyAnimation>(std::string (name), animation));
+            int numRead = file.Scan ("%s start: %f end: %f", name, &animation.Start, &animation.End);
+            if (numRead == 3) {
+                animations.insert (std::pair<std::string,EnemyAnimation>(std::string (name), animation));
+            } else if (numRead == 1 && strcmp (name, "SampleRate:") == 0) {
+                float rate;
+                if (file.Scan ("%f", &rate) == 1) {
+                    m_PoseSampleRates[_filename] = rate;
+                }
             }
         }
-    } else {
-        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _filename);
+        cached = m_EnemyAnimations.insert (std::make_pair (std::string (_filename), animations)).first;
     }
+    _enemy.Animation = cached->second;
 }
 
 void Game::NewEnemy (UINT _waveIndex, float _animSpeed) {
@@ -119,7 +83,6 @@ void Game::NewEnemy (UINT _waveIndex, float _animSpeed) {
         return;
     }
     EnemyInfo enemy;
-    enemy.Id = m_Ms3dLoader->LoadModel (m_EnemyWaves[_waveIndex].Filename);
     enemy.WaveId = _waveIndex;
     enemy.HitPoints = m_EnemyWaves[_waveIndex].HitPoints;
     enemy.MaxHitPoints = enemy.HitPoints;
@@ -129,46 +92,98 @@ void Game::NewEnemy (UINT _waveIndex, float _animSpeed) {
     enemy.NumSlowedDown = 0;
     enemy.AttackSpeed = m_EnemyWaves[_waveIndex].AttackSpeed;
     enemy.RemainingTimeToShoot = 0.0f;
-    enemy.Gun = new Beam (3.0f, 30.0f, 0.01f, 50, m_EnemyWaves[_waveIndex].ShotTime, m_EnemyWaves[_waveIndex].ShotPauseTime);
-    enemy.Gun->Init (m_Device, NULL);
-    enemy.Gun->SetColor (0xffCC0099);
-    enemy.Gun->SetMaxRange (200.0f);
-    enemy.Gun->SetMaxTime (1.0f);
     enemy.MaxAmmo = m_EnemyWaves[_waveIndex].MaxAmmo;
     enemy.Ammo = enemy.MaxAmmo;
     enemy.Power = m_EnemyWaves[_waveIndex].Power;
     float x = m_Waypoints[0].Position.x * m_Terrain->GetTerrain()->GetScale(0);
     float y = m_Terrain->GetTerrain()->GetScaledHeight(m_Waypoints[0].Position.x, m_Waypoints[0].Position.y);
     float z = m_Waypoints[0].Position.y * m_Terrain->GetTerrain()->GetScale(2);
-    m_Ms3dLoader->GetModel(enemy.Id)->Scale(10.0f, 10.0f, 10.0f);
-    m_Ms3dLoader->GetModel(enemy.Id)->Translate (x, y, z);
-    m_Ms3dLoader->GetModel(enemy.Id)->Rotate (-3.14f / 2.0f, 3.14f, 0.0f);
     enemy.ActiveWaypoint = 0;
-    enemy.Distance = 0.0f;
+    enemy.PathDistance = 0.0f;
+    enemy.TargetIndex = INVALID_ID;
     enemy.Position = VECTOR3(x, y, z);
+    enemy.PreviousPosition = enemy.Position;
+    enemy.RenderPosition = enemy.Position;
     enemy.NumAttackers = 0;
     enemy.NumResources = m_EnemyWaves[_waveIndex].NumResources;
     enemy.Direction = m_Waypoints[0].Direction;
-    cml::vector2f oldDirection (0.0f, -1.0f);
-    cml::vector2f newDirection (enemy.Direction[0], enemy.Direction[2]);
-    float angle = cml::signed_angle_2D (newDirection, oldDirection);
-    m_Ms3dLoader->GetModel(enemy.Id)->Rotate (0.0f, angle, 0.0f);
-    enemy.SoundId = m_Audio->Play3D (m_AudioBankId, "Steps", enemy.Position, m_Waypoints[enemy.ActiveWaypoint].Direction, VECTOR3 (0.0f, 1.0f, 0.0f));
     enemy.SelfDestructionTime = 0.0f;
     /*enemy.AnimationStart = _animStart;
     enemy.AnimationEnd = _animEnd;*/
-    ReadEnemyAnimation (m_EnemyWaves[_waveIndex].AnimationFile, enemy);
     enemy.AnimationSpeed = _animSpeed;
     enemy.LoopAnimation = true;
+    enemy.ClipTimeLeft = 0.0f;
     if (enemy.IsFast) {
         enemy.CurrentAnimation = "Run";
     } else {
         enemy.CurrentAnimation = "Walk";
     }
     enemy.IsDead = false;
+    AttachEnemyResources (enemy);
     m_Enemies.push_back (enemy);
 }
 
+/* Model, gun, map mark, sound and animation table of an enemy whose state is already set */
+void Game::AttachEnemyResources (EnemyInfo& _enemy) {
+    const WaveInfo& wave = m_EnemyWaves[_enemy.WaveId];
+    ReadEnemyAnimation (wave.AnimationFile, _enemy);
+    BakeEnemyPoses (wave.Filename, wave.AnimationFile, _enemy.Animation);
+    _enemy.Id = m_Ms3dLoader->LoadModel (wave.Filename);
+    _enemy.PoseInterval = 0;    /* the first pose is evaluated at once */
+    Ms3dModel* model = m_Ms3dLoader->GetModel(_enemy.Id);
+    model->Scale(10.0f, 10.0f, 10.0f);
+    model->Translate (_enemy.Position[0], _enemy.Position[1], _enemy.Position[2]);
+    model->Rotate (-3.14f / 2.0f, 3.14f, 0.0f);
+    cml::vector2f oldDirection (0.0f, -1.0f);
+    cml::vector2f newDirection (_enemy.Direction[0], _enemy.Direction[2]);
+    float angle = cml::signed_angle_2D (newDirection, oldDirection);
+    model->Rotate (0.0f, angle, 0.0f);
+    _enemy.Gun = new Beam (3.0f, 30.0f, 0.01f, 50, wave.ShotTime, wave.ShotPauseTime);
+    _enemy.Gun->Init (m_Device, NULL);
+    _enemy.Gun->SetColor (0xffCC0099);
+    _enemy.Gun->SetMaxRange (200.0f);
+    _enemy.Gun->SetMaxTime (1.0f);
+    _enemy.MapMark = m_GameUI->AddEnemyMark (_enemy.Position);
+    _enemy.SoundId = INVALID_ID;
+    if (!_enemy.IsDead) {
+        _enemy.SoundId = m_Audio->Play3D (m_AudioBankId, "Steps", _enemy.Position, _enemy.Direction, VECTOR3 (0.0f, 1.0f, 0.0f));
+    }
+}
+
+/* The clips of a model are sampled the first time the model is used, then all
+   the enemies of the model blend the shared palettes instead of interpolating
+   their keyframes. A SampleRate line in the animation file overrides the rate. */
+void Game::BakeEnemyPoses (const char* _modelFile, const char* _animationFile, const std::map<std::string, EnemyAnimation>& _animations) {
+    if (m_PoseSampleRate <= 0.0f || m_Ms3dLoader->GetPoseCache (_modelFile)) {
+        return;
+    }
+    std::map<std::string, float>::const_iterator tuned = m_PoseSampleRates.find (_animationFile);
+    float rate = tuned != m_PoseSampleRates.end () ? tuned->second : m_PoseSampleRate;
+    if (rate <= 0.0f) {
+        return;
+    }
+    std::map<std::string, EnemyAnimation>::const_iterator i;
+    for (i = _animations.begin (); i != _animations.end (); i++) {
+        m_Ms3dLoader->BakeClip (_modelFile, i->first.c_str (), i->second.Start, i->second.End, rate);
+    }
+}
+
+void Game::WritePoseCacheReport (FILE* _report) {
+    std::map<std::string, bool> isReported;
+    for (UINT i = 0; i < m_EnemyWaves.size (); i++) {
+        const Ms3dPoseCache* cache = m_Ms3dLoader->GetPoseCache (m_EnemyWaves[i].Filename);
+        if (!cache || isReported[m_EnemyWaves[i].Filename]) {
+            continue;
+        }
+        isReported[m_EnemyWaves[i].Filename] = true;
+        for (UINT j = 0; j < cache->GetNumClips (); j++) {
+            fprintf (_report, "pose cache %s clip %s samples %u memory %u bytes\n", m_EnemyWaves[i].Filename,
+                cache->GetClipName (j), cache->GetClipNumSamples (j), cache->GetClipMemory (j));
+        }
+        fprintf (_report, "pose cache %s memory %u bytes\n", m_EnemyWaves[i].Filename, cache->GetMemory ());
+    }
+}
+
 void Game::ChangeEnemyDirection (std::list<EnemyInfo>::iterator _enemy) {
     if (_enemy->ActiveWaypoint + 1 < m_Waypoints.size()) {
         cml::vector2f newDirection = cml::vector2f(m_Waypoints[_enemy->ActiveWaypoint].Direction[0], m_Waypoints[_enemy->ActiveWaypoint].Direction[2]).normalize();
@@ -188,8 +203,10 @@ void Game::ChangeEnemyDirection (std::list<EnemyInfo>::iterator _enemy) {
         m_Ms3dLoader->GetModel(_enemy->Id)->Rotate (-3.14f / 2.0f, 3.14f, 0.0f);
         _enemy->ActiveWaypoint = 0;
         _enemy->Position = VECTOR3(x, y, z);
+        _enemy->PreviousPosition = _enemy->Position;    /* teleported, nothing to interpolate */
+        _enemy->RenderPosition = _enemy->Position;
         _enemy->Direction = m_Waypoints[0].Direction;
-        _enemy->Distance = 0.0f;
+        _enemy->PathDistance = 0.0f;
         cml::vector2f oldDirection (0.0f, -1.0f);
         cml::vector2f newDirection (_enemy->Direction[0], _enemy->Direction[2]);
         float angle = cml::signed_angle_2D (newDirection, oldDirection);
@@ -197,41 +214,109 @@ void Game::ChangeEnemyDirection (std::list<EnemyInfo>::iterator _enemy) {
     }
 }
 
-void Game::UpdateEnemyMovement (float _Delta) {
+/* Enemies are moved and animated in ranges on the job threads. Each job
+   only changes its own enemies and their models; the castle, the hood and
+   the sounds are changed afterwards in list order, so the result does not
+   depend on the number of threads. */
+class MoveEnemiesTask : public JobTask {
+public:
+    MoveEnemiesTask (Game* _game, float _delta) {
+        m_Game = _game;
+        m_Delta = _delta;
+    }
+    virtual void Run (UINT _begin, UINT _end) {
+        m_Game->MoveEnemies (_begin, _end, m_Delta);
+    }
+private:
+    Game* m_Game;
+    float m_Delta;
+};
+
+class AnimateEnemiesTask : public JobTask {
+public:
+    AnimateEnemiesTask (Game* _game) {
+        m_Game = _game;
+    }
+    virtual void Run (UINT _begin, UINT _end) {
+        m_Game->AnimateEnemies (_begin, _end);
+    }
+private:
+    Game* m_Game;
+};
+
+void Game::UpdateEnemyOrder () {
+    m_EnemyOrder.clear ();
     std::list<EnemyInfo>::iterator i;
     for (i = m_Enemies.begin(); i != m_Enemies.end(); i++) {
+        m_EnemyOrder.push_back (i);
+    }
+}
+
+void Game::UpdateEnemyMovement (float _Delta) {
+    UpdateEnemyOrder ();
+    MoveEnemiesTask task (this, _Delta);
+    m_Jobs.ParallelFor (task, m_EnemyOrder.size (), JOB_ENEMY_GRAIN);
+    for (UINT j = 0; j < m_EnemyOrder.size (); j++) {
+        std::list<EnemyInfo>::iterator i = m_EnemyOrder[j];
+        for (UINT k = 0; k < i->CastleHits; k++) {
+            if (m_GameUI->GetCastleHitPoints () != 0) {
+                m_GameUI->DecreaseCastleHitPoints (i->Power);
+                if (m_GameUI->GetCastleHitPoints () == 0) {
+                    char gameOverMsg[MAX_PATH];
+                    sprintf (gameOverMsg, "Game Over");
+                    m_GameUI->ShowMessage (gameOverMsg, 0xffff0000, 120.0f);
+                    sprintf (gameOverMsg, "Your score is %u", m_Score);
+                    m_GameUI->ShowMessage (gameOverMsg, 0xff00ff00, 120.0f);
+                    SaveRecording ();
+                }
+            }
+        }
+        if (i->HasMoved) {
+            m_GameUI->UpdateEnemyMark (i->MapMark, i->Position);
+            m_Audio->Update3DSoundPosition (i->SoundId, i->Position);
+            m_Audio->Update3DSoundFront (i->SoundId, m_Waypoints[i->ActiveWaypoint].Direction);
+        }
+        if (i->HasStartedShooting) {
+            GameEvent shot;
+            shot.TowerId = INVALID_ID;
+            shot.EnemyId = i->Id;
+            shot.SoundId = INVALID_ID;
+            shot.Position = i->Position;
+            shot.Position[1] += 20.0f;
+            shot.Target = shot.Position + 200.0f * i->Direction;
+            shot.Position += 50.0f * i->Direction;
+            m_Events.Add (EVENT_ENEMY_SHOT, shot);  /* the gun is started after the steps */
+        }
+    }
+}
+
+void Game::MoveEnemies (UINT _begin, UINT _end, float _Delta) {
+    for (UINT j = _begin; j < _end; j++) {
+        std::list<EnemyInfo>::iterator i = m_EnemyOrder[j];
+        i->CastleHits = 0;
+        i->HasMoved = false;
+        i->HasStartedShooting = false;
+        i->PreviousPosition = i->Position;
         if ((int)i->ActiveWaypoint == m_FinalWaypointIndex) {
             if (i->CurrentAnimation.compare ("Shoot") == 0 && i->Ammo > 0.0f) {
-                i->Ammo -= _Delta * m_SpeedUpFactor;
-                i->RemainingTimeToShoot -= _Delta * m_SpeedUpFactor;
-                i->Gun->Update (_Delta * m_SpeedUpFactor);
-            } else if (m_Ms3dLoader->GetModel(i->Id)->IsAnimationCompleted ()) {
-                if (!i->IsDead) {
+                i->Ammo -= _Delta;
+                i->RemainingTimeToShoot -= _Delta;
+            } else if (i->CurrentAnimation.compare ("PrepareToShoot") == 0 && !i->IsDead) {
+                /* the clip is timed by the steps, the model only shows it */
+                i->ClipTimeLeft -= i->AnimationSpeed * _Delta;
+                if (i->ClipTimeLeft <= 0.0f) {
                     i->CurrentAnimation = "Shoot";
-                    VECTOR3 position = i->Position;
-                    position[1] += 20.0f;
-                    i->Gun->SetPosition (position + 50.0f * i->Direction, position + 200.0f * i->Direction);
-                    i->Gun->AddParticle ();
+                    i->HasStartedShooting = true;
                     i->LoopAnimation = true;
                 }
             }
             while (i->RemainingTimeToShoot < 0.0f) {
-                if (m_GameUI->GetCastleHitPoints () != 0) {
-                    m_GameUI->DecreaseCastleHitPoints (i->Power);
-                    if (m_GameUI->GetCastleHitPoints () == 0) {
-                        char gameOverMsg[MAX_PATH];
-                        sprintf (gameOverMsg, "Game Over");
-                        m_GameUI->ShowMessage (gameOverMsg, 0xffff0000, 120.0f);
-                        sprintf (gameOverMsg, "Your score is %u", m_Score);
-                        m_GameUI->ShowMessage (gameOverMsg, 0xff00ff00, 120.0f);
-                    }
-                }
+                i->CastleHits++;
                 i->RemainingTimeToShoot += i->AttackSpeed;
             }
             if (i->Ammo > 0.0f) {
                 continue;
             } else {
-                i->Gun->Destroy ();
                 if (i->IsFast) {
                     i->CurrentAnimation = "Run";
                 } else {
@@ -243,76 +328,123 @@ void Game::UpdateEnemyMovement (float _Delta) {
         if (i->IsDead) {
             continue;
         }
-        i->Distance += i->Speed * i->SlowDownFactor * m_SpeedUpFactor * _Delta;
-        while (i->Distance > m_Waypoints[i->ActiveWaypoint].Length) {
-            i->Distance -= m_Waypoints[i->ActiveWaypoint].Length;
-            i->ActiveWaypoint++;
-            if (i->ActiveWaypoint == m_Waypoints.size() - 1) {
-                i->Distance = m_Waypoints[i->ActiveWaypoint].Length;
-            }
+        i->PathDistance += i->Speed * i->SlowDownFactor * _Delta;
+        if (i->PathDistance > m_Path.GetLength ()) {
+            i->PathDistance = m_Path.GetLength ();
         }
-        float posx = m_Waypoints[i->ActiveWaypoint].Position.x * m_Terrain->GetTerrain()->GetScale(0);
-        float posz = m_Waypoints[i->ActiveWaypoint].Position.y * m_Terrain->GetTerrain()->GetScale(2);
-        VECTOR3 position = VECTOR3 (posx, 0.0f, posz);
-        VECTOR3 newPosition = position + m_Waypoints[i->ActiveWaypoint].Direction * i->Distance;
-        newPosition[1] = GetHeight (newPosition);
-        position[1] = newPosition[1];
-        m_GameUI->UpdateEnemyMark (i->Id, newPosition);
-        float x = newPosition[0] - i->Position[0];
-        float y = newPosition[1] - i->Position[1];
-        float z = newPosition[2] - i->Position[2];
-        m_Ms3dLoader->GetModel(i->Id)->Translate(x, y, z);
-        i->Position = newPosition;
+        i->ActiveWaypoint = m_Path.FindSegment (i->PathDistance);
+        i->Position = m_Path.GetPosition (i->PathDistance, i->ActiveWaypoint);
         if (i->ActiveWaypoint != m_FinalWaypointIndex || i->Ammo <= 0.0f) {
             ChangeEnemyDirection (i);
         }
         if (i->ActiveWaypoint == m_FinalWaypointIndex && i->Ammo > 0.0f) {
             i->CurrentAnimation = "PrepareToShoot";
             i->LoopAnimation = false;
+            std::map<std::string, EnemyAnimation>::const_iterator clip = i->Animation.find (i->CurrentAnimation);
+            i->ClipTimeLeft = clip != i->Animation.end () ? clip->second.End - clip->second.Start : 0.0f;
         }
-        m_Audio->Update3DSoundPosition (i->SoundId, i->Position);
-        m_Audio->Update3DSoundFront (i->SoundId, m_Waypoints[i->ActiveWaypoint].Direction);
+        i->HasMoved = true;
     }
 }
 
 void Game::UpdateEnemies (float _delta) {
-    std::list<EnemyInfo>::iterator i = m_Enemies.begin();
-    while (i != m_Enemies.end()) {
+    UpdateEnemyOrder ();
+    m_AnimationEye = m_Camera->GetPosition ();
+    AnimateEnemiesTask task (this);
+    m_Jobs.ParallelFor (task, m_EnemyOrder.size (), JOB_ENEMY_GRAIN);
+    m_AnimationFrame++;
+    m_NumPoses = 0;
+    m_NumHiddenEnemies = 0;
+    m_NumReducedEnemies = 0;
+    for (UINT j = 0; j < m_EnemyOrder.size (); j++) {
+        std::list<EnemyInfo>::iterator i = m_EnemyOrder[j];
+        m_NumPoses += i->IsPoseEvaluated ? 1 : 0;
+        m_NumHiddenEnemies += i->PoseInterval == 0 ? 1 : 0;
+        m_NumReducedEnemies += i->PoseInterval > 1 ? 1 : 0;
+    }
+}
+
+void Game::AnimateEnemies (UINT _begin, UINT _end) {
+    for (UINT j = _begin; j < _end; j++) {
+        std::list<EnemyInfo>::iterator i = m_EnemyOrder[j];
+        Ms3dModel* model = m_Ms3dLoader->GetModel(i->Id);
         std::map<std::string, EnemyAnimation>::iterator animation;
         animation = i->Animation.find (i->CurrentAnimation);
         if (animation != i->Animation.end ()) {
-            m_Ms3dLoader->GetModel(i->Id)->Animate(
+            model->AdvanceAnimation (
                 i->AnimationSpeed * m_SpeedUpFactor, 
                 animation->second.Start,
                 animation->second.End,
                 i->LoopAnimation);
         }
-        i++;
+        /* an enemy coming into sight gets its pose at once */
+        bool wasHidden = i->PoseInterval == 0;
+        i->PoseInterval = GetPoseInterval (i);
+        i->IsPoseEvaluated = i->PoseInterval > 0 &&
+            (wasHidden || (m_AnimationFrame + i->Id) % i->PoseInterval == 0);
+        if (i->IsPoseEvaluated) {
+            model->EvaluatePose ();
+        }
     }
 }
 
-void Game::RenderEnemies (float _delta) {
+/* Frames per evaluated pose of an enemy, 0 when it is outside the view
+   frustum and the shadow frustum of the last frame. */
+UINT Game::GetPoseInterval (const std::list<EnemyInfo>::iterator _enemy) {
+    if (!m_AnimationLod.IsEnabled) {
+        return 1;
+    }
+    if (!IsEnemyVisible (m_Frustum, _enemy) && !IsEnemyVisible (m_ShadowMapFrustum, _enemy)) {
+        return 0;
+    }
+    float distance = (_enemy->RenderPosition - m_AnimationEye).length_squared ();
+    if (distance < m_AnimationLod.NearDistance * m_AnimationLod.NearDistance) {
+        return 1;
+    }
+    if (distance < m_AnimationLod.FarDistance * m_AnimationLod.FarDistance) {
+        return m_AnimationLod.MidInterval;
+    }
+    return m_AnimationLod.FarInterval;
+}
+
+void Game::UpdateDeadEnemies (float _delta) {
     std::list<EnemyInfo>::iterator i = m_Enemies.begin();
     while (i != m_Enemies.end()) {
-        if (IsEnemyVisible (m_Frustum, i)) {
-            m_Ms3dLoader->GetModel(i->Id)->Render(m_Device);
-        }
         if (i->IsDead) {
-            i->SelfDestructionTime -= _delta * m_SpeedUpFactor;
+            i->SelfDestructionTime -= _delta;
             if (i->SelfDestructionTime <= 0.0f) {
                 m_Ms3dLoader->GetModel(i->Id)->Unload ();
-                m_GameUI->RemoveEnemyMark (i->Id);
+                m_GameUI->RemoveEnemyMark (i->MapMark);
                 delete i->Gun;
                 i = m_Enemies.erase (i);
-            } else {
-                i++;
+                continue;
             }
-        } else {
+        }
+        i++;
+    }
+}
+
+void Game::InterpolateEnemies (float _Alpha) {
+    /* the models are placed between the last two simulated positions */
+    std::list<EnemyInfo>::iterator i;
+    for (i = m_Enemies.begin(); i != m_Enemies.end(); i++) {
+        VECTOR3 position = i->PreviousPosition + (i->Position - i->PreviousPosition) * _Alpha;
+        VECTOR3 offset = position - i->RenderPosition;
+        m_Ms3dLoader->GetModel(i->Id)->Translate (offset[0], offset[1], offset[2]);
+        i->RenderPosition = position;
+    }
+}
+
+void Game::RenderEnemies () {
+    std::list<EnemyInfo>::iterator i;
+    for (i = m_Enemies.begin(); i != m_Enemies.end(); i++) {
+        if (IsEnemyVisible (m_Frustum, i)) {
+            m_Ms3dLoader->GetModel(i->Id)->Render(m_Device);
+        }
+        if (!i->IsDead) {
             i->Gun->Render ();
-            i++;
         }
     }
-    
 }
 
 void Game::RenderEnemyHealthBar (const std::list<EnemyInfo>::iterator _Enemy) {
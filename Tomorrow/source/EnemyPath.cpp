@@ -0,0 +1,100 @@
+#include "../include/EnemyPath.h"
+#include <algorithm>
+
+EnemyPath::EnemyPath () {
+    m_HeightSpacing = 1.0f;
+}
+
+void EnemyPath::Build (const std::vector<VECTOR3>& _Points, float _HeightSpacing) {
+    if (_Points.size () == 0 || _HeightSpacing <= 0.0f) {
+        THROW_ERROR (ERRC_INVALID_PARAMETER);
+    }
+    m_Points = _Points;
+    m_HeightSpacing = _HeightSpacing;
+    UINT numPoints = m_Points.size ();
+    m_Directions.resize (numPoints);
+    m_Starts.resize (numPoints);
+    m_Starts[0] = 0.0f;
+    for (UINT i = 0; i + 1 < numPoints; i++) {
+        VECTOR3 segment = m_Points[i + 1] - m_Points[i];
+        segment[1] = 0.0f;
+        float length = segment.length ();
+        m_Directions[i] = length > 0.0f ? segment / length : VECTOR3 (1.0f, 0.0f, 0.0f);
+        m_Starts[i + 1] = m_Starts[i] + length;
+    }
+    /* past the end an enemy keeps the direction of the last segment */
+    m_Directions[numPoints - 1] = numPoints > 1 ? m_Directions[numPoints - 2] : VECTOR3 (1.0f, 0.0f, 0.0f);
+    m_Heights.assign ((UINT)(GetLength () / m_HeightSpacing) + 2, 0.0f);
+}
+
+void EnemyPath::Clear () {
+    m_Points.clear ();
+    m_Directions.clear ();
+    m_Starts.clear ();
+    m_Heights.clear ();
+}
+
+UINT EnemyPath::GetNumHeightSamples () const {
+    return m_Heights.size ();
+}
+
+VECTOR3 EnemyPath::GetHeightSamplePoint (UINT _Sample) const {
+    float distance = _Sample * m_HeightSpacing;
+    return GetPosition (distance < GetLength () ? distance : GetLength ());
+}
+
+void EnemyPath::SetHeightSample (UINT _Sample, float _Height) {
+    m_Heights[_Sample] = _Height;
+}
+
+float EnemyPath::GetLength () const {
+    return m_Starts.empty () ? 0.0f : m_Starts.back ();
+}
+
+UINT EnemyPath::GetNumPoints () const {
+    return m_Points.size ();
+}
+
+float EnemyPath::GetSegmentStart (UINT _Segment) const {
+    return m_Starts[_Segment];
+}
+
+const VECTOR3& EnemyPath::GetDirection (UINT _Segment) const {
+    return m_Directions[_Segment];
+}
+
+UINT EnemyPath::FindSegment (float _Distance) const {
+    /* a segment owns (start, end], past the end is the last point */
+    if (_Distance >= GetLength ()) {
+        return m_Points.size () - 1;
+    }
+    std::vector<float>::const_iterator end = std::lower_bound (m_Starts.begin (), m_Starts.end (), _Distance);
+    UINT index = end - m_Starts.begin ();
+    return index > 0 ? index - 1 : 0;
+}
+
+VECTOR3 EnemyPath::GetPosition (float _Distance) const {
+    return GetPosition (_Distance, FindSegment (_Distance));
+}
+
+VECTOR3 EnemyPath::GetPosition (float _Distance, UINT _Segment) const {
+    VECTOR3 position = m_Points[_Segment] + m_Directions[_Segment] * (_Distance - m_Starts[_Segment]);
+    position[1] = GetHeight (_Distance);
+    return position;
+}
+
+float EnemyPath::GetHeight (float _Distance) const {
+    if (m_Heights.empty ()) {
+        return 0.0f;
+    }
+    float sample = _Distance / m_HeightSpacing;
+    if (sample <= 0.0f) {
+        return m_Heights[0];
+    }
+    UINT index = (UINT)sample;
+    if (index + 1 >= m_Heights.size ()) {
+        return m_Heights.back ();
+    }
+    float t = sample - index;
+    return m_Heights[index] + (m_Heights[index + 1] - m_Heights[index]) * t;
+}
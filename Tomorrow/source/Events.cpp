@@ -0,0 +1,97 @@
+#include "../include/Game.h"
+
+/* Runs once a frame after the simulation steps, when the frustum of the
+   frame is known. _delta is the simulated time of the frame. */
+void Game::ProcessEvents (float _delta) {
+    ProcessShotEvents ();
+    ProcessEnemyShotEvents (_delta);
+    ProcessHitEvents ();
+    ProcessDeathEvents ();
+}
+
+void Game::ProcessShotEvents () {
+    const std::vector<GameEvent>& shots = m_Events.GetEvents (EVENT_SHOT);
+    UINT numSounds = 0;
+    for (UINT i = 0; i < shots.size (); i++) {
+        const GameEvent& shot = shots[i];
+        TowerInfo& tower = m_Towers[shot.TowerId];
+        bool isVisible = IsPointVisible (m_Frustum, shot.Position, EVENT_VISIBLE_RADIUS) ||
+            IsPointVisible (m_Frustum, shot.Target, EVENT_VISIBLE_RADIUS);
+        if (isVisible) {
+            tower.Gun->SetPosition (shot.Position, shot.Target);
+            tower.Gun->AddParticle ();
+        }
+        bool isHeard = numSounds < EVENT_MAX_SOUNDS && IsPointAudible (shot.Position);
+        if (isHeard) {
+            tower.SoundId = m_Audio->Play3D (m_AudioBankId, "Shot", shot.Position, VECTOR3 (0.0f, 0.0f, 1.0f), VECTOR3 (0.0f, 1.0f, 0.0f));
+            numSounds++;
+        }
+        if (!isVisible && !isHeard) {
+            m_Events.Cull (EVENT_SHOT);
+        }
+    }
+}
+
+/* The enemy guns are only drawn, so they are started and advanced here on
+   the main thread, never culled. */
+void Game::ProcessEnemyShotEvents (float _delta) {
+    const std::vector<GameEvent>& shots = m_Events.GetEvents (EVENT_ENEMY_SHOT);
+    std::list<EnemyInfo>::iterator i;
+    for (UINT j = 0; j < shots.size (); j++) {
+        i = m_Enemies.begin ();
+        while (i != m_Enemies.end () && i->Id != shots[j].EnemyId) {
+            i++;
+        }
+        if (i != m_Enemies.end () && i->CurrentAnimation.compare ("Shoot") == 0) {
+            i->Gun->SetPosition (shots[j].Position, shots[j].Target);
+            i->Gun->AddParticle ();
+        }
+    }
+    for (i = m_Enemies.begin (); i != m_Enemies.end (); i++) {
+        if ((int)i->ActiveWaypoint != m_FinalWaypointIndex || i->IsDead) {
+            continue;
+        }
+        if (i->CurrentAnimation.compare ("Shoot") == 0) {
+            i->Gun->Update (_delta);
+        } else if (i->Ammo <= 0.0f) {
+            i->Gun->Destroy ();     /* out of ammo */
+        }
+    }
+}
+
+void Game::ProcessHitEvents () {
+    const std::vector<GameEvent>& hits = m_Events.GetEvents (EVENT_HIT);
+    UINT numSounds = 0;
+    for (UINT i = 0; i < hits.size (); i++) {
+        if (numSounds < EVENT_MAX_SOUNDS && IsPointAudible (hits[i].Position)) {
+            m_Audio->Play3D (m_AudioBankId, "Grunt", hits[i].Position, hits[i].Target, VECTOR3 (0.0f, 1.0f, 0.0f));
+            numSounds++;
+        } else {
+            m_Events.Cull (EVENT_HIT);
+        }
+    }
+}
+
+void Game::ProcessDeathEvents () {
+    const std::vector<GameEvent>& deaths = m_Events.GetEvents (EVENT_DEATH);
+    if (deaths.empty ()) {
+        return;
+    }
+    for (UINT i = 0; i < deaths.size (); i++) {
+        m_Audio->Stop (deaths[i].SoundId);     /* never culled, the steps would go on */
+    }
+    m_GameUI->UpdateNumResources (m_Resource.NumResources);
+}
+
+bool Game::IsPointVisible (float _frustum[6][4], const VECTOR3& _point, float _radius) {
+    for (UINT i = 0; i < 6; i++) {
+        if (_frustum[i][0] * _point[0] + _frustum[i][1] * _point[1] + _frustum[i][2] * _point[2] + _frustum[i][3] < -_radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Game::IsPointAudible (const VECTOR3& _point) {
+    return (_point - m_Camera->GetPosition ()).length_squared () < EVENT_AUDIBLE_DISTANCE * EVENT_AUDIBLE_DISTANCE;
+}
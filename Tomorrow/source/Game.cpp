@@ -21,8 +21,12 @@ Game::Game (HWND _hMain, HINSTANCE _instance) {
     m_Camera->SetZoomSpeed (0.0f);
 
     m_ObjManager = new ObjManager (m_Device);
+    m_RingMeshes = new RingMeshCache (m_Device);
+    m_IsTowerGhostPlaced = false;
 
     m_Ms3dLoader = new Ms3dLoader ();
+    m_Assets = new AssetLoader (m_Device, m_ObjManager, m_Ms3dLoader);
+    m_Assets->Start (ASSET_THREADS);
     //UINT alienId = m_Ms3dLoader->LoadModel ("data/ms3d/Alien.ms3d");
     //m_Ms3dLoader->GetModel(alienId)->Scale (10.0f, 10.0f, 10.0f);
     m_GameUI = new GameUI(m_Device, m_WindowWidth, m_WindowHeight);
@@ -45,8 +49,27 @@ Game::Game (HWND _hMain, HINSTANCE _instance) {
     m_ForestSoundId = INVALID_ID;
 
     m_SpeedUpFactor = 1.0f;
+    m_ScenarioFile = DEFAULT_SCENARIO;
+    SetAutosave (AUTOSAVE_INTERVAL, AUTOSAVE_MEMORY_BUDGET);
+    m_IsHashingRecord = false;
+    m_Tick = 0;
+    m_StateHash = COMMAND_LOG_HASH_SEED;
+    SetSimulationRate (SIMULATION_STEP_RATE, SIMULATION_MAX_STEPS);
+    SetNumThreads (JOB_THREADS);
+    SetAnimationLod (true, ANIMATION_LOD_NEAR, ANIMATION_LOD_FAR, ANIMATION_LOD_MID_INTERVAL, ANIMATION_LOD_FAR_INTERVAL);
+    SetPoseSampleRate (POSE_SAMPLE_RATE);
+    m_AnimationFrame = 0;
+    m_NumPoses = 0;
+    m_NumHiddenEnemies = 0;
+    m_NumReducedEnemies = 0;
+    memset (m_Frustum, 0, sizeof (m_Frustum));
+    memset (m_ShadowMapFrustum, 0, sizeof (m_ShadowMapFrustum));
 
-    m_BuildingFieldTextureId = m_Device->GetSkinManager()->AddTexture ("data/terrain_texture/BuildingField.jpg");
+    /* the building mask is read by PlaceTower, it is loaded from its source,
+       never from a lossy cooked texture */
+    VirtualFile buildingField ("data/terrain_texture/BuildingField.jpg");
+    m_BuildingFieldTextureId = m_Device->GetSkinManager()->AddTexture ("data/terrain_texture/BuildingField.jpg",
+        buildingField.GetData (), buildingField.GetSize ());
 
     SetupScene ();
 
@@ -64,18 +87,8 @@ Game::Game (HWND _hMain, HINSTANCE _instance) {
     m_Device->EnableLight (0, true);
     m_Device->SetAmbientLight (0x00676767);
 
-    FILE* save = fopen ("Save.txt", "r");
-    m_IsSaved = true;
-    if (!save) {
-        m_IsSaved = false;
-    } else {
-        UINT hitPoints = 0;
-        fscanf (save, "%u", &hitPoints);
-        if (hitPoints == 0) {
-            m_IsSaved = false;
-        }
-        fclose (save);
-    }
+    SnapshotHeader saved;
+    m_IsSaved = ReadSnapshotHeader (saved, SNAPSHOT_FILE) && saved.CastleHitPoints > 0;
 }
 
 Game::~Game () {
@@ -84,62 +97,133 @@ Game::~Game () {
         delete m_Towers[i].Gun;
     }
     delete m_GameUI;
+    delete m_Assets;
     delete m_Ms3dLoader;
     delete m_RendererLoader;
     delete m_TerrainLoader;
     delete m_AudioLoader;
     delete m_ObjManager;
+    delete m_RingMeshes;
     delete m_Log;
     delete m_Camera;
     delete m_Input;
 }
 
+void Game::SetScenario (const char* _scenarioFile) {
+    m_ScenarioFile = _scenarioFile;
+}
+
 void Game::StartNew () {
-    m_GameUI->RenderLoadingScreen ();
+    m_GameUI->RenderLoadingScreen (0.0f);
     UnloadLevel ();
-    SetupTowersInfo ();
+    std::string scenarioFile = m_ScenarioFile;
+    SnapshotHeader saved;
+    if (m_IsContinuing && ReadSnapshotHeader (saved, SNAPSHOT_FILE)) {
+        scenarioFile = saved.Scenario;     /* the saved towers and waves belong to it */
+    }
+    m_Scenario.Load (scenarioFile.c_str());
+    RequestScenarioAssets ();
     LoadLevel("c_level.terrain");
+    SetupTowersInfo ();
+    m_Assets->Clear ();
     m_Timer.StartCounter ();
+    m_SimulationTime = 0.0f;
+    m_SpeedUpFactor = 1.0f;
+    m_Tick = 0;
+    m_StateHash = COMMAND_LOG_HASH_SEED;
     VECTOR3 position (600.0f, 600.0f, 250.0f);
     VECTOR3 front (0.0f, 0.0f, 1.0f);
     VECTOR3 top (0.0f, 1.0f, 0.0f);
     m_ForestSoundId = m_Audio->Play3D (m_AudioBankId, "Forest", position, front, top);
     AddEnemyWaves ();
+    if (!m_IsContinuing) {
+        PlaceScenarioTowers ();     /* a saved game has its own towers */
+    }
+    if (!m_RecordFile.empty ()) {
+        if (m_IsContinuing) {
+            m_CommandLog.Stop ();   /* a replay starts from the scenario, not from a save */
+        } else {
+            m_CommandLog.StartRecording (scenarioFile.c_str (), m_SimulationStep, m_IsHashingRecord);
+            for (UINT i = 0; i < 6; i++) {
+                m_RecordedCamera[i] = 0.0f;
+            }
+        }
+    }
 }
             
                 
 void Game::Update () {
     m_Timer.EndCounter ();
     float delta = (float)m_Timer.GetTimeDelta();
-    if (m_SpeedUpFactor > 1.0001f && m_Enemies.size() == 0) {
-        delta = m_NextWaveTimeLeft / m_SpeedUpFactor;
-    }
 
     char framesPerSecond[20];
     double fps = (double) m_Timer.GetFramesPerSecond();
     sprintf (framesPerSecond, "%.2f fps", fps);
 
     m_Timer.StartCounter ();
+    m_HeightField.Refresh (m_Terrain->GetTerrain ());
+
+    /* Speed-up runs more steps of the same length, not longer steps */
+    float frameTime = delta * m_SpeedUpFactor;
+    if (m_SpeedUpFactor > 1.0001f && m_Enemies.size() == 0) {
+        /* nothing to simulate but timers until the next wave, skip to it;
+           the cap spreads a long skip over the next frames */
+        if (m_NextWaveTimeLeft > frameTime) {
+            frameTime = m_NextWaveTimeLeft;
+        }
+    }
+    if (m_CommandLog.IsFinished (m_Tick)) {
+        frameTime = 0.0f;   /* the recorded session ended here */
+    }
+    m_SimulationTime += frameTime;
+    UINT numSteps = 0;
+    while (m_SimulationTime >= m_SimulationStep && numSteps < m_MaxSimulationSteps) {
+        Simulate (m_SimulationStep);
+        m_SimulationTime -= m_SimulationStep;
+        numSteps++;
+    }
+    if (m_SimulationTime >= m_SimulationStep) {
+        /* over the catch-up cap the rest is dropped, so the slowdown does not pile up */
+        m_SimulationTime = fmodf (m_SimulationTime, m_SimulationStep);
+    }
+    InterpolateEnemies (m_SimulationTime / m_SimulationStep);
+    if (m_Autosave.Update (delta) && m_GameUI->GetCastleHitPoints () > 0 && !IsReplaying ()) {
+        GameSnapshot* snapshot = m_Autosave.BeginCapture (GetSnapshotSize ());
+        if (snapshot) {
+            CaptureSnapshot (*snapshot);
+            m_Autosave.EndCapture ();
+        }
+    }
+    if (m_Autosave.HasFailed ()) {
+        m_GameUI->ShowMessage ("Autosave failed.", 0xffff0000, 3.0f);
+    }
+    if (m_Autosave.HasStartedSkipping ()) {
+        m_GameUI->ShowMessage ("Autosave is skipped, the level is too large.", 0xffff0000, 3.0f);
+    }
+
     m_Camera->Update (delta);
+    RecordCamera ();
     m_Audio->SetListenerPosition (m_Camera->GetPosition ());
     m_Audio->SetListenerFront (m_Camera->GetLookingPoint ());
     m_Audio->SetListenerTop (m_Camera->GetUpVector ());
     m_Audio->Update3DSoundPosition (m_ForestSoundId, VECTOR3 (600.0f, 200.0f, 250.0f));
-    UpdateEnemyMovement (delta);
     m_Camera->SetZoomSpeed (0.0f);
     m_Device->LookAt (
         m_Camera->GetPosition(), 
         m_Camera->GetLookingPoint() + m_Camera->GetPosition(),
         m_Camera->GetUpVector());
+    /* before the enemies, their animation depends on what is seen */
+    extract_frustum_planes (m_Device->GetViewMatrix(), m_Device->GetProjectionMatrix(), m_Frustum, cml::z_clip_zero);
     UpdateEnemies (delta);
 
     RenderShadowMap (delta);
 
     m_Device->BeginRendering (true, false, true);
+    bool isCascaded = m_ShadowCascades.GetNumCascades () > 0;
     if (m_ShouldRenderTowerGhost) {
-        m_Device->GetVCacheManager()->EnableEffect (m_TerrainEffect, "ShadowedSceneWithBuildingField");
+        m_Device->GetVCacheManager()->EnableEffect (m_TerrainEffect, isCascaded ? "CascadedShadowedSceneWithBuildingField" : "ShadowedSceneWithBuildingField");
     } else {
-        m_Device->GetVCacheManager()->EnableEffect (m_TerrainEffect, "ShadowedScene");
+        m_Device->GetVCacheManager()->EnableEffect (m_TerrainEffect, isCascaded ? "CascadedShadowedScene" : "ShadowedScene");
     }
     //m_Device->SetTextureStageState (1, TSS_COLOROP, TOP_MODULATE);
     UpdateTerrain ();
@@ -150,9 +234,8 @@ void Game::Update () {
     //m_Device->SetTextureStageState (1, TSS_COLOROP, TOP_DISABLE);
     //m_Device->GetVCacheManager()->Flush();
     //m_Device->EnableLighting (true);
-    m_Device->GetVCacheManager()->EnableEffect (m_ObjectEffect, "ShadowedScene");
-    //float frustum[6][4];
-    extract_frustum_planes (m_Device->GetViewMatrix(), m_Device->GetProjectionMatrix(), m_Frustum, cml::z_clip_zero);
+    m_Device->GetVCacheManager()->EnableEffect (m_ObjectEffect, isCascaded ? "CascadedShadowedScene" : "ShadowedScene");
+    ProcessEvents (numSteps * m_SimulationStep);
     for (UINT i = 0; i < m_Objects.size(); i++) {
         if (IsObjectVisible (m_Frustum, m_Objects[i])) {
             m_ObjManager->GetModel(m_Objects[i])->Render();
@@ -161,9 +244,8 @@ void Game::Update () {
     }
     /*m_Device->Clear (false, false, true);
     m_Ms3dLoader->GetModel(alienId)->Translate(0.0f, 0.0f, 0.1f);*/
-    RenderEnemies (delta);
+    RenderEnemies ();
     //m_Device->GetVCacheManager()->Flush();
-    UpdateTowers (delta);
     RenderTowers (false, false);    /* render active towers */
     m_Device->GetVCacheManager()->EnableEffect (m_ObjectEffect, "UnlitScene");
     RenderTowers (false, true);     /* render inactive towers */
@@ -171,41 +253,25 @@ void Game::Update () {
         RenderTowerGhost (m_BuildingTowerType);
     }
     m_Device->GetVCacheManager()->DisableEffects ();
+    if (m_ShouldRenderTowerGhost && m_IsTowerGhostPlaced) {
+        RenderTowerRange (m_TowerGhostPosition[0], m_TowerGhostPosition[1], m_TowerGhostPosition[2], m_PreparedTowers[m_BuildingTowerType].Radius);
+    }
     //m_Device->EnableLighting (false);
     for (UINT i = 0; i < m_Towers.size(); i++) {
         if (m_Towers[i].BuildingTime > 0.0f) {
             RenderBuildingTime (i);
-            m_Towers[i].BuildingTime -= delta * m_SpeedUpFactor;
-            if (m_Towers[i].BuildingTime <= 0.0f) {
-                if (m_Towers[i].Level < MAX_TOWER_LEVEL) {
-                    MakeTowerUpgrade (i);
-                } else {
-                    m_Towers[i].Level = 0;
-                }
-                if (m_SelectedTowerId == i) {
-                    ShowUpgradeInfo (i);
-                    if (m_Towers[i].Level < MAX_TOWER_LEVEL && m_Towers[i].BuildingTime <= 0.0f) {
-                        m_GameUI->EnableUpgradeButton ();
-                    }
-                }
-            }
         }
         if (!m_Towers[i].Gun->IsEmpty()) {
-            m_Towers[i].Gun->Update (delta * m_SpeedUpFactor);
             m_Towers[i].Gun->Render ();
         }
     }
     if (m_SelectedTowerId != INVALID_ID) {
-        float x = m_Towers[m_SelectedTowerId].Location.x * m_Terrain->GetTerrain()->GetScale(0);
-        float y = m_Terrain->GetTerrain()->GetScaledHeight(m_Towers[m_SelectedTowerId].Location.x, m_Towers[m_SelectedTowerId].Location.y) + 0.01f;
-        float z = m_Towers[m_SelectedTowerId].Location.y * m_Terrain->GetTerrain()->GetScale(2);
-        RenderTowerRange (x, y, z, m_Towers[m_SelectedTowerId].Radius);
+        RenderTowerRangeOutline (m_SelectedTowerId);
     }
     std::list<EnemyInfo>::iterator i;
     for (i = m_Enemies.begin(); i != m_Enemies.end(); i++) {
         RenderEnemyHealthBar (i);
     }
-    UpdateEnemyWaves (delta);
     //m_Device->Clear (false, false, true);
     //if (m_Towers.size() > 1) {
         /*  for (UINT i = 0; i < m_Towers.size(); i++) {
@@ -213,24 +279,195 @@ void Game::Update () {
         }*/
     //}
                         
-    m_Resource.TimeRemaining -= delta * m_SpeedUpFactor;
-    if (m_Resource.TimeRemaining < 0.0f) {
-        m_Resource.TimeRemaining += m_Resource.Time;
-        m_Resource.NumResources += m_Resource.Stride;
-        m_Score += m_Resource.Stride;
-        m_GameUI->UpdateNumResources (m_Resource.NumResources);
-    }
     if (m_IsMoving) {
         RenderCameraMovement ();
     }
     m_GameUI->UpdateNextWaveTime (m_NextWaveTimeLeft);
     m_GameUI->Render (m_Camera->GetPosition(), delta);
     m_Device->GetVCacheManager()->RenderText (framesPerSecond, 0xffffffff, 50, 50);
+#ifdef _DEBUG
+    char events[MAX_PATH];
+    sprintf (events, "shots %u (%u culled) hits %u (%u culled) deaths %u",
+        m_Events.GetEvents (EVENT_SHOT).size (), m_Events.GetNumCulled (EVENT_SHOT),
+        m_Events.GetEvents (EVENT_HIT).size (), m_Events.GetNumCulled (EVENT_HIT),
+        m_Events.GetEvents (EVENT_DEATH).size ());
+    m_Device->GetVCacheManager()->RenderText (events, 0xffffffff, 50, 70);
+    char poses[MAX_PATH];
+    sprintf (poses, "poses %u of %u (%u hidden, %u reduced)",
+        m_NumPoses, m_EnemyOrder.size (), m_NumHiddenEnemies, m_NumReducedEnemies);
+    m_Device->GetVCacheManager()->RenderText (poses, 0xffffffff, 50, 90);
+#endif
+    m_Events.Clear ();
     m_Device->EndRendering ();
     m_Audio->Update ();
     m_Input->Reset ();
 }
 
+void Game::SetSimulationRate (float _StepsPerSecond, UINT _MaxSteps) {
+    if (_StepsPerSecond <= 0.0f || _MaxSteps == 0) {
+        THROW_ERROR (ERRC_INVALID_PARAMETER);
+    }
+    m_SimulationStep = 1.0f / _StepsPerSecond;
+    m_MaxSimulationSteps = _MaxSteps;
+    m_SimulationTime = 0.0f;
+}
+
+void Game::SetNumThreads (UINT _numThreads) {
+    m_Jobs.Start (_numThreads);
+}
+
+void Game::SetAnimationLod (bool _isEnabled, float _nearDistance, float _farDistance, UINT _midInterval, UINT _farInterval) {
+    if (_nearDistance < 0.0f || _farDistance < _nearDistance || _midInterval == 0 || _farInterval == 0) {
+        THROW_ERROR (ERRC_INVALID_PARAMETER);
+    }
+    m_AnimationLod.IsEnabled = _isEnabled;
+    m_AnimationLod.NearDistance = _nearDistance;
+    m_AnimationLod.FarDistance = _farDistance;
+    m_AnimationLod.MidInterval = _midInterval;
+    m_AnimationLod.FarInterval = _farInterval;
+}
+
+/* Clips are baked again at the new rate when their model is next used */
+void Game::SetPoseSampleRate (float _rate) {
+    if (_rate < 0.0f) {
+        THROW_ERROR (ERRC_INVALID_PARAMETER);
+    }
+    m_PoseSampleRate = _rate;
+    m_Ms3dLoader->ClearPoseCaches ();
+}
+
+void Game::Simulate (float _Step) {
+    ExecuteReplayCommands ();
+    UpdateEnemyMovement (_Step);
+    UpdateDeadEnemies (_Step);
+    UpdateTowers (_Step);
+    UpdateTowerBuilding (_Step);
+    UpdateEnemyWaves (_Step);
+    m_Resource.TimeRemaining -= _Step;
+    if (m_Resource.TimeRemaining < 0.0f) {
+        m_Resource.TimeRemaining += m_Resource.Time;
+        m_Resource.NumResources += m_Resource.Stride;
+        m_Score += m_Resource.Stride;
+        m_GameUI->UpdateNumResources (m_Resource.NumResources);
+    }
+    if (m_CommandLog.IsHashing ()) {
+        m_StateHash = HashState (m_StateHash);
+    }
+    m_CommandLog.EndTick (m_Tick, m_StateHash);
+    m_Tick++;
+}
+
+void Game::RunLoadTest (float _Seconds, const char* _ReportFile) {
+    StartNew ();
+    /* simulation only, nothing is rendered or animated; the shooting at
+       the end of the path is timed by the steps, so it is run too */
+    UINT numSteps = (UINT)(_Seconds / m_SimulationStep);
+    m_Events.ResetTotals ();
+    UINT castleHitPoints = m_GameUI->GetCastleHitPoints ();
+    UINT maxEnemies = 0;
+    UINT maxEnemiesAtCastle = 0;
+    double totalTime = 0.0;
+    double maxStepTime = 0.0;
+    FpsCounter timer;
+    for (UINT i = 0; i < numSteps; i++) {
+        timer.StartCounter ();
+        Simulate (m_SimulationStep);
+        m_Events.Clear ();      /* nothing to show or play */
+        timer.EndCounter ();
+        double stepTime = (double)timer.GetTimeDelta ();
+        totalTime += stepTime;
+        maxStepTime = stepTime > maxStepTime ? stepTime : maxStepTime;
+        maxEnemies = m_Enemies.size () > maxEnemies ? m_Enemies.size () : maxEnemies;
+        UINT numAtCastle = 0;
+        for (std::list<EnemyInfo>::const_iterator enemy = m_Enemies.begin (); enemy != m_Enemies.end (); enemy++) {
+            if ((int)enemy->ActiveWaypoint == m_FinalWaypointIndex) {
+                numAtCastle++;
+            }
+        }
+        maxEnemiesAtCastle = numAtCastle > maxEnemiesAtCastle ? numAtCastle : maxEnemiesAtCastle;
+    }
+    FILE* report = fopen (_ReportFile, "w");
+    if (!report) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _ReportFile);
+    }
+    fprintf (report, "scenario %s\n", m_Scenario.GetFilename ());
+    fprintf (report, "steps %u of %f s\n", numSteps, m_SimulationStep);
+    fprintf (report, "simulated time %f s\n", numSteps * m_SimulationStep);
+    fprintf (report, "real time %f s\n", totalTime);
+    fprintf (report, "step time mean %f ms max %f ms\n", 
+        numSteps > 0 ? totalTime * 1000.0 / numSteps : 0.0, maxStepTime * 1000.0);
+    fprintf (report, "towers %u\n", m_Towers.size ());
+    fprintf (report, "enemies max %u left %u at the castle max %u\n", maxEnemies, m_Enemies.size (), maxEnemiesAtCastle);
+    fprintf (report, "waves %u\n", m_EnemyWaves.size ());
+    fprintf (report, "events shots %u hits %u deaths %u enemy shots %u\n",
+        m_Events.GetTotal (EVENT_SHOT), m_Events.GetTotal (EVENT_HIT), m_Events.GetTotal (EVENT_DEATH),
+        m_Events.GetTotal (EVENT_ENEMY_SHOT));
+    fprintf (report, "castle hit points %u of %u\n", m_GameUI->GetCastleHitPoints (), castleHitPoints);
+    WritePoseCacheReport (report);
+    WriteMeshReport (report);
+    WriteTextureReport (report);
+    fclose (report);
+}
+
+/* The load test once for every number of job threads. Enemy animation is
+   included, as in a frame. Returns false when the state at the end is not
+   the same for all of them. */
+bool Game::RunJobBenchmark (float _Seconds, const char* _ReportFile) {
+    FILE* report = fopen (_ReportFile, "w");
+    if (!report) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _ReportFile);
+    }
+    UINT numSteps = (UINT)(_Seconds / m_SimulationStep);
+    double singleThreadTime = 0.0;
+    UINT singleThreadHash = 0;
+    bool isSameState = true;
+    bool isLodEnabled = m_AnimationLod.IsEnabled;
+    m_AnimationLod.IsEnabled = false;   /* every enemy is animated, nothing is seen here */
+    try {
+        for (UINT numThreads = 1; numThreads <= JOB_MAX_THREADS; numThreads++) {
+            SetNumThreads (numThreads);
+            StartNew ();
+            double totalTime = 0.0;
+            double maxStepTime = 0.0;
+            FpsCounter timer;
+            for (UINT i = 0; i < numSteps; i++) {
+                timer.StartCounter ();
+                Simulate (m_SimulationStep);
+                UpdateEnemies (m_SimulationStep);
+                m_Events.Clear ();
+                timer.EndCounter ();
+                double stepTime = (double)timer.GetTimeDelta ();
+                totalTime += stepTime;
+                maxStepTime = stepTime > maxStepTime ? stepTime : maxStepTime;
+            }
+            UINT hash = HashState (COMMAND_LOG_HASH_SEED);
+            if (numThreads == 1) {
+                fprintf (report, "scenario %s\n", m_Scenario.GetFilename ());
+                fprintf (report, "steps %u of %f s\n", numSteps, m_SimulationStep);
+                singleThreadTime = totalTime;
+                singleThreadHash = hash;
+            }
+            isSameState = isSameState && hash == singleThreadHash;
+            fprintf (report, "threads %2u real time %f s step mean %f ms max %f ms speed-up %.2f enemies %u hash %08x%s\n",
+                numThreads, totalTime,
+                numSteps > 0 ? totalTime * 1000.0 / numSteps : 0.0, maxStepTime * 1000.0,
+                totalTime > 0.0 ? singleThreadTime / totalTime : 0.0,
+                m_Enemies.size (), hash, hash == singleThreadHash ? "" : " DIFFERS");
+        }
+    } catch (...) {
+        m_AnimationLod.IsEnabled = isLodEnabled;
+        fclose (report);
+        throw;
+    }
+    m_AnimationLod.IsEnabled = isLodEnabled;
+    fprintf (report, "state %s\n", isSameState ? "the same with every number of threads" : "DIFFERS from the single thread");
+    WritePoseCacheReport (report);
+    WriteMeshReport (report);
+    WriteTextureReport (report);
+    fclose (report);
+    return isSameState;
+}
+
 void Game::RenderMainScreen () {
     m_Device->BeginRendering (true, false, true);
     if (m_IsShowingControls) {
@@ -242,37 +479,87 @@ void Game::RenderMainScreen () {
 }
 
 void Game::RenderShadowMap (float _delta) {
-    m_Device->BeginRenderingToShadowMap ();
-    m_Device->Clear (true, false, true);
-    m_Terrain->GetTerrain()->Update (m_ShadowMapLightEye, m_ShadowMapLightView, m_ShadowMapLightProj);
+    UINT numCascades = m_ShadowCascades.GetNumCascades ();
+    if (numCascades == 0) {
+        m_Device->BeginRenderingToShadowMap ();
+        m_Device->Clear (true, false, true);
+        RenderShadowCasters (m_ShadowMapLightEye, m_ShadowMapLightView, m_ShadowMapLightProj);
+        m_Device->EndRenderingToShadowMap ();
+
+        m_Device->SetShadowMap (m_TerrainEffect, "g_ShadowMap");
+        m_Device->SetShadowMap (m_ObjectEffect, "g_ShadowMap");
+        m_Device->GetVCacheManager()->SetEffectParameter (m_TerrainEffect, "g_LightsWorldViewProjection", m_ShadowMapLightViewProj.data());
+        m_Device->GetVCacheManager()->SetEffectParameter (m_ObjectEffect, "g_LightsWorldViewProjection", m_ShadowMapLightViewProj.data());
+    } else {
+        m_ShadowCascades.Update (m_Device->GetViewMatrix(), m_Device->GetProjectionMatrix(), CAMERA_NEAR_CLIP, CAMERA_FAR_CLIP, m_ShadowMapLightDir);
+        MATRIX44 cascadeViewProj[MAX_SHADOW_CASCADES];
+        float splits[MAX_SHADOW_CASCADES] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (UINT i = 0; i < numCascades; i++) {
+            if (m_ShadowCascades.IsDirty (i)) {
+                m_Device->BeginRenderingToShadowCascade (i, m_ShadowCascades.GetLightViewProj (i));
+                m_Device->Clear (true, false, true);
+                RenderShadowCasters (m_ShadowCascades.GetLightEye (i), m_ShadowCascades.GetLightView (i), m_ShadowCascades.GetLightProj (i));
+                m_Device->EndRenderingToShadowMap ();
+            }
+            cascadeViewProj[i] = m_ShadowCascades.GetLightViewProj (i);
+            splits[i] = m_ShadowCascades.GetSplit (i);
+        }
+        for (UINT i = numCascades; i < MAX_SHADOW_CASCADES; i++) {
+            cascadeViewProj[i].identity ();
+        }
+        char cascadeParamName[MAX_PATH];
+        for (UINT i = 0; i < numCascades; i++) {
+            sprintf (cascadeParamName, "g_ShadowCascade%u", i);
+            m_Device->SetShadowCascade (m_TerrainEffect, i, cascadeParamName);
+            m_Device->SetShadowCascade (m_ObjectEffect, i, cascadeParamName);
+        }
+        m_Device->GetVCacheManager()->SetEffectParameter (m_TerrainEffect, "g_CascadeViewProjection", cascadeViewProj[0].data());
+        m_Device->GetVCacheManager()->SetEffectParameter (m_ObjectEffect, "g_CascadeViewProjection", cascadeViewProj[0].data());
+        m_Device->GetVCacheManager()->SetEffectParameter (m_TerrainEffect, "g_CascadeSplits", splits);
+        m_Device->GetVCacheManager()->SetEffectParameter (m_ObjectEffect, "g_CascadeSplits", splits);
+    }
+    m_Device->GetVCacheManager()->SetEffectParameter (m_TerrainEffect, "g_World", m_Device->GetWorldMatrix().data());
+    m_Device->GetVCacheManager()->SetEffectParameter (m_ObjectEffect, "g_World", m_Device->GetWorldMatrix().data());
+    MATRIX44 wvp = m_Device->GetWorldMatrix() * m_Device->GetViewMatrix() * m_Device->GetProjectionMatrix();
+    m_Device->GetVCacheManager()->SetEffectParameter (m_TerrainEffect, "g_WorldViewProjection", wvp.data());
+    m_Device->GetVCacheManager()->SetEffectParameter (m_ObjectEffect, "g_WorldViewProjection", wvp.data());
+}
+
+/* The object effect ignores the world matrix of the device, a model placed
+   by the world matrix needs the parameters of its own. */
+void Game::SetObjectEffectWorld (const MATRIX44& _World) {
+    m_Device->GetVCacheManager()->Flush ();
+    MATRIX44 world = _World;
+    MATRIX44 wvp = world * m_Device->GetViewMatrix() * m_Device->GetProjectionMatrix();
+    m_Device->GetVCacheManager()->SetEffectParameter (m_ObjectEffect, "g_World", world.data());
+    m_Device->GetVCacheManager()->SetEffectParameter (m_ObjectEffect, "g_WorldViewProjection", wvp.data());
+}
+
+void Game::RenderShadowCasters (const VECTOR3& _LightEye, const MATRIX44& _LightView, const MATRIX44& _LightProj) {
+    /* only casters inside the light frustum reach the shadow map */
+    extract_frustum_planes (_LightView, _LightProj, m_ShadowMapFrustum, cml::z_clip_zero);
+    m_Terrain->GetTerrain()->Update (_LightEye, _LightView, _LightProj);
     RenderTerrain();
     m_Device->SetCullingState (RS_CULL_CW);
     RenderTowers (true, false);
     for (UINT i = 0; i < m_Objects.size(); i++) {
-        m_ObjManager->GetModel(m_Objects[i])->Render();
+        if (IsObjectVisible (m_ShadowMapFrustum, m_Objects[i])) {
+            m_ObjManager->GetModel(m_Objects[i])->Render();
+        }
     }
     std::list<EnemyInfo>::iterator i;
     for (i = m_Enemies.begin(); i != m_Enemies.end(); i++) {
-        m_Ms3dLoader->GetModel(i->Id)->Render(m_Device);
+        if (IsEnemyVisible (m_ShadowMapFrustum, i)) {
+            m_Ms3dLoader->GetModel(i->Id)->Render(m_Device);
+        }
     }
-    m_Device->EndRenderingToShadowMap ();
     m_Device->SetCullingState (RS_CULL_CCW);
-
-    m_Device->SetShadowMap (m_TerrainEffect, "g_ShadowMap");
-    m_Device->SetShadowMap (m_ObjectEffect, "g_ShadowMap");
-    m_Device->GetVCacheManager()->SetEffectParameter (m_TerrainEffect, "g_World", m_Device->GetWorldMatrix().data());
-    m_Device->GetVCacheManager()->SetEffectParameter (m_ObjectEffect, "g_World", m_Device->GetWorldMatrix().data());
-    m_Device->GetVCacheManager()->SetEffectParameter (m_TerrainEffect, "g_LightsWorldViewProjection", m_ShadowMapLightViewProj.data());
-    m_Device->GetVCacheManager()->SetEffectParameter (m_ObjectEffect, "g_LightsWorldViewProjection", m_ShadowMapLightViewProj.data());
-    MATRIX44 wvp = m_Device->GetWorldMatrix() * m_Device->GetViewMatrix() * m_Device->GetProjectionMatrix();
-    m_Device->GetVCacheManager()->SetEffectParameter (m_TerrainEffect, "g_WorldViewProjection", wvp.data());
-    m_Device->GetVCacheManager()->SetEffectParameter (m_ObjectEffect, "g_WorldViewProjection", wvp.data());
 }
 
 void Game::SetupScene () {
     m_Device->EnableLighting (false);
     m_Device->SetClearColor (0.2f, 0.4f, 0.8f);
-    m_Device->SetProjectionView ((float)m_WindowHeight / m_WindowWidth, 1.0f, 3000.0f);
+    m_Device->SetProjectionView ((float)m_WindowHeight / m_WindowWidth, CAMERA_NEAR_CLIP, CAMERA_FAR_CLIP);
 
     m_Device->SetTextureStageState (0, TSS_COLORARG0, TA_DIFFUSE);
     m_Device->SetTextureStageState (0, TSS_COLORARG1, TA_TEXTURE);
@@ -315,7 +602,20 @@ void Game::SetupShaders () {
     m_Device->GetVCacheManager()->SetEffectParameter (m_ObjectEffect, "g_LightDir", m_ShadowMapLightDir.data());
     cml::matrix_look_at_LH (m_ShadowMapLightView, m_ShadowMapLightEye, m_ShadowMapLightDir + m_ShadowMapLightEye, VECTOR3 (0.0f, 1.0f, 0.0f));
     m_ShadowMapLightViewProj = m_ShadowMapLightView * m_ShadowMapLightProj;
-    m_Device->CreateShadowMap (1024, m_ShadowMapLightViewProj, m_ShadowMapFarClip);
+    if (SHADOW_NUM_CASCADES == 0) {
+        m_Device->CreateShadowMap (1024, m_ShadowMapLightViewProj, m_ShadowMapFarClip);
+        return;
+    }
+
+    /* Setup shadow cascades, far ones are coarser and refreshed less often. */
+    UINT sizes[MAX_SHADOW_CASCADES] = {2048, 1024, 1024, 512};
+    UINT updateIntervals[MAX_SHADOW_CASCADES] = {1, 1, 4, 8};
+    m_ShadowCascades.Setup (SHADOW_NUM_CASCADES, CAMERA_NEAR_CLIP, SHADOW_DISTANCE, 0.75f);
+    for (UINT i = 0; i < m_ShadowCascades.GetNumCascades (); i++) {
+        m_ShadowCascades.SetResolution (i, sizes[i]);
+        m_ShadowCascades.SetUpdateInterval (i, updateIntervals[i]);
+    }
+    m_Device->CreateShadowCascades (m_ShadowCascades.GetNumCascades (), sizes);
 }
 
 void Game::UnloadLevel () {
@@ -336,6 +636,7 @@ void Game::UnloadLevel () {
     m_ObjManager->UnloadAll ();
     m_Objects.clear ();
     m_Waypoints.clear ();
+    m_Path.Clear ();
     m_SelectedTowerId = INVALID_ID;
     m_Towers.clear ();
     m_PreparedTowers.clear ();
@@ -349,37 +650,65 @@ void Game::UnloadLevel () {
     }
 }
 
-void Game::LoadLevel (const char* _levelFile) {
-    FILE* file = fopen (_levelFile, "r");
-    if (!file) {
-        THROW_ERROR (ERRC_FILE_NOT_FOUND);
+/* Loaded with the level, the enemy models are parsed from the cached files when they spawn */
+void Game::RequestScenarioAssets () {
+    m_TowerAssets.clear ();
+    for (UINT i = 0; i < NUM_TOWER_TYPES; i++) {
+        const TowerDefinition& definition = m_Scenario.GetTower ((TowerType)i);
+        m_TowerAssets.push_back (m_Assets->RequestTexture (definition.Texture.c_str()));
+        m_TowerAssets.push_back (m_Assets->RequestObjModel (definition.Model.c_str()));
+    }
+    for (UINT i = 0; i < m_Scenario.GetNumScriptWaves (); i++) {
+        m_Assets->RequestMs3dFile (m_Scenario.GetWave (i).Filename.c_str());
     }
+}
+
+/* The files are read on the loader threads, the device resources are
+   created a budget at a time between the frames of the loading screen */
+void Game::WaitForAssets () {
+    while (!m_Assets->Update (ASSET_FRAME_BUDGET)) {
+        m_GameUI->RenderLoadingScreen (m_Assets->GetProgress ());
+    }
+    m_GameUI->RenderLoadingScreen (1.0f);
+}
+
+/* An object of the level file, placed when its model and texture are loaded */
+struct LevelObjectInfo {
+    UINT ModelAsset;
+    UINT TextureAsset;
+    VECTOR3 Position;
+    VECTOR3 Rotation;
+    VECTOR3 Scale;
+};
+
+void Game::LoadLevel (const char* _levelFile) {
+    VirtualFile file (_levelFile);
 
     //m_Device->GetSkinManager()->RemoveAll();
 
     char lightmapFile[MAX_PATH];
     float scaleX, scaleY, scaleZ;  
-    fscanf (file, "%f %f %f", &scaleX, &scaleY, &scaleZ);
+    file.Scan ("%f %f %f", &scaleX, &scaleY, &scaleZ);
     m_Terrain->GetTerrain()->SetScale (scaleX, scaleY, scaleZ);
     UINT lightmode;
-    fscanf (file, "%u", &lightmode);
+    file.Scan ("%u", &lightmode);
     UCHAR lightMode = (UCHAR)lightmode;
     UINT minBrightness, maxBrightness;
     int slopeLightingDirX, slopeLightingDirZ;
     float slopeLightingSoftness;
     switch (lightMode) {
         case 1:
-            fgets (lightmapFile, MAX_PATH, file);   // reading empty line
-            fgets (lightmapFile, MAX_PATH, file);
+            file.Gets (lightmapFile, MAX_PATH);   // reading empty line
+            file.Gets (lightmapFile, MAX_PATH);
             lightmapFile[strlen(lightmapFile) - 1] = '\0';  // remove the '\n' character
             break;
         case 2:
-            fscanf (file, "%d %d %u %u %f", &slopeLightingDirX, &slopeLightingDirZ, 
+            file.Scan ("%d %d %u %u %f", &slopeLightingDirX, &slopeLightingDirZ, 
                 &minBrightness, &maxBrightness, &slopeLightingSoftness);
             break;
     }
     UINT lightR, lightG, lightB;
-    fscanf (file, "%u %u %u", &lightR, &lightG, &lightB);
+    file.Scan ("%u %u %u", &lightR, &lightG, &lightB);
     UCHAR lightColor[3];
     lightColor[0] = (UCHAR)lightR;
     lightColor[1] = (UCHAR)lightG;
@@ -387,47 +716,43 @@ void Game::LoadLevel (const char* _levelFile) {
     m_Terrain->GetTerrain()->SetLightColor (lightColor[0], lightColor[1], lightColor[2]);
 
     UINT isTerrainReady;
-    fscanf (file, "%u", &isTerrainReady);
-    UINT terrainSkinId;
+    file.Scan ("%u", &isTerrainReady);
+    std::vector<UINT> terrainAssets;
     VERTEXFORMATTYPE vft;
     if (isTerrainReady) {
         UINT numTextures;
-        fscanf (file, "%u", &numTextures);
+        file.Scan ("%u", &numTextures);
         char texture[MAX_PATH];
-        UINT* textureId = new UINT[numTextures];
-        fgets (texture, MAX_PATH, file);    // reading empty line
+        file.Gets (texture, MAX_PATH);    // reading empty line
         for (UINT i = 0; i < numTextures; i++) {
             //fscanf (file, "%s", texture);
-            fgets (texture, MAX_PATH, file);
+            file.Gets (texture, MAX_PATH);
             texture[strlen(texture) - 1] = '\0';    // remove \n character
-            textureId[i] = m_Device->GetSkinManager()->AddTexture(texture);
+            terrainAssets.push_back (m_Assets->RequestTexture (texture));
         }
-        terrainSkinId = m_Device->GetSkinManager()->AddSkin(textureId, numTextures);
-        delete[] textureId;
-        fscanf (file, "%u", &vft);
+        file.Scan ("%u", &vft);
     } else {
-        terrainSkinId = INVALID_ID;
         vft = VFT_UL2;
     }
 
     UINT isWaterReady;
-    fscanf (file, "%u", &isWaterReady);
+    file.Scan ("%u", &isWaterReady);
+    UINT waterAsset = INVALID_ID;
     if (isWaterReady) {
         char waterTexture[MAX_PATH];
-        fgets (waterTexture, MAX_PATH, file);   // reading empty line
-        fgets (waterTexture, MAX_PATH, file);
+        file.Gets (waterTexture, MAX_PATH);   // reading empty line
+        file.Gets (waterTexture, MAX_PATH);
         waterTexture[strlen(waterTexture) - 1] = '\0';  // remove \n character
-        UINT waterSkinId = m_Device->GetSkinManager()->AddSkin(waterTexture);
-        m_Terrain->GetTerrainWater()->SetSkinId(waterSkinId);
+        waterAsset = m_Assets->RequestTexture (waterTexture);
         UINT waterR, waterG, waterB, waterA;
-        fscanf (file, "%u %u %u %u", &waterR, &waterG, &waterB, &waterA);
+        file.Scan ("%u %u %u %u", &waterR, &waterG, &waterB, &waterA);
         //m_WaterR = (UCHAR)waterR;
         //m_WaterG = (UCHAR)waterG;
         //m_WaterB = (UCHAR)waterB;
         //m_WaterA = (UCHAR)waterA;
         m_Terrain->GetTerrainWater()->SetColor (waterR, waterG, waterB, waterA);
         float waterHeight;
-        fscanf (file, "%f", &waterHeight);
+        file.Scan ("%f", &waterHeight);
         m_Terrain->GetTerrainWater()->SetWaterHeight(waterHeight);
     }
     //m_IsWaterPrepared = true;
@@ -435,42 +760,27 @@ void Game::LoadLevel (const char* _levelFile) {
     //CheckMenuItem (GetMenu (hMain), IDM_WATER_TURNON, MF_CHECKED);
     //CheckMenuItem (GetMenu (hMain), IDM_WATER_TURNOFF, MF_UNCHECKED);
     UINT isSkyboxReady;
-    fscanf (file, "%d", &isSkyboxReady);
+    file.Scan ("%d", &isSkyboxReady);
+    UINT skyBoxAssets[6];   /* top, bottom, left, right, far and near */
+    float skyBoxX = 0.0f, skyBoxY = 0.0f, skyBoxZ = 0.0f, skyBoxSize = 0.0f;
     if (isSkyboxReady) {
         char skyboxTexture[MAX_PATH];
         //fscanf (file, "%s", skyboxTexture);
-        fgets (skyboxTexture, MAX_PATH, file);  // read empty line
-        fgets (skyboxTexture, MAX_PATH, file);
-        skyboxTexture[strlen(skyboxTexture) - 1] = '\0';    // remove the \n character
-        UINT skyBoxTop = m_Device->GetSkinManager()->AddSkin (skyboxTexture);
-        fgets (skyboxTexture, MAX_PATH, file);
-        skyboxTexture[strlen(skyboxTexture) - 1] = '\0';    // remove the \n character
-        UINT skyBoxBottom = m_Device->GetSkinManager()->AddSkin (skyboxTexture);
-        fgets (skyboxTexture, MAX_PATH, file);
-        skyboxTexture[strlen(skyboxTexture) - 1] = '\0';    // remove the \n character
-        UINT skyBoxLeft = m_Device->GetSkinManager()->AddSkin (skyboxTexture);
-        fgets (skyboxTexture, MAX_PATH, file);
-        skyboxTexture[strlen(skyboxTexture) - 1] = '\0';    // remove the \n character
-        UINT skyBoxRight = m_Device->GetSkinManager()->AddSkin (skyboxTexture);
-        fgets (skyboxTexture, MAX_PATH, file);
-        skyboxTexture[strlen(skyboxTexture) - 1] = '\0';    // remove the \n character
-        UINT skyBoxFar = m_Device->GetSkinManager()->AddSkin (skyboxTexture);
-        fgets (skyboxTexture, MAX_PATH, file);
-        skyboxTexture[strlen(skyboxTexture) - 1] = '\0';    // remove the \n character
-        UINT skyBoxNear = m_Device->GetSkinManager()->AddSkin (skyboxTexture);
-        float skyBoxX, skyBoxY, skyBoxZ, skyBoxSize;
-        fscanf (file, "%f %f %f %f", &skyBoxX, &skyBoxY, &skyBoxZ, &skyBoxSize);
-        m_Terrain->GetSkyBox()->Init (skyBoxX, skyBoxY, skyBoxZ, skyBoxSize,
-                                      skyBoxTop, skyBoxBottom, skyBoxLeft, 
-                                      skyBoxRight, skyBoxFar, skyBoxNear);
+        file.Gets (skyboxTexture, MAX_PATH);  // read empty line
+        for (UINT i = 0; i < 6; i++) {
+            file.Gets (skyboxTexture, MAX_PATH);
+            skyboxTexture[strlen(skyboxTexture) - 1] = '\0';    // remove the \n character
+            skyBoxAssets[i] = m_Assets->RequestTexture (skyboxTexture);
+        }
+        file.Scan ("%f %f %f %f", &skyBoxX, &skyBoxY, &skyBoxZ, &skyBoxSize);
     }
 
     UINT numWaypoints;
-    fscanf (file, "%u", &numWaypoints);
-    fscanf (file, "%d", &m_FinalWaypointIndex);
+    file.Scan ("%u", &numWaypoints);
+    file.Scan ("%d", &m_FinalWaypointIndex);
     for (UINT i = 0; i < numWaypoints; i++) {
         WaypointInfo waypoint;
-        fscanf (file, "%u %u", &waypoint.Position.x, &waypoint.Position.y);
+        file.Scan ("%u %u", &waypoint.Position.x, &waypoint.Position.y);
         m_Waypoints.push_back (waypoint);
     }
 
@@ -484,51 +794,100 @@ void Game::LoadLevel (const char* _levelFile) {
     }
     m_Waypoints[numWaypoints - 1].Length = 0.0f;
     m_Waypoints[numWaypoints - 1].Direction = VECTOR3 (1.0f, 0.0f, 0.0f);
+    std::vector<VECTOR3> pathPoints (numWaypoints);
+    for (UINT i = 0; i < numWaypoints; i++) {
+        pathPoints[i] = VECTOR3 (m_Waypoints[i].Position.x * scaleX, 0.0f, m_Waypoints[i].Position.y * scaleZ);
+    }
+    m_Path.Build (pathPoints, PATH_HEIGHT_SPACING);
 
     UINT numObjects;
-    fscanf (file, "%u", &numObjects);
+    file.Scan ("%u", &numObjects);
     char objFile[MAX_PATH];
     char objTexture[MAX_PATH];
+    std::vector<LevelObjectInfo> objects (numObjects);
     for (UINT i = 0; i < numObjects; i++) {
-        fgets (objFile, MAX_PATH, file);    // read empty line
-        fgets (objFile, MAX_PATH, file);
+        file.Gets (objFile, MAX_PATH);    // read empty line
+        file.Gets (objFile, MAX_PATH);
         objFile[strlen(objFile) - 1] = '\0';    // remove the \n character
-        fgets (objTexture, MAX_PATH, file);
+        file.Gets (objTexture, MAX_PATH);
         objTexture[strlen(objTexture) - 1] = '\0';    // remove the \n character
-        vs3d::MATERIAL material;
-        material.Ambient = vs3d::COLORVALUE (0.8f, 0.8f, 0.8f, 1.0f);
-        material.Diffuse = vs3d::COLORVALUE (1.0f, 1.0f, 1.0f, 1.0f);
-        material.Emissive = vs3d::COLORVALUE (0.0f, 0.0f, 0.0f, 0.0f);
-        material.Specular = vs3d::COLORVALUE (0.0f, 0.0f, 0.0f, 0.0f);
-        material.Power = 0.0f;
-        UINT objId = m_ObjManager->Load (objFile, m_Device->GetSkinManager()->AddSkin(objTexture, material));
-        VECTOR3 position;
-        fscanf (file, "%f %f %f", &(position[0]), &(position[1]), &(position[2]));
-        VECTOR3 rotation;
-        fscanf (file, "%f %f %f", &(rotation[0]), &(rotation[1]), &(rotation[2]));
-        VECTOR3 scale;
-        fscanf (file, "%f %f %f", &(scale[0]), &(scale[1]), &(scale[2]));
-        m_ObjManager->GetModel (objId)->ScaleX (scale[0]);
-        m_ObjManager->GetModel (objId)->ScaleY (scale[1]);
-        m_ObjManager->GetModel (objId)->ScaleZ (scale[2]);
-        m_ObjManager->GetModel (objId)->Rotate (rotation[0], rotation[1], rotation[2]);
-        m_ObjManager->GetModel (objId)->Translate (position[0], position[1], position[2]);
-        m_ObjManager->GetModel (objId)->Prepare ();
-        m_Objects.push_back (objId);
+        objects[i].ModelAsset = m_Assets->RequestObjModel (objFile);
+        objects[i].TextureAsset = m_Assets->RequestTexture (objTexture);
+        VECTOR3& position = objects[i].Position;
+        file.Scan ("%f %f %f", &(position[0]), &(position[1]), &(position[2]));
+        VECTOR3& rotation = objects[i].Rotation;
+        file.Scan ("%f %f %f", &(rotation[0]), &(rotation[1]), &(rotation[2]));
+        VECTOR3& scale = objects[i].Scale;
+        file.Scan ("%f %f %f", &(scale[0]), &(scale[1]), &(scale[2]));
     }
 
     UINT size;
-    fscanf (file, "%u", &size);
+    file.Scan ("%u", &size);
     m_Terrain->GetTerrain()->NewHeightmap (size);
     UINT height;
     for (UINT i = 0; i < size; i++) {
         for (UINT j = 0; j < size; j++) {
-            fscanf (file, "%u", &height);
+            file.Scan ("%u", &height);
             m_Terrain->GetTerrain()->SetHeight (j, i, (UCHAR)height);
         }
         /*fscanf (file, "%u", &height);
         m_Terrain->SetHeight (size - 1, i, height);*/
     }
+    m_HeightField.Refresh (m_Terrain->GetTerrain ());
+    UINT numSamples = m_Path.GetNumHeightSamples ();
+    std::vector<float> sampleX (numSamples), sampleZ (numSamples), sampleHeight (numSamples);
+    for (UINT i = 0; i < numSamples; i++) {
+        VECTOR3 point = m_Path.GetHeightSamplePoint (i);
+        sampleX[i] = point[0];
+        sampleZ[i] = point[2];
+    }
+    m_HeightField.GetHeights (&sampleX[0], &sampleZ[0], &sampleHeight[0], numSamples);
+    for (UINT i = 0; i < numSamples; i++) {
+        m_Path.SetHeightSample (i, sampleHeight[i]);
+    }
+
+    /* the rest needs the textures and the models */
+    WaitForAssets ();
+    UINT terrainSkinId = INVALID_ID;
+    if (!terrainAssets.empty ()) {
+        std::vector<UINT> textureId (terrainAssets.size ());
+        for (UINT i = 0; i < terrainAssets.size (); i++) {
+            textureId[i] = m_Assets->GetResult (terrainAssets[i]);
+        }
+        terrainSkinId = m_Device->GetSkinManager()->AddSkin(&textureId[0], textureId.size ());
+    }
+    if (isWaterReady) {
+        m_Terrain->GetTerrainWater()->SetSkinId(m_Device->GetSkinManager()->AddSkin (m_Assets->GetResult (waterAsset), INVALID_ID));
+    }
+    if (isSkyboxReady) {
+        UINT skyBoxSkin[6];
+        for (UINT i = 0; i < 6; i++) {
+            skyBoxSkin[i] = m_Device->GetSkinManager()->AddSkin (m_Assets->GetResult (skyBoxAssets[i]), INVALID_ID);
+        }
+        m_Terrain->GetSkyBox()->Init (skyBoxX, skyBoxY, skyBoxZ, skyBoxSize,
+                                      skyBoxSkin[0], skyBoxSkin[1], skyBoxSkin[2], 
+                                      skyBoxSkin[3], skyBoxSkin[4], skyBoxSkin[5]);
+    }
+    vs3d::MATERIAL material;
+    material.Ambient = vs3d::COLORVALUE (0.8f, 0.8f, 0.8f, 1.0f);
+    material.Diffuse = vs3d::COLORVALUE (1.0f, 1.0f, 1.0f, 1.0f);
+    material.Emissive = vs3d::COLORVALUE (0.0f, 0.0f, 0.0f, 0.0f);
+    material.Specular = vs3d::COLORVALUE (0.0f, 0.0f, 0.0f, 0.0f);
+    material.Power = 0.0f;
+    UINT objectMaterialId = m_Device->GetSkinManager()->AddMaterial (material);
+    for (UINT i = 0; i < numObjects; i++) {
+        UINT objId = m_Assets->GetResult (objects[i].ModelAsset);
+        ObjModel* model = m_ObjManager->GetModel (objId);
+        model->SetSkinId (m_Device->GetSkinManager()->AddSkin (m_Assets->GetResult (objects[i].TextureAsset), objectMaterialId));
+        model->ScaleX (objects[i].Scale[0]);
+        model->ScaleY (objects[i].Scale[1]);
+        model->ScaleZ (objects[i].Scale[2]);
+        model->Rotate (objects[i].Rotation[0], objects[i].Rotation[1], objects[i].Rotation[2]);
+        model->Translate (objects[i].Position[0], objects[i].Position[1], objects[i].Position[2]);
+        model->Prepare ();
+        m_Objects.push_back (objId);
+    }
+
     switch (lightMode) {
         case 0:
             m_Terrain->GetTerrain()->SetHeightBasedLighting();
@@ -547,7 +906,6 @@ void Game::LoadLevel (const char* _levelFile) {
 
     m_Terrain->GetTerrain()->EnableBruteForce(true);
 
-    fclose (file);
 
     m_IsLevelLoaded = true;
 
@@ -566,133 +924,52 @@ void Game::LoadLevel (const char* _levelFile) {
     m_GameUI->UpdateNumResources (m_Resource.NumResources);
 }
 
-void Game::Save () {
-    FILE* save = fopen ("Save.txt", "w");
-    fprintf (save, "%u\n", m_GameUI->GetCastleHitPoints());
-    fprintf (save, "%f %f %f %f %f %f\n", 
-        m_Camera->GetPosition()[0], m_Camera->GetPosition()[1], m_Camera->GetPosition()[2],
-        m_Camera->GetLookingPoint()[0], m_Camera->GetLookingPoint()[1], m_Camera->GetLookingPoint()[2]);
-    fprintf (save, "%u\n", m_EnemyWaves.size());
-    for (UINT i = 0; i < m_EnemyWaves.size(); i++) {
-        fprintf (save, "%f %u %f\n", m_EnemyWaves[i].Delay, m_EnemyWaves[i].NumEnemies, m_EnemyWaves[i].SpawnTimeRemaining);
-    }
-    fprintf (save, "%u\n", m_Enemies.size());
-    std::list<EnemyInfo>::iterator enemy;
-    for (enemy = m_Enemies.begin(); enemy != m_Enemies.end(); enemy++) {
-        fprintf (save, "%u %u %d %f %f %f %f %f %f %f %f %f %s %f %u %u %f\n",
-            enemy->WaveId, enemy->ActiveWaypoint, enemy->HitPoints,
-            enemy->SlowDownFactor, enemy->Ammo, 
-            enemy->Position[0], enemy->Position[1], enemy->Position[2],
-            enemy->Direction[0], enemy->Direction[1], enemy->Direction[2],
-            enemy->Distance, enemy->CurrentAnimation.c_str(), 
-            enemy->AnimationSpeed, enemy->LoopAnimation, enemy->IsDead,
-            enemy->SelfDestructionTime);
-    }
-    fprintf (save, "%u\n", m_Towers.size());
-    for (UINT i = 0; i < m_Towers.size(); i++) {
-        fprintf (save, "%u %u %u %u %f %f\n", 
-            m_Towers[i].Type, 
-            m_Towers[i].Level, 
-            m_Towers[i].Location.x, 
-            m_Towers[i].Location.y,
-            m_Towers[i].BuildingTime,
-            m_Towers[i].MaxBuildingTime);
-    }
-    fprintf (save, "%f %f %u %u\n", m_Resource.Time, m_Resource.TimeRemaining,
-        m_Resource.Stride, m_Resource.NumResources);
-    fprintf (save, "%u\n", m_Score);
-    fclose (save);
+/* Every obj file once, the copies of a model are prepared the same way. */
+void Game::WriteMeshReport (FILE* _report) {
+    std::map<std::string, bool> isReported;
+    for (UINT i = 0; i < m_ObjManager->GetNumModels (); i++) {
+        ObjModel* model = m_ObjManager->GetModel (i);
+        if (model->GetNumTriangles () == 0 || isReported[model->GetFilename ()]) {
+            continue;
+        }
+        isReported[model->GetFilename ()] = true;
+        fprintf (_report, "mesh %s triangles %u corners %u vertices %u acmr %.3f -> %.3f\n", model->GetFilename (),
+            model->GetNumTriangles (), model->GetNumCorners (), model->GetNumRenderVertices (),
+            model->GetAcmrBefore (), model->GetAcmrAfter ());
+    }
 }
 
-void Game::Load () {
-    FILE* load = fopen ("Save.txt", "r");
-    UINT numHP;
-    fscanf (load, "%u", &numHP);
-    m_GameUI->SetCastleHitPoints (numHP);
-    VECTOR3 position, lookingPoint, direction;
-    fscanf (load, "%f %f %f %f %f %f", 
-        &(position[0]), &(position[1]), &(position[2]),
-        &(lookingPoint[0]), &(lookingPoint[1]), &(lookingPoint[2]));
-    m_Camera->SetPosition (position);
-    m_Camera->SetLookingPoint (lookingPoint);
-    m_EnemyWaves.clear ();
-    UINT numWaves;
-    fscanf (load, "%u", &numWaves);
-    while (numWaves > m_EnemyWaves.size()) {
-        AddEnemyWaves ();
-    }
-    for (UINT i = 0; i < numWaves; i++) {
-        fscanf (load, "%f %u %f", 
-            &(m_EnemyWaves[i].Delay), 
-            &(m_EnemyWaves[i].NumEnemies), 
-            &(m_EnemyWaves[i].SpawnTimeRemaining));
-    }
-    m_Enemies.clear ();
-    UINT numEnemies;
-    fscanf (load, "%u", &numEnemies);
-    std::list<EnemyInfo>::iterator enemy;
-    UINT waveIndex, activeWaypoint;
-    float slowDownFactor, ammo, distance, animSpeed, selfDestructionTime;
-    UINT loopAnim, isDead;
-    char currentAnim[MAX_PATH];
-    int hitPoints;
-    for (UINT i = 0; i < numEnemies; i++) {
-        fscanf (load, "%u %u %d %f %f %f %f %f %f %f %f %f %s %f %u %u %f",
-            &waveIndex, &activeWaypoint, &hitPoints,
-            &slowDownFactor, &ammo, 
-            &(position[0]), &(position[1]), &(position[2]),
-            &(direction[0]), &(direction[1]), &(direction[2]),
-            &distance, currentAnim, &animSpeed, 
-            &loopAnim, &isDead, &selfDestructionTime);
-        NewEnemy (waveIndex, animSpeed);
-        EnemyInfo& enemy = m_Enemies.back();
-        enemy.ActiveWaypoint = activeWaypoint;
-        enemy.Ammo = ammo;
-        enemy.Direction[0] = direction[0];
-        enemy.Direction[1] = direction[1];
-        enemy.Direction[2] = direction[2];
-        enemy.Distance = distance;
-        enemy.HitPoints = hitPoints;
-        enemy.IsDead = isDead == 1 ? true : false;
-        enemy.LoopAnimation = loopAnim == 1 ? true : false;
-        enemy.Position[0] = position[0];
-        enemy.Position[1] = position[1];
-        enemy.Position[2] = position[2];
-        enemy.SelfDestructionTime = selfDestructionTime;
-        enemy.SlowDownFactor = slowDownFactor;
-        enemy.CurrentAnimation = currentAnim;
-        m_Ms3dLoader->GetModel(enemy.Id)->ClearTransformations();
-        m_Ms3dLoader->GetModel(enemy.Id)->Scale(10.0f, 10.0f, 10.0f);
-        m_Ms3dLoader->GetModel(enemy.Id)->Translate (position[0], position[1], position[2]);
-        m_Ms3dLoader->GetModel(enemy.Id)->Rotate (-3.14f / 2.0f, 3.14f, 0.0f);
-        cml::vector2f oldDirection (0.0f, -1.0f);
-        cml::vector2f newDirection (enemy.Direction[0], enemy.Direction[2]);
-        float angle = cml::signed_angle_2D (newDirection, oldDirection);
-        m_Ms3dLoader->GetModel(enemy.Id)->Rotate (0.0f, angle, 0.0f);
-    }
-    m_Towers.clear ();
-    UINT numTowers;
-    fscanf (load, "%u", &numTowers);
-    UINT level;
-    TowerType type;
-    POINT pos;
-    float buildingTime, maxBuildingTime;
-    for (UINT i = 0; i < numTowers; i++) {
-        fscanf (load, "%u %u %u %u %f %f", &type, &level, &pos.x, &pos.y, &buildingTime, &maxBuildingTime);
-        CreateTower (type, pos);
-        if (level <= MAX_TOWER_LEVEL) {
-            m_Towers[i].Level = 0;              /* tower must be already built */
-            for (UINT j = 0; j < level; j++) {
-                MakeTowerUpgrade (i);
-            }
+/* The memory of every texture as it is loaded. The ones with a cooked file
+   are loaded once more both ways, to compare the time and the memory. */
+void Game::WriteTextureReport (FILE* _report) {
+    ISkinManager* skins = m_Device->GetSkinManager ();
+    UINT totalMemory = 0;
+    UINT sourceMemory = 0;
+    UINT cookedMemory = 0;
+    float sourceTime = 0.0f;
+    float cookedTime = 0.0f;
+    for (UINT i = 0; i < skins->GetNumTextures (); i++) {
+        const char* name = skins->GetTextureName (i);
+        UINT memory = skins->GetTextureMemory (i);
+        totalMemory += memory;
+        fprintf (_report, "texture %s %s memory %u", name, skins->IsTextureCooked (i) ? "cooked" : "source", memory);
+        if (skins->HasCookedTexture (name)) {
+            float time[2];
+            UINT levelsMemory[2];
+            skins->MeasureTextureLoad (name, false, time[0], levelsMemory[0]);
+            skins->MeasureTextureLoad (name, true, time[1], levelsMemory[1]);
+            fprintf (_report, " load %.2f -> %.2f ms (%+.2f ms) memory %u -> %u bytes saved %.1f%%",
+                time[0] * 1000.0f, time[1] * 1000.0f, (time[1] - time[0]) * 1000.0f, levelsMemory[0], levelsMemory[1],
+                100.0f * (1.0f - (float)levelsMemory[1] / levelsMemory[0]));
+            sourceTime += time[0];
+            cookedTime += time[1];
+            sourceMemory += levelsMemory[0];
+            cookedMemory += levelsMemory[1];
         }
-        m_Towers[i].BuildingTime = buildingTime;
-        m_Towers[i].MaxBuildingTime = maxBuildingTime;
+        fprintf (_report, "\n");
     }
-    fscanf (load, "%f %f %u %u", &m_Resource.Time, &m_Resource.TimeRemaining,
-        &m_Resource.Stride, &m_Resource.NumResources);
-    fscanf (load, "%u", &m_Score);
-    fclose (load);
+    fprintf (_report, "textures %u memory %u cooked load %.2f -> %.2f ms memory %u -> %u bytes\n", skins->GetNumTextures (),
+        totalMemory, sourceTime * 1000.0f, cookedTime * 1000.0f, sourceMemory, cookedMemory);
 }
 
 bool Game::IsRayIntersectsObb (const VECTOR3& _rayOrigin, const VECTOR3& _rayDirection, 
@@ -740,30 +1017,7 @@ bool Game::IsRayIntersectsObb (const VECTOR3& _rayOrigin, const VECTOR3& _rayDir
 }
 
 float Game::GetHeight (const VECTOR3& _Position) {
-    float x = _Position[0] / m_Terrain->GetTerrain()->GetScale(0);
-    float z = _Position[2] / m_Terrain->GetTerrain()->GetScale(2);
-    UINT mapX = (UINT)x;
-    UINT mapZ = (UINT)z;
-    x = x - floorf (x);
-    z = z - floorf (z);
-    float h1, h2, h3;
-    float r1, r2, r;
-    if (x + z < 1.0f) {
-        h1 = m_Terrain->GetTerrain()->GetScaledHeight(mapX + 1, mapZ);
-        h2 = m_Terrain->GetTerrain()->GetScaledHeight(mapX, mapZ + 1);
-        h3 = m_Terrain->GetTerrain()->GetScaledHeight(mapX, mapZ);
-        r1 = h2 - (h2 - h1) * x;
-        r2 = h3 + (h1 - h3) * x;
-        r = r2 + (r1 - r2) * z / (1.0f - x);
-    } else {
-        h1 = m_Terrain->GetTerrain()->GetScaledHeight(mapX, mapZ + 1);
-        h2 = m_Terrain->GetTerrain()->GetScaledHeight(mapX + 1, mapZ);
-        h3 = m_Terrain->GetTerrain()->GetScaledHeight(mapX + 1, mapZ + 1);
-        r1 = h2 - (h2 - h1) * (1.0f - x);
-        r2 = h3 + (h1 - h3) * (1.0f - x);
-        r = r2 + (r1 - r2) * (1.0f - z) / x;
-    }
-    return r;
+    return m_HeightField.GetHeight (_Position[0], _Position[2]);
 }
 
 void Game::PauseSounds () {
@@ -0,0 +1,51 @@
+#include "../include/GameEvents.h"
+
+GameEventBuffer::GameEventBuffer () {
+    for (UINT i = 0; i < NUM_EVENT_TYPES; i++) {
+        m_NumCulled[i] = 0;
+    }
+    ResetTotals ();
+}
+
+void GameEventBuffer::Add (GameEventType _type, const GameEvent& _event) {
+    m_Events[_type].push_back (_event);
+    m_Totals[_type]++;
+}
+
+const std::vector<GameEvent>& GameEventBuffer::GetEvents (GameEventType _type) const {
+    if ((UINT)_type >= NUM_EVENT_TYPES) {
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    return m_Events[_type];
+}
+
+void GameEventBuffer::Cull (GameEventType _type) {
+    m_NumCulled[_type]++;
+    m_TotalsCulled[_type]++;
+}
+
+void GameEventBuffer::Clear () {
+    for (UINT i = 0; i < NUM_EVENT_TYPES; i++) {
+        m_Events[i].clear ();
+        m_NumCulled[i] = 0;
+    }
+}
+
+UINT GameEventBuffer::GetNumCulled (GameEventType _type) const {
+    return m_NumCulled[_type];
+}
+
+UINT GameEventBuffer::GetTotal (GameEventType _type) const {
+    return m_Totals[_type];
+}
+
+UINT GameEventBuffer::GetTotalCulled (GameEventType _type) const {
+    return m_TotalsCulled[_type];
+}
+
+void GameEventBuffer::ResetTotals () {
+    for (UINT i = 0; i < NUM_EVENT_TYPES; i++) {
+        m_Totals[i] = 0;
+        m_TotalsCulled[i] = 0;
+    }
+}
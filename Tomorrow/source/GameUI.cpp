@@ -11,6 +11,7 @@ GameUI::GameUI (RenderDevice* _Device, UINT _WindowWidth, UINT _WindowHeight) {
     m_MainInfoVertex = NULL;
     m_HoodMapSkinId = INVALID_ID;
     m_HoodMapVertex = NULL;
+    m_Minimap = new Minimap (_Device);
     m_CastleHitPointsVertex = NULL;
     m_CastleHitPointsIndex = NULL;
     m_InfoButton = NULL;
@@ -30,6 +31,8 @@ GameUI::GameUI (RenderDevice* _Device, UINT _WindowWidth, UINT _WindowHeight) {
     m_Header[0] = '\0';
     m_Description[0] = '\0';
     m_ResourceText[0] = '\0';
+    m_NextWaveTimeMsg[0] = '\0';
+    m_NextWaveTimeShown = INVALID_ID;
 }
 
 GameUI::~GameUI () {
@@ -42,6 +45,7 @@ GameUI::~GameUI () {
     delete[] m_CastleHitPointsIndex;
     delete[] m_InfoButton;
     delete[] m_MessageBox;
+    delete m_Minimap;
 }
 
 void GameUI::Render (const VECTOR3& _Position, float _delta) {
@@ -74,22 +78,7 @@ void GameUI::Render (const VECTOR3& _Position, float _delta) {
                 VFT_TLC,
                 INVALID_ID);
         }
-        m_Device->EnablePointsScale();
-        m_Device->SetPointsSize (2.0f);
-        vs3d::TLCVERTEX* mapObjectData = new vs3d::TLCVERTEX[m_MapObjects.size()];
-        UINT numData = 0;
-        std::map<UINT, MapObject>::iterator i;
-        for (i = m_MapObjects.begin(); i != m_MapObjects.end(); i++) {
-            mapObjectData[numData].Color = i->second.Color;
-            mapObjectData[numData].X = i->second.Location[0];
-            mapObjectData[numData].Y = i->second.Location[1];
-            mapObjectData[numData].Z = 0.0f;
-            mapObjectData[numData].RHW = 1.0f;
-            numData++;
-        }
-        m_Device->GetVCacheManager()->Render (PT_POINT, mapObjectData, numData, NULL, 0, VFT_TLC, INVALID_ID);
-        m_Device->DisablePointsScale();
-        delete[] mapObjectData;
+        m_Minimap->Render (2.0f);
         m_Device->GetVCacheManager()->Render (
             PT_TRIANGLELIST,
             m_HoodPanelVertex,
@@ -127,7 +116,6 @@ void GameUI::Render (const VECTOR3& _Position, float _delta) {
                 6,
                 VFT_TL,
                 m_MessageBoxSkinId);
-            m_Device->GetVCacheManager()->Flush (); // render now to make text on top
             m_Device->GetVCacheManager()->SetTextSize (16);
             m_Device->GetVCacheManager()->RenderText (
                 m_MessageBoxTitle,
@@ -219,6 +207,13 @@ bool GameUI::InitMainHood (const char* _MapTexture, const char* _HoodTexture, fl
     if (hoodBottomOffset < 0) {
         hoodBottomOffset = 0;
     }
+    m_Minimap->SetArea (
+        hoodBottomOffset + MAP_UPPER_X,
+        m_WindowHeight - HOOD_HEIGHT + MAP_UPPER_Y,
+        MAP_LOWER_X - MAP_UPPER_X,
+        MAP_LOWER_Y - MAP_UPPER_Y,
+        _MapSizeX,
+        _MapSizeY);
 
     m_HoodPanelSkinId = m_Device->GetSkinManager()->AddSkin("data/hood/Panel.png");
 
@@ -405,53 +400,28 @@ void GameUI::SetMaxCastleHitPoints (UINT _MaxHitPoints) {
     m_CastleHitPointsVertex[5].X = hp;
 }
 
-void GameUI::UpdateMark (UINT _Id, VECTOR3 _Position, DWORD _Color) {
-    std::map<UINT, MapObject>::iterator i;
-    i = m_MapObjects.find (_Id);
-    float mapPositionX = (m_WindowWidth - HOOD_WIDTH) / 2.0f;
-    if (mapPositionX < 0.0f) {
-        mapPositionX = 0.0f;
-    }
-    mapPositionX += MAP_UPPER_X;
-    float mapSizeX = MAP_LOWER_X - MAP_UPPER_X;
-    float mapPositionY = m_WindowHeight - HOOD_HEIGHT + MAP_UPPER_Y;
-    float mapSizeY = MAP_LOWER_Y - MAP_UPPER_Y;
-    if (i == m_MapObjects.end()) {
-        MapObject object;
-        object.Color = _Color;
-        object.Location[0] = mapPositionX + mapSizeX * _Position[0] / m_MapSizeX;
-        object.Location[1] = mapPositionY +  mapSizeY * (1.0f - _Position[2] / m_MapSizeY);
-        m_MapObjects[_Id] = object;
-    } else {
-        i->second.Location[0] = mapPositionX + mapSizeX * _Position[0] / m_MapSizeX;
-        i->second.Location[1] = mapPositionY + mapSizeY * (1.0f - _Position[2] / m_MapSizeY);
-    }
+UINT GameUI::AddEnemyMark (VECTOR3 _Position) {
+    return m_Minimap->AddDynamicMark (_Position, 0xffff0000);
 }
 
-void GameUI::UpdateEnemyMark (UINT _EnemyId, VECTOR3 _Position) {
-    UpdateMark (10000 + _EnemyId, _Position, 0xffff0000);
+void GameUI::UpdateEnemyMark (UINT _MarkId, VECTOR3 _Position) {
+    m_Minimap->UpdateMark (_MarkId, _Position);
 }
 
-void GameUI::RemoveEnemyMark (UINT _EnemyId) {
-    std::map<UINT, MapObject>::iterator i = m_MapObjects.find (10000 + _EnemyId);
-    if (i != m_MapObjects.end()) {
-        m_MapObjects.erase (i);
-    }
+void GameUI::RemoveEnemyMark (UINT _MarkId) {
+    m_Minimap->RemoveMark (_MarkId);
 }
 
-void GameUI::UpdateTowerMark (UINT _TowerId, VECTOR3 _Position) {
-    UpdateMark (20000 + _TowerId, _Position, 0xff0000ff);
+UINT GameUI::AddTowerMark (VECTOR3 _Position) {
+    return m_Minimap->AddStaticMark (_Position, 0xff0000ff);
 }
 
-void GameUI::RemoveTowerMark (UINT _TowerId) {
-    std::map<UINT, MapObject>::iterator i = m_MapObjects.find (20000 + _TowerId);
-    if (i != m_MapObjects.end()) {
-        m_MapObjects.erase (i);
-    }
+void GameUI::RemoveTowerMark (UINT _MarkId) {
+    m_Minimap->RemoveMark (_MarkId);
 }
 
 void GameUI::RemoveAllMarks () {
-    m_MapObjects.clear ();
+    m_Minimap->RemoveAllMarks ();
 }
 
 bool GameUI::IsCursorOnHood (POINT _Cursor) {
@@ -588,6 +558,11 @@ void GameUI::DisableDetailsButton () {
 void GameUI::UpdateNextWaveTime (float _timeLeft) {
     float min = floor (_timeLeft / 60.0f);
     float sec = floor (_timeLeft - min * 60.0f);
+    UINT shownTime = (UINT)(min * 60.0f + sec);
+    if (shownTime == m_NextWaveTimeShown) {
+        return;     /* the message is the same, keep the cached text layout */
+    }
+    m_NextWaveTimeShown = shownTime;
     sprintf (m_NextWaveTimeMsg, "Next wave after %.0f:%.0f", min, sec);
 }
 
@@ -627,9 +602,22 @@ void GameUI::ProcessMessageBoxInput (POINT _cursor) {
     }
 }
 
-void GameUI::RenderLoadingScreen () {
+void GameUI::RenderLoadingScreen (float _progress) {
     m_Device->BeginRendering (true, false, true);
     m_Device->GetVCacheManager()->Render(PT_TRIANGLELIST, m_MainScreenBuffer, 0, INVALID_ID, 0, 2, VFT_TL, m_MainScreenSkin.LoadingScreen);
+    if (_progress > 0.0f) {
+        m_Device->GetVCacheManager()->Flush();
+        float left = (m_WindowWidth - LOADING_BAR_WIDTH) / 2.0f;
+        float right = left + LOADING_BAR_WIDTH * (_progress < 1.0f ? _progress : 1.0f);
+        float bottom = m_WindowHeight - LOADING_BAR_BOTTOM;
+        float top = bottom - LOADING_BAR_HEIGHT;
+        vs3d::TLCVERTEX bar[4];
+        bar[0] = vs3d::TLCVERTEX (left, bottom, 0.0f, 1.0f, LOADING_BAR_COLOR);
+        bar[1] = vs3d::TLCVERTEX (left, top, 0.0f, 1.0f, LOADING_BAR_COLOR);
+        bar[2] = vs3d::TLCVERTEX (right, top, 0.0f, 1.0f, LOADING_BAR_COLOR);
+        bar[3] = vs3d::TLCVERTEX (right, bottom, 0.0f, 1.0f, LOADING_BAR_COLOR);
+        m_Device->GetVCacheManager()->Render (PT_TRIANGLELIST, bar, 4, m_MainHoodIndex, 6, VFT_TLC, INVALID_ID);
+    }
     m_Device->EndRendering ();
 }
 
@@ -0,0 +1,122 @@
+#include "../include/HeightField.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define HEIGHTFIELD_SSE2
+#include <emmintrin.h>
+#endif
+
+HeightField::HeightField () {
+    m_Size = 0;
+    m_Revision = 0;
+    m_InvScaleX = 1.0f;
+    m_InvScaleZ = 1.0f;
+}
+
+bool HeightField::Refresh (ITerrain* _Terrain) {
+    UINT revision = _Terrain->GetHeightmapRevision ();
+    if (!IsEmpty () && revision == m_Revision) {
+        return false;
+    }
+    UINT size = _Terrain->GetSize ();
+    if (size < 2) {
+        Clear ();
+        return false;
+    }
+    m_Heights.resize (size * size);
+    _Terrain->GetScaledHeights (&m_Heights[0]);
+    m_Size = size;
+    m_Revision = revision;
+    m_InvScaleX = 1.0f / _Terrain->GetScale (0);
+    m_InvScaleZ = 1.0f / _Terrain->GetScale (2);
+    return true;
+}
+
+void HeightField::Clear () {
+    m_Heights.clear ();
+    m_Size = 0;
+}
+
+bool HeightField::IsEmpty () const {
+    return m_Heights.empty ();
+}
+
+float HeightField::GetGridHeight (UINT _X, UINT _Z) const {
+    if (_X >= m_Size || _Z >= m_Size) {
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    return m_Heights[_Z * m_Size + _X];
+}
+
+float HeightField::GetHeight (float _X, float _Z) const {
+    if (IsEmpty ()) {
+        return 0.0f;
+    }
+    float maxCoord = (float)(m_Size - 1);
+    float maxCell = (float)(m_Size - 2);
+    float x = _X * m_InvScaleX;
+    float z = _Z * m_InvScaleZ;
+    x = x < 0.0f ? 0.0f : (x > maxCoord ? maxCoord : x);
+    z = z < 0.0f ? 0.0f : (z > maxCoord ? maxCoord : z);
+    /* the far edge belongs to the last cell */
+    float cellX = (float)(UINT)x;
+    float cellZ = (float)(UINT)z;
+    cellX = cellX > maxCell ? maxCell : cellX;
+    cellZ = cellZ > maxCell ? maxCell : cellZ;
+    x -= cellX;
+    z -= cellZ;
+    const float* corner = &m_Heights[(UINT)cellZ * m_Size + (UINT)cellX];
+    float h00 = corner[0];
+    float h10 = corner[1];
+    float h01 = corner[m_Size];
+    float h11 = corner[m_Size + 1];
+    if (x + z < 1.0f) {
+        return h00 + (h10 - h00) * x + (h01 - h00) * z;
+    }
+    return h11 + (h01 - h11) * (1.0f - x) + (h10 - h11) * (1.0f - z);
+}
+
+void HeightField::GetHeights (const float* _X, const float* _Z, float* _Heights, UINT _Count) const {
+    UINT i = 0;
+    if (IsEmpty ()) {
+        for (; i < _Count; i++) {
+            _Heights[i] = 0.0f;
+        }
+        return;
+    }
+#ifdef HEIGHTFIELD_SSE2
+    const __m128 zero = _mm_setzero_ps ();
+    const __m128 one = _mm_set1_ps (1.0f);
+    const __m128 maxCoord = _mm_set1_ps ((float)(m_Size - 1));
+    const __m128 maxCell = _mm_set1_ps ((float)(m_Size - 2));
+    const __m128 size = _mm_set1_ps ((float)m_Size);
+    const __m128 invScaleX = _mm_set1_ps (m_InvScaleX);
+    const __m128 invScaleZ = _mm_set1_ps (m_InvScaleZ);
+    const float* heights = &m_Heights[0];
+    for (; i + 4 <= _Count; i += 4) {
+        __m128 x = _mm_min_ps (_mm_max_ps (_mm_mul_ps (_mm_loadu_ps (_X + i), invScaleX), zero), maxCoord);
+        __m128 z = _mm_min_ps (_mm_max_ps (_mm_mul_ps (_mm_loadu_ps (_Z + i), invScaleZ), zero), maxCoord);
+        __m128 cellX = _mm_min_ps (_mm_cvtepi32_ps (_mm_cvttps_epi32 (x)), maxCell);
+        __m128 cellZ = _mm_min_ps (_mm_cvtepi32_ps (_mm_cvttps_epi32 (z)), maxCell);
+        x = _mm_sub_ps (x, cellX);
+        z = _mm_sub_ps (z, cellZ);
+        /* no gather in SSE2, the corners are fetched lane by lane */
+        int index[4];
+        _mm_storeu_si128 ((__m128i*)index, _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (cellZ, size), cellX)));
+        __m128 h00 = _mm_set_ps (heights[index[3]], heights[index[2]], heights[index[1]], heights[index[0]]);
+        __m128 h10 = _mm_set_ps (heights[index[3] + 1], heights[index[2] + 1], heights[index[1] + 1], heights[index[0] + 1]);
+        __m128 h01 = _mm_set_ps (heights[index[3] + m_Size], heights[index[2] + m_Size], heights[index[1] + m_Size], heights[index[0] + m_Size]);
+        __m128 h11 = _mm_set_ps (heights[index[3] + m_Size + 1], heights[index[2] + m_Size + 1], heights[index[1] + m_Size + 1], heights[index[0] + m_Size + 1]);
+        __m128 lower = _mm_add_ps (h00, _mm_add_ps (
+            _mm_mul_ps (_mm_sub_ps (h10, h00), x),
+            _mm_mul_ps (_mm_sub_ps (h01, h00), z)));
+        __m128 upper = _mm_add_ps (h11, _mm_add_ps (
+            _mm_mul_ps (_mm_sub_ps (h01, h11), _mm_sub_ps (one, x)),
+            _mm_mul_ps (_mm_sub_ps (h10, h11), _mm_sub_ps (one, z))));
+        __m128 isLower = _mm_cmplt_ps (_mm_add_ps (x, z), one);
+        _mm_storeu_ps (_Heights + i, _mm_or_ps (_mm_and_ps (isLower, lower), _mm_andnot_ps (isLower, upper)));
+    }
+#endif
+    for (; i < _Count; i++) {
+        _Heights[i] = GetHeight (_X[i], _Z[i]);
+    }
+}
@@ -10,6 +10,8 @@ void Game::ProcessMainScreenInput () {
             POINT cursor;
             GetCursorPos (&cursor);
             if (m_GameUI->IsCursorOnNewGame (cursor)) {
+                SaveRecording ();
+                m_CommandLog.Stop ();   /* a replay ends, a recording starts again */
                 m_IsContinuing = false;
                 m_IsLevelLoaded = false;
                 m_IsPaused = false;
@@ -35,6 +37,16 @@ void Game::ProcessInGameInput () {
         if (!m_IsLevelLoaded) {
             return;
         }
+        if (IsReplaying ()) {
+            /* the recording plays the commands and moves the camera */
+            if (m_Input->WasPressed (VK_ESCAPE)) {
+                PauseSounds ();
+                m_IsPaused = true;
+                m_Device->SetTextureStageState (0, TSS_ALPHAARG1, TA_TEXTURE);
+                m_Device->SetTextureStageState (0, TSS_ALPHAOP, TOP_SELECTARG1);
+            }
+            return;
+        }
         POINT mouse;
         GetCursorPos (&mouse);
         MoveCamera ();
@@ -55,24 +67,21 @@ void Game::ProcessInGameInput () {
             }
             if (m_Input->WasPressed (VK_LBUTTON)) {
                 if (m_ShouldRenderTowerGhost) {
-                    if (m_Resource.NumResources >= m_PreparedTowers[m_BuildingTowerType].Price) {
-                        POINT point;
-                        if (IsTerrainClicked (point)) {
-                            if (CreateTower (m_BuildingTowerType, point)) {
-                                m_Resource.NumResources -= m_PreparedTowers[m_BuildingTowerType].Price;
-                                m_GameUI->UpdateNumResources (m_Resource.NumResources);
-                                m_SelectedTowerId = m_Towers.size() - 1;
-                                ShowUpgradeInfo (m_SelectedTowerId);
-                                m_KeepInfoMessage = true;
-                                m_GameUI->DisableDetailsButton ();
-                                if (m_Towers[m_SelectedTowerId].Level < MAX_TOWER_LEVEL && m_Towers[m_SelectedTowerId].BuildingTime <= 0.0f) {
-                                    m_GameUI->EnableUpgradeButton ();
-                                }
-                                m_ShouldRenderTowerGhost = false;
-                            }
-                        }
-                    } else {
+                    GameCommand command;
+                    ZeroMemory (&command, sizeof (GameCommand));
+                    command.Type = CMD_PLACE_TOWER;
+                    command.Param = m_BuildingTowerType;
+                    if (m_Resource.NumResources < m_PreparedTowers[m_BuildingTowerType].Price) {
                         m_GameUI->ShowMessage ("Not enough resources.", 0xffff0000, 3.0f);
+                    } else if (IsTerrainClicked (command.Location) && IssueCommand (command)) {
+                        m_SelectedTowerId = m_Towers.size() - 1;
+                        ShowUpgradeInfo (m_SelectedTowerId);
+                        m_KeepInfoMessage = true;
+                        m_GameUI->DisableDetailsButton ();
+                        if (m_Towers[m_SelectedTowerId].Level < MAX_TOWER_LEVEL && m_Towers[m_SelectedTowerId].BuildingTime <= 0.0f) {
+                            m_GameUI->EnableUpgradeButton ();
+                        }
+                        m_ShouldRenderTowerGhost = false;
                     }
                 }
             }
@@ -121,10 +130,13 @@ void Game::ProcessInGameInput () {
                 m_IsMoving = false;
             }
         }
-        if (m_Input->IsPressed (VK_SPACE)) {
-            m_SpeedUpFactor = 5.0f;
-        } else {
-            m_SpeedUpFactor = 1.0f;
+        float speedUpFactor = m_Input->IsPressed (VK_SPACE) ? 5.0f : 1.0f;
+        if (speedUpFactor != m_SpeedUpFactor) {
+            GameCommand command;
+            ZeroMemory (&command, sizeof (GameCommand));
+            command.Type = CMD_SPEED_UP;
+            command.Values[0] = speedUpFactor;
+            IssueCommand (command);
         }
         if (wasEscPressed && shouldShowMainScreen) {
             Save ();
@@ -236,19 +248,13 @@ void Game::ProcessInputOnHood (POINT _mouse) {
                         m_GameUI->ShowMessageBox ("Area Tower details", m_PreparedTowers[AREA_TOWER].Description);
                 }
             } else if (m_GameUI->IsUpgradeButtonVisible ()) {
-                TowerType type = m_Towers[m_SelectedTowerId].Type;
-                UINT lvl = m_Towers[m_SelectedTowerId].Level;
-                if (lvl < MAX_TOWER_LEVEL) {
-                    if (m_Resource.NumResources >= m_UpgradeInfo[type].Price[lvl]) {
-                        m_Resource.NumResources -= m_UpgradeInfo[type].Price[lvl];
-                        m_GameUI->UpdateNumResources (m_Resource.NumResources);
-                        m_Towers[m_SelectedTowerId].BuildingTime = m_UpgradeInfo[type].UpgradeTime[lvl];
-                        m_Towers[m_SelectedTowerId].MaxBuildingTime = m_UpgradeInfo[type].UpgradeTime[lvl];
-                        ShowUpgradeInfo (m_SelectedTowerId);
-                        m_GameUI->DisableUpgradeButton ();
-                    } else {
-                        m_GameUI->ShowMessage ("Not enough resources", 0xffff0000, 3.0f);
-                    }
+                GameCommand command;
+                ZeroMemory (&command, sizeof (GameCommand));
+                command.Type = CMD_UPGRADE_TOWER;
+                command.Param = m_SelectedTowerId;
+                if (IssueCommand (command)) {
+                    ShowUpgradeInfo (m_SelectedTowerId);
+                    m_GameUI->DisableUpgradeButton ();
                 }
             }
         }
@@ -341,6 +347,9 @@ void Game::RotateCamera (POINT _mouse) {
 }
 
 void Game::ZoomCamera (float _speed) {
+    if (IsReplaying ()) {
+        return;
+    }
     m_Camera->SetZoomSpeed(_speed);
     if (m_Camera->GetNextPosition()[1] < MIN_HEIGHT || m_Camera->GetNextPosition()[1] > 1500.0f) {
         m_Camera->SetZoomSpeed (0.0f);
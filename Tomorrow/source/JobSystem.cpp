@@ -0,0 +1,177 @@
+#include "../include/JobSystem.h"
+#include <climits>
+
+#define JOB_SPIN_COUNT 4000     /* the caller spins this long before it sleeps */
+
+JobSystem::JobSystem () : m_Error (ERRC_UNDEFINED, __FILE__, __LINE__) {
+    m_WakeSemaphore = NULL;
+    m_DoneEvent = NULL;
+    m_NumPending = 0;
+    m_IsStopping = 0;
+    m_HasFailed = 0;
+}
+
+JobSystem::~JobSystem () {
+    Stop ();
+}
+
+void JobSystem::Start (UINT _numThreads) {
+    Stop ();
+    if (_numThreads == 0) {
+        SYSTEM_INFO info;
+        GetSystemInfo (&info);
+        _numThreads = info.dwNumberOfProcessors;
+    }
+    _numThreads = _numThreads > JOB_MAX_THREADS ? JOB_MAX_THREADS : _numThreads;
+    _numThreads = _numThreads < 1 ? 1 : _numThreads;
+    m_IsStopping = 0;
+    m_WakeSemaphore = CreateSemaphore (NULL, 0, LONG_MAX, NULL);
+    m_DoneEvent = CreateEvent (NULL, FALSE, FALSE, NULL);
+    if (!m_WakeSemaphore || !m_DoneEvent) {
+        Stop ();
+        THROW_ERROR (ERRC_API_CALL);
+    }
+    for (UINT i = 0; i < _numThreads; i++) {
+        Worker* worker = new Worker;
+        InitializeCriticalSection (&worker->Lock);
+        worker->Thread = NULL;
+        worker->System = this;
+        worker->Index = i;
+        m_Workers.push_back (worker);
+        if (i > 0) {
+            worker->Thread = CreateThread (NULL, 0, WorkerProc, worker, 0, NULL);
+            if (!worker->Thread) {
+                Stop ();
+                THROW_ERROR (ERRC_API_CALL);
+            }
+        }
+    }
+}
+
+void JobSystem::Stop () {
+    InterlockedExchange (&m_IsStopping, 1);
+    if (m_WakeSemaphore && m_Workers.size () > 1) {
+        ReleaseSemaphore (m_WakeSemaphore, m_Workers.size () - 1, NULL);
+    }
+    for (UINT i = 0; i < m_Workers.size (); i++) {
+        if (m_Workers[i]->Thread) {
+            WaitForSingleObject (m_Workers[i]->Thread, INFINITE);
+            CloseHandle (m_Workers[i]->Thread);
+        }
+    }
+    /* a late worker may still look into the queues of the others until it sees the stop */
+    for (UINT i = 0; i < m_Workers.size (); i++) {
+        DeleteCriticalSection (&m_Workers[i]->Lock);
+        delete m_Workers[i];
+    }
+    m_Workers.clear ();
+    if (m_WakeSemaphore) {
+        CloseHandle (m_WakeSemaphore);
+        m_WakeSemaphore = NULL;
+    }
+    if (m_DoneEvent) {
+        CloseHandle (m_DoneEvent);
+        m_DoneEvent = NULL;
+    }
+}
+
+UINT JobSystem::GetNumThreads () const {
+    return m_Workers.size () > 0 ? m_Workers.size () : 1;
+}
+
+void JobSystem::ParallelFor (JobTask& _task, UINT _count, UINT _grain) {
+    _grain = _grain > 0 ? _grain : 1;
+    if (m_Workers.size () < 2 || _count <= _grain) {
+        if (_count > 0) {
+            _task.Run (0, _count);
+        }
+        return;
+    }
+    /* neighbouring jobs go to the same queue */
+    UINT numJobs = (_count + _grain - 1) / _grain;
+    UINT numWorkers = m_Workers.size ();
+    m_NumPending = numJobs;
+    for (UINT i = 0; i < numJobs; i++) {
+        Job job;
+        job.Task = &_task;
+        job.Begin = i * _grain;
+        job.End = job.Begin + _grain < _count ? job.Begin + _grain : _count;
+        Worker* worker = m_Workers[(UINT)((unsigned __int64)i * numWorkers / numJobs)];
+        EnterCriticalSection (&worker->Lock);
+        worker->Jobs.push_back (job);
+        LeaveCriticalSection (&worker->Lock);
+    }
+    /* a worker woken late finds the queues empty and sleeps again */
+    ReleaseSemaphore (m_WakeSemaphore, numWorkers - 1, NULL);
+    RunJobs (0);
+    /* the last jobs run on other threads, they are short, so spin a while first */
+    for (UINT spin = 0; m_NumPending > 0 && spin < JOB_SPIN_COUNT; spin++) {
+        YieldProcessor ();
+    }
+    while (m_NumPending > 0) {
+        WaitForSingleObject (m_DoneEvent, INFINITE);    /* may be left set by an earlier call */
+    }
+    if (InterlockedExchange (&m_HasFailed, 0) != 0) {
+        throw m_Error;
+    }
+}
+
+DWORD WINAPI JobSystem::WorkerProc (LPVOID _worker) {
+    Worker* worker = (Worker*)_worker;
+    worker->System->Work (worker->Index);
+    return 0;
+}
+
+void JobSystem::Work (UINT _index) {
+    while (true) {
+        WaitForSingleObject (m_WakeSemaphore, INFINITE);
+        if (m_IsStopping) {
+            return;
+        }
+        RunJobs (_index);
+    }
+}
+
+bool JobSystem::PopJob (UINT _index, Job& _job) {
+    Worker* own = m_Workers[_index];
+    EnterCriticalSection (&own->Lock);
+    if (!own->Jobs.empty ()) {
+        _job = own->Jobs.back ();
+        own->Jobs.pop_back ();
+        LeaveCriticalSection (&own->Lock);
+        return true;
+    }
+    LeaveCriticalSection (&own->Lock);
+    for (UINT i = 1; i < m_Workers.size (); i++) {
+        Worker* victim = m_Workers[(_index + i) % m_Workers.size ()];
+        EnterCriticalSection (&victim->Lock);
+        if (!victim->Jobs.empty ()) {
+            _job = victim->Jobs.front ();
+            victim->Jobs.pop_front ();
+            LeaveCriticalSection (&victim->Lock);
+            return true;
+        }
+        LeaveCriticalSection (&victim->Lock);
+    }
+    return false;
+}
+
+void JobSystem::RunJobs (UINT _index) {
+    Job job;
+    while (PopJob (_index, job)) {
+        try {
+            job.Task->Run (job.Begin, job.End);
+        } catch (ErrorMessage e) {
+            if (InterlockedCompareExchange (&m_HasFailed, 1, 0) == 0) {
+                m_Error = e;
+            }
+        } catch (...) {
+            if (InterlockedCompareExchange (&m_HasFailed, 1, 0) == 0) {
+                m_Error = ErrorMessage (ERRC_UNDEFINED, __FILE__, __LINE__);
+            }
+        }
+        if (InterlockedDecrement (&m_NumPending) == 0) {
+            SetEvent (m_DoneEvent);
+        }
+    }
+}
@@ -0,0 +1,174 @@
+#include "../include/Minimap.h"
+
+Minimap::Minimap (RenderDevice* _Device) {
+    m_Device = _Device;
+    m_NumStatic = 0;
+    m_DirtyStart = 0;
+    m_DirtyEnd = 0;
+    m_BufferId = INVALID_ID;
+    m_BufferCapacity = 0;
+    m_AreaX = m_AreaY = 0.0f;
+    m_AreaWidth = m_AreaHeight = 0.0f;
+    m_MapSizeX = m_MapSizeY = 1.0f;
+}
+
+Minimap::~Minimap () {
+}
+
+void Minimap::SetArea (float _X, float _Y, float _Width, float _Height, float _MapSizeX, float _MapSizeY) {
+    m_AreaX = _X;
+    m_AreaY = _Y;
+    m_AreaWidth = _Width;
+    m_AreaHeight = _Height;
+    m_MapSizeX = _MapSizeX;
+    m_MapSizeY = _MapSizeY;
+}
+
+UINT Minimap::AddMark (const VECTOR3& _Position, DWORD _Color) {
+    UINT markId;
+    if (m_FreeMarks.empty ()) {
+        markId = m_MarkSlot.size ();
+        m_MarkSlot.push_back (INVALID_ID);
+    } else {
+        markId = m_FreeMarks.back ();
+        m_FreeMarks.pop_back ();
+    }
+    UINT slot = m_Vertices.size ();
+    m_Vertices.push_back (vs3d::TLCVERTEX (0.0f, 0.0f, 0.0f, 1.0f, _Color));
+    m_SlotOwner.push_back (markId);
+    m_MarkSlot[markId] = slot;
+    SetLocation (slot, _Position);
+    return markId;
+}
+
+UINT Minimap::AddStaticMark (const VECTOR3& _Position, DWORD _Color) {
+    UINT markId = AddMark (_Position, _Color);
+    UINT slot = m_MarkSlot[markId];
+    if (slot != m_NumStatic) {
+        /* first dynamic mark goes to the end, the new static one takes its place */
+        vs3d::TLCVERTEX vertex = m_Vertices[slot];
+        MoveSlot (m_NumStatic, slot);
+        m_Vertices[m_NumStatic] = vertex;
+        m_SlotOwner[m_NumStatic] = markId;
+        m_MarkSlot[markId] = m_NumStatic;
+        MarkDirty (m_NumStatic);
+    }
+    m_NumStatic++;
+    return markId;
+}
+
+UINT Minimap::AddDynamicMark (const VECTOR3& _Position, DWORD _Color) {
+    return AddMark (_Position, _Color);
+}
+
+void Minimap::UpdateMark (UINT _MarkId, const VECTOR3& _Position) {
+    if (_MarkId >= m_MarkSlot.size () || m_MarkSlot[_MarkId] == INVALID_ID) {
+        return;
+    }
+    SetLocation (m_MarkSlot[_MarkId], _Position);
+}
+
+void Minimap::RemoveMark (UINT _MarkId) {
+    if (_MarkId >= m_MarkSlot.size () || m_MarkSlot[_MarkId] == INVALID_ID) {
+        return;
+    }
+    UINT slot = m_MarkSlot[_MarkId];
+    if (slot < m_NumStatic) {
+        /* keep static marks packed: the last static mark fills the hole */
+        m_NumStatic--;
+        if (slot != m_NumStatic) {
+            MoveSlot (m_NumStatic, slot);
+        }
+        slot = m_NumStatic;
+    }
+    UINT last = m_Vertices.size () - 1;
+    if (slot != last) {
+        MoveSlot (last, slot);
+    }
+    m_Vertices.pop_back ();
+    m_SlotOwner.pop_back ();
+    m_MarkSlot[_MarkId] = INVALID_ID;
+    m_FreeMarks.push_back (_MarkId);
+}
+
+void Minimap::RemoveAllMarks () {
+    m_Vertices.clear ();
+    m_SlotOwner.clear ();
+    m_MarkSlot.clear ();
+    m_FreeMarks.clear ();
+    m_NumStatic = 0;
+    m_DirtyStart = m_DirtyEnd = 0;
+}
+
+void Minimap::Render (float _PointSize) {
+    if (m_Vertices.empty ()) {
+        return;
+    }
+    Upload ();
+    m_Device->EnablePointsScale ();
+    m_Device->SetPointsSize (_PointSize);
+    m_Device->GetVCacheManager()->Render (PT_POINT, m_BufferId, 0, INVALID_ID, 0, m_Vertices.size (), VFT_TLC, INVALID_ID);
+    m_Device->DisablePointsScale ();
+}
+
+UINT Minimap::GetNumMarks () const {
+    return m_Vertices.size ();
+}
+
+void Minimap::SetLocation (UINT _Slot, const VECTOR3& _Position) {
+    float x = m_AreaX + m_AreaWidth * _Position[0] / m_MapSizeX;
+    float y = m_AreaY + m_AreaHeight * (1.0f - _Position[2] / m_MapSizeY);
+    if (m_Vertices[_Slot].X != x || m_Vertices[_Slot].Y != y) {
+        m_Vertices[_Slot].X = x;
+        m_Vertices[_Slot].Y = y;
+        MarkDirty (_Slot);
+    }
+}
+
+void Minimap::MoveSlot (UINT _From, UINT _To) {
+    m_Vertices[_To] = m_Vertices[_From];
+    m_SlotOwner[_To] = m_SlotOwner[_From];
+    m_MarkSlot[m_SlotOwner[_To]] = _To;
+    MarkDirty (_To);
+}
+
+void Minimap::MarkDirty (UINT _Slot) {
+    if (m_DirtyStart == m_DirtyEnd) {
+        m_DirtyStart = _Slot;
+        m_DirtyEnd = _Slot + 1;
+        return;
+    }
+    if (_Slot < m_DirtyStart) {
+        m_DirtyStart = _Slot;
+    }
+    if (_Slot + 1 > m_DirtyEnd) {
+        m_DirtyEnd = _Slot + 1;
+    }
+}
+
+void Minimap::Upload () {
+    IVertexCacheManager* vcm = m_Device->GetVCacheManager();
+    UINT numVertices = m_Vertices.size ();
+    if (m_BufferId == INVALID_ID || numVertices > m_BufferCapacity) {
+        UINT capacity = m_BufferCapacity > 0 ? m_BufferCapacity : MINIMAP_INITIAL_CAPACITY;
+        while (capacity < numVertices) {
+            capacity *= 2;
+        }
+        std::vector<vs3d::TLCVERTEX> padding (capacity - m_BufferCapacity);
+        if (m_BufferId == INVALID_ID) {
+            m_BufferId = vcm->CreateStaticVertexBuffer (&padding[0], capacity, VFT_TLC);
+        } else {
+            vcm->AddToStaticVertexBuffer (m_BufferId, &padding[0], capacity - m_BufferCapacity, VFT_TLC);
+        }
+        m_BufferCapacity = capacity;
+        m_DirtyStart = 0;
+        m_DirtyEnd = numVertices;
+    }
+    if (m_DirtyEnd > numVertices) {
+        m_DirtyEnd = numVertices;
+    }
+    if (m_DirtyStart < m_DirtyEnd) {
+        vcm->UpdateStaticVertexBuffer (m_BufferId, m_DirtyStart, &m_Vertices[m_DirtyStart], m_DirtyEnd - m_DirtyStart, VFT_TLC);
+    }
+    m_DirtyStart = m_DirtyEnd = 0;
+}
@@ -0,0 +1,189 @@
+#include "../include/Game.h"
+
+#ifdef TOMORROW_TESTS
+#include <set>
+
+using namespace ms3d;
+
+/* The decode Ms3dModel::Load did before its data was validated up front: a
+   record at a time, the triangle indices and the keyframes allocated per mesh
+   and per joint. It trusts the counts of the file, so it runs on good files only. */
+static void DecodePerRecord (const char* _data) {
+    const char* data = _data + 14;
+    USHORT numVertices;
+    memcpy (&numVertices, data, sizeof (USHORT));
+    data += 2;
+    VERTEX* vertex = new VERTEX[numVertices];
+    memcpy (vertex, data, numVertices * sizeof (VERTEX));
+    data += numVertices * sizeof (VERTEX);
+
+    USHORT numTriangles;
+    memcpy (&numTriangles, data, sizeof (USHORT));
+    data += 2;
+    TRIANGLE* triangle = new TRIANGLE[numTriangles];
+    for (UINT i = 0; i < numTriangles; i++) {
+        memcpy (&triangle[i].Flag, data, sizeof (USHORT));
+        data += sizeof (USHORT);
+        memcpy (triangle[i].VertIndex, data, 68);
+        data += 68;
+    }
+
+    USHORT numMeshes;
+    memcpy (&numMeshes, data, sizeof (USHORT));
+    data += 2;
+    MESH* mesh = new MESH[numMeshes];
+    for (UINT i = 0; i < numMeshes; i++) {
+        memcpy (&mesh[i], data, 35);
+        data += 35;
+        mesh[i].TriIndex = new USHORT[mesh[i].NumTriangles];
+        memcpy (mesh[i].TriIndex, data, mesh[i].NumTriangles * sizeof (USHORT));
+        data += mesh[i].NumTriangles * sizeof (USHORT);
+        mesh[i].Material = *data;
+        data += 1;
+    }
+
+    USHORT numMaterials;
+    memcpy (&numMaterials, data, sizeof (USHORT));
+    data += 2;
+    MATERIAL* material = new MATERIAL[numMaterials];
+    memcpy (material, data, numMaterials * sizeof (MATERIAL));
+    data += numMaterials * sizeof (MATERIAL);
+    data += 12;
+
+    USHORT numJoints;
+    memcpy (&numJoints, data, sizeof (USHORT));
+    data += 2;
+    JOINT* joint = new JOINT[numJoints];
+    for (UINT i = 0; i < numJoints; i++) {
+        memcpy (&joint[i], data, 93);
+        data += 93;
+        joint[i].RotKeyFrame = new KEYFRAME[joint[i].NumRotFrames];
+        memcpy (joint[i].RotKeyFrame, data, joint[i].NumRotFrames * sizeof (KEYFRAME));
+        data += joint[i].NumRotFrames * sizeof (KEYFRAME);
+        joint[i].TransKeyFrame = new KEYFRAME[joint[i].NumTransFrames];
+        memcpy (joint[i].TransKeyFrame, data, joint[i].NumTransFrames * sizeof (KEYFRAME));
+        data += joint[i].NumTransFrames * sizeof (KEYFRAME);
+    }
+
+    for (UINT i = 0; i < numJoints; i++) {
+        delete[] joint[i].RotKeyFrame;
+        delete[] joint[i].TransKeyFrame;
+    }
+    delete[] joint;
+    delete[] material;
+    for (UINT i = 0; i < numMeshes; i++) {
+        delete[] mesh[i].TriIndex;
+    }
+    delete[] mesh;
+    delete[] triangle;
+    delete[] vertex;
+}
+
+/* The decode Ms3dModel::Load does now: the sections are validated first,
+   the triangle indices and the keyframes go to one array each */
+static void DecodeSections (const Ms3dModel& _model, const char* _filename, const char* _data, UINT _size) {
+    SECTIONS sections;
+    _model.ValidateData (_filename, _data, _size, sections);
+    TRIANGLE* triangle = new TRIANGLE[sections.NumTriangles];
+    const char* data = sections.Triangles;
+    for (UINT i = 0; i < sections.NumTriangles; i++) {
+        memcpy (&triangle[i].Flag, data, sizeof (USHORT));
+        memcpy (triangle[i].VertIndex, data + sizeof (USHORT), 68);
+        data += 70;
+    }
+
+    MESH* mesh = new MESH[sections.NumMeshes];
+    USHORT* triIndex = new USHORT[sections.NumTriIndices];
+    USHORT* nextTriIndex = triIndex;
+    data = sections.Meshes;
+    for (UINT i = 0; i < sections.NumMeshes; i++) {
+        memcpy (&mesh[i], data, 35);
+        data += 35;
+        mesh[i].TriIndex = nextTriIndex;
+        memcpy (nextTriIndex, data, mesh[i].NumTriangles * sizeof (USHORT));
+        nextTriIndex += mesh[i].NumTriangles;
+        data += mesh[i].NumTriangles * sizeof (USHORT);
+        mesh[i].Material = *data;
+        data += 1;
+    }
+
+    MATERIAL* material = new MATERIAL[sections.NumMaterials];
+    memcpy (material, sections.Materials, sections.NumMaterials * sizeof (MATERIAL));
+
+    JOINT* joint = new JOINT[sections.NumJoints];
+    KEYFRAME* keyFrame = new KEYFRAME[sections.NumKeyFrames];
+    KEYFRAME* nextKeyFrame = keyFrame;
+    data = sections.Joints;
+    for (UINT i = 0; i < sections.NumJoints; i++) {
+        memcpy (&joint[i], data, 93);
+        data += 93;
+        UINT numFrames = joint[i].NumRotFrames + joint[i].NumTransFrames;
+        memcpy (nextKeyFrame, data, numFrames * sizeof (KEYFRAME));
+        data += numFrames * sizeof (KEYFRAME);
+        joint[i].RotKeyFrame = nextKeyFrame;
+        joint[i].TransKeyFrame = nextKeyFrame + joint[i].NumRotFrames;
+        nextKeyFrame += numFrames;
+    }
+
+    delete[] keyFrame;
+    delete[] joint;
+    delete[] material;
+    delete[] triIndex;
+    delete[] mesh;
+    delete[] triangle;
+}
+
+void Game::RunMs3dBenchmark (UINT _Loads, const char* _ReportFile) {
+    /* the enemy models of the scenario, each once */
+    m_Scenario.Load (m_ScenarioFile.c_str ());
+    std::set<std::string> filenames;
+    for (UINT i = 0; i < m_Scenario.GetNumScriptWaves (); i++) {
+        filenames.insert (m_Scenario.GetWave (i).Filename);
+    }
+    FILE* report = fopen (_ReportFile, "w");
+    if (!report) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _ReportFile);
+    }
+    fprintf (report, "scenario %s loads %u\n", m_Scenario.GetFilename (), _Loads);
+    try {
+        for (std::set<std::string>::iterator i = filenames.begin (); i != filenames.end (); i++) {
+            const char* filename = i->c_str ();
+            VirtualFile file;
+            file.Open (filename);
+            Ms3dModel model;
+            /* the old decode trusts the file, check it first */
+            model.Load (filename, file.GetData (), file.GetSize ());
+            FpsCounter timer;
+            timer.StartCounter ();
+            for (UINT j = 0; j < _Loads; j++) {
+                DecodePerRecord (file.GetData ());
+            }
+            timer.EndCounter ();
+            double perRecordTime = (double)timer.GetTimeDelta ();
+            timer.StartCounter ();
+            for (UINT j = 0; j < _Loads; j++) {
+                DecodeSections (model, filename, file.GetData (), file.GetSize ());
+            }
+            timer.EndCounter ();
+            double sectionsTime = (double)timer.GetTimeDelta ();
+            timer.StartCounter ();
+            for (UINT j = 0; j < _Loads; j++) {
+                model.Load (filename, file.GetData (), file.GetSize ());
+            }
+            timer.EndCounter ();
+            double loadTime = (double)timer.GetTimeDelta ();
+            double toMicroseconds = _Loads > 0 ? 1000000.0 / _Loads : 0.0;
+            fprintf (report, "%s %u bytes\n", filename, file.GetSize ());
+            fprintf (report, "    decode per record   %f us\n", perRecordTime * toMicroseconds);
+            fprintf (report, "    validate and decode %f us speed-up %.2f\n", sectionsTime * toMicroseconds,
+                sectionsTime > 0.0 ? perRecordTime / sectionsTime : 0.0);
+            fprintf (report, "    whole load          %f us\n", loadTime * toMicroseconds);
+        }
+    } catch (...) {
+        fclose (report);
+        throw;
+    }
+    fclose (report);
+}
+
+#endif
@@ -0,0 +1,115 @@
+#include "../include/RingMeshCache.h"
+
+RingMeshCache::RingMeshCache (RenderDevice* _Device) {
+    m_Device = _Device;
+}
+
+RingMeshCache::~RingMeshCache () {
+}
+
+void RingMeshCache::RenderCircle (const VECTOR3& _Center, float _Radius, UINT _NumSegments, DWORD _Color) {
+    /* unit X -> world X, unit Y -> world Z */
+    MATRIX44 world (
+        _Radius, 0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, _Radius, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        _Center[0], _Center[1], _Center[2], 1.0f);
+    RenderMesh (world, GetMesh (_NumSegments, _Color), _NumSegments);
+}
+
+void RingMeshCache::RenderArc (const VECTOR3& _Center, const VECTOR3& _Right, const VECTOR3& _Up, float _Radius, float _Fraction, UINT _NumSegments, DWORD _Color) {
+    UINT numPrimitives = (UINT)(_NumSegments * _Fraction);
+    if (numPrimitives == 0) {
+        return;
+    }
+    if (numPrimitives > _NumSegments) {
+        numPrimitives = _NumSegments;
+    }
+    VECTOR3 right = _Right * _Radius;
+    VECTOR3 up = _Up * _Radius;
+    VECTOR3 forward = cml::cross (_Right, _Up);
+    MATRIX44 world (
+        right[0], right[1], right[2], 0.0f,
+        up[0], up[1], up[2], 0.0f,
+        forward[0], forward[1], forward[2], 0.0f,
+        _Center[0], _Center[1], _Center[2], 1.0f);
+    RenderMesh (world, GetMesh (_NumSegments, _Color), numPrimitives);
+}
+
+void RingMeshCache::BuildCircle (const VECTOR3& _Center, float _Radius, UINT _NumSegments, DWORD _Color, std::vector<vs3d::ULCVERTEX>& _Vertices) {
+    const std::vector<float>& ring = GetUnitRing (_NumSegments);
+    _Vertices.resize (_NumSegments + 1);
+    _Vertices[0] = vs3d::ULCVERTEX (_Center[0], _Center[1], _Center[2], _Color);
+    for (UINT i = 0; i < _NumSegments; i++) {
+        _Vertices[i + 1] = vs3d::ULCVERTEX (
+            _Center[0] + ring[i * 2] * _Radius,
+            _Center[1],
+            _Center[2] + ring[i * 2 + 1] * _Radius,
+            _Color);
+    }
+}
+
+void RingMeshCache::RenderVertices (std::vector<vs3d::ULCVERTEX>& _Vertices) {
+    if (_Vertices.size () < 2) {
+        return;
+    }
+    UINT numSegments = _Vertices.size () - 1;
+    m_Device->GetVCacheManager()->Render (PT_TRIANGLELIST, &_Vertices[0], _Vertices.size (), GetIndexBuffer (numSegments), 0, numSegments, VFT_ULC, INVALID_ID);
+}
+
+const std::vector<float>& RingMeshCache::GetUnitRing (UINT _NumSegments) {
+    std::map<UINT, std::vector<float> >::iterator ring = m_UnitRings.find (_NumSegments);
+    if (ring != m_UnitRings.end ()) {
+        return ring->second;
+    }
+    std::vector<float>& points = m_UnitRings[_NumSegments];
+    points.resize (_NumSegments * 2);
+    for (UINT i = 0; i < _NumSegments; i++) {
+        float angle = i * 2 * (float)M_PI / _NumSegments;
+        points[i * 2] = cosf (angle);
+        points[i * 2 + 1] = sinf (angle);
+    }
+    return points;
+}
+
+const RingMeshCache::UnitMesh& RingMeshCache::GetMesh (UINT _NumSegments, DWORD _Color) {
+    std::pair<UINT, DWORD> key (_NumSegments, _Color);
+    std::map<std::pair<UINT, DWORD>, UnitMesh>::iterator mesh = m_Meshes.find (key);
+    if (mesh != m_Meshes.end ()) {
+        return mesh->second;
+    }
+    const std::vector<float>& ring = GetUnitRing (_NumSegments);
+    std::vector<vs3d::ULCVERTEX> vertices (_NumSegments + 1);
+    vertices[0] = vs3d::ULCVERTEX (0.0f, 0.0f, 0.0f, _Color);   // center vertex
+    for (UINT i = 0; i < _NumSegments; i++) {
+        vertices[i + 1] = vs3d::ULCVERTEX (ring[i * 2], ring[i * 2 + 1], 0.0f, _Color);
+    }
+    UnitMesh unitMesh;
+    unitMesh.VertexBufferId = m_Device->GetVCacheManager()->CreateStaticVertexBuffer (&vertices[0], vertices.size (), VFT_ULC);
+    unitMesh.IndexBufferId = GetIndexBuffer (_NumSegments);
+    return m_Meshes[key] = unitMesh;
+}
+
+UINT RingMeshCache::GetIndexBuffer (UINT _NumSegments) {
+    std::map<UINT, UINT>::iterator buffer = m_IndexBuffers.find (_NumSegments);
+    if (buffer != m_IndexBuffers.end ()) {
+        return buffer->second;
+    }
+    /* one triangle per segment, so an arc is a prefix of the index buffer */
+    std::vector<WORD> indices (_NumSegments * 3);
+    for (UINT i = 0; i < _NumSegments; i++) {
+        indices[i * 3] = (WORD)(i + 1);
+        indices[i * 3 + 1] = 0;
+        indices[i * 3 + 2] = (WORD)((i + 1) % _NumSegments + 1);
+    }
+    UINT bufferId = m_Device->GetVCacheManager()->CreateStaticIndexBuffer (&indices[0], indices.size ());
+    m_IndexBuffers[_NumSegments] = bufferId;
+    return bufferId;
+}
+
+void RingMeshCache::RenderMesh (const MATRIX44& _World, const UnitMesh& _Mesh, UINT _NumPrimitives) {
+    MATRIX44 oldWorld = m_Device->GetWorldMatrix ();
+    m_Device->SetWorldMatrix (_World);
+    m_Device->GetVCacheManager()->Render (PT_TRIANGLELIST, _Mesh.VertexBufferId, 0, _Mesh.IndexBufferId, 0, _NumPrimitives, VFT_ULC, INVALID_ID);
+    m_Device->SetWorldMatrix (oldWorld);
+}
@@ -0,0 +1,361 @@
+#include "../include/Game.h"
+#include <algorithm>
+
+static const char g_SnapshotMagic[4] = {'T', 'M', 'R', 'W'};
+
+void Game::Save () {
+    if (m_CommandLog.IsReplaying ()) {
+        return;     /* the player's save is left alone */
+    }
+    SaveRecording ();
+    m_Autosave.WaitIdle ();     /* both write the same file */
+    GameSnapshot snapshot;
+    CaptureSnapshot (snapshot);
+    WriteSnapshot (snapshot, SNAPSHOT_FILE);
+}
+
+void Game::Load () {
+    GameSnapshot snapshot;
+    ReadSnapshot (snapshot, SNAPSHOT_FILE);
+    RestoreSnapshot (snapshot);
+}
+
+void Game::SetAutosave (float _interval, UINT _memoryBudget) {
+    if (_interval <= 0.0f) {
+        m_Autosave.Stop ();
+    } else {
+        m_Autosave.Start (SNAPSHOT_FILE, _interval, _memoryBudget);
+    }
+}
+
+/* What CaptureSnapshot is going to fill, from the counts only */
+size_t Game::GetSnapshotSize () {
+    UINT numGuns = 0;
+    for (UINT i = 0; i < m_Towers.size (); i++) {
+        numGuns += m_Towers[i].GunInfo.size ();
+    }
+    return sizeof (SnapshotHeader) +
+        m_EnemyWaves.size () * sizeof (WaveInfo) +
+        m_Enemies.size () * sizeof (EnemySnapshot) +
+        m_Towers.size () * sizeof (TowerSnapshot) +
+        numGuns * sizeof (GunSnapshot) +
+        m_Occupied.size () * m_Occupied.size ();
+}
+
+/* Called every autosave interval on the main thread; the buffers keep their
+   capacity between captures, so this only copies records. */
+void Game::CaptureSnapshot (GameSnapshot& _snapshot) {
+    SnapshotHeader& header = _snapshot.Header;
+    ZeroMemory (&header, sizeof (SnapshotHeader));
+    memcpy (header.Magic, g_SnapshotMagic, sizeof (header.Magic));
+    header.Version = SNAPSHOT_VERSION;
+    strncpy (header.Scenario, m_Scenario.GetFilename (), MAX_PATH - 1);
+    header.CastleHitPoints = m_GameUI->GetCastleHitPoints ();
+    for (UINT i = 0; i < 3; i++) {
+        header.CameraPosition[i] = m_Camera->GetPosition ()[i];
+        header.CameraLookingPoint[i] = m_Camera->GetLookingPoint ()[i];
+    }
+    header.Resource = m_Resource;
+    header.Score = m_Score;
+    header.NextWaveTimeLeft = m_NextWaveTimeLeft;
+
+    _snapshot.Waves = m_EnemyWaves;
+
+    /* guns refer to enemies by their index in the list */
+    m_SnapshotEnemyIndex.clear ();
+    _snapshot.Enemies.resize (m_Enemies.size ());
+    UINT index = 0;
+    std::list<EnemyInfo>::const_iterator enemy;
+    for (enemy = m_Enemies.begin (); enemy != m_Enemies.end (); enemy++, index++) {
+        EnemySnapshot& record = _snapshot.Enemies[index];
+        ZeroMemory (&record, sizeof (EnemySnapshot));
+        m_SnapshotEnemyIndex.push_back (std::make_pair (&(*enemy), index));
+        record.WaveId = enemy->WaveId;
+        record.HitPoints = enemy->HitPoints;
+        record.MaxHitPoints = enemy->MaxHitPoints;
+        record.IsFast = enemy->IsFast;
+        record.Speed = enemy->Speed;
+        record.SlowDownFactor = enemy->SlowDownFactor;
+        record.NumSlowedDown = enemy->NumSlowedDown;
+        record.AttackSpeed = enemy->AttackSpeed;
+        record.RemainingTimeToShoot = enemy->RemainingTimeToShoot;
+        record.Ammo = enemy->Ammo;
+        record.MaxAmmo = enemy->MaxAmmo;
+        record.Power = enemy->Power;
+        for (UINT i = 0; i < 3; i++) {
+            record.Position[i] = enemy->Position[i];
+            record.PreviousPosition[i] = enemy->PreviousPosition[i];
+            record.Direction[i] = enemy->Direction[i];
+        }
+        record.PathDistance = enemy->PathDistance;
+        record.NumAttackers = enemy->NumAttackers;
+        record.NumResources = enemy->NumResources;
+        strncpy (record.CurrentAnimation, enemy->CurrentAnimation.c_str (), SNAPSHOT_NAME_LENGTH - 1);
+        record.AnimationSpeed = enemy->AnimationSpeed;
+        record.LoopAnimation = enemy->LoopAnimation;
+        record.ClipTimeLeft = enemy->ClipTimeLeft;
+        record.IsDead = enemy->IsDead;
+        record.SelfDestructionTime = enemy->SelfDestructionTime;
+    }
+
+    std::sort (m_SnapshotEnemyIndex.begin (), m_SnapshotEnemyIndex.end ());
+
+    _snapshot.Towers.resize (m_Towers.size ());
+    _snapshot.Guns.clear ();
+    for (UINT i = 0; i < m_Towers.size (); i++) {
+        TowerSnapshot& record = _snapshot.Towers[i];
+        ZeroMemory (&record, sizeof (TowerSnapshot));
+        record.Type = m_Towers[i].Type;
+        record.Level = m_Towers[i].Level;
+        record.Location = m_Towers[i].Location;
+        record.Radius = m_Towers[i].Radius;
+        record.AttackSpeed = m_Towers[i].AttackSpeed;
+        record.ShootDelay = m_Towers[i].ShootDelay;
+        record.Power = m_Towers[i].Power;
+        record.BuildingTime = m_Towers[i].BuildingTime;
+        record.MaxBuildingTime = m_Towers[i].MaxBuildingTime;
+        record.NumGuns = m_Towers[i].GunInfo.size ();
+        std::list<TowerGunInfo>::const_iterator gun;
+        for (gun = m_Towers[i].GunInfo.begin (); gun != m_Towers[i].GunInfo.end (); gun++) {
+            GunSnapshot gunRecord;
+            gunRecord.ShootingTime = gun->ShootingTime;
+            gunRecord.IsTargetAcquired = gun->IsTargetAcquired;
+            gunRecord.IsShootingUpdated = gun->IsShootingUpdated;
+            /* the target is compared by its address only, it is not read */
+            std::pair<const EnemyInfo*, UINT> key (&(*gun->Target), 0);
+            std::vector<std::pair<const EnemyInfo*, UINT>>::const_iterator found;
+            found = std::lower_bound (m_SnapshotEnemyIndex.begin (), m_SnapshotEnemyIndex.end (), key);
+            bool isFound = found != m_SnapshotEnemyIndex.end () && found->first == key.first;
+            gunRecord.Target = isFound ? found->second : INVALID_ID;
+            _snapshot.Guns.push_back (gunRecord);
+        }
+    }
+
+    UINT size = m_Occupied.size ();
+    _snapshot.Occupied.resize (size * size);
+    for (UINT i = 0; i < size; i++) {
+        for (UINT j = 0; j < size; j++) {
+            _snapshot.Occupied[i * size + j] = m_Occupied[i][j];
+        }
+    }
+
+    header.NumWaves = _snapshot.Waves.size ();
+    header.NumEnemies = _snapshot.Enemies.size ();
+    header.NumTowers = _snapshot.Towers.size ();
+    header.NumGuns = _snapshot.Guns.size ();
+    header.OccupiedSize = size;
+}
+
+/* Expects a freshly started level of the snapshot's scenario */
+void Game::RestoreSnapshot (const GameSnapshot& _snapshot) {
+    const SnapshotHeader& header = _snapshot.Header;
+    if (header.OccupiedSize != m_Occupied.size ()) {
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, "The save does not match the level.");
+    }
+    m_GameUI->SetCastleHitPoints (header.CastleHitPoints);
+    m_Camera->SetPosition (VECTOR3 (header.CameraPosition[0], header.CameraPosition[1], header.CameraPosition[2]));
+    m_Camera->SetLookingPoint (VECTOR3 (header.CameraLookingPoint[0], header.CameraLookingPoint[1], header.CameraLookingPoint[2]));
+
+    m_EnemyWaves = _snapshot.Waves;
+
+    m_GameUI->RemoveAllMarks ();
+    m_Enemies.clear ();
+    std::vector<std::list<EnemyInfo>::iterator> enemies;
+    enemies.reserve (_snapshot.Enemies.size ());
+    for (UINT i = 0; i < _snapshot.Enemies.size (); i++) {
+        const EnemySnapshot& record = _snapshot.Enemies[i];
+        if (record.WaveId >= m_EnemyWaves.size ()) {
+            THROW_DETAILED_ERROR (ERRC_BAD_FILE, SNAPSHOT_FILE);
+        }
+        EnemyInfo enemy;
+        enemy.WaveId = record.WaveId;
+        enemy.HitPoints = record.HitPoints;
+        enemy.MaxHitPoints = record.MaxHitPoints;
+        enemy.IsFast = record.IsFast != 0;
+        enemy.Speed = record.Speed;
+        enemy.SlowDownFactor = record.SlowDownFactor;
+        enemy.NumSlowedDown = record.NumSlowedDown;
+        enemy.AttackSpeed = record.AttackSpeed;
+        enemy.RemainingTimeToShoot = record.RemainingTimeToShoot;
+        enemy.Ammo = record.Ammo;
+        enemy.MaxAmmo = record.MaxAmmo;
+        enemy.Power = record.Power;
+        enemy.Position = VECTOR3 (record.Position[0], record.Position[1], record.Position[2]);
+        enemy.PreviousPosition = VECTOR3 (record.PreviousPosition[0], record.PreviousPosition[1], record.PreviousPosition[2]);
+        enemy.RenderPosition = enemy.Position;
+        enemy.Direction = VECTOR3 (record.Direction[0], record.Direction[1], record.Direction[2]);
+        enemy.PathDistance = record.PathDistance;
+        enemy.ActiveWaypoint = m_Path.FindSegment (record.PathDistance);
+        enemy.TargetIndex = INVALID_ID;
+        enemy.NumAttackers = record.NumAttackers;
+        enemy.NumResources = record.NumResources;
+        enemy.CurrentAnimation = std::string (record.CurrentAnimation, strnlen (record.CurrentAnimation, SNAPSHOT_NAME_LENGTH));
+        enemy.AnimationSpeed = record.AnimationSpeed;
+        enemy.LoopAnimation = record.LoopAnimation != 0;
+        enemy.ClipTimeLeft = record.ClipTimeLeft;
+        enemy.IsDead = record.IsDead != 0;
+        enemy.SelfDestructionTime = record.SelfDestructionTime;
+        AttachEnemyResources (enemy);
+        m_Enemies.push_back (enemy);
+        enemies.push_back (--m_Enemies.end ());
+    }
+
+    for (UINT i = 0; i < m_Towers.size (); i++) {
+        delete m_Towers[i].Gun;
+    }
+    m_Towers.clear ();
+    m_Towers.reserve (_snapshot.Towers.size ());
+    m_SelectedTowerId = INVALID_ID;
+    UINT firstGun = 0;
+    for (UINT i = 0; i < _snapshot.Towers.size (); i++) {
+        const TowerSnapshot& record = _snapshot.Towers[i];
+        if (record.Type >= NUM_TOWER_TYPES || firstGun + record.NumGuns > _snapshot.Guns.size ()) {
+            THROW_DETAILED_ERROR (ERRC_BAD_FILE, SNAPSHOT_FILE);
+        }
+        TowerInfo tower;
+        tower.Type = (TowerType)record.Type;
+        tower.Level = record.Level;
+        tower.Location = record.Location;
+        tower.Radius = record.Radius;
+        tower.AttackSpeed = record.AttackSpeed;
+        tower.ShootDelay = record.ShootDelay;
+        tower.Power = record.Power;
+        tower.Size = m_PreparedTowers[tower.Type].Size;
+        tower.BuildingTime = record.BuildingTime;
+        tower.MaxBuildingTime = record.MaxBuildingTime;
+        for (UINT j = firstGun; j < firstGun + record.NumGuns; j++) {
+            const GunSnapshot& gunRecord = _snapshot.Guns[j];
+            if (gunRecord.Target == INVALID_ID) {
+                continue;   /* lost its target, there is nothing left to hit */
+            }
+            if (gunRecord.Target >= enemies.size ()) {
+                THROW_DETAILED_ERROR (ERRC_BAD_FILE, SNAPSHOT_FILE);
+            }
+            TowerGunInfo gun;
+            gun.ShootingTime = gunRecord.ShootingTime;
+            gun.IsTargetAcquired = gunRecord.IsTargetAcquired != 0;
+            gun.IsShootingUpdated = gunRecord.IsShootingUpdated != 0;
+            gun.Target = enemies[gunRecord.Target];
+            tower.GunInfo.push_back (gun);
+        }
+        firstGun += record.NumGuns;
+        AttachTowerResources (tower, GetTowerPosition (tower.Location));
+        m_Towers.push_back (tower);
+        UpdateTowerAim (i);
+        BuildTowerRangeOutline (i);
+    }
+
+    UINT size = header.OccupiedSize;
+    for (UINT i = 0; i < size; i++) {
+        for (UINT j = 0; j < size; j++) {
+            m_Occupied[i][j] = _snapshot.Occupied[i * size + j] != 0;
+        }
+    }
+
+    m_Resource = header.Resource;
+    m_GameUI->UpdateNumResources (m_Resource.NumResources);
+    m_Score = header.Score;
+    m_NextWaveTimeLeft = header.NextWaveTimeLeft;
+    m_SimulationTime = 0.0f;
+}
+
+/* Written to a temporary file first and moved over the old save, so a
+   crash while writing never leaves a broken save behind. Also called from
+   the autosave thread, it must not touch the game. */
+void Game::WriteSnapshot (const GameSnapshot& _snapshot, const char* _filename) {
+    char tempFile[MAX_PATH];
+    if (strlen (_filename) + 4 >= MAX_PATH) {
+        THROW_ERROR (ERRC_INVALID_PARAMETER);
+    }
+    sprintf (tempFile, "%s.tmp", _filename);
+    FILE* file = fopen (tempFile, "wb");
+    if (!file) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, tempFile);
+    }
+    bool isWritten = fwrite (&_snapshot.Header, sizeof (SnapshotHeader), 1, file) == 1;
+    if (isWritten && !_snapshot.Waves.empty ()) {
+        isWritten = fwrite (&_snapshot.Waves[0], sizeof (WaveInfo), _snapshot.Waves.size (), file) == _snapshot.Waves.size ();
+    }
+    if (isWritten && !_snapshot.Enemies.empty ()) {
+        isWritten = fwrite (&_snapshot.Enemies[0], sizeof (EnemySnapshot), _snapshot.Enemies.size (), file) == _snapshot.Enemies.size ();
+    }
+    if (isWritten && !_snapshot.Towers.empty ()) {
+        isWritten = fwrite (&_snapshot.Towers[0], sizeof (TowerSnapshot), _snapshot.Towers.size (), file) == _snapshot.Towers.size ();
+    }
+    if (isWritten && !_snapshot.Guns.empty ()) {
+        isWritten = fwrite (&_snapshot.Guns[0], sizeof (GunSnapshot), _snapshot.Guns.size (), file) == _snapshot.Guns.size ();
+    }
+    if (isWritten && !_snapshot.Occupied.empty ()) {
+        isWritten = fwrite (&_snapshot.Occupied[0], 1, _snapshot.Occupied.size (), file) == _snapshot.Occupied.size ();
+    }
+    isWritten = fflush (file) == 0 && isWritten;
+    fclose (file);
+    if (!isWritten || !MoveFileEx (tempFile, _filename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        DeleteFile (tempFile);
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+}
+
+void Game::ReadSnapshot (GameSnapshot& _snapshot, const char* _filename) {
+    FILE* file = fopen (_filename, "rb");
+    if (!file) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _filename);
+    }
+    SnapshotHeader& header = _snapshot.Header;
+    bool isRead = fread (&header, sizeof (SnapshotHeader), 1, file) == 1 &&
+        memcmp (header.Magic, g_SnapshotMagic, sizeof (header.Magic)) == 0 &&
+        header.Version == SNAPSHOT_VERSION;
+    if (isRead) {
+        /* the counts must match the file size before anything is allocated */
+        double expectedSize = (double)sizeof (SnapshotHeader) +
+            (double)header.NumWaves * sizeof (WaveInfo) +
+            (double)header.NumEnemies * sizeof (EnemySnapshot) +
+            (double)header.NumTowers * sizeof (TowerSnapshot) +
+            (double)header.NumGuns * sizeof (GunSnapshot) +
+            (double)header.OccupiedSize * header.OccupiedSize;
+        isRead = fseek (file, 0, SEEK_END) == 0 && (double)ftell (file) == expectedSize &&
+            fseek (file, sizeof (SnapshotHeader), SEEK_SET) == 0;
+    }
+    if (isRead) {
+        header.Scenario[MAX_PATH - 1] = '\0';
+        _snapshot.Waves.resize (header.NumWaves);
+        _snapshot.Enemies.resize (header.NumEnemies);
+        _snapshot.Towers.resize (header.NumTowers);
+        _snapshot.Guns.resize (header.NumGuns);
+        _snapshot.Occupied.resize (header.OccupiedSize * header.OccupiedSize);
+    }
+    if (isRead && header.NumWaves > 0) {
+        isRead = fread (&_snapshot.Waves[0], sizeof (WaveInfo), header.NumWaves, file) == header.NumWaves;
+    }
+    if (isRead && header.NumEnemies > 0) {
+        isRead = fread (&_snapshot.Enemies[0], sizeof (EnemySnapshot), header.NumEnemies, file) == header.NumEnemies;
+    }
+    if (isRead && header.NumTowers > 0) {
+        isRead = fread (&_snapshot.Towers[0], sizeof (TowerSnapshot), header.NumTowers, file) == header.NumTowers;
+    }
+    if (isRead && header.NumGuns > 0) {
+        isRead = fread (&_snapshot.Guns[0], sizeof (GunSnapshot), header.NumGuns, file) == header.NumGuns;
+    }
+    if (isRead && !_snapshot.Occupied.empty ()) {
+        isRead = fread (&_snapshot.Occupied[0], 1, _snapshot.Occupied.size (), file) == _snapshot.Occupied.size ();
+    }
+    fclose (file);
+    if (!isRead) {
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+}
+
+bool Game::ReadSnapshotHeader (SnapshotHeader& _header, const char* _filename) {
+    FILE* file = fopen (_filename, "rb");
+    if (!file) {
+        return false;
+    }
+    bool isRead = fread (&_header, sizeof (SnapshotHeader), 1, file) == 1;
+    fclose (file);
+    if (!isRead || memcmp (_header.Magic, g_SnapshotMagic, sizeof (_header.Magic)) != 0 ||
+        _header.Version != SNAPSHOT_VERSION) {
+        return false;
+    }
+    _header.Scenario[MAX_PATH - 1] = '\0';
+    return true;
+}
@@ -0,0 +1,276 @@
+#include "../include/Scenario.h"
+
+static const char* g_TowerNames[NUM_TOWER_TYPES] = {"basic", "slowing", "area"};
+
+Scenario::Scenario () {
+    Clear ();
+}
+
+void Scenario::Load (const char* _filename) {
+    Clear ();
+    Parse (_filename, 0);
+    for (UINT i = 0; i < NUM_TOWER_TYPES; i++) {
+        if (!m_IsTowerDefined[i]) {
+            THROW_DETAILED_ERROR (ERRC_BAD_FILE, g_TowerNames[i]);
+        }
+    }
+    if (m_Waves.empty ()) {
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+    m_Filename = _filename;
+}
+
+void Scenario::Clear () {
+    m_Filename.clear ();
+    for (UINT i = 0; i < NUM_TOWER_TYPES; i++) {
+        m_Towers[i] = TowerDefinition ();
+        m_IsTowerDefined[i] = false;
+    }
+    m_Enemies.clear ();
+    m_Waves.clear ();
+    m_RepeatStrength = 0.0f;
+    m_RepeatCount = 0.0f;
+    m_Placements.clear ();
+}
+
+bool Scenario::IsLoaded () const {
+    return !m_Filename.empty ();
+}
+
+const char* Scenario::GetFilename () const {
+    return m_Filename.c_str ();
+}
+
+const TowerDefinition& Scenario::GetTower (TowerType _type) const {
+    if ((UINT)_type >= NUM_TOWER_TYPES) {
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    return m_Towers[_type];
+}
+
+UINT Scenario::GetNumScriptWaves () const {
+    return m_Waves.size ();
+}
+
+EnemyAdditionDetails Scenario::GetWave (UINT _wave) const {
+    if (m_Waves.empty ()) {
+        THROW_ERROR (ERRC_NOT_READY);
+    }
+    UINT repetition = _wave / m_Waves.size ();
+    EnemyAdditionDetails details = m_Waves[_wave % m_Waves.size ()];
+    details.NumEnemies += (UINT)(details.NumEnemies * repetition * m_RepeatCount);
+    return details;
+}
+
+float Scenario::GetStrengthBonus (UINT _wave) const {
+    if (m_Waves.empty ()) {
+        THROW_ERROR (ERRC_NOT_READY);
+    }
+    return (_wave / m_Waves.size ()) * m_RepeatStrength;
+}
+
+UINT Scenario::GetNumPlacements () const {
+    return m_Placements.size ();
+}
+
+const TowerPlacement& Scenario::GetPlacement (UINT _placement) const {
+    if (_placement >= m_Placements.size ()) {
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    return m_Placements[_placement];
+}
+
+void Scenario::Parse (const char* _filename, UINT _depth) {
+    if (_depth > SCENARIO_MAX_INCLUDES) {
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+    VirtualFile file (_filename);
+    bool hasOwnWaves = false;
+    char token[MAX_PATH];
+    while (ReadToken (file, token)) {
+        if (strcmp (token, "include") == 0) {
+            char included[MAX_PATH];
+            if (!ReadToken (file, included)) {
+                THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+            }
+            Parse (included, _depth + 1);
+        } else if (strcmp (token, "tower") == 0) {
+            ParseTower (file, _filename);
+        } else if (strcmp (token, "enemy") == 0) {
+            ParseEnemy (file, _filename);
+        } else if (strcmp (token, "wave") == 0) {
+            char name[MAX_PATH];
+            if (!ReadToken (file, name)) {
+                THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+            }
+            std::map<std::string, EnemyAdditionDetails>::const_iterator enemy = m_Enemies.find (name);
+            if (enemy == m_Enemies.end ()) {
+                THROW_DETAILED_ERROR (ERRC_BAD_FILE, name);
+            }
+            if (!hasOwnWaves) {
+                m_Waves.clear ();
+                hasOwnWaves = true;
+            }
+            EnemyAdditionDetails details = enemy->second;
+            details.NumEnemies = ReadUint (file, _filename);
+            details.Delay = ReadFloat (file, _filename);
+            details.SpawnTime = ReadFloat (file, _filename);
+            m_Waves.push_back (details);
+        } else if (strcmp (token, "repeat_strength") == 0) {
+            m_RepeatStrength = ReadFloat (file, _filename);
+        } else if (strcmp (token, "repeat_count") == 0) {
+            m_RepeatCount = ReadFloat (file, _filename);
+        } else if (strcmp (token, "place") == 0) {
+            TowerPlacement placement;
+            placement.Type = ReadTowerType (file, _filename);
+            placement.Location.x = ReadUint (file, _filename);
+            placement.Location.y = ReadUint (file, _filename);
+            placement.Level = ReadUint (file, _filename);
+            if (placement.Level > MAX_TOWER_LEVEL) {
+                THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+            }
+            m_Placements.push_back (placement);
+        } else {
+            THROW_DETAILED_ERROR (ERRC_BAD_FILE, token);
+        }
+    }
+}
+
+void Scenario::ParseTower (VirtualFile& _file, const char* _filename) {
+    TowerType type = ReadTowerType (_file, _filename);
+    TowerDefinition& tower = m_Towers[type];
+    char token[MAX_PATH];
+    while (true) {
+        if (!ReadToken (_file, token)) {
+            THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);     /* missing end */
+        }
+        if (strcmp (token, "end") == 0) {
+            break;
+        } else if (strcmp (token, "model") == 0 || strcmp (token, "texture") == 0) {
+            char path[MAX_PATH];
+            if (!ReadToken (_file, path)) {
+                THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+            }
+            (token[0] == 'm' ? tower.Model : tower.Texture) = path;
+        } else if (strcmp (token, "price") == 0) {
+            tower.Price = ReadUint (_file, _filename);
+        } else if (strcmp (token, "attack_speed") == 0) {
+            tower.AttackSpeed = ReadFloat (_file, _filename);
+        } else if (strcmp (token, "power") == 0) {
+            tower.Power = ReadUint (_file, _filename);
+        } else if (strcmp (token, "radius") == 0) {
+            tower.Radius = ReadFloat (_file, _filename);
+        } else if (strcmp (token, "size") == 0) {
+            tower.Size = ReadUint (_file, _filename);
+        } else if (strcmp (token, "building_time") == 0) {
+            tower.BuildingTime = ReadFloat (_file, _filename);
+        } else if (strcmp (token, "upgrade_time") == 0) {
+            for (UINT i = 0; i < MAX_TOWER_LEVEL; i++) {
+                tower.Upgrade.UpgradeTime[i] = ReadFloat (_file, _filename);
+            }
+        } else if (strcmp (token, "upgrade_attack_speed") == 0) {
+            for (UINT i = 0; i < MAX_TOWER_LEVEL; i++) {
+                tower.Upgrade.AttackSpeedDecrease[i] = ReadFloat (_file, _filename);
+            }
+        } else if (strcmp (token, "upgrade_power") == 0) {
+            for (UINT i = 0; i < MAX_TOWER_LEVEL; i++) {
+                tower.Upgrade.PowerIncrease[i] = ReadUint (_file, _filename);
+            }
+        } else if (strcmp (token, "upgrade_radius") == 0) {
+            for (UINT i = 0; i < MAX_TOWER_LEVEL; i++) {
+                tower.Upgrade.RadiusIncrease[i] = ReadFloat (_file, _filename);
+            }
+        } else if (strcmp (token, "upgrade_price") == 0) {
+            for (UINT i = 0; i < MAX_TOWER_LEVEL; i++) {
+                tower.Upgrade.Price[i] = ReadUint (_file, _filename);
+            }
+        } else {
+            THROW_DETAILED_ERROR (ERRC_BAD_FILE, token);
+        }
+    }
+    m_IsTowerDefined[type] = true;
+}
+
+void Scenario::ParseEnemy (VirtualFile& _file, const char* _filename) {
+    char name[MAX_PATH];
+    if (!ReadToken (_file, name)) {
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+    EnemyAdditionDetails& enemy = m_Enemies[name];
+    char token[MAX_PATH];
+    while (true) {
+        if (!ReadToken (_file, token)) {
+            THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);     /* missing end */
+        }
+        if (strcmp (token, "end") == 0) {
+            break;
+        } else if (strcmp (token, "model") == 0 || strcmp (token, "animation") == 0) {
+            char path[MAX_PATH];
+            if (!ReadToken (_file, path)) {
+                THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+            }
+            (token[0] == 'm' ? enemy.Filename : enemy.AnimInfoFile) = path;
+        } else if (strcmp (token, "hit_points") == 0) {
+            enemy.HitPoints = ReadUint (_file, _filename);
+        } else if (strcmp (token, "speed") == 0) {
+            enemy.Speed = ReadFloat (_file, _filename);
+        } else if (strcmp (token, "attack_speed") == 0) {
+            enemy.AttackSpeed = ReadFloat (_file, _filename);
+        } else if (strcmp (token, "ammo") == 0) {
+            enemy.MaxAmmo = ReadFloat (_file, _filename);
+        } else if (strcmp (token, "power") == 0) {
+            enemy.Power = ReadUint (_file, _filename);
+        } else if (strcmp (token, "resources") == 0) {
+            enemy.NumResources = ReadUint (_file, _filename);
+        } else if (strcmp (token, "shot_time") == 0) {
+            enemy.ShotTime = ReadFloat (_file, _filename);
+        } else if (strcmp (token, "shot_pause_time") == 0) {
+            enemy.ShotPauseTime = ReadFloat (_file, _filename);
+        } else if (strcmp (token, "fast") == 0) {
+            enemy.IsFast = ReadUint (_file, _filename) != 0;
+        } else {
+            THROW_DETAILED_ERROR (ERRC_BAD_FILE, token);
+        }
+    }
+}
+
+bool Scenario::ReadToken (VirtualFile& _file, char* _token) {
+    while (_file.Scan ("%259s", _token) == 1) {
+        if (_token[0] != '#') {
+            return true;
+        }
+        char rest[MAX_PATH];    /* skip the rest of the comment */
+        while (_file.Gets (rest, MAX_PATH) && rest[strlen (rest) - 1] != '\n') {
+        }
+    }
+    return false;
+}
+
+float Scenario::ReadFloat (VirtualFile& _file, const char* _filename) {
+    float value;
+    if (_file.Scan ("%f", &value) != 1) {
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+    return value;
+}
+
+UINT Scenario::ReadUint (VirtualFile& _file, const char* _filename) {
+    UINT value;
+    if (_file.Scan ("%u", &value) != 1) {
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+    return value;
+}
+
+TowerType Scenario::ReadTowerType (VirtualFile& _file, const char* _filename) {
+    char name[MAX_PATH];
+    if (!ReadToken (_file, name)) {
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+    for (UINT i = 0; i < NUM_TOWER_TYPES; i++) {
+        if (strcmp (name, g_TowerNames[i]) == 0) {
+            return (TowerType)i;
+        }
+    }
+    THROW_DETAILED_ERROR (ERRC_BAD_FILE, name);
+}
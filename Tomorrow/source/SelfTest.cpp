@@ -0,0 +1,1094 @@
+#include "../include/Game.h"
+
+#ifdef TOMORROW_TESTS
+#include "../include/VertexCacheOptimizer.h"
+#include "../include/DxtTexel.h"
+#include "../../TextureCooker/include/DxtCompressor.h"
+#include <algorithm>
+#include <cstdarg>
+
+/* The checks of -selftest. They run on the CPU only, the level checks start
+   the scenario without rendering it. Every check writes a line to the report,
+   the failed ones start with FAILED. */
+
+struct SelfTestReport {
+    FILE* File;
+    UINT NumChecks;
+    UINT NumFailed;
+};
+
+static bool Check (SelfTestReport& _report, bool _isPassed, const char* _format, ...) {
+    va_list args;
+    va_start (args, _format);
+    fprintf (_report.File, _isPassed ? "passed " : "FAILED ");
+    vfprintf (_report.File, _format, args);
+    fprintf (_report.File, "\n");
+    va_end (args);
+    _report.NumChecks++;
+    _report.NumFailed += _isPassed ? 0 : 1;
+    return _isPassed;
+}
+
+static bool IsNear (float _a, float _b, float _tolerance) {
+    return fabsf (_a - _b) <= _tolerance * (fabsf (_a) > fabsf (_b) ? fabsf (_a) : fabsf (_b)) + 1e-6f;
+}
+
+static void ReadFileData (const char* _filename, std::vector<BYTE>& _data) {
+    _data.clear ();
+    FILE* file = fopen (_filename, "rb");
+    if (!file) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _filename);
+    }
+    BYTE buffer[4096];
+    size_t numRead;
+    while ((numRead = fread (buffer, 1, sizeof (buffer), file)) > 0) {
+        _data.insert (_data.end (), buffer, buffer + numRead);
+    }
+    fclose (file);
+}
+
+/* the first _size bytes of _data, zeros past its end */
+static void WriteFileData (const char* _filename, const std::vector<BYTE>& _data, size_t _size) {
+    FILE* file = fopen (_filename, "wb");
+    if (!file) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _filename);
+    }
+    std::vector<BYTE> data (_data);
+    data.resize (_size);
+    bool isWritten = data.empty () || fwrite (&data[0], 1, data.size (), file) == data.size ();
+    fclose (file);
+    if (!isWritten) {
+        THROW_DETAILED_ERROR (ERRC_BAD_FILE, _filename);
+    }
+}
+
+/* Split distances and the light matrices of every cascade, for a few cameras and lights */
+static void TestShadowCascades (SelfTestReport& _report) {
+    const float lambdas[] = {0.0f, 0.5f, 0.75f, 1.0f};
+    for (UINT numCascades = 2; numCascades <= MAX_SHADOW_CASCADES; numCascades++) {
+        bool isUniform = true;
+        bool isLogarithmic = true;
+        for (UINT i = 0; i <= numCascades; i++) {
+            float ratio = (float)i / numCascades;
+            isUniform = isUniform && IsNear (ShadowCascades::ComputeSplit (i, numCascades, CAMERA_NEAR_CLIP, SHADOW_DISTANCE, 0.0f),
+                CAMERA_NEAR_CLIP + (SHADOW_DISTANCE - CAMERA_NEAR_CLIP) * ratio, 1e-5f);
+            isLogarithmic = isLogarithmic && IsNear (ShadowCascades::ComputeSplit (i, numCascades, CAMERA_NEAR_CLIP, SHADOW_DISTANCE, 1.0f),
+                CAMERA_NEAR_CLIP * powf (SHADOW_DISTANCE / CAMERA_NEAR_CLIP, ratio), 1e-5f);
+        }
+        Check (_report, isUniform, "shadow splits of %u cascades are uniform at lambda 0", numCascades);
+        Check (_report, isLogarithmic, "shadow splits of %u cascades are logarithmic at lambda 1", numCascades);
+        for (UINT j = 0; j < sizeof (lambdas) / sizeof (lambdas[0]); j++) {
+            bool isIncreasing = true;
+            float previous = CAMERA_NEAR_CLIP;
+            for (UINT i = 1; i <= numCascades; i++) {
+                float split = ShadowCascades::ComputeSplit (i, numCascades, CAMERA_NEAR_CLIP, SHADOW_DISTANCE, lambdas[j]);
+                isIncreasing = isIncreasing && split > previous;
+                previous = split;
+            }
+            Check (_report, isIncreasing && IsNear (previous, SHADOW_DISTANCE, 1e-5f),
+                "shadow splits of %u cascades at lambda %.2f increase up to the shadow distance", numCascades, lambdas[j]);
+        }
+    }
+
+    /* every corner of a slice has to be inside the light projection of its
+       cascade, the camera circles the map so the snapping hits all offsets */
+    const VECTOR3 lightDirs[] = {VECTOR3 (700.0f, -650.0f, 650.0f), VECTOR3 (0.0f, -1.0f, 0.0f), VECTOR3 (-1.0f, -0.2f, 0.3f)};
+    const UINT sizes[] = {2048, 1024, 512, 64};
+    const UINT NUM_CAMERAS = 500;
+    for (UINT light = 0; light < sizeof (lightDirs) / sizeof (lightDirs[0]); light++) {
+        for (UINT size = 0; size < sizeof (sizes) / sizeof (sizes[0]); size++) {
+            UINT numOutside = 0;
+            for (UINT camera = 0; camera < NUM_CAMERAS; camera++) {
+                float angle = camera * 0.37f;
+                VECTOR3 target (1000.0f + 800.0f * cosf (angle * 0.13f), 0.0f, 1000.0f + 800.0f * sinf (angle * 0.11f));
+                VECTOR3 eye = target + VECTOR3 (600.0f * cosf (angle), 150.0f + 17.0f * (camera % 200), 600.0f * sinf (angle));
+                MATRIX44 view;
+                MATRIX44 projection;
+                cml::matrix_look_at_LH (view, eye, target, VECTOR3 (0.0f, 1.0f, 0.0f));
+                cml::matrix_perspective_yfov_LH (projection, 3.14f / 3, 1024.0f / 768.0f, CAMERA_NEAR_CLIP, CAMERA_FAR_CLIP, cml::z_clip_zero);
+                VECTOR3 frustum[8];
+                ShadowCascades::GetFrustumCorners (view, projection, frustum);
+                float sliceNear = CAMERA_NEAR_CLIP;
+                for (UINT i = 0; i < MAX_SHADOW_CASCADES; i++) {
+                    float sliceFar = ShadowCascades::ComputeSplit (i + 1, MAX_SHADOW_CASCADES, CAMERA_NEAR_CLIP, SHADOW_DISTANCE, 0.75f);
+                    VECTOR3 corners[8];
+                    ShadowCascades::GetSliceCorners (frustum, CAMERA_NEAR_CLIP, CAMERA_FAR_CLIP, sliceNear, sliceFar, corners);
+                    VECTOR3 lightEye;
+                    MATRIX44 lightView;
+                    MATRIX44 lightProj;
+                    ShadowCascades::FitLight (corners, lightDirs[light], sizes[size], 500.0f, lightEye, lightView, lightProj);
+                    MATRIX44 lightViewProj = lightView * lightProj;
+                    for (UINT k = 0; k < 8; k++) {
+                        VECTOR3 point = cml::transform_point_4D (lightViewProj, corners[k]);
+                        if (fabsf (point[0]) > 1.0f || fabsf (point[1]) > 1.0f || point[2] < 0.0f || point[2] > 1.0f) {
+                            numOutside++;
+                        }
+                    }
+                    sliceNear = sliceFar;
+                }
+            }
+            Check (_report, numOutside == 0, "shadow cascades of %u texels and light %u contain their slices (%u corners outside)",
+                sizes[size], light, numOutside);
+        }
+    }
+}
+
+class CountVisitsTask : public JobTask {
+public:
+    CountVisitsTask (std::vector<LONG>& _visits, UINT _failingItem) : m_Visits (_visits), m_FailingItem (_failingItem) {
+    }
+    virtual void Run (UINT _begin, UINT _end) {
+        for (UINT i = _begin; i < _end; i++) {
+            if (i == m_FailingItem) {
+                THROW_ERROR (ERRC_OUT_OF_RANGE);
+            }
+            InterlockedIncrement (&m_Visits[i]);
+        }
+    }
+private:
+    std::vector<LONG>& m_Visits;
+    UINT m_FailingItem;
+};
+
+/* Every item of a parallel loop runs exactly once, a failing job reaches the caller */
+static void TestJobs (SelfTestReport& _report) {
+    const UINT threadCounts[] = {1, 2, 4, JOB_MAX_THREADS};
+    const UINT NUM_ITEMS = 10007;
+    const UINT NUM_RUNS = 20;
+    for (UINT i = 0; i < sizeof (threadCounts) / sizeof (threadCounts[0]); i++) {
+        JobSystem jobs;
+        jobs.Start (threadCounts[i]);
+        std::vector<LONG> visits (NUM_ITEMS, 0);
+        CountVisitsTask task (visits, INVALID_ID);
+        for (UINT run = 0; run < NUM_RUNS; run++) {
+            jobs.ParallelFor (task, NUM_ITEMS, run % 2 == 0 ? 64 : NUM_ITEMS * 2);
+        }
+        bool isOnce = true;
+        for (UINT j = 0; j < NUM_ITEMS; j++) {
+            isOnce = isOnce && visits[j] == NUM_RUNS;
+        }
+        Check (_report, isOnce, "%u job threads run each item once per loop", jobs.GetNumThreads ());
+
+        bool hasFailed = false;
+        CountVisitsTask failingTask (visits, NUM_ITEMS / 2);
+        try {
+            jobs.ParallelFor (failingTask, NUM_ITEMS, 64);
+        } catch (ErrorMessage e) {
+            hasFailed = e.GetErrorCode () == ERRC_OUT_OF_RANGE;     /* the error of the job itself */
+        }
+        visits.assign (NUM_ITEMS, 0);
+        jobs.ParallelFor (task, NUM_ITEMS, 64);
+        bool isRecovered = true;
+        for (UINT j = 0; j < NUM_ITEMS; j++) {
+            isRecovered = isRecovered && visits[j] == 1;
+        }
+        Check (_report, hasFailed && isRecovered, "%u job threads pass on the error of a failed job and run the next loop", jobs.GetNumThreads ());
+    }
+}
+
+/* The packed range test against the one target at a time test, and the path direction past its end */
+static void TestTargeting (SelfTestReport& _report) {
+    TargetingKernel targets;
+    for (UINT i = 0; i < 103; i++) {     /* not a multiple of four, so the tail runs too */
+        float angle = i * 0.7f;
+        targets.AddTarget (VECTOR3 (10.0f * (i % 13), 180.0f, 10.0f * (i / 13)), VECTOR3 (cosf (angle), 0.0f, sinf (angle)) * 40.0f);
+    }
+    bool isSame = true;
+    UINT numFound = 0;
+    for (UINT tower = 0; tower < 16; tower++) {
+        TowerAim aim = TargetingKernel::MakeAim (VECTOR3 (8.0f * tower, 200.0f, 5.0f * tower), 20.0f + 3.0f * tower, 0.5f);
+        std::vector<UINT> found;
+        targets.FindTargets (aim, found);
+        UINT next = 0;
+        for (UINT i = 0; i < targets.GetNumTargets (); i++) {
+            if (targets.IsInRange (aim, i)) {
+                isSame = isSame && next < found.size () && found[next] == i;
+                next++;
+            }
+        }
+        isSame = isSame && next == found.size ();
+        numFound += found.size ();
+    }
+    Check (_report, isSame && numFound > 0, "packed tower range test finds the same %u targets in order", numFound);
+
+    EnemyPath path;
+    std::vector<VECTOR3> points;
+    points.push_back (VECTOR3 (0.0f, 0.0f, 0.0f));
+    points.push_back (VECTOR3 (100.0f, 0.0f, 0.0f));
+    points.push_back (VECTOR3 (100.0f, 0.0f, 50.0f));
+    path.Build (points, PATH_HEIGHT_SPACING);
+    UINT last = path.FindSegment (path.GetLength ());
+    const VECTOR3& direction = path.GetDirection (last);
+    Check (_report, last == 2 && direction[0] == 0.0f && direction[2] == 1.0f,
+        "enemy path keeps the last segment's direction at its end");
+}
+
+/* The binary search of the enemy path against a walk over its points, positions on the
+   segments and heights interpolated between the samples, with a zero length segment */
+static void TestEnemyPath (SelfTestReport& _report) {
+    std::vector<VECTOR3> points;
+    points.push_back (VECTOR3 (0.0f, 0.0f, 0.0f));
+    points.push_back (VECTOR3 (30.0f, 7.0f, 40.0f));
+    points.push_back (VECTOR3 (30.0f, 0.0f, 100.0f));
+    points.push_back (VECTOR3 (30.0f, 0.0f, 100.0f));
+    points.push_back (VECTOR3 (-20.5f, 0.0f, 100.0f));
+    points.push_back (VECTOR3 (-20.5f, 0.0f, 137.25f));
+    EnemyPath path;
+    path.Build (points, PATH_HEIGHT_SPACING);
+    std::vector<float> starts (1, 0.0f);
+    for (UINT i = 0; i + 1 < points.size (); i++) {
+        VECTOR3 segment = points[i + 1] - points[i];
+        segment[1] = 0.0f;
+        starts.push_back (starts.back () + segment.length ());
+    }
+    bool isLengthSame = IsNear (path.GetLength (), starts.back (), 1e-5f) && path.GetNumPoints () == points.size ();
+    for (UINT i = 0; i < points.size (); i++) {
+        isLengthSame = isLengthSame && IsNear (path.GetSegmentStart (i), starts[i], 1e-5f);
+    }
+    Check (_report, isLengthSame, "enemy path of %u points is %.2f long", points.size (), path.GetLength ());
+
+    /* the distances of the points themselves, around them, and before and past the ends */
+    std::vector<float> distances;
+    for (UINT i = 0; i < starts.size (); i++) {
+        distances.push_back (starts[i]);
+        distances.push_back (starts[i] - 0.01f);
+        distances.push_back (starts[i] + 0.01f);
+    }
+    for (UINT i = 0; i <= 1000; i++) {
+        distances.push_back (-10.0f + i * (starts.back () + 20.0f) / 1000);
+    }
+    UINT numWrongSegments = 0;
+    UINT numWrongPositions = 0;
+    for (UINT i = 0; i < distances.size (); i++) {
+        float distance = distances[i];
+        /* a segment owns (start, end], the start of the path is in the first one */
+        UINT segment = 0;
+        while (segment + 1 < starts.size () && distance > starts[segment + 1]) {
+            segment++;
+        }
+        segment = distance >= starts.back () ? points.size () - 1 : segment;
+        numWrongSegments += path.FindSegment (distance) == segment ? 0 : 1;
+        if (distance >= 0.0f && distance <= starts.back ()) {
+            UINT start = segment < points.size () - 1 ? segment : segment - 1;
+            VECTOR3 expected = points[start];
+            float length = starts[start + 1] - starts[start];
+            if (length > 0.0f) {
+                expected = expected + (points[start + 1] - points[start]) * ((distance - starts[start]) / length);
+            }
+            VECTOR3 position = path.GetPosition (distance);
+            numWrongPositions += fabsf (position[0] - expected[0]) < 1e-3f && fabsf (position[2] - expected[2]) < 1e-3f ? 0 : 1;
+        }
+    }
+    Check (_report, numWrongSegments == 0, "enemy path finds the segment of %u distances, %u wrong",
+        distances.size (), numWrongSegments);
+    Check (_report, numWrongPositions == 0, "enemy path positions lie on their segments, %u wrong", numWrongPositions);
+
+    /* heights rising by one per sample read back linearly between the samples, clamped at the ends */
+    for (UINT i = 0; i < path.GetNumHeightSamples (); i++) {
+        path.SetHeightSample (i, (float)i);
+    }
+    UINT numWrongHeights = 0;
+    for (UINT i = 0; i <= 1000; i++) {
+        float distance = -10.0f + i * (starts.back () + 20.0f) / 1000;
+        float sample = distance / PATH_HEIGHT_SPACING;
+        float expected = sample < 0.0f ? 0.0f : (sample > path.GetNumHeightSamples () - 1 ?
+            path.GetNumHeightSamples () - 1.0f : sample);
+        numWrongHeights += fabsf (path.GetHeight (distance) - expected) < 1e-3f &&
+            (distance < 0.0f || distance > starts.back () || path.GetPosition (distance)[1] == path.GetHeight (distance)) ? 0 : 1;
+    }
+    Check (_report, numWrongHeights == 0 && path.GetNumHeightSamples () > starts.back () / PATH_HEIGHT_SPACING,
+        "enemy path interpolates %u height samples, %u wrong", path.GetNumHeightSamples (), numWrongHeights);
+}
+
+/* A recording saved twice, as on game over and then on quitting, replays the whole session */
+static void TestCommandLog (SelfTestReport& _report) {
+    const char* RECORDING = "SelfTest.rec";
+    const UINT NUM_TICKS = 100;
+    const UINT commandTicks[] = {0, 0, 5, 50, 80};
+    const UINT NUM_COMMANDS = sizeof (commandTicks) / sizeof (commandTicks[0]);
+    CommandLog log;
+    log.StartRecording (DEFAULT_SCENARIO, 1.0f / SIMULATION_STEP_RATE, true);
+    UINT next = 0;
+    for (UINT tick = 0; tick < NUM_TICKS; tick++) {
+        while (next < NUM_COMMANDS && commandTicks[next] == tick) {
+            GameCommand command;
+            ZeroMemory (&command, sizeof (GameCommand));
+            command.Tick = tick;
+            command.Type = CMD_PLACE_TOWER;
+            command.Param = next;
+            log.Record (command);
+            next++;
+        }
+        log.EndTick (tick, CommandLog::Hash (COMMAND_LOG_HASH_SEED, &tick, sizeof (tick)));
+        if (tick == NUM_TICKS / 2) {
+            log.Save (RECORDING);
+        }
+    }
+    log.Save (RECORDING);
+
+    for (UINT divergent = NUM_TICKS / 2 + 20; divergent <= NUM_TICKS; divergent += NUM_TICKS / 2 - 20) {
+        log.StartReplay (RECORDING);
+        bool isInOrder = strcmp (log.GetScenario (), DEFAULT_SCENARIO) == 0 && log.GetNumTicks () == NUM_TICKS;
+        next = 0;
+        UINT tick = 0;
+        for (; !log.IsFinished (tick); tick++) {
+            GameCommand command;
+            while (log.NextCommand (tick, command)) {
+                isInOrder = isInOrder && next < NUM_COMMANDS && command.Tick == commandTicks[next] && command.Param == next;
+                next++;
+            }
+            UINT hashTick = tick == divergent ? tick + 1 : tick;
+            log.EndTick (tick, CommandLog::Hash (COMMAND_LOG_HASH_SEED, &hashTick, sizeof (hashTick)));
+        }
+        Check (_report, isInOrder && next == NUM_COMMANDS && tick == NUM_TICKS,
+            "recording replays its %u commands over %u steps", next, tick);
+        if (divergent < NUM_TICKS) {
+            Check (_report, log.GetDivergentTick () == divergent, "replay with a changed step %u diverges there", divergent);
+        } else {
+            Check (_report, log.GetDivergentTick () == INVALID_ID, "replay of the same steps does not diverge");
+        }
+    }
+
+    /* a recording cut short is refused */
+    std::vector<BYTE> data;
+    ReadFileData (RECORDING, data);
+    WriteFileData (RECORDING, data, data.size () - 1);
+    bool isRefused = false;
+    try {
+        log.StartReplay (RECORDING);
+    } catch (ErrorMessage e) {
+        isRefused = e.GetErrorCode () == ERRC_BAD_FILE && !log.IsReplaying ();
+    }
+    Check (_report, isRefused, "recording cut short is refused");
+    DeleteFile (RECORDING);
+}
+
+static bool IsSameSnapshot (const GameSnapshot& _a, const GameSnapshot& _b) {
+    return memcmp (&_a.Header, &_b.Header, sizeof (SnapshotHeader)) == 0 &&
+        _a.Waves.size () == _b.Waves.size () && _a.Enemies.size () == _b.Enemies.size () &&
+        _a.Towers.size () == _b.Towers.size () && _a.Guns.size () == _b.Guns.size () &&
+        _a.Occupied == _b.Occupied &&
+        memcmp (&_a.Waves[0], &_b.Waves[0], _a.Waves.size () * sizeof (WaveInfo)) == 0 &&
+        memcmp (&_a.Enemies[0], &_b.Enemies[0], _a.Enemies.size () * sizeof (EnemySnapshot)) == 0 &&
+        memcmp (&_a.Towers[0], &_b.Towers[0], _a.Towers.size () * sizeof (TowerSnapshot)) == 0 &&
+        memcmp (&_a.Guns[0], &_b.Guns[0], _a.Guns.size () * sizeof (GunSnapshot)) == 0;
+}
+
+static bool IsBadSnapshotRejected (const char* _filename) {
+    GameSnapshot snapshot;
+    try {
+        Game::ReadSnapshot (snapshot, _filename);
+    } catch (ErrorMessage e) {
+        return e.GetErrorCode () == ERRC_BAD_FILE;
+    }
+    return false;
+}
+
+/* A snapshot written directly and through the autosave worker reads back the same, broken files are refused */
+static void TestSnapshots (SelfTestReport& _report) {
+    const char* SNAPSHOT = "SelfTest.sav";
+    GameSnapshot snapshot;
+    memset (&snapshot.Header, 0, sizeof (SnapshotHeader));
+    memcpy (snapshot.Header.Magic, "TMRW", sizeof (snapshot.Header.Magic));
+    snapshot.Header.Version = SNAPSHOT_VERSION;
+    strcpy (snapshot.Header.Scenario, DEFAULT_SCENARIO);
+    snapshot.Header.NumWaves = 3;
+    snapshot.Header.NumEnemies = 40;
+    snapshot.Header.NumTowers = 7;
+    snapshot.Header.NumGuns = 5;
+    snapshot.Header.OccupiedSize = 16;
+    snapshot.Waves.resize (snapshot.Header.NumWaves);
+    snapshot.Enemies.resize (snapshot.Header.NumEnemies);
+    snapshot.Towers.resize (snapshot.Header.NumTowers);
+    snapshot.Guns.resize (snapshot.Header.NumGuns);
+    snapshot.Occupied.resize (snapshot.Header.OccupiedSize * snapshot.Header.OccupiedSize);
+    /* every record gets its own bytes, so a shifted or dropped record shows */
+    for (UINT i = 0; i < snapshot.Waves.size (); i++) {
+        memset (&snapshot.Waves[i], i + 1, sizeof (WaveInfo));
+    }
+    for (UINT i = 0; i < snapshot.Enemies.size (); i++) {
+        memset (&snapshot.Enemies[i], i + 11, sizeof (EnemySnapshot));
+    }
+    for (UINT i = 0; i < snapshot.Towers.size (); i++) {
+        memset (&snapshot.Towers[i], i + 101, sizeof (TowerSnapshot));
+    }
+    for (UINT i = 0; i < snapshot.Guns.size (); i++) {
+        memset (&snapshot.Guns[i], i + 201, sizeof (GunSnapshot));
+    }
+    for (UINT i = 0; i < snapshot.Occupied.size (); i++) {
+        snapshot.Occupied[i] = i % 3 == 0;
+    }
+
+    Game::WriteSnapshot (snapshot, SNAPSHOT);
+    GameSnapshot loaded;
+    Game::ReadSnapshot (loaded, SNAPSHOT);
+    SnapshotHeader header;
+    Check (_report, IsSameSnapshot (snapshot, loaded), "snapshot reads back as written");
+    Check (_report, Game::ReadSnapshotHeader (header, SNAPSHOT) && header.NumEnemies == snapshot.Header.NumEnemies,
+        "snapshot header reads back as written");
+
+    /* a snapshot cut short, one with a byte too many and one of another version */
+    std::vector<BYTE> data;
+    ReadFileData (SNAPSHOT, data);
+    const size_t sizes[] = {0, 10, sizeof (SnapshotHeader), data.size () - 1, data.size () + 1};
+    for (UINT i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++) {
+        WriteFileData (SNAPSHOT, data, sizes[i]);
+        Check (_report, IsBadSnapshotRejected (SNAPSHOT), "snapshot of %u bytes is refused", (UINT)sizes[i]);
+    }
+    ((SnapshotHeader*)&data[0])->Version = SNAPSHOT_VERSION + 1;
+    WriteFileData (SNAPSHOT, data, data.size ());
+    Check (_report, IsBadSnapshotRejected (SNAPSHOT) && !Game::ReadSnapshotHeader (header, SNAPSHOT),
+        "snapshot of another version is refused");
+    DeleteFile (SNAPSHOT);
+
+    Autosave autosave;
+    autosave.Start (SNAPSHOT, AUTOSAVE_INTERVAL, AUTOSAVE_MEMORY_BUDGET);
+    bool isDue = autosave.Update (AUTOSAVE_INTERVAL * 0.5f);
+    isDue = !isDue && autosave.Update (AUTOSAVE_INTERVAL * 0.5f);
+    Check (_report, isDue, "autosave is due once its interval has passed");
+    GameSnapshot* buffer = autosave.BeginCapture (AUTOSAVE_MEMORY_BUDGET);
+    bool isQueued = buffer != NULL;
+    if (isQueued) {
+        *buffer = snapshot;
+        autosave.EndCapture ();
+    }
+    autosave.WaitIdle ();
+    loaded = GameSnapshot ();
+    Game::ReadSnapshot (loaded, SNAPSHOT);
+    Check (_report, isQueued && !autosave.HasFailed () && IsSameSnapshot (snapshot, loaded),
+        "autosave writes the captured snapshot");
+    autosave.Start (SNAPSHOT, AUTOSAVE_INTERVAL, sizeof (SnapshotHeader));
+    bool isSkipped = autosave.BeginCapture (sizeof (SnapshotHeader) + 1) == NULL && autosave.HasStartedSkipping ();
+    isSkipped = isSkipped && autosave.BeginCapture (sizeof (SnapshotHeader) + 1) == NULL && !autosave.HasStartedSkipping ();
+    bool isResumed = autosave.BeginCapture (sizeof (SnapshotHeader)) != NULL && !autosave.HasStartedSkipping ();
+    Check (_report, isSkipped && isResumed, "autosave skips snapshots over its memory budget and reports it once");
+    autosave.Stop ();
+    DeleteFile (SNAPSHOT);
+}
+
+/* Transformed vertices of a triangle list with a FIFO post-transform cache of 16 vertices */
+static UINT CountFifoMisses (const std::vector<UINT>& _index, UINT _numVertices) {
+    std::vector<UINT> cacheTime (_numVertices, INVALID_ID);
+    UINT time = 0;
+    for (UINT i = 0; i < _index.size (); i++) {
+        if (cacheTime[_index[i]] == INVALID_ID || time - cacheTime[_index[i]] >= 16) {
+            cacheTime[_index[i]] = time++;
+        }
+    }
+    return time;
+}
+
+static bool IsBadPackDataRejected (const std::vector<char>& _compressed, UINT _size, UINT _originalSize) {
+    std::vector<char> data (_originalSize + 1);
+    try {
+        PackFile::Decompress (_compressed.empty () ? NULL : &_compressed[0], _size, &data[0], _originalSize);
+    } catch (ErrorMessage e) {
+        return e.GetErrorCode () == ERRC_BAD_FILE;
+    }
+    return false;
+}
+
+/* The pak entry codec gives back the same bytes: empty and tiny data, text, long runs that
+   overlap their match, noise, and repeats at the window's end and past it. Cut and wrongly
+   sized data is refused. */
+static void TestPackCompression (SelfTestReport& _report) {
+    const char* NAMES[] = {"empty", "1 byte", "text", "runs", "noise", "window", "past the window"};
+    const UINT NUM_SAMPLES = sizeof (NAMES) / sizeof (NAMES[0]);
+    UINT seed = 12345;
+    for (UINT sample = 0; sample < NUM_SAMPLES; sample++) {
+        std::vector<char> data;
+        if (sample == 1) {
+            data.push_back ('x');
+        } else if (sample == 2) {
+            for (UINT i = 0; i < 2000; i++) {
+                char line[64];
+                int length = sprintf (line, "waypoint %u x: %u z: %u\n", i, (i * 37) % 256, (i * 101) % 256);
+                data.insert (data.end (), line, line + length);
+            }
+        } else if (sample == 3) {
+            /* literals and matches longer than a token holds */
+            for (UINT run = 0; run < 40; run++) {
+                for (UINT i = 0; i < run * 13; i++) {
+                    seed = seed * 1664525 + 1013904223;
+                    data.push_back ((char)(seed >> 24));
+                }
+                data.insert (data.end (), 300 + run * 7, (char)run);
+            }
+        } else if (sample >= 4) {
+            UINT period = sample == 5 ? 65535 : 65537;
+            UINT size = sample == 4 ? 100000 : 3 * period;
+            for (UINT i = 0; i < size; i++) {
+                if (i < period || sample == 4) {
+                    seed = seed * 1664525 + 1013904223;
+                    data.push_back ((char)(seed >> 24));
+                } else {
+                    data.push_back (data[i - period]);
+                }
+            }
+        }
+        const char* source = data.empty () ? NULL : &data[0];
+        std::vector<char> compressed;
+        PackFile::Compress (source, data.size (), compressed);
+        std::vector<char> decompressed (data.size () + 1, 0);
+        bool isSame = false;
+        try {
+            PackFile::Decompress (&compressed[0], compressed.size (), &decompressed[0], data.size ());
+            isSame = data.empty () || memcmp (&data[0], &decompressed[0], data.size ()) == 0;
+        } catch (ErrorMessage e) {
+            isSame = false;
+        }
+        bool isRejected = IsBadPackDataRejected (compressed, compressed.size (), data.size () + 1);
+        if (data.size () > 0) {
+            isRejected = isRejected && IsBadPackDataRejected (compressed, compressed.size () - 1, data.size ()) &&
+                IsBadPackDataRejected (compressed, compressed.size (), data.size () - 1);
+        }
+        Check (_report, isSame && isRejected, "pak codec round trip of %s, %u bytes to %u",
+            NAMES[sample], data.size (), compressed.size ());
+        if (sample == 2 || sample == 3 || sample == 5) {
+            Check (_report, compressed.size () < data.size () / 2, "pak codec halves the %s", NAMES[sample]);
+        }
+    }
+}
+
+/* The texel decode of GetTextureTexel gives what the cooker decodes, on the blocks the cooker
+   compresses and on arbitrary blocks, those have both color modes of DXT1 */
+static void TestDxtDecode (SelfTestReport& _report) {
+    const UINT NUM_BLOCKS = 2000;
+    UINT seed = 12345;
+    for (UINT f = 0; f < 2; f++) {
+        DxtFormat format = f == 0 ? DXT_FORMAT_DXT1 : DXT_FORMAT_DXT5;
+        UINT numCompressedDifferent = 0;
+        UINT numArbitraryDifferent = 0;
+        for (UINT b = 0; b < NUM_BLOCKS; b++) {
+            // smooth texels, then noise, then the arbitrary block
+            BYTE rgba[64];
+            BYTE block[DXT5_BLOCK_SIZE];
+            for (UINT i = 0; i < 64; i++) {
+                seed = seed * 1664525 + 1013904223;
+                rgba[i] = b % 2 == 0 ? (BYTE)(b * 7 + (i / 4) * (b % 13) + (i % 4) * 50) : (BYTE)(seed >> 24);
+            }
+            for (UINT pass = 0; pass < 2; pass++) {
+                if (pass == 0) {
+                    DxtCompressor::CompressBlock (rgba, format, block);
+                } else {
+                    for (UINT i = 0; i < DXT5_BLOCK_SIZE; i++) {
+                        seed = seed * 1664525 + 1013904223;
+                        block[i] = (BYTE)(seed >> 24);
+                    }
+                }
+                BYTE decoded[64];
+                DxtCompressor::DecompressBlock (block, format, decoded);
+                bool isDifferent = false;
+                for (UINT i = 0; i < 16; i++) {
+                    BYTE bgra[4];
+                    DecodeBlockTexel (format == DXT_FORMAT_DXT5, block, i % 4, i / 4, bgra);
+                    isDifferent |= bgra[0] != decoded[i * 4 + 2] || bgra[1] != decoded[i * 4 + 1] ||
+                        bgra[2] != decoded[i * 4] || bgra[3] != decoded[i * 4 + 3];
+                }
+                (pass == 0 ? numCompressedDifferent : numArbitraryDifferent) += isDifferent ? 1 : 0;
+            }
+        }
+        const char* name = format == DXT_FORMAT_DXT5 ? "DXT5" : "DXT1";
+        Check (_report, numCompressedDifferent == 0, "%s texels of %u compressed blocks decode as cooked, %u differ",
+            name, NUM_BLOCKS, numCompressedDifferent);
+        Check (_report, numArbitraryDifferent == 0, "%s texels of %u arbitrary blocks decode as cooked, %u differ",
+            name, NUM_BLOCKS, numArbitraryDifferent);
+    }
+}
+
+/* The vertex cache order keeps every triangle and the order of its vertices, it is the same
+   for 16-bit and 32-bit indices, and it transforms fewer vertices than a shuffled order */
+static void TestTriangleOrder (SelfTestReport& _report) {
+    const UINT GRID_SIZE = 40;
+    const UINT numVertices = (GRID_SIZE + 1) * (GRID_SIZE + 1);
+    std::vector<UINT> index;
+    for (UINT z = 0; z < GRID_SIZE; z++) {
+        for (UINT x = 0; x < GRID_SIZE; x++) {
+            UINT vertex = z * (GRID_SIZE + 1) + x;
+            UINT triangles[6] = {vertex, vertex + 1, vertex + GRID_SIZE + 1, vertex + 1, vertex + GRID_SIZE + 2, vertex + GRID_SIZE + 1};
+            index.insert (index.end (), triangles, triangles + 6);
+        }
+    }
+    UINT seed = 12345;
+    for (UINT i = index.size () / 3 - 1; i > 0; i--) {
+        seed = seed * 1664525 + 1013904223;
+        UINT j = (seed >> 8) % (i + 1);
+        for (UINT k = 0; k < 3; k++) {
+            std::swap (index[i * 3 + k], index[j * 3 + k]);
+        }
+    }
+    std::vector<UINT> ordered (index);
+    std::vector<WORD> shortOrdered (index.begin (), index.end ());
+    OptimizeTriangleOrder (&ordered[0], ordered.size (), numVertices);
+    OptimizeTriangleOrder (&shortOrdered[0], shortOrdered.size (), numVertices);
+    bool isSame = std::equal (ordered.begin (), ordered.end (), shortOrdered.begin ());
+    std::vector<UINT64> triangles;
+    std::vector<UINT64> orderedTriangles;
+    for (UINT i = 0; i < index.size (); i += 3) {
+        triangles.push_back (((UINT64)index[i] * numVertices + index[i + 1]) * numVertices + index[i + 2]);
+        orderedTriangles.push_back (((UINT64)ordered[i] * numVertices + ordered[i + 1]) * numVertices + ordered[i + 2]);
+    }
+    std::sort (triangles.begin (), triangles.end ());
+    std::sort (orderedTriangles.begin (), orderedTriangles.end ());
+    Check (_report, triangles == orderedTriangles && isSame, "vertex cache order keeps the %u triangles, for 16-bit and 32-bit indices",
+        (UINT)triangles.size ());
+    UINT numMisses = CountFifoMisses (index, numVertices);
+    UINT numOrderedMisses = CountFifoMisses (ordered, numVertices);
+    Check (_report, numOrderedMisses < numMisses, "vertex cache order transforms %u vertices instead of %u", numOrderedMisses, numMisses);
+}
+
+/* 0 if the model data loads, otherwise the error code, INVALID_ID for anything but an ErrorMessage */
+static UINT LoadMs3dData (Ms3dModel& _model, const char* _filename, const char* _data, UINT _size) {
+    try {
+        _model.Load (_filename, _data, _size);
+    } catch (ErrorMessage e) {
+        return e.GetErrorCode ();
+    } catch (...) {
+        return INVALID_ID;
+    }
+    return 0;
+}
+
+static bool IsMs3dDataRefused (Ms3dModel& _model, const char* _filename, const std::vector<char>& _data) {
+    return LoadMs3dData (_model, _filename, &_data[0], _data.size ()) == ERRC_BAD_FILE;
+}
+
+/* The offset of every joint record of the model data, and the end of the last one */
+static void GetMs3dJointOffsets (const std::vector<char>& _data, const ms3d::SECTIONS& _sections, std::vector<UINT>& _offsets) {
+    _offsets.clear ();
+    const char* joint = _sections.Joints;
+    for (UINT i = 0; i <= _sections.NumJoints; i++) {
+        _offsets.push_back (joint - &_data[0]);
+        if (i < _sections.NumJoints) {
+            const ms3d::JOINT* header = (const ms3d::JOINT*)joint;
+            joint += 93 + (header->NumRotFrames + header->NumTransFrames) * sizeof (ms3d::KEYFRAME);
+        }
+    }
+}
+
+/* The model data with its joints in the reverse order, so the children come before their parents */
+static void ReverseMs3dJoints (const std::vector<char>& _data, const ms3d::SECTIONS& _sections,
+                               const std::vector<UINT>& _offsets, std::vector<char>& _reversed) {
+    _reversed.assign (_data.begin (), _data.begin () + _offsets[0]);
+    for (UINT i = _sections.NumJoints; i > 0; i--) {
+        _reversed.insert (_reversed.end (), _data.begin () + _offsets[i - 1], _data.begin () + _offsets[i]);
+    }
+    _reversed.insert (_reversed.end (), _data.begin () + _offsets[_sections.NumJoints], _data.end ());
+    ms3d::VERTEX* vertex = (ms3d::VERTEX*)(&_reversed[0] + (_sections.Vertices - &_data[0]));
+    for (UINT i = 0; i < _sections.NumVertices; i++) {
+        if (vertex[i].BoneId != -1) {
+            vertex[i].BoneId = (char)(_sections.NumJoints - 1 - vertex[i].BoneId);
+        }
+    }
+}
+
+/* The joints of both models match by name, with the same parents, vertices, triangles and pose */
+static bool IsSameSkeleton (Ms3dModel& _a, Ms3dModel& _b, UINT _numTriangles) {
+    USHORT numJoints = _a.GetNumJoints ();
+    if (numJoints == 0 || numJoints != _b.GetNumJoints ()) {
+        return false;
+    }
+    std::vector<D3DXMATRIX> paletteA (numJoints);
+    std::vector<D3DXMATRIX> paletteB (numJoints);
+    _a.SamplePose (1.0f, &paletteA[0]);
+    _b.SamplePose (1.0f, &paletteB[0]);
+    const ms3d::JOINT* jointA = _a.GetJoints ();
+    const ms3d::JOINT* jointB = _b.GetJoints ();
+    std::vector<short> jointIdB (numJoints, -1);
+    bool isSame = true;
+    for (UINT i = 0; isSame && i < numJoints; i++) {
+        short j = 0;
+        while (j < numJoints && strcmp (jointA[i].Name, jointB[j].Name) != 0) {
+            j++;
+        }
+        isSame = j < numJoints && strcmp (jointA[i].Parent, jointB[j].Parent) == 0 && jointB[j].ParentId < j &&
+            (jointA[i].ParentId == -1) == (jointB[j].ParentId == -1) && jointA[i].NumVertices == jointB[j].NumVertices &&
+            memcmp (&paletteA[i], &paletteB[j], sizeof (D3DXMATRIX)) == 0;
+        if (isSame) {
+            jointIdB[i] = j;
+            const ms3d::VERTEX* vertexA = _a.GetVertices (i);
+            const ms3d::VERTEX* vertexB = _b.GetVertices (j);
+            for (UINT k = 0; isSame && k < jointA[i].NumVertices; k++) {
+                isSame = memcmp (&vertexA[k].Vertex, &vertexB[k].Vertex, sizeof (D3DXVECTOR3)) == 0 &&
+                    vertexA[k].BoneId == (char)i && vertexB[k].BoneId == (char)j;
+            }
+        }
+    }
+    const ms3d::TRIANGLE* triangleA = _a.GetTriangles ();
+    const ms3d::TRIANGLE* triangleB = _b.GetTriangles ();
+    for (UINT i = 0; isSame && i < _numTriangles; i++) {
+        for (UINT j = 0; isSame && j < 3; j++) {
+            short jointId = triangleA[i].JointIndex[j];
+            isSame = jointId == -1 ? triangleB[i].JointIndex[j] == -1 : triangleB[i].JointIndex[j] == jointIdB[jointId];
+        }
+    }
+    return isSame;
+}
+
+/* The enemy models load whole, also with their children joints first, and refuse to load
+   cut short or with broken references, randomly changed bytes either load or are refused as bad files */
+static void TestMs3dFiles (SelfTestReport& _report) {
+    const char* filenames[] = {"data/ms3d/AlienScout/AlienScout.ms3d", "data/ms3d/AlienInfantry/AlienInfantry.ms3d",
+        "data/ms3d/AlienCivilian/AlienCivilian.ms3d", "data/ms3d/AlienBoss/AlienBoss.ms3d"};
+    const UINT NUM_MUTATIONS = 2000;
+    UINT seed = 12345;
+    for (UINT i = 0; i < sizeof (filenames) / sizeof (filenames[0]); i++) {
+        const char* filename = filenames[i];
+        std::vector<char> data;
+        VirtualFile::Load (filename, data);
+        Ms3dModel original;
+        UINT size = data.size ();
+        if (!Check (_report, LoadMs3dData (original, filename, &data[0], size) == 0, "%s loads", filename)) {
+            continue;
+        }
+        ms3d::SECTIONS sections;
+        original.ValidateData (filename, &data[0], size, sections);
+        Ms3dModel model;
+        /* the joints are the last section, anything after them is not read */
+        std::vector<UINT> jointOffsets;
+        GetMs3dJointOffsets (data, sections, jointOffsets);
+        UINT usedSize = jointOffsets[sections.NumJoints];
+        bool isRefused = true;
+        for (UINT length = 0; isRefused && length < usedSize; length++) {
+            isRefused = LoadMs3dData (model, filename, &data[0], length) == ERRC_BAD_FILE;
+        }
+        Check (_report, isRefused && LoadMs3dData (model, filename, &data[0], usedSize) == 0,
+            "%s cut anywhere before its %u bytes is refused", filename, usedSize);
+
+        /* a header or a reference out of its range */
+        std::vector<char> broken (data);
+        broken[0] = 'X';
+        Check (_report, IsMs3dDataRefused (model, filename, broken), "%s with another id string is refused", filename);
+        broken = data;
+        broken[10] = 5;
+        Check (_report, IsMs3dDataRefused (model, filename, broken), "%s of version 5 is refused", filename);
+        broken = data;
+        ms3d::VERTEX* vertex = (ms3d::VERTEX*)(&broken[0] + (sections.Vertices - &data[0]));
+        vertex->BoneId = (char)sections.NumJoints;
+        Check (_report, IsMs3dDataRefused (model, filename, broken), "%s with a vertex of a missing joint is refused", filename);
+        broken = data;
+        USHORT* vertIndex = (USHORT*)(&broken[0] + (sections.Triangles - &data[0]) + sizeof (USHORT));
+        vertIndex[1] = sections.NumVertices;
+        Check (_report, IsMs3dDataRefused (model, filename, broken), "%s with a triangle of a missing vertex is refused", filename);
+        broken = data;
+        ms3d::JOINT* joint = (ms3d::JOINT*)(&broken[0] + jointOffsets[0]);
+        strcpy (joint->Parent, "no such joint");
+        Check (_report, IsMs3dDataRefused (model, filename, broken), "%s with a missing parent joint is refused", filename);
+        /* the first joint is a root, make it the child of its own child */
+        const ms3d::JOINT* loadedJoint = original.GetJoints ();
+        UINT child = 1;
+        while (child < sections.NumJoints && loadedJoint[child].ParentId != 0) {
+            child++;
+        }
+        if (child < sections.NumJoints) {
+            strcpy (joint->Parent, loadedJoint[child].Name);
+            Check (_report, IsMs3dDataRefused (model, filename, broken), "%s with a cycle of joints is refused", filename);
+        }
+
+        std::vector<char> reversed;
+        ReverseMs3dJoints (data, sections, jointOffsets, reversed);
+        Ms3dModel reversedModel;
+        Check (_report, LoadMs3dData (reversedModel, filename, &reversed[0], reversed.size ()) == 0 &&
+            IsSameSkeleton (original, reversedModel, sections.NumTriangles), "%s with its joints reversed loads the same", filename);
+
+        /* bytes changed anywhere, or in the meshes, materials and joints, where the counts and references are */
+        UINT recordsOffset = sections.Meshes - sizeof (USHORT) - &data[0];
+        UINT numLoaded = 0;
+        UINT numRefused = 0;
+        for (UINT j = 0; j < NUM_MUTATIONS; j++) {
+            broken = data;
+            UINT numChanges = 1 + j % 4;
+            for (UINT k = 0; k < numChanges; k++) {
+                seed = seed * 1664525 + 1013904223;
+                UINT offset = (seed >> 8) % size;
+                if (j % 2 == 1) {
+                    offset = recordsOffset + offset % (usedSize - recordsOffset);
+                }
+                seed = seed * 1664525 + 1013904223;
+                broken[offset] = (char)(seed >> 24);
+            }
+            UINT result = LoadMs3dData (model, filename, &broken[0], size);
+            numLoaded += result == 0 ? 1 : 0;
+            numRefused += result == ERRC_BAD_FILE || result == ERRC_OUT_OF_MEM ? 1 : 0;
+        }
+        Check (_report, numLoaded + numRefused == NUM_MUTATIONS,
+            "%s changed %u times loads %u times and is refused %u times", filename, NUM_MUTATIONS, numLoaded, numRefused);
+    }
+}
+
+static UINT GetAssetError (const AssetLoader& _assets, UINT _handle) {
+    try {
+        _assets.GetResult (_handle);
+    } catch (ErrorMessage e) {
+        return e.GetErrorCode ();
+    }
+    return 0;
+}
+
+/* The ms3d files need no device, a failed request is retried when it is asked for again.
+   The requests are made while the workers are stopped, so they are still queued. */
+static void TestAssetRetry (SelfTestReport& _report) {
+    const char* missingFile = "data/ms3d/Missing.ms3d";
+    const char* filename = "data/ms3d/AlienScout/AlienScout.ms3d";
+    Ms3dLoader ms3dLoader;
+    AssetLoader assets (NULL, NULL, &ms3dLoader);
+    UINT missing = assets.RequestMs3dFile (missingFile);
+    UINT loading = GetAssetError (assets, missing);
+    UINT clearing = 0;
+    try {
+        assets.Clear ();
+    } catch (ErrorMessage e) {
+        clearing = e.GetErrorCode ();
+    }
+    Check (_report, loading == ERRC_INVALID_PARAMETER && clearing == ERRC_INVALID_PARAMETER,
+        "an asset still loading is an invalid parameter, not a lost device");
+    assets.Start (2);
+    while (!assets.Update (0.01f)) {
+    }
+    assets.Stop ();
+    bool isFailed = assets.GetState (missing) == ASSET_FAILED && GetAssetError (assets, missing) != 0;
+    UINT retried = assets.RequestMs3dFile (missingFile);
+    UINT found = assets.RequestMs3dFile (filename);
+    Check (_report, isFailed && retried != missing && assets.GetState (retried) == ASSET_QUEUED &&
+        assets.RequestMs3dFile (filename) == found, "a failed asset is requested again, a loading one is shared");
+    assets.Start (2);
+    while (!assets.Update (0.01f)) {
+    }
+    Check (_report, assets.GetState (retried) == ASSET_FAILED && GetAssetError (assets, found) == 0 &&
+        ms3dLoader.IsFileCached (filename), "%s is cached after the retry of the missing file", filename);
+    assets.Clear ();
+    Check (_report, assets.IsFinished () && assets.GetProgress () == 1.0f && assets.RequestMs3dFile (filename) == 0 &&
+        assets.GetState (0) == ASSET_READY, "the cleared loader finds %s cached", filename);
+}
+
+/* A session recorded until the enemies have shot at the castle for a while,
+   with the enemies animated every few steps as if frames were rendered, then
+   replayed without animating them. Every step has to hash the same. */
+void Game::TestCommandReplay (SelfTestReport& _report) {
+    const char* RECORDING = "SelfTest.rec";
+    const UINT MAX_STEPS = (UINT)(600.0f * SIMULATION_STEP_RATE);
+    const UINT SHOOTING_STEPS = (UINT)(10.0f * SIMULATION_STEP_RATE);
+    const UINT STEPS_PER_FRAME = 3;
+    std::string recordFile = m_RecordFile;
+    bool isHashingRecord = m_IsHashingRecord;
+    bool isLodEnabled = m_AnimationLod.IsEnabled;
+    m_AnimationLod.IsEnabled = false;   /* nothing is seen here */
+    m_IsContinuing = false;
+    StartRecording (RECORDING, true);
+    StartNew ();
+    UINT fullHitPoints = m_GameUI->GetCastleHitPoints ();
+    UINT lastStep = MAX_STEPS;
+    while (m_Tick < lastStep) {
+        Simulate (m_SimulationStep);
+        if (m_Tick % STEPS_PER_FRAME == 0) {
+            UpdateEnemies (m_SimulationStep * STEPS_PER_FRAME);
+        }
+        m_Events.Clear ();
+        if (lastStep == MAX_STEPS && m_GameUI->GetCastleHitPoints () < fullHitPoints) {
+            lastStep = m_Tick + SHOOTING_STEPS;
+        }
+    }
+    UINT hitPoints = m_GameUI->GetCastleHitPoints ();
+    UINT hash = m_StateHash;
+    UINT numSteps = m_Tick;
+    SaveRecording ();
+    Check (_report, hitPoints < fullHitPoints, "enemies shoot at the castle within %u steps, %u of %u hit points left",
+        numSteps, hitPoints, fullHitPoints);
+
+    StartReplay (RECORDING);
+    StartNew ();
+    while (!m_CommandLog.IsFinished (m_Tick)) {
+        Simulate (m_SimulationStep);
+        m_Events.Clear ();
+    }
+    Check (_report, m_CommandLog.GetDivergentTick () == INVALID_ID && m_Tick == numSteps && m_StateHash == hash &&
+        m_GameUI->GetCastleHitPoints () == hitPoints, "replay without animation matches the recording of %u steps", numSteps);
+    m_CommandLog.Stop ();
+    m_RecordFile = recordFile;
+    m_IsHashingRecord = isHashingRecord;
+    m_AnimationLod.IsEnabled = isLodEnabled;
+    DeleteFile (RECORDING);
+}
+
+/* Towers are put along the path so that guns are in flight when the level is
+   captured. The restored level has to hash the same and to go on the same. */
+void Game::TestSnapshotRestore (SelfTestReport& _report) {
+    const UINT MAX_STEPS = (UINT)(300.0f * SIMULATION_STEP_RATE);
+    const UINT FOLLOWING_STEPS = (UINT)(20.0f * SIMULATION_STEP_RATE);
+    const int TOWER_OFFSET = 6;     /* from the waypoints on the heightmap grid */
+    m_IsContinuing = false;
+    StartNew ();
+    for (UINT i = 0; i < m_Waypoints.size (); i++) {
+        POINT point = m_Waypoints[i].Position;
+        point.x += TOWER_OFFSET;
+        if (PlaceTower (BASIC_TOWER, point)) {
+            UINT towerId = m_Towers.size () - 1;
+            m_Towers[towerId].Level = 0;
+            m_Towers[towerId].BuildingTime = 0.0f;
+        }
+    }
+    UINT numGuns = 0;
+    while (m_Tick < MAX_STEPS && numGuns == 0) {
+        Simulate (m_SimulationStep);
+        m_Events.Clear ();
+        numGuns = 0;
+        for (UINT i = 0; i < m_Towers.size (); i++) {
+            numGuns += m_Towers[i].GunInfo.size ();
+        }
+    }
+    Check (_report, numGuns > 0, "%u towers along the path fire within %u steps", m_Towers.size (), m_Tick);
+
+    GameSnapshot captured;
+    CaptureSnapshot (captured);
+    UINT capturedHash = HashState (COMMAND_LOG_HASH_SEED);
+    for (UINT i = 0; i < FOLLOWING_STEPS; i++) {
+        Simulate (m_SimulationStep);
+        m_Events.Clear ();
+    }
+    UINT followingHash = HashState (COMMAND_LOG_HASH_SEED);
+
+    StartNew ();
+    RestoreSnapshot (captured);
+    GameSnapshot restored;
+    CaptureSnapshot (restored);
+    bool isSame = restored.Enemies.size () == captured.Enemies.size () &&
+        restored.Towers.size () == captured.Towers.size () &&
+        restored.Guns.size () == captured.Guns.size () &&
+        (captured.Enemies.empty () ||
+            memcmp (&restored.Enemies[0], &captured.Enemies[0], captured.Enemies.size () * sizeof (EnemySnapshot)) == 0) &&
+        (captured.Towers.empty () ||
+            memcmp (&restored.Towers[0], &captured.Towers[0], captured.Towers.size () * sizeof (TowerSnapshot)) == 0) &&
+        (captured.Guns.empty () ||
+            memcmp (&restored.Guns[0], &captured.Guns[0], captured.Guns.size () * sizeof (GunSnapshot)) == 0);
+    Check (_report, isSame && HashState (COMMAND_LOG_HASH_SEED) == capturedHash,
+        "a restored level of %u enemies and %u guns captures and hashes the same", captured.Enemies.size (), captured.Guns.size ());
+    for (UINT i = 0; i < FOLLOWING_STEPS; i++) {
+        Simulate (m_SimulationStep);
+        m_Events.Clear ();
+    }
+    Check (_report, HashState (COMMAND_LOG_HASH_SEED) == followingHash,
+        "a restored level goes on the same for %u steps", FOLLOWING_STEPS);
+}
+
+/* The cached height field of a level against the heights the terrain gives: the grid,
+   the triangles of the terrain mesh as the game sampled them before the cache, the batch
+   sampling outside the terrain too, and a refresh once a height changes */
+void Game::TestHeightField (SelfTestReport& _report) {
+    const UINT NUM_POSITIONS = 4001;   /* not a multiple of four, so the tail runs too */
+    m_IsContinuing = false;
+    StartNew ();
+    ITerrain* terrain = m_Terrain->GetTerrain ();
+    UINT size = terrain->GetSize ();
+    float scaleX = terrain->GetScale (0);
+    float scaleZ = terrain->GetScale (2);
+    UINT numWrongGrid = 0;
+    for (UINT z = 0; z < size; z++) {
+        for (UINT x = 0; x < size; x++) {
+            float height = terrain->GetScaledHeight (x, z);
+            numWrongGrid += m_HeightField.GetGridHeight (x, z) == height &&
+                fabsf (m_HeightField.GetHeight (x * scaleX, z * scaleZ) - height) <= 1e-3f * (1.0f + fabsf (height)) ? 0 : 1;
+        }
+    }
+    Check (_report, size > 1 && numWrongGrid == 0, "height field has the %ux%u terrain heights, %u wrong", size, size, numWrongGrid);
+
+    std::vector<float> positionX (NUM_POSITIONS);
+    std::vector<float> positionZ (NUM_POSITIONS);
+    UINT seed = 12345;
+    UINT numWrongHeights = 0;
+    for (UINT i = 0; i < NUM_POSITIONS; i++) {
+        seed = seed * 1664525 + 1013904223;
+        float x = (seed >> 8) / 16777216.0f * (size - 1);
+        seed = seed * 1664525 + 1013904223;
+        float z = (seed >> 8) / 16777216.0f * (size - 1);
+        positionX[i] = x * scaleX;
+        positionZ[i] = z * scaleZ;
+        /* the interpolation of Game::GetHeight before the cache */
+        UINT mapX = (UINT)x;
+        UINT mapZ = (UINT)z;
+        x = x - floorf (x);
+        z = z - floorf (z);
+        float h1, h2, h3;
+        float r1, r2, r;
+        if (x + z < 1.0f) {
+            h1 = terrain->GetScaledHeight (mapX + 1, mapZ);
+            h2 = terrain->GetScaledHeight (mapX, mapZ + 1);
+            h3 = terrain->GetScaledHeight (mapX, mapZ);
+            r1 = h2 - (h2 - h1) * x;
+            r2 = h3 + (h1 - h3) * x;
+            r = r2 + (r1 - r2) * z / (1.0f - x);
+        } else {
+            h1 = terrain->GetScaledHeight (mapX, mapZ + 1);
+            h2 = terrain->GetScaledHeight (mapX + 1, mapZ);
+            h3 = terrain->GetScaledHeight (mapX + 1, mapZ + 1);
+            r1 = h2 - (h2 - h1) * (1.0f - x);
+            r2 = h3 + (h1 - h3) * (1.0f - x);
+            r = r2 + (r1 - r2) * (1.0f - z) / x;
+        }
+        float height = m_HeightField.GetHeight (positionX[i], positionZ[i]);
+        numWrongHeights += fabsf (height - r) <= 1e-3f * (1.0f + fabsf (r)) ? 0 : 1;
+    }
+    Check (_report, numWrongHeights == 0, "height field interpolates %u positions as the terrain mesh, %u wrong",
+        NUM_POSITIONS, numWrongHeights);
+
+    /* a margin around the terrain, clamped to its edge */
+    for (UINT i = 0; i < NUM_POSITIONS; i += 3) {
+        positionX[i] = positionX[i] * 1.2f - 0.1f * (size - 1) * scaleX;
+        positionZ[i] = positionZ[i] * 1.2f - 0.1f * (size - 1) * scaleZ;
+    }
+    std::vector<float> heights (NUM_POSITIONS);
+    m_HeightField.GetHeights (&positionX[0], &positionZ[0], &heights[0], NUM_POSITIONS);
+    UINT numWrongBatch = 0;
+    for (UINT i = 0; i < NUM_POSITIONS; i++) {
+        float height = m_HeightField.GetHeight (positionX[i], positionZ[i]);
+        numWrongBatch += fabsf (heights[i] - height) <= 1e-4f * (1.0f + fabsf (height)) ? 0 : 1;
+    }
+    Check (_report, numWrongBatch == 0, "batched heights of %u positions are the single ones, %u wrong",
+        NUM_POSITIONS, numWrongBatch);
+
+    /* the terrain's revision refreshes the cache, the old height is put back after */
+    UINT x = size / 2;
+    UINT z = size / 3;
+    UCHAR height = terrain->GetHeight (x, z);
+    bool isSameRefreshed = !m_HeightField.Refresh (terrain);
+    terrain->SetHeight (x, z, height < 128 ? height + 100 : height - 100);
+    isSameRefreshed = isSameRefreshed && m_HeightField.Refresh (terrain) &&
+        m_HeightField.GetGridHeight (x, z) == terrain->GetScaledHeight (x, z);
+    terrain->SetHeight (x, z, height);
+    isSameRefreshed = isSameRefreshed && m_HeightField.Refresh (terrain) &&
+        m_HeightField.GetGridHeight (x, z) == terrain->GetScaledHeight (x, z);
+    Check (_report, isSameRefreshed, "height field refreshes only when a terrain height changes");
+}
+
+UINT Game::RunSelfTest (const char* _ReportFile) {
+    SelfTestReport report;
+    report.File = fopen (_ReportFile, "w");
+    if (!report.File) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _ReportFile);
+    }
+    report.NumChecks = 0;
+    report.NumFailed = 0;
+    try {
+        TestShadowCascades (report);
+        TestJobs (report);
+        TestTargeting (report);
+        TestEnemyPath (report);
+        TestSnapshots (report);
+        TestCommandLog (report);
+        TestMs3dFiles (report);
+        TestTriangleOrder (report);
+        TestDxtDecode (report);
+        TestPackCompression (report);
+        TestAssetRetry (report);
+        TestCommandReplay (report);
+        TestSnapshotRestore (report);
+        TestHeightField (report);
+    } catch (...) {
+        fclose (report.File);
+        throw;
+    }
+    fprintf (report.File, "%u checks, %u failed\n", report.NumChecks, report.NumFailed);
+    fclose (report.File);
+    return report.NumFailed;
+}
+
+#endif
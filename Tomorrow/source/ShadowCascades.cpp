@@ -0,0 +1,189 @@
+#include "../include/ShadowCascades.h"
+
+ShadowCascades::ShadowCascades () {
+    m_NumCascades = 0;
+    m_CasterDistance = 500.0f;
+    m_Frame = 0;
+    for (UINT i = 0; i < MAX_SHADOW_CASCADES; i++) {
+        m_Cascades[i].Split = 0.0f;
+        m_Cascades[i].Size = 1024;
+        m_Cascades[i].UpdateInterval = 1;
+        m_Cascades[i].IsDirty = false;
+        m_Cascades[i].IsValid = false;
+        m_Cascades[i].LightEye.zero ();
+        m_Cascades[i].LightView.identity ();
+        m_Cascades[i].LightProj.identity ();
+        m_Cascades[i].LightViewProj.identity ();
+    }
+}
+
+void ShadowCascades::Setup (UINT _NumCascades, float _Near, float _ShadowDistance, float _SplitLambda) {
+    if (_NumCascades > MAX_SHADOW_CASCADES) {
+        THROW_ERROR (ERRC_INVALID_PARAMETER);
+    }
+    m_NumCascades = _NumCascades;
+    for (UINT i = 0; i < m_NumCascades; i++) {
+        m_Cascades[i].Split = ComputeSplit (i + 1, m_NumCascades, _Near, _ShadowDistance, _SplitLambda);
+    }
+    Invalidate ();
+}
+
+void ShadowCascades::SetSplit (UINT _Cascade, float _Distance) {
+    if (_Cascade >= m_NumCascades) {
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    m_Cascades[_Cascade].Split = _Distance;
+    m_Cascades[_Cascade].IsValid = false;
+}
+
+void ShadowCascades::SetResolution (UINT _Cascade, UINT _Size) {
+    if (_Cascade >= m_NumCascades) {
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    m_Cascades[_Cascade].Size = _Size;
+    m_Cascades[_Cascade].IsValid = false;
+}
+
+void ShadowCascades::SetUpdateInterval (UINT _Cascade, UINT _Frames) {
+    if (_Cascade >= m_NumCascades) {
+        THROW_ERROR (ERRC_OUT_OF_RANGE);
+    }
+    m_Cascades[_Cascade].UpdateInterval = _Frames > 0 ? _Frames : 1;
+}
+
+void ShadowCascades::SetCasterDistance (float _Distance) {
+    m_CasterDistance = _Distance;
+    Invalidate ();
+}
+
+void ShadowCascades::Update (const MATRIX44& _View, const MATRIX44& _Projection, float _Near, float _Far, const VECTOR3& _LightDir) {
+    VECTOR3 frustum[8];
+    GetFrustumCorners (_View, _Projection, frustum);
+    float sliceNear = _Near;
+    for (UINT i = 0; i < m_NumCascades; i++) {
+        Cascade& cascade = m_Cascades[i];
+        /* cascades are staggered, so the far ones do not all refresh in the same frame */
+        cascade.IsDirty = !cascade.IsValid || (m_Frame + i) % cascade.UpdateInterval == 0;
+        if (cascade.IsDirty) {
+            VECTOR3 corners[8];
+            GetSliceCorners (frustum, _Near, _Far, sliceNear, cascade.Split, corners);
+            FitLight (corners, _LightDir, cascade.Size, m_CasterDistance, cascade.LightEye, cascade.LightView, cascade.LightProj);
+            cascade.LightViewProj = cascade.LightView * cascade.LightProj;
+            cascade.IsValid = true;
+        }
+        sliceNear = cascade.Split;
+    }
+    m_Frame++;
+}
+
+void ShadowCascades::Invalidate () {
+    for (UINT i = 0; i < MAX_SHADOW_CASCADES; i++) {
+        m_Cascades[i].IsValid = false;
+    }
+}
+
+bool ShadowCascades::IsDirty (UINT _Cascade) const {
+    return _Cascade < m_NumCascades && m_Cascades[_Cascade].IsDirty;
+}
+
+UINT ShadowCascades::GetNumCascades () const {
+    return m_NumCascades;
+}
+
+float ShadowCascades::GetSplit (UINT _Cascade) const {
+    return m_Cascades[_Cascade].Split;
+}
+
+UINT ShadowCascades::GetResolution (UINT _Cascade) const {
+    return m_Cascades[_Cascade].Size;
+}
+
+const VECTOR3& ShadowCascades::GetLightEye (UINT _Cascade) const {
+    return m_Cascades[_Cascade].LightEye;
+}
+
+const MATRIX44& ShadowCascades::GetLightView (UINT _Cascade) const {
+    return m_Cascades[_Cascade].LightView;
+}
+
+const MATRIX44& ShadowCascades::GetLightProj (UINT _Cascade) const {
+    return m_Cascades[_Cascade].LightProj;
+}
+
+const MATRIX44& ShadowCascades::GetLightViewProj (UINT _Cascade) const {
+    return m_Cascades[_Cascade].LightViewProj;
+}
+
+float ShadowCascades::ComputeSplit (UINT _Index, UINT _NumCascades, float _Near, float _Far, float _Lambda) {
+    /* blend of the logarithmic and the uniform split schemes */
+    float ratio = (float)_Index / _NumCascades;
+    float logSplit = _Near * powf (_Far / _Near, ratio);
+    float uniformSplit = _Near + (_Far - _Near) * ratio;
+    return _Lambda * logSplit + (1.0f - _Lambda) * uniformSplit;
+}
+
+void ShadowCascades::GetFrustumCorners (const MATRIX44& _View, const MATRIX44& _Projection, VECTOR3 _Corners[8]) {
+    MATRIX44 inverseViewProj = cml::inverse (_View * _Projection);
+    /* near plane corners first, then the far plane ones in the same order */
+    for (UINT i = 0; i < 8; i++) {
+        VECTOR3 ndc ((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : 0.0f);
+        _Corners[i] = cml::transform_point_4D (inverseViewProj, ndc);
+    }
+}
+
+void ShadowCascades::GetSliceCorners (const VECTOR3 _FrustumCorners[8], float _Near, float _Far, float _SliceNear, float _SliceFar, VECTOR3 _Corners[8]) {
+    /* view depth is linear along the edges which join the near and far corners */
+    float tNear = (_SliceNear - _Near) / (_Far - _Near);
+    float tFar = (_SliceFar - _Near) / (_Far - _Near);
+    for (UINT i = 0; i < 4; i++) {
+        VECTOR3 edge = _FrustumCorners[i + 4] - _FrustumCorners[i];
+        _Corners[i] = _FrustumCorners[i] + edge * tNear;
+        _Corners[i + 4] = _FrustumCorners[i] + edge * tFar;
+    }
+}
+
+void ShadowCascades::FitLight (const VECTOR3 _Corners[8], const VECTOR3& _LightDir, UINT _Size, float _CasterDistance,
+                               VECTOR3& _Eye, MATRIX44& _View, MATRIX44& _Proj) {
+    VECTOR3 center;
+    center.zero ();
+    for (UINT i = 0; i < 8; i++) {
+        center += _Corners[i];
+    }
+    center /= 8.0f;
+    float radius = 0.0f;
+    for (UINT i = 0; i < 8; i++) {
+        float distance = (_Corners[i] - center).length ();
+        if (distance > radius) {
+            radius = distance;
+        }
+    }
+    /* the sphere keeps the extent constant while the camera rotates, it is
+       a texel wider, as the snapping below moves the center up to a texel */
+    radius = ceilf (radius);
+    if (_Size > 2) {
+        radius *= (float)_Size / (_Size - 2);
+    }
+
+    VECTOR3 direction = cml::normalize (_LightDir);
+    VECTOR3 up (0.0f, 1.0f, 0.0f);
+    if (fabsf (direction[1]) > 0.99f) {
+        up = VECTOR3 (0.0f, 0.0f, 1.0f);
+    }
+    MATRIX44 rotation;
+    cml::matrix_look_at_LH (rotation, VECTOR3 (0.0f, 0.0f, 0.0f), direction, up);
+
+    /* snap the center to whole texels, so the shadows do not shimmer when the camera moves */
+    VECTOR3 lightCenter = cml::transform_point (rotation, center);
+    float texelSize = 2.0f * radius / _Size;
+    lightCenter[0] = floorf (lightCenter[0] / texelSize) * texelSize;
+    lightCenter[1] = floorf (lightCenter[1] / texelSize) * texelSize;
+    float eyeDepth = lightCenter[2] - radius - _CasterDistance;
+
+    MATRIX44 translation;
+    cml::matrix_translation (translation, VECTOR3 (-lightCenter[0], -lightCenter[1], -eyeDepth));
+    _View = rotation * translation;
+    cml::matrix_orthographic_LH (_Proj, 2.0f * radius, 2.0f * radius, 0.0f, 2.0f * radius + _CasterDistance, cml::z_clip_zero);
+
+    MATRIX44 inverseRotation = cml::inverse (rotation);
+    _Eye = cml::transform_point (inverseRotation, VECTOR3 (lightCenter[0], lightCenter[1], eyeDepth));
+}
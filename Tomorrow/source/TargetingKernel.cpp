@@ -0,0 +1,90 @@
+#include "../include/TargetingKernel.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TARGETING_SSE2
+#include <emmintrin.h>
+#endif
+
+TowerAim TargetingKernel::MakeAim (const VECTOR3& _Origin, float _Radius, float _FlightTime) {
+    TowerAim aim;
+    aim.Origin = _Origin;
+    aim.RadiusSq = _Radius * _Radius;
+    aim.LeadTime = _Radius > 0.0f ? _FlightTime / _Radius : 0.0f;
+    return aim;
+}
+
+void TargetingKernel::Clear () {
+    m_X.clear ();
+    m_Y.clear ();
+    m_Z.clear ();
+    m_VelocityX.clear ();
+    m_VelocityZ.clear ();
+}
+
+void TargetingKernel::Reserve (UINT _NumTargets) {
+    m_X.reserve (_NumTargets);
+    m_Y.reserve (_NumTargets);
+    m_Z.reserve (_NumTargets);
+    m_VelocityX.reserve (_NumTargets);
+    m_VelocityZ.reserve (_NumTargets);
+}
+
+UINT TargetingKernel::AddTarget (const VECTOR3& _Position, const VECTOR3& _Velocity) {
+    m_X.push_back (_Position[0]);
+    m_Y.push_back (_Position[1]);
+    m_Z.push_back (_Position[2]);
+    m_VelocityX.push_back (_Velocity[0]);
+    m_VelocityZ.push_back (_Velocity[2]);
+    return m_X.size () - 1;
+}
+
+UINT TargetingKernel::GetNumTargets () const {
+    return m_X.size ();
+}
+
+bool TargetingKernel::IsInRange (const TowerAim& _Aim, UINT _Target) const {
+    float x = m_X[_Target] - _Aim.Origin[0];
+    float y = m_Y[_Target] - _Aim.Origin[1];
+    float z = m_Z[_Target] - _Aim.Origin[2];
+    float time = sqrtf (x * x + y * y + z * z) * _Aim.LeadTime;
+    x += m_VelocityX[_Target] * time;
+    z += m_VelocityZ[_Target] * time;
+    return x * x + z * z <= _Aim.RadiusSq;
+}
+
+UINT TargetingKernel::FindTargets (const TowerAim& _Aim, std::vector<UINT>& _Targets) const {
+    UINT numFound = _Targets.size ();
+    UINT numTargets = m_X.size ();
+    UINT i = 0;
+#ifdef TARGETING_SSE2
+    const __m128 originX = _mm_set1_ps (_Aim.Origin[0]);
+    const __m128 originY = _mm_set1_ps (_Aim.Origin[1]);
+    const __m128 originZ = _mm_set1_ps (_Aim.Origin[2]);
+    const __m128 radiusSq = _mm_set1_ps (_Aim.RadiusSq);
+    const __m128 leadTime = _mm_set1_ps (_Aim.LeadTime);
+    for (; i + 4 <= numTargets; i += 4) {
+        __m128 x = _mm_sub_ps (_mm_loadu_ps (&m_X[i]), originX);
+        __m128 y = _mm_sub_ps (_mm_loadu_ps (&m_Y[i]), originY);
+        __m128 z = _mm_sub_ps (_mm_loadu_ps (&m_Z[i]), originZ);
+        __m128 distanceSq = _mm_add_ps (_mm_add_ps (_mm_mul_ps (x, x), _mm_mul_ps (y, y)), _mm_mul_ps (z, z));
+        __m128 time = _mm_mul_ps (_mm_sqrt_ps (distanceSq), leadTime);
+        x = _mm_add_ps (x, _mm_mul_ps (_mm_loadu_ps (&m_VelocityX[i]), time));
+        z = _mm_add_ps (z, _mm_mul_ps (_mm_loadu_ps (&m_VelocityZ[i]), time));
+        int inRange = _mm_movemask_ps (_mm_cmple_ps (_mm_add_ps (_mm_mul_ps (x, x), _mm_mul_ps (z, z)), radiusSq));
+        while (inRange) {
+            UINT lane = 0;
+            while (!(inRange & (1 << lane))) {
+                lane++;
+            }
+            _Targets.push_back (i + lane);
+            inRange &= ~(1 << lane);
+        }
+    }
+#endif
+    for (; i < numTargets; i++) {
+        if (IsInRange (_Aim, i)) {
+            _Targets.push_back (i);
+        }
+    }
+    return _Targets.size () - numFound;
+}
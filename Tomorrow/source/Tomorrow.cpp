@@ -2,14 +2,114 @@
 
 #define WINDOW_WIDTH 1024
 #define WINDOW_HEIGHT 768
+#define LOAD_TEST_REPORT "LoadTest.txt"
+#define REPLAY_REPORT "Replay.txt"
+#define JOB_BENCHMARK_REPORT "JobBenchmark.txt"
+#define SELF_TEST_REPORT "SelfTest.txt"
+#define TARGETING_BENCHMARK_REPORT "TargetingBenchmark.txt"
+#define MS3D_BENCHMARK_REPORT "Ms3dBenchmark.txt"
 
 Game* g_Game;
 
 LRESULT CALLBACK WndProc (HWND, UINT, WPARAM, LPARAM);
 
+/* -scenario <file> starts the game with the given scenario,
+   -loadtest <seconds> simulates it without rendering, writes LOAD_TEST_REPORT and quits,
+   -record <file> records the player's commands of a new game, with -hash also the state of every step,
+   -replay <file> plays a recording back, with -headless only simulates it, writes REPLAY_REPORT and quits,
+   -threads <count> sets the number of job threads, 0 for one per processor,
+   -jobbench <seconds> runs the load test with 1 to JOB_MAX_THREADS threads, writes JOB_BENCHMARK_REPORT and quits,
+      with 1 when a number of threads ends in another state than the single thread,
+   -animlod <near> <far> <mid interval> <far interval> sets the enemy animation level of detail, off animates all enemies every frame,
+   -poserate <rate> sets the baked palettes per second of the enemy clips, 0 interpolates the keyframes.
+   Built with TOMORROW_TESTS (the Test configuration) also
+   -targetbench <rounds> times the tower range tests of 500 towers and 2000 enemies, writes TARGETING_BENCHMARK_REPORT and quits,
+   -ms3dbench <loads> times the old and the new decode and the whole load of the scenario's enemy models, writes MS3D_BENCHMARK_REPORT and quits,
+   -selftest runs the CPU checks, writes SELF_TEST_REPORT and quits, with 1 when a check has failed */
+void ReadCommandLine (const char* _cmdLine, char* _scenarioFile, float& _loadTestSeconds,
+                      char* _recordFile, char* _replayFile, bool& _isHashing, bool& _isHeadless,
+                      int& _numThreads, float& _benchmarkSeconds, AnimationLod& _animationLod, float& _poseSampleRate,
+                      bool& _isSelfTest, UINT& _targetingRounds, UINT& _ms3dLoads) {
+    char option[MAX_PATH];
+    int offset = 0;
+    int length = 0;
+    while (sscanf (_cmdLine + offset, "%259s%n", option, &length) == 1) {
+        offset += length;
+        if (strcmp (option, "-scenario") == 0) {
+            if (sscanf (_cmdLine + offset, "%259s%n", _scenarioFile, &length) == 1) {
+                offset += length;
+            }
+        } else if (strcmp (option, "-loadtest") == 0) {
+            if (sscanf (_cmdLine + offset, "%f%n", &_loadTestSeconds, &length) == 1) {
+                offset += length;
+            }
+        } else if (strcmp (option, "-record") == 0 || strcmp (option, "-replay") == 0) {
+            char* file = strcmp (option, "-record") == 0 ? _recordFile : _replayFile;
+            if (sscanf (_cmdLine + offset, "%259s%n", file, &length) == 1) {
+                offset += length;
+            }
+        } else if (strcmp (option, "-threads") == 0) {
+            if (sscanf (_cmdLine + offset, "%d%n", &_numThreads, &length) == 1) {
+                offset += length;
+            }
+        } else if (strcmp (option, "-jobbench") == 0) {
+            if (sscanf (_cmdLine + offset, "%f%n", &_benchmarkSeconds, &length) == 1) {
+                offset += length;
+            }
+        } else if (strcmp (option, "-animlod") == 0) {
+            length = 0;
+            if (sscanf (_cmdLine + offset, "%f %f %u %u%n", &_animationLod.NearDistance, &_animationLod.FarDistance,
+                        &_animationLod.MidInterval, &_animationLod.FarInterval, &length) == 4) {
+                offset += length;
+            } else {
+                sscanf (_cmdLine + offset, " off%n", &length);
+                if (length > 0) {
+                    _animationLod.IsEnabled = false;
+                    offset += length;
+                }
+            }
+        } else if (strcmp (option, "-poserate") == 0) {
+            if (sscanf (_cmdLine + offset, "%f%n", &_poseSampleRate, &length) == 1) {
+                offset += length;
+            }
+        } else if (strcmp (option, "-hash") == 0) {
+            _isHashing = true;
+        } else if (strcmp (option, "-headless") == 0) {
+            _isHeadless = true;
+#ifdef TOMORROW_TESTS
+        } else if (strcmp (option, "-targetbench") == 0) {
+            if (sscanf (_cmdLine + offset, "%u%n", &_targetingRounds, &length) == 1) {
+                offset += length;
+            }
+        } else if (strcmp (option, "-ms3dbench") == 0) {
+            if (sscanf (_cmdLine + offset, "%u%n", &_ms3dLoads, &length) == 1) {
+                offset += length;
+            }
+        } else if (strcmp (option, "-selftest") == 0) {
+            _isSelfTest = true;
+#endif
+        }
+    }
+}
+
 int WINAPI WinMain (HINSTANCE _instance, HINSTANCE _previous, LPSTR _cmdLine, int _show) {
     Window* win = NULL;
     g_Game = NULL;
+    char scenarioFile[MAX_PATH] = "";
+    float loadTestSeconds = 0.0f;
+    char recordFile[MAX_PATH] = "";
+    char replayFile[MAX_PATH] = "";
+    bool isHashing = false;
+    bool isHeadless = false;
+    int numThreads = -1;
+    float benchmarkSeconds = 0.0f;
+    AnimationLod animationLod = {true, ANIMATION_LOD_NEAR, ANIMATION_LOD_FAR, ANIMATION_LOD_MID_INTERVAL, ANIMATION_LOD_FAR_INTERVAL};
+    float poseSampleRate = POSE_SAMPLE_RATE;
+    bool isSelfTest = false;
+    UINT targetingRounds = 0;
+    UINT ms3dLoads = 0;
+    ReadCommandLine (_cmdLine, scenarioFile, loadTestSeconds, recordFile, replayFile, isHashing, isHeadless,
+                     numThreads, benchmarkSeconds, animationLod, poseSampleRate, isSelfTest, targetingRounds, ms3dLoads);
     try {
         win = new Window ();
         if (FAILED(win->Init (_instance, WINDOW_WIDTH, WINDOW_HEIGHT, "Tomorrow"))) {
@@ -19,6 +119,58 @@ int WINAPI WinMain (HINSTANCE _instance, HINSTANCE _previous, LPSTR _cmdLine, in
         }
         g_Game = new Game (win->GetHwnd(), _instance);
         win->SetMsgLoopFunc ((WNDPROC)WndProc);
+        if (scenarioFile[0] != '\0') {
+            g_Game->SetScenario (scenarioFile);
+        }
+        if (numThreads >= 0) {
+            g_Game->SetNumThreads (numThreads);
+        }
+        g_Game->SetAnimationLod (animationLod.IsEnabled, animationLod.NearDistance, animationLod.FarDistance,
+                                 animationLod.MidInterval, animationLod.FarInterval);
+        g_Game->SetPoseSampleRate (poseSampleRate);
+#ifdef TOMORROW_TESTS
+        if (isSelfTest) {
+            UINT numFailed = g_Game->RunSelfTest (SELF_TEST_REPORT);
+            delete g_Game;
+            delete win;
+            return numFailed > 0 ? 1 : 0;
+        }
+        if (targetingRounds > 0) {
+            g_Game->RunTargetingBenchmark (targetingRounds, TARGETING_BENCHMARK_REPORT);
+            delete g_Game;
+            delete win;
+            return 0;
+        }
+        if (ms3dLoads > 0) {
+            g_Game->RunMs3dBenchmark (ms3dLoads, MS3D_BENCHMARK_REPORT);
+            delete g_Game;
+            delete win;
+            return 0;
+        }
+#endif
+        if (benchmarkSeconds > 0.0f) {
+            bool isSameState = g_Game->RunJobBenchmark (benchmarkSeconds, JOB_BENCHMARK_REPORT);
+            delete g_Game;
+            delete win;
+            return isSameState ? 0 : 1;
+        }
+        if (loadTestSeconds > 0.0f) {
+            g_Game->RunLoadTest (loadTestSeconds, LOAD_TEST_REPORT);
+            delete g_Game;
+            delete win;
+            return 0;
+        }
+        if (replayFile[0] != '\0') {
+            if (isHeadless) {
+                g_Game->RunReplay (replayFile, REPLAY_REPORT);
+                delete g_Game;
+                delete win;
+                return 0;
+            }
+            g_Game->StartReplay (replayFile);
+        } else if (recordFile[0] != '\0') {
+            g_Game->StartRecording (recordFile, isHashing);
+        }
         
         MSG msg;
         ZeroMemory (&msg, sizeof (MSG));
@@ -7,152 +7,34 @@ void Game::SetupTowersInfo () {
     material.Emissive = vs3d::COLORVALUE (0.0f, 0.0f, 0.0f, 0.0f);
     material.Specular = vs3d::COLORVALUE (0.0f, 0.0f, 0.0f, 0.0f);
     material.Power = 0.0f;
-    UINT towerSkin = m_Device->GetSkinManager()->AddSkin ("data/obj/basic_tower/tower_texture.jpg", material);
-    TowerInfo basicTower;
-    basicTower.Id = m_ObjManager->Load ("data/obj/basic_tower/Tower1.obj", towerSkin);
-    basicTower.Type = BASIC_TOWER;
-    basicTower.Level = 0;
-    basicTower.Price = 10;
-    basicTower.AttackSpeed = 5.0f;
-    basicTower.Power = 10;
-    basicTower.Radius = 150.0f;
-    basicTower.ShootDelay = 5.0f;
-    basicTower.Gun = NULL;
-    basicTower.Size = 2;
-    basicTower.BuildingTime = 2.0f;
-    basicTower.MaxBuildingTime = 2.0f;
-    strcpy (basicTower.Description, BASIC_TOWER_DESCRIPTION);
-    m_PreparedTowers.push_back (basicTower);
-
-    TowerUpgradeInfo basicTowerUpgrade;
-    basicTowerUpgrade.UpgradeTime[0] = 2.0f;
-    basicTowerUpgrade.UpgradeTime[1] = 4.0f;
-    basicTowerUpgrade.UpgradeTime[2] = 7.0f;
-    basicTowerUpgrade.UpgradeTime[3] = 10.0f;
-    basicTowerUpgrade.UpgradeTime[4] = 12.0f;
-
-    basicTowerUpgrade.AttackSpeedDecrease[0] = 0.2f;
-    basicTowerUpgrade.AttackSpeedDecrease[1] = 0.5f;
-    basicTowerUpgrade.AttackSpeedDecrease[2] = 0.8f;
-    basicTowerUpgrade.AttackSpeedDecrease[3] = 1.0f;
-    basicTowerUpgrade.AttackSpeedDecrease[4] = 1.5f;
-
-    basicTowerUpgrade.PowerIncrease[0] = 1;
-    basicTowerUpgrade.PowerIncrease[1] = 3;
-    basicTowerUpgrade.PowerIncrease[2] = 5;
-    basicTowerUpgrade.PowerIncrease[3] = 7;
-    basicTowerUpgrade.PowerIncrease[4] = 10;
-
-    basicTowerUpgrade.RadiusIncrease[0] = 10.0f;
-    basicTowerUpgrade.RadiusIncrease[1] = 20.0f;
-    basicTowerUpgrade.RadiusIncrease[2] = 30.0f;
-    basicTowerUpgrade.RadiusIncrease[3] = 40.0f;
-    basicTowerUpgrade.RadiusIncrease[4] = 50.0f;
-
-    basicTowerUpgrade.Price[0] = 10;
-    basicTowerUpgrade.Price[1] = 20;
-    basicTowerUpgrade.Price[2] = 40;
-    basicTowerUpgrade.Price[3] = 80;
-    basicTowerUpgrade.Price[4] = 160;
-    m_UpgradeInfo.push_back (basicTowerUpgrade);
-
-    towerSkin = m_Device->GetSkinManager()->AddSkin ("data/obj/slowing_tower/SlowingTowerTexture.jpg", material);
-    TowerInfo slowingTower;
-    slowingTower.Id = m_ObjManager->Load ("data/obj/slowing_tower/SlowingTower.obj", towerSkin);
-    slowingTower.Type = SLOWING_TOWER;
-    slowingTower.Level = 0;
-    slowingTower.Price = 20;
-    slowingTower.AttackSpeed = 10.0f;
-    slowingTower.Power = 0;
-    slowingTower.Radius = 200.0f;
-    slowingTower.ShootDelay = 10.0f;
-    slowingTower.Gun = NULL;
-    slowingTower.Size = 2;
-    slowingTower.BuildingTime = 4.0f;
-    slowingTower.MaxBuildingTime = 4.0f;
-    strcpy (slowingTower.Description, SLOWING_TOWER_DESCRIPTION);
-    m_PreparedTowers.push_back (slowingTower);
-
-    TowerUpgradeInfo slowingTowerUpgrade;
-    slowingTowerUpgrade.UpgradeTime[0] = 4.0f;
-    slowingTowerUpgrade.UpgradeTime[1] = 4.0f;
-    slowingTowerUpgrade.UpgradeTime[2] = 4.0f;
-    slowingTowerUpgrade.UpgradeTime[3] = 4.0f;
-    slowingTowerUpgrade.UpgradeTime[4] = 4.0f;
-
-    slowingTowerUpgrade.AttackSpeedDecrease[0] = 0.0f;
-    slowingTowerUpgrade.AttackSpeedDecrease[1] = 0.0f;
-    slowingTowerUpgrade.AttackSpeedDecrease[2] = 0.0f;
-    slowingTowerUpgrade.AttackSpeedDecrease[3] = 0.0f;
-    slowingTowerUpgrade.AttackSpeedDecrease[4] = 0.0f;
-
-    slowingTowerUpgrade.PowerIncrease[0] = 0;
-    slowingTowerUpgrade.PowerIncrease[1] = 0;
-    slowingTowerUpgrade.PowerIncrease[2] = 0;
-    slowingTowerUpgrade.PowerIncrease[3] = 0;
-    slowingTowerUpgrade.PowerIncrease[4] = 0;
-
-    slowingTowerUpgrade.RadiusIncrease[0] = 10.0f;
-    slowingTowerUpgrade.RadiusIncrease[1] = 20.0f;
-    slowingTowerUpgrade.RadiusIncrease[2] = 40.0f;
-    slowingTowerUpgrade.RadiusIncrease[3] = 60.0f;
-    slowingTowerUpgrade.RadiusIncrease[4] = 80.0f;
-
-    slowingTowerUpgrade.Price[0] = 10;
-    slowingTowerUpgrade.Price[1] = 15;
-    slowingTowerUpgrade.Price[2] = 20;
-    slowingTowerUpgrade.Price[3] = 30;
-    slowingTowerUpgrade.Price[4] = 40;
-    m_UpgradeInfo.push_back (slowingTowerUpgrade);
-
-    towerSkin = m_Device->GetSkinManager()->AddSkin ("data/obj/area_tower/AreaTowerTexture.jpg", material);
-    TowerInfo areaTower;
-    areaTower.Id = m_ObjManager->Load ("data/obj/area_tower/AreaTower.obj", towerSkin);
-    areaTower.Type = AREA_TOWER;
-    areaTower.Level = 0;
-    areaTower.Price = 50;
-    areaTower.AttackSpeed = 5.0f;
-    areaTower.Power = 10;
-    areaTower.Radius = 100.0f;
-    areaTower.ShootDelay = 5.0f;
-    areaTower.Gun = NULL;
-    areaTower.Size = 8;
-    areaTower.BuildingTime = 5.0f;
-    areaTower.MaxBuildingTime = 5.0f;
-    strcpy (areaTower.Description, AREA_TOWER_DESCRIPTION);
-    m_PreparedTowers.push_back (areaTower);
-
-    TowerUpgradeInfo areaTowerUpgrade;
-    areaTowerUpgrade.UpgradeTime[0] = 6.0f;
-    areaTowerUpgrade.UpgradeTime[1] = 10.0f;
-    areaTowerUpgrade.UpgradeTime[2] = 14.0f;
-    areaTowerUpgrade.UpgradeTime[3] = 18.0f;
-    areaTowerUpgrade.UpgradeTime[4] = 20.0f;
-
-    areaTowerUpgrade.AttackSpeedDecrease[0] = 0.2f;
-    areaTowerUpgrade.AttackSpeedDecrease[1] = 0.5f;
-    areaTowerUpgrade.AttackSpeedDecrease[2] = 0.8f;
-    areaTowerUpgrade.AttackSpeedDecrease[3] = 1.0f;
-    areaTowerUpgrade.AttackSpeedDecrease[4] = 1.5f;
-
-    areaTowerUpgrade.PowerIncrease[0] = 1;
-    areaTowerUpgrade.PowerIncrease[1] = 3;
-    areaTowerUpgrade.PowerIncrease[2] = 5;
-    areaTowerUpgrade.PowerIncrease[3] = 7;
-    areaTowerUpgrade.PowerIncrease[4] = 10;
-
-    areaTowerUpgrade.RadiusIncrease[0] = 10.0f;
-    areaTowerUpgrade.RadiusIncrease[1] = 15.0f;
-    areaTowerUpgrade.RadiusIncrease[2] = 20.0f;
-    areaTowerUpgrade.RadiusIncrease[3] = 25.0f;
-    areaTowerUpgrade.RadiusIncrease[4] = 30.0f;
-
-    areaTowerUpgrade.Price[0] = 50;
-    areaTowerUpgrade.Price[1] = 80;
-    areaTowerUpgrade.Price[2] = 140;
-    areaTowerUpgrade.Price[3] = 200;
-    areaTowerUpgrade.Price[4] = 300;
-    m_UpgradeInfo.push_back (areaTowerUpgrade);
+    UINT materialId = m_Device->GetSkinManager()->AddMaterial (material);
+    const char* descriptions[NUM_TOWER_TYPES] = {
+        BASIC_TOWER_DESCRIPTION,
+        SLOWING_TOWER_DESCRIPTION,
+        AREA_TOWER_DESCRIPTION
+    };
+    for (UINT i = 0; i < NUM_TOWER_TYPES; i++) {
+        const TowerDefinition& definition = m_Scenario.GetTower ((TowerType)i);
+        /* loaded with the level, see RequestScenarioAssets */
+        UINT towerSkin = m_Device->GetSkinManager()->AddSkin (m_Assets->GetResult (m_TowerAssets[i * 2]), materialId);
+        TowerInfo tower;
+        tower.Id = m_Assets->GetResult (m_TowerAssets[i * 2 + 1]);
+        m_ObjManager->GetModel (tower.Id)->SetSkinId (towerSkin);
+        tower.Type = (TowerType)i;
+        tower.Level = 0;
+        tower.Price = definition.Price;
+        tower.AttackSpeed = definition.AttackSpeed;
+        tower.Power = definition.Power;
+        tower.Radius = definition.Radius;
+        tower.ShootDelay = definition.AttackSpeed;
+        tower.Gun = NULL;
+        tower.Size = definition.Size;
+        tower.BuildingTime = definition.BuildingTime;
+        tower.MaxBuildingTime = definition.BuildingTime;
+        strcpy (tower.Description, descriptions[i]);
+        m_PreparedTowers.push_back (tower);
+        m_UpgradeInfo.push_back (definition.Upgrade);
+    }
 
     /* Tower ghosts */
     m_TowerGhost.push_back (m_ObjManager->GetModel(m_PreparedTowers[BASIC_TOWER].Id)->MakeCopy());    /* basic tower */
@@ -160,7 +42,33 @@ void Game::SetupTowersInfo () {
     m_TowerGhost.push_back (m_ObjManager->GetModel(m_PreparedTowers[AREA_TOWER].Id)->MakeCopy());    /* area tower */
 }
 
+void Game::PlaceScenarioTowers () {
+    for (UINT i = 0; i < m_Scenario.GetNumPlacements (); i++) {
+        const TowerPlacement& placement = m_Scenario.GetPlacement (i);
+        if (!PlaceTower (placement.Type, placement.Location)) {
+            continue;       /* occupied or not buildable */
+        }
+        UINT towerId = m_Towers.size () - 1;
+        m_Towers[towerId].Level = 0;
+        for (UINT j = 0; j < placement.Level; j++) {
+            ApplyTowerUpgrade (towerId);
+        }
+        m_Towers[towerId].BuildingTime = 0.0f;
+        UpdateTowerAim (towerId);
+        BuildTowerRangeOutline (towerId);
+    }
+}
+
 bool Game::CreateTower (TowerType _type, POINT _point) {
+    if (!PlaceTower (_type, _point)) {
+        m_GameUI->ShowMessage ("Tower cannot be placed here.", 0xffff0000, 3.0f);
+        return false;
+    }
+    m_Audio->Play3D (m_AudioBankId, "Tower", GetTowerPosition (_point), VECTOR3 (0.0f, 0.0f, 1.0f), VECTOR3 (0.0f, 1.0f, 0.0f));
+    return true;
+}
+
+bool Game::PlaceTower (TowerType _type, POINT _point) {
     bool isThereSpace = true;
     int halfSize = m_PreparedTowers[_type].Size / 2;
     int terrainSize = m_Terrain->GetTerrain()->GetSize ();
@@ -184,28 +92,8 @@ bool Game::CreateTower (TowerType _type, POINT _point) {
         }
     }
     if (isThereSpace) {
-        UINT tower = m_ObjManager->GetModel(m_PreparedTowers[_type].Id)->MakeCopy();
-        switch (_type) {
-            case BASIC_TOWER:
-                m_ObjManager->GetModel(tower)->Scale(10.0f);
-                break;
-            case SLOWING_TOWER:
-                m_ObjManager->GetModel(tower)->Scale(20.0f);
-                break;
-            case AREA_TOWER:
-                m_ObjManager->GetModel(tower)->Scale(20.0f);
-                break;
-        }
-        float x = _point.x * m_Terrain->GetTerrain()->GetScale(0);
-        float y = m_Terrain->GetTerrain()->GetScaledHeight(_point.x, _point.y);
-        float z = _point.y * m_Terrain->GetTerrain()->GetScale(2);
-        m_GameUI->UpdateTowerMark (tower, VECTOR3 (x, y, z));
-        m_ObjManager->GetModel(tower)->TranslateX (x);
-        m_ObjManager->GetModel(tower)->TranslateY (y);
-        m_ObjManager->GetModel(tower)->TranslateZ (z);
-        m_ObjManager->GetModel(tower)->Prepare ();
+        VECTOR3 position = GetTowerPosition (_point);
         TowerInfo info;
-        info.Id = tower;
         info.Type = _type;
         info.Level = MAX_TOWER_LEVEL + 1;
         info.Location = _point;
@@ -213,28 +101,13 @@ bool Game::CreateTower (TowerType _type, POINT _point) {
         info.Power = m_PreparedTowers[_type].Power;
         info.Radius = m_PreparedTowers[_type].Radius;
         info.ShootDelay = m_PreparedTowers[_type].ShootDelay;
-        info.Gun = new Bullet (3.0f, 3.0f);
-        info.Gun->Init (m_Device, NULL);
-        switch (_type) {
-            case BASIC_TOWER:
-                info.Gun->SetColor (0xff888888);
-                break;
-            case SLOWING_TOWER:
-                info.Gun->SetColor (0xff0000ff);
-                break;
-            case AREA_TOWER:
-                info.Gun->SetColor (0xffaaaaaa);
-                break;
-        }
-        info.Gun->SetMaxRange (info.Radius);
-        info.Gun->SetMaxTime (0.5f);
-        for (UINT i = 0; i < 1; i++) {
-            info.Gun->AddParticle();
-        }
         info.Size = m_PreparedTowers[_type].Size;
         info.BuildingTime = m_PreparedTowers[_type].BuildingTime;
         info.MaxBuildingTime = m_PreparedTowers[_type].MaxBuildingTime;
+        AttachTowerResources (info, position);
         m_Towers.push_back (info);
+        UpdateTowerAim (m_Towers.size () - 1);
+        BuildTowerRangeOutline (m_Towers.size () - 1);
         int halfSize = info.Size / 2;
         for (int i = -halfSize; i <= halfSize; i++) {
             for (int j = -halfSize; j <= halfSize; j++) {
@@ -245,84 +118,162 @@ bool Game::CreateTower (TowerType _type, POINT _point) {
                 }
             }
         }
-        m_Audio->Play3D (m_AudioBankId, "Tower", VECTOR3 (x, y, z), VECTOR3 (0.0f, 0.0f, 1.0f), VECTOR3 (0.0f, 1.0f, 0.0f));
-        return true;
-    } else {
-        m_GameUI->ShowMessage ("Tower cannot be placed here.", 0xffff0000, 3.0f);
     }
-    return false;
+    return isThereSpace;
+}
+
+VECTOR3 Game::GetTowerPosition (POINT _point) {
+    return VECTOR3 (
+        _point.x * m_Terrain->GetTerrain()->GetScale(0),
+        m_Terrain->GetTerrain()->GetScaledHeight(_point.x, _point.y),
+        _point.y * m_Terrain->GetTerrain()->GetScale(2));
+}
+
+/* Model copy, gun and map mark of a tower whose stats are already set */
+void Game::AttachTowerResources (TowerInfo& _tower, const VECTOR3& _position) {
+    UINT tower = m_ObjManager->GetModel(m_PreparedTowers[_tower.Type].Id)->MakeCopy();
+    switch (_tower.Type) {
+        case BASIC_TOWER:
+            m_ObjManager->GetModel(tower)->Scale(10.0f);
+            break;
+        case SLOWING_TOWER:
+            m_ObjManager->GetModel(tower)->Scale(20.0f);
+            break;
+        case AREA_TOWER:
+            m_ObjManager->GetModel(tower)->Scale(20.0f);
+            break;
+    }
+    m_ObjManager->GetModel(tower)->TranslateX (_position[0]);
+    m_ObjManager->GetModel(tower)->TranslateY (_position[1]);
+    m_ObjManager->GetModel(tower)->TranslateZ (_position[2]);
+    m_ObjManager->GetModel(tower)->Prepare ();
+    _tower.Id = tower;
+    _tower.MapMark = m_GameUI->AddTowerMark (_position);
+    _tower.Gun = new Bullet (3.0f, 3.0f);
+    _tower.Gun->Init (m_Device, NULL);
+    switch (_tower.Type) {
+        case BASIC_TOWER:
+            _tower.Gun->SetColor (0xff888888);
+            break;
+        case SLOWING_TOWER:
+            _tower.Gun->SetColor (0xff0000ff);
+            break;
+        case AREA_TOWER:
+            _tower.Gun->SetColor (0xffaaaaaa);
+            break;
+    }
+    _tower.Gun->SetMaxRange (m_PreparedTowers[_tower.Type].Radius);
+    _tower.Gun->SetMaxTime (0.5f);
+    for (UINT i = 0; i < 1; i++) {
+        _tower.Gun->AddParticle();
+    }
 }
 
 void Game::RenderTowerRange (float _x, float _y, float _z, float _range) {
-    vs3d::ULCVERTEX data[31];
-    UINT numData = 0;
-    WORD index[30 * 3];
-    UINT numIndices = 0;
-        
-    for (UINT i = 0; i < 30; i++) {
-        float angle = i * 2 * (float)M_PI / 30.0f;
-        data[numData].Color = 0x330000ff;
-        data[numData].X = _x + (cosf(angle) * _range);
-        data[numData].Y = _y;
-        data[numData].Z = _z + (sinf(angle) * _range);
-        if (i > 0) {
-            index[numIndices++] = numData - 1;
-            index[numIndices++] = 30;   // center vertex
-            index[numIndices++] = numData;
-        }
-        numData++;
-    }
-    data[numData].Color = 0x330000ff;
-    data[numData].X = _x;
-    data[numData].Y = _y;
-    data[numData].Z = _z;
-    numData++;
-    index[numIndices++] = index[numIndices-1];
-    index[numIndices++] = 30;
-    index[numIndices++] = index[0];
     m_Device->SetAlphaBlendState (AS_SRCBLEND, BLEND_SRCALPHA);
     m_Device->SetAlphaBlendState (AS_DESTBLEND, BLEND_INVSRCALPHA);
     m_Device->EnableAlphaBlend ();
-    m_Device->GetVCacheManager()->Render(PT_TRIANGLELIST, data, numData, index, numIndices, VFT_ULC, INVALID_ID);
+    m_RingMeshes->RenderCircle (VECTOR3 (_x, _y, _z), _range, TOWER_RANGE_SEGMENTS, TOWER_RANGE_COLOR);
+    m_Device->DisableAlphaBlend ();
+}
+
+void Game::BuildTowerRangeOutline (UINT _towerId) {
+    TowerInfo& tower = m_Towers[_towerId];
+    float scaleX = m_Terrain->GetTerrain()->GetScale(0);
+    float scaleZ = m_Terrain->GetTerrain()->GetScale(2);
+    float maxX = (m_Terrain->GetTerrain()->GetSize () - 1) * scaleX - 0.01f;
+    float maxZ = (m_Terrain->GetTerrain()->GetSize () - 1) * scaleZ - 0.01f;
+    VECTOR3 center (tower.Location.x * scaleX, 0.0f, tower.Location.y * scaleZ);
+    center[1] = m_HeightField.GetGridHeight (tower.Location.x, tower.Location.y) + 0.01f;
+    m_RingMeshes->BuildCircle (center, tower.Radius, TOWER_RANGE_SEGMENTS, TOWER_RANGE_COLOR, tower.RangeOutline);
+    UINT numPoints = tower.RangeOutline.size () - 1;
+    float x[TOWER_RANGE_SEGMENTS], z[TOWER_RANGE_SEGMENTS], height[TOWER_RANGE_SEGMENTS];
+    for (UINT i = 0; i < numPoints; i++) {
+        vs3d::ULCVERTEX& vertex = tower.RangeOutline[i + 1];
+        /* keep the outline inside the terrain */
+        vertex.X = vertex.X < 0.0f ? 0.0f : (vertex.X > maxX ? maxX : vertex.X);
+        vertex.Z = vertex.Z < 0.0f ? 0.0f : (vertex.Z > maxZ ? maxZ : vertex.Z);
+        x[i] = vertex.X;
+        z[i] = vertex.Z;
+    }
+    m_HeightField.GetHeights (x, z, height, numPoints);
+    for (UINT i = 0; i < numPoints; i++) {
+        tower.RangeOutline[i + 1].Y = height[i] + 0.5f;
+    }
+}
+
+void Game::RenderTowerRangeOutline (UINT _towerId) {
+    m_Device->SetAlphaBlendState (AS_SRCBLEND, BLEND_SRCALPHA);
+    m_Device->SetAlphaBlendState (AS_DESTBLEND, BLEND_INVSRCALPHA);
+    m_Device->EnableAlphaBlend ();
+    m_RingMeshes->RenderVertices (m_Towers[_towerId].RangeOutline);
     m_Device->DisableAlphaBlend ();
 }
 
 void Game::RenderTowerGhost (TowerType _type) {
+    m_IsTowerGhostPlaced = false;
     POINT mouse;
     GetCursorPos (&mouse);
     if (!m_GameUI->IsCursorOnHood(mouse)) {
         POINT location;
         if (IsTerrainClicked (location)) {
-            m_ObjManager->GetModel(m_TowerGhost[_type])->ClearTransformations();
+            ObjModel* ghost = m_ObjManager->GetModel(m_TowerGhost[_type]);
+            ghost->ClearTransformations();
             switch (_type) {
                 case BASIC_TOWER:
-                    m_ObjManager->GetModel(m_TowerGhost[_type])->Scale(10.0f);
+                    ghost->Scale(10.0f);
                     break;
                 case SLOWING_TOWER:
                 case AREA_TOWER:
-                    m_ObjManager->GetModel(m_TowerGhost[_type])->Scale(20.0f);
+                    ghost->Scale(20.0f);
                     break;
             }
             float x = location.x * m_Terrain->GetTerrain()->GetScale(0);
             float y = m_Terrain->GetTerrain()->GetScaledHeight(location.x, location.y);
             float z = location.y * m_Terrain->GetTerrain()->GetScale(2);
-            m_ObjManager->GetModel(m_TowerGhost[_type])->TranslateX(x);
-            m_ObjManager->GetModel(m_TowerGhost[_type])->TranslateY(y);
-            m_ObjManager->GetModel(m_TowerGhost[_type])->TranslateZ(z);            
+            ghost->TranslateX(x);
+            ghost->TranslateY(y);
+            ghost->TranslateZ(z);            
             /*m_Device->SetTextureStageState (0, TSS_ALPHAARG1, TA_DIFFUSE);
             m_Device->SetTextureStageState (0, TSS_ALPHAOP, TOP_SELECTARG1);
             m_Device->SetAlphaBlendState (AS_SRCBLEND, BLEND_SRCALPHA);
             m_Device->SetAlphaBlendState (AS_DESTBLEND, BLEND_INVSRCALPHA);*/
             //m_Device->EnableAlphaBlend ();
-            m_ObjManager->GetModel(m_TowerGhost[_type])->RenderDynamic();
-            
-            RenderTowerRange(x, y + 0.01f, z, m_PreparedTowers[_type].Radius);
+            /* following the cursor only moves the world matrix of the ghost */
+            MATRIX44 world = m_Device->GetWorldMatrix();
+            SetObjectEffectWorld (ghost->GetTransformation() * world);
+            ghost->RenderTransformed();
+            SetObjectEffectWorld (world);
+
+            /* the range is drawn after the effects are disabled, the effect ignores the world matrix */
+            m_TowerGhostPosition = VECTOR3 (x, y + 0.01f, z);
+            m_IsTowerGhostPlaced = true;
             //m_Device->DisableAlphaBlend ();
         }
     }
 }
 
+/* Shooting delays and target searches of the towers are independent of
+   each other and run in ranges on the job threads; the shots, which change
+   the enemies, follow in tower order. */
+class AimTowersTask : public JobTask {
+public:
+    AimTowersTask (Game* _game, float _delta) {
+        m_Game = _game;
+        m_Delta = _delta;
+    }
+    virtual void Run (UINT _begin, UINT _end) {
+        m_Game->AimTowers (_begin, _end, m_Delta);
+    }
+private:
+    Game* m_Game;
+    float m_Delta;
+};
+
 void Game::UpdateTowers (float _delta) {
+    PackTargets ();
+    AimTowersTask task (this, _delta);
+    m_Jobs.ParallelFor (task, m_Towers.size (), JOB_TOWER_GRAIN);
     for (UINT i = 0; i < m_Towers.size(); i++) {
         if (m_Towers[i].BuildingTime <= 0.0f) {
             UpdateTowerShooting (i, _delta);
@@ -333,16 +284,16 @@ void Game::UpdateTowers (float _delta) {
                     gun = m_Towers[i].GunInfo.erase (gun);
                 } else {
                     if (!gun->IsShootingUpdated) {
-                        gun->ShootingTime -= _delta * m_SpeedUpFactor;
+                        gun->ShootingTime -= _delta;
                     }
                     if (!gun->IsShootingUpdated && gun->ShootingTime <= 0.0f) {
                         if (gun->Target->HitPoints > 0) {
-                            m_Audio->Play3D (
-                                m_AudioBankId, 
-                                "Grunt", 
-                                gun->Target->Position, 
-                                m_Waypoints[gun->Target->ActiveWaypoint].Direction, 
-                                VECTOR3 (0.0f, 1.0f, 0.0f));
+                            GameEvent hit;
+                            hit.TowerId = i;
+                            hit.SoundId = INVALID_ID;
+                            hit.Position = gun->Target->Position;
+                            hit.Target = m_Waypoints[gun->Target->ActiveWaypoint].Direction;
+                            m_Events.Add (EVENT_HIT, hit);
                         }
                         gun->Target->HitPoints -= m_Towers[i].Power;
                         gun->IsShootingUpdated = true;
@@ -358,8 +309,12 @@ void Game::UpdateTowers (float _delta) {
                         if (gun->Target->NumAttackers == 0 && gun->Target->NumSlowedDown == 0) {
                             m_Resource.NumResources += gun->Target->NumResources;
                             m_Score += gun->Target->NumResources;
-                            m_GameUI->UpdateNumResources (m_Resource.NumResources);
-                            m_Audio->Stop (gun->Target->SoundId);
+                            GameEvent death;
+                            death.TowerId = i;
+                            death.SoundId = gun->Target->SoundId;
+                            death.Position = gun->Target->Position;
+                            death.Target = gun->Target->Position;
+                            m_Events.Add (EVENT_DEATH, death);
                             gun->Target->IsDead = true;
                             gun->Target->AnimationSpeed = 1.0f;
                             gun->Target->CurrentAnimation = "Die";
@@ -382,6 +337,30 @@ void Game::UpdateTowers (float _delta) {
     }
 }
 
+void Game::UpdateTowerBuilding (float _delta) {
+    for (UINT i = 0; i < m_Towers.size(); i++) {
+        if (m_Towers[i].BuildingTime > 0.0f) {
+            m_Towers[i].BuildingTime -= _delta;
+            if (m_Towers[i].BuildingTime <= 0.0f) {
+                if (m_Towers[i].Level < MAX_TOWER_LEVEL) {
+                    MakeTowerUpgrade (i);
+                } else {
+                    m_Towers[i].Level = 0;
+                }
+                if (m_SelectedTowerId == i) {
+                    ShowUpgradeInfo (i);
+                    if (m_Towers[i].Level < MAX_TOWER_LEVEL && m_Towers[i].BuildingTime <= 0.0f) {
+                        m_GameUI->EnableUpgradeButton ();
+                    }
+                }
+            }
+        }
+        if (!m_Towers[i].Gun->IsEmpty()) {
+            m_Towers[i].Gun->Update (_delta);
+        }
+    }
+}
+
 void Game::RenderBuildingTime (UINT _towerId) {
     float timeLeft = m_Towers[_towerId].BuildingTime / m_Towers[_towerId].MaxBuildingTime;
 
@@ -393,47 +372,22 @@ void Game::RenderBuildingTime (UINT _towerId) {
     VECTOR3 forward (view(0, 2), view(1, 2), view(2, 2));
     forward = forward.normalize();
 
-    vs3d::ULCVERTEX timer[31];
-    UINT numVertices = 0;
-    WORD index[30 * 3];
-    UINT numIndices = 0;
-
     float min[3], max[3];
     m_ObjManager->GetModel(m_Towers[_towerId].Id)->GetBounds (min, max);
     float x = m_Towers[_towerId].Location.x * m_Terrain->GetTerrain()->GetScale (0);
     float y = max[1];
     float z = m_Towers[_towerId].Location.y * m_Terrain->GetTerrain()->GetScale (2);
 
-    /* center */
-    VECTOR3 position (x, y, z);
-    VECTOR3 location = position + right + up + forward;
-    timer[numVertices].Color = 0xff0000ff;
-    timer[numVertices].X = x;
-    timer[numVertices].Y = y;
-    timer[numVertices].Z = z;
-    numVertices++;
-    for (UINT i = 0; i < (UINT)(30 * timeLeft); i++) {
-        float angle = i * 2 * (float)M_PI / 30.0f;
-        location = position + (cosf(angle) * 10.0f) * right + (sinf(angle) * 10.0f) * up + forward;
-        timer[numVertices].Color = 0xff0000ff;
-        timer[numVertices].X = location[0];
-        timer[numVertices].Y = location[1];
-        timer[numVertices].Z = location[2];
-        if (i > 0) {
-            index[numIndices++] = numVertices - 1;
-            index[numIndices++] = 0;   // center vertex
-            index[numIndices++] = numVertices;
-        }
-        numVertices++;
-    }
-    m_Device->GetVCacheManager()->Render(PT_TRIANGLELIST, timer, numVertices, index, numIndices, VFT_ULC, INVALID_ID);
+    m_RingMeshes->RenderArc (VECTOR3 (x, y, z) + forward, right, up, 10.0f, timeLeft, TOWER_RANGE_SEGMENTS, 0xff0000ff);
 }
 
 void Game::RenderTowers (bool _isRenderingShadowMap, bool _isRenderingInactive) {
     for (UINT i = 0; i < m_Towers.size(); i++) {
         bool shouldRender = true;
         bool isInactive = false;
-        if (!_isRenderingShadowMap) {
+        if (_isRenderingShadowMap) {
+            shouldRender = IsObjectVisible (m_ShadowMapFrustum, m_Towers[i].Id);
+        } else {
             shouldRender = m_Terrain->GetTerrain()->IsPointVisible(m_Towers[i].Location.x, m_Towers[i].Location.y);
             isInactive = m_Towers[i].BuildingTime > 0.0f;
             if (_isRenderingInactive) {
@@ -453,6 +407,13 @@ void Game::RenderTowers (bool _isRenderingShadowMap, bool _isRenderingInactive)
 }
 
 void Game::MakeTowerUpgrade (UINT _towerId) {
+    ApplyTowerUpgrade (_towerId);
+    UpdateTowerAim (_towerId);
+    BuildTowerRangeOutline (_towerId);
+    m_GameUI->ShowMessage ("Upgraded successfully", 0xff00ff00, 3.0f);
+}
+
+void Game::ApplyTowerUpgrade (UINT _towerId) {
     UINT lvl = m_Towers[_towerId].Level;
     UINT type = m_Towers[_towerId].Type;
     m_Towers[_towerId].Radius += m_UpgradeInfo[type].RadiusIncrease[lvl];
@@ -460,70 +421,175 @@ void Game::MakeTowerUpgrade (UINT _towerId) {
     m_Towers[_towerId].ShootDelay = m_Towers[_towerId].AttackSpeed;
     m_Towers[_towerId].Power += m_UpgradeInfo[type].PowerIncrease[lvl];
     m_Towers[_towerId].Level++;
-    m_GameUI->ShowMessage ("Upgraded successfully", 0xff00ff00, 3.0f);
 }
 
-float Game::GetDistanceTime (UINT _towerId, const VECTOR3& _origin, const VECTOR3& _destination) {
-    float x = _origin[0] - _destination[0];
-    float y = _origin[1] - _destination[1];
-    float z = _origin[2] - _destination[2];
-    float length = sqrtf (x * x + y * y + z * z);
-    return length / m_Towers[_towerId].Radius * m_Towers[_towerId].Gun->GetMaxTime ();
+void Game::UpdateTowerAim (UINT _towerId) {
+    TowerInfo& tower = m_Towers[_towerId];
+    VECTOR3 origin (
+        tower.Location.x * m_Terrain->GetTerrain()->GetScale(0),
+        m_HeightField.GetGridHeight (tower.Location.x, tower.Location.y) + 5.0f,
+        tower.Location.y * m_Terrain->GetTerrain()->GetScale(2));
+    tower.Aim = TargetingKernel::MakeAim (origin, tower.Radius, tower.Gun->GetMaxTime ());
 }
 
-bool Game::IsEnemyInTowerRange (float _TowerX, float _TowerY, UINT _TowerId, std::list<EnemyInfo>::iterator _Enemy, VECTOR3& _NextPosition) {
-    if (_Enemy->IsDead) {
+void Game::PackTargets () {
+    m_Targets.Clear ();
+    m_TargetEnemies.clear ();
+    std::list<EnemyInfo>::iterator i;
+    for (i = m_Enemies.begin(); i != m_Enemies.end(); i++) {
+        if (i->IsDead) {
+            i->TargetIndex = INVALID_ID;
+            continue;
+        }
+        VECTOR3 velocity = m_Path.GetDirection (i->ActiveWaypoint) * (i->Speed * i->SlowDownFactor);
+        i->TargetIndex = m_Targets.AddTarget (i->Position, velocity);
+        m_TargetEnemies.push_back (i);
+    }
+}
+
+#ifdef TOMORROW_TESTS
+/* The range test the targeting kernel replaced, a tower and an enemy at a time */
+static bool IsInRangePerPair (const VECTOR3& _Origin, float _Radius, float _FlightTime, const VECTOR3& _Position, const VECTOR3& _Velocity) {
+    VECTOR3 distance = _Position - _Origin;
+    float time = distance.length () / _Radius * _FlightTime;
+    float x = distance[0] + _Velocity[0] * time;
+    float z = distance[2] + _Velocity[2] * time;
+    return sqrtf (x * x + z * z) <= _Radius;
+}
+
+void Game::RunTargetingBenchmark (UINT _Rounds, const char* _ReportFile) {
+    FILE* report = fopen (_ReportFile, "w");
+    if (!report) {
+        THROW_DETAILED_ERROR (ERRC_FILE_NOT_FOUND, _ReportFile);
+    }
+    const UINT NUM_TOWERS = 500;
+    const UINT NUM_ENEMIES = 2000;
+    const float MAP_SIZE = 4000.0f;
+    const float FLIGHT_TIME = 0.5f;
+    /* a fixed pseudo random map, the same every run */
+    UINT seed = 12345;
+    std::vector<VECTOR3> origins (NUM_TOWERS);
+    std::vector<float> radii (NUM_TOWERS);
+    std::vector<TowerAim> aims (NUM_TOWERS);
+    for (UINT i = 0; i < NUM_TOWERS; i++) {
+        seed = seed * 1664525 + 1013904223;
+        float x = (seed >> 8) * (MAP_SIZE / (1 << 24));
+        seed = seed * 1664525 + 1013904223;
+        float z = (seed >> 8) * (MAP_SIZE / (1 << 24));
+        origins[i] = VECTOR3 (x, 200.0f, z);
+        radii[i] = 150.0f + (i % 4) * 50.0f;
+        aims[i] = TargetingKernel::MakeAim (origins[i], radii[i], FLIGHT_TIME);
+    }
+    std::vector<VECTOR3> positions (NUM_ENEMIES);
+    std::vector<VECTOR3> velocities (NUM_ENEMIES);
+    TargetingKernel targets;
+    targets.Reserve (NUM_ENEMIES);
+    for (UINT i = 0; i < NUM_ENEMIES; i++) {
+        seed = seed * 1664525 + 1013904223;
+        float x = (seed >> 8) * (MAP_SIZE / (1 << 24));
+        seed = seed * 1664525 + 1013904223;
+        float z = (seed >> 8) * (MAP_SIZE / (1 << 24));
+        float angle = i * 0.7f;
+        positions[i] = VECTOR3 (x, 180.0f, z);
+        velocities[i] = VECTOR3 (cosf (angle), 0.0f, sinf (angle)) * 40.0f;
+        targets.AddTarget (positions[i], velocities[i]);
+    }
+    std::vector<UINT> candidates;
+    candidates.reserve (NUM_ENEMIES);
+    FpsCounter timer;
+    UINT numPerPairHits = 0;
+    timer.StartCounter ();
+    for (UINT round = 0; round < _Rounds; round++) {
+        for (UINT i = 0; i < NUM_TOWERS; i++) {
+            for (UINT j = 0; j < NUM_ENEMIES; j++) {
+                if (IsInRangePerPair (origins[i], radii[i], FLIGHT_TIME, positions[j], velocities[j])) {
+                    numPerPairHits++;
+                }
+            }
+        }
+    }
+    timer.EndCounter ();
+    double perPairTime = (double)timer.GetTimeDelta ();
+    UINT numKernelHits = 0;
+    timer.StartCounter ();
+    for (UINT round = 0; round < _Rounds; round++) {
+        for (UINT i = 0; i < NUM_TOWERS; i++) {
+            candidates.clear ();
+            numKernelHits += targets.FindTargets (aims[i], candidates);
+        }
+    }
+    timer.EndCounter ();
+    double kernelTime = (double)timer.GetTimeDelta ();
+    fprintf (report, "towers %u enemies %u rounds %u\n", NUM_TOWERS, NUM_ENEMIES, _Rounds);
+    fprintf (report, "per pair %f ms per round hits %u\n",
+        _Rounds > 0 ? perPairTime * 1000.0 / _Rounds : 0.0, numPerPairHits);
+    fprintf (report, "kernel   %f ms per round hits %u speed-up %.2f\n",
+        _Rounds > 0 ? kernelTime * 1000.0 / _Rounds : 0.0, numKernelHits,
+        kernelTime > 0.0 ? perPairTime / kernelTime : 0.0);
+    fclose (report);
+}
+#endif
+
+bool Game::IsEnemyInTowerRange (UINT _TowerId, std::list<EnemyInfo>::iterator _Enemy) {
+    if (_Enemy->IsDead || _Enemy->TargetIndex == INVALID_ID) {
         return false;
     }
-    float height = m_Terrain->GetTerrain()->GetScaledHeight(m_Towers[_TowerId].Location.x, m_Towers[_TowerId].Location.y);
-    VECTOR3 origin (_TowerX, height + 5.0f, _TowerY);
-    _NextPosition = _Enemy->Position + m_Waypoints[_Enemy->ActiveWaypoint].Direction * _Enemy->Speed * _Enemy->SlowDownFactor * m_SpeedUpFactor * GetDistanceTime(_TowerId, origin, _Enemy->Position);
-    float enemyX = _NextPosition[0];
-    float enemyY = _NextPosition[2];
-    float x = _TowerX - enemyX;
-    float y = _TowerY - enemyY;
-    return (sqrt(x * x + y * y) <= m_Towers[_TowerId].Radius);
+    return m_Targets.IsInRange (m_Towers[_TowerId].Aim, _Enemy->TargetIndex);
+}
+
+UINT Game::FindTowerTargets (UINT _TowerId) {
+    m_Towers[_TowerId].Candidates.clear ();
+    return m_Targets.FindTargets (m_Towers[_TowerId].Aim, m_Towers[_TowerId].Candidates);
+}
+
+VECTOR3 Game::GetLeadPosition (UINT _TowerId, std::list<EnemyInfo>::iterator _Enemy) {
+    /* lead the target along the path, so shots are not wasted at the corners */
+    const TowerAim& aim = m_Towers[_TowerId].Aim;
+    float flightTime = (_Enemy->Position - aim.Origin).length () * aim.LeadTime;
+    float pathDistance = _Enemy->PathDistance + _Enemy->Speed * _Enemy->SlowDownFactor * flightTime;
+    return m_Path.GetPosition (pathDistance < m_Path.GetLength () ? pathDistance : m_Path.GetLength ());
 }
 
 void Game::TowerShoot (float _TowerX, float _TowerY, UINT _TowerId, std::list<EnemyInfo>::iterator _Enemy, const VECTOR3& _NextPosition) {
-    float height = m_Terrain->GetTerrain()->GetScaledHeight(m_Towers[_TowerId].Location.x, m_Towers[_TowerId].Location.y);
+    float height = m_HeightField.GetGridHeight (m_Towers[_TowerId].Location.x, m_Towers[_TowerId].Location.y);
     VECTOR3 origin (_TowerX, height + 55.0f, _TowerY);
     VECTOR3 destination = _NextPosition;
     destination[1] += 35.0f;
-    m_Towers[_TowerId].Gun->SetPosition (origin, destination);
-    for (UINT i = 0; i < 1; i++) {
-        m_Towers[_TowerId].Gun->AddParticle();
-    }
     TowerGunInfo gun;
     gun.IsTargetAcquired = true;
-    gun.ShootingTime = m_Towers[_TowerId].Gun->GetLifeTime();
+    gun.ShootingTime = m_Towers[_TowerId].Gun->GetFlightTime (origin, destination);
     gun.IsShootingUpdated = false;
     gun.Target = _Enemy;
     m_Towers[_TowerId].GunInfo.push_back (gun);
-    m_Towers[_TowerId].SoundId = m_Audio->Play3D (m_AudioBankId, "Shot", origin, VECTOR3 (0.0f, 0.0f, 1.0f), VECTOR3 (0.0f, 1.0f, 0.0f));
+    GameEvent shot;
+    shot.TowerId = _TowerId;
+    shot.SoundId = INVALID_ID;
+    shot.Position = origin;
+    shot.Target = destination;
+    m_Events.Add (EVENT_SHOT, shot);    /* particle and sound follow after the step */
 }
 
 void Game::UpdateBasicTowerShooting (float _towerX, float _towerY, UINT _towerId, float _delta) {
-    VECTOR3 nextPosition;
     std::list<TowerGunInfo>::iterator towerGun;
     towerGun = m_Towers[_towerId].GunInfo.begin();
     if (towerGun != m_Towers[_towerId].GunInfo.end () &&
         towerGun->IsTargetAcquired &&
-        IsEnemyInTowerRange (_towerX, _towerY, _towerId, towerGun->Target, nextPosition)) {
-            TowerShoot (_towerX, _towerY, _towerId, towerGun->Target, nextPosition);
+        IsEnemyInTowerRange (_towerId, towerGun->Target)) {
+            TowerShoot (_towerX, _towerY, _towerId, towerGun->Target, GetLeadPosition (_towerId, towerGun->Target));
             m_Towers[_towerId].GunInfo.pop_front (); /* Remove the old one because a new one was added. */
-            m_Towers[_towerId].ShootDelay -= _delta * m_SpeedUpFactor;
+            m_Towers[_towerId].ShootDelay -= _delta;
     } else {
         if (towerGun != m_Towers[_towerId].GunInfo.end () && towerGun->IsTargetAcquired) {
             towerGun->Target->NumAttackers--;
             m_Towers[_towerId].GunInfo.erase (towerGun);
         }
-        std::list<EnemyInfo>::iterator i;
-        for (i = m_Enemies.begin(); i != m_Enemies.end(); i++) {
-            if (IsEnemyInTowerRange (_towerX, _towerY, _towerId, i, nextPosition)) {
-                TowerShoot (_towerX, _towerY, _towerId, i, nextPosition);
-                i->NumAttackers++;
-                m_Towers[_towerId].ShootDelay -= _delta * m_SpeedUpFactor;
+        const std::vector<UINT>& candidates = m_Towers[_towerId].Candidates;
+        for (UINT i = 0; i < candidates.size (); i++) {
+            std::list<EnemyInfo>::iterator enemy = m_TargetEnemies[candidates[i]];
+            if (!enemy->IsDead) {   /* may have been killed by another tower in this step */
+                TowerShoot (_towerX, _towerY, _towerId, enemy, GetLeadPosition (_towerId, enemy));
+                enemy->NumAttackers++;
+                m_Towers[_towerId].ShootDelay -= _delta;
                 break;
             }
         }
@@ -531,8 +597,6 @@ void Game::UpdateBasicTowerShooting (float _towerX, float _towerY, UINT _towerId
 }
 
 void Game::UpdateSlowingTowerShooting (float _towerX, float _towerY, UINT _towerId, float _delta) {
-    VECTOR3 nextPosition;
-    std::list<EnemyInfo>::iterator i;
     std::list<TowerGunInfo>::iterator towerGun;
     towerGun = m_Towers[_towerId].GunInfo.begin();
     while (towerGun != m_Towers[_towerId].GunInfo.end()) {
@@ -543,46 +607,62 @@ void Game::UpdateSlowingTowerShooting (float _towerX, float _towerY, UINT _tower
         }
         towerGun = m_Towers[_towerId].GunInfo.erase (towerGun);
     }
-    for (i = m_Enemies.begin(); i != m_Enemies.end(); i++) {
-        if (IsEnemyInTowerRange (_towerX, _towerY, _towerId, i, nextPosition)) {
-            TowerShoot (_towerX, _towerY, _towerId, i, nextPosition);
-            i->NumSlowedDown++;
-            i->SlowDownFactor = 0.5f;
-            i->AnimationSpeed = 0.5f;
+    const std::vector<UINT>& candidates = m_Towers[_towerId].Candidates;
+    for (UINT i = 0; i < candidates.size (); i++) {
+        std::list<EnemyInfo>::iterator enemy = m_TargetEnemies[candidates[i]];
+        if (!enemy->IsDead) {
+            TowerShoot (_towerX, _towerY, _towerId, enemy, GetLeadPosition (_towerId, enemy));
+            enemy->NumSlowedDown++;
+            enemy->SlowDownFactor = 0.5f;
+            enemy->AnimationSpeed = 0.5f;
         }
     }
-    m_Towers[_towerId].ShootDelay -= _delta * m_SpeedUpFactor;
+    m_Towers[_towerId].ShootDelay -= _delta;
 }
 
 void Game::UpdateAreaTowerShooting (float _towerX, float _towerY, UINT _towerId, float _delta) {
-    VECTOR3 nextPosition;
-    std::list<EnemyInfo>::iterator i;
     std::list<TowerGunInfo>::iterator towerGun;
     towerGun = m_Towers[_towerId].GunInfo.begin();
     while (towerGun != m_Towers[_towerId].GunInfo.end()) {
         towerGun->Target->NumAttackers--;
         towerGun = m_Towers[_towerId].GunInfo.erase (towerGun);
     }
-    for (i = m_Enemies.begin(); i != m_Enemies.end(); i++) {
-        if (IsEnemyInTowerRange (_towerX, _towerY, _towerId, i, nextPosition)) {
-            TowerShoot (_towerX, _towerY, _towerId, i, nextPosition);
-            i->NumAttackers++;
+    const std::vector<UINT>& candidates = m_Towers[_towerId].Candidates;
+    for (UINT i = 0; i < candidates.size (); i++) {
+        std::list<EnemyInfo>::iterator enemy = m_TargetEnemies[candidates[i]];
+        if (!enemy->IsDead) {
+            TowerShoot (_towerX, _towerY, _towerId, enemy, GetLeadPosition (_towerId, enemy));
+            enemy->NumAttackers++;
         }
     }
-    m_Towers[_towerId].ShootDelay -= _delta * m_SpeedUpFactor;
+    m_Towers[_towerId].ShootDelay -= _delta;
 }
 
-void Game::UpdateTowerShooting (UINT _towerId, float _Delta) {
-    float towerX = m_Towers[_towerId].Location.x * m_Terrain->GetTerrain()->GetScale(0);
-    float towerY = m_Towers[_towerId].Location.y * m_Terrain->GetTerrain()->GetScale(2);
-    if (m_Towers[_towerId].ShootDelay < m_Towers[_towerId].AttackSpeed) {
-        m_Towers[_towerId].ShootDelay -= _Delta * m_SpeedUpFactor;
-        if (m_Towers[_towerId].ShootDelay < 0.0f) {
-            m_Towers[_towerId].ShootDelay = m_Towers[_towerId].AttackSpeed;
+void Game::AimTowers (UINT _begin, UINT _end, float _Delta) {
+    for (UINT i = _begin; i < _end; i++) {
+        TowerInfo& tower = m_Towers[i];
+        tower.IsFiring = false;
+        if (tower.BuildingTime > 0.0f) {
+            continue;
+        }
+        if (tower.ShootDelay < tower.AttackSpeed) {
+            tower.ShootDelay -= _Delta;
+            if (tower.ShootDelay < 0.0f) {
+                tower.ShootDelay = tower.AttackSpeed;
+            }
+        }
+        tower.IsFiring = fabs (tower.ShootDelay - tower.AttackSpeed) < 0.0001f;
+        if (tower.IsFiring) {
+            FindTowerTargets (i);
         }
     }
+}
 
-    if (fabs (m_Towers[_towerId].ShootDelay - m_Towers[_towerId].AttackSpeed) < 0.0001f) {
+/* after AimTowers */
+void Game::UpdateTowerShooting (UINT _towerId, float _Delta) {
+    float towerX = m_Towers[_towerId].Location.x * m_Terrain->GetTerrain()->GetScale(0);
+    float towerY = m_Towers[_towerId].Location.y * m_Terrain->GetTerrain()->GetScale(2);
+    if (m_Towers[_towerId].IsFiring) {
         switch (m_Towers[_towerId].Type) {
             case BASIC_TOWER:
                 UpdateBasicTowerShooting (towerX, towerY, _towerId, _Delta);